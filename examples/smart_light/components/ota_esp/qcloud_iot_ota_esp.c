@@ -40,6 +40,7 @@
 #define OTA_CLIENT_TASK_PRIO        3
 
 #define ESP_OTA_BUF_LEN   2048
+#define ESP_OTA_BUF_NUM   3
 #define MAX_OTA_RETRY_CNT 3
 #define MAX_SIZE_OF_FW_VERSION 32
 
@@ -55,6 +56,8 @@ typedef struct OTAContextData {
     // remote_version means version for the FW in the cloud and to be downloaded
     char     remote_version[MAX_SIZE_OF_FW_VERSION];
     uint32_t fw_file_size;
+    uint32_t compress_type;
+    uint32_t delta_type;
 
     // for resuming download
     char     downloading_version[MAX_SIZE_OF_FW_VERSION];
@@ -74,85 +77,46 @@ static bool           g_ota_task_running = false;
 
 #define SUPPORT_RESUMING_DOWNLOAD
 
-#ifdef SUPPORT_RESUMING_DOWNLOAD
-
-int _read_esp_fw(void *dst_buf, uint32_t read_size_bytes, uint32_t fetched_bytes, OTAContextData *ota_ctx)
+static int _save_fw_data(OTAContextData *ota_ctx, char *buf, int len)
 {
-    esp_err_t ret;
-    int       retry_cnt = 0;
-
-    if (fetched_bytes % 4 || read_size_bytes % 4) {
-        Log_e("fetched size: %u and read bytes: %u should be word aligned", fetched_bytes, read_size_bytes);
-        return -1;
+    if (esp_ota_write(ota_ctx->esp_ota->handle, buf, len) != ESP_OK) {
+        Log_e("write esp fw failed");
+        return QCLOUD_ERR_FAILURE;
     }
 
-    uint32_t src_addr = ota_ctx->esp_ota->partition.address + fetched_bytes;
-
-    do {
-        ret = spi_flash_read(src_addr, dst_buf, read_size_bytes);
-        if (ret != ESP_OK) {
-            retry_cnt++;
-            if (retry_cnt > 3)
-                return -1;
-            Log_e("read %u bytes from addr %u failed: %u retry: %d", read_size_bytes, src_addr, ret, retry_cnt);
-            HAL_SleepMs(100);
-        }
-    } while (ret != ESP_OK);
-
     return 0;
 }
 
-// calculate left MD5 for resuming download from break point
-static int _cal_exist_fw_md5(OTAContextData *ota_ctx)
+// sink of OTA pipeline, the downloaded size only counts data written to flash
+static int _sink_fw_data(void *user_data, uint32_t offset, const char *buf, uint32_t len)
 {
-    char * buff;
-    size_t rlen, total_read = 0;
-    int    ret = QCLOUD_RET_SUCCESS;
+    OTAContextData *ota_ctx = (OTAContextData *)user_data;
 
-    ret = IOT_OTA_ResetClientMD5(ota_ctx->ota_handle);
-    if (ret) {
-        Log_e("reset MD5 failed: %d", ret);
+    if (!g_ota_task_running) {
+        Log_e("OTA task stopped during downloading!");
         return QCLOUD_ERR_FAILURE;
     }
 
-    buff = HAL_Malloc(ESP_OTA_BUF_LEN);
-    if (buff == NULL) {
-        Log_e("malloc ota buffer failed");
-        return QCLOUD_ERR_MALLOC;
-    }
-
-    size_t size = ota_ctx->downloaded_size;
-
-    while (total_read < ota_ctx->downloaded_size) {
-        rlen = (size > ESP_OTA_BUF_LEN) ? ESP_OTA_BUF_LEN : size;
-        ret = _read_esp_fw(buff, rlen, total_read, ota_ctx);        
-        if (ret) {
-            Log_e("read data from flash error");
-            ret = QCLOUD_ERR_FAILURE;
-            break;
-        }
-        IOT_OTA_UpdateClientMd5(ota_ctx->ota_handle, buff, rlen);
-        size -= rlen;
-        total_read += rlen;
+    if (_save_fw_data(ota_ctx, (char *)buf, len)) {
+        Log_e("write data to file failed");
+        return QCLOUD_ERR_FAILURE;
     }
 
-    HAL_Free(buff);
-    Log_d("total read: %d", total_read);
-    return ret;
+    ota_ctx->downloaded_size = offset + len;
+    return QCLOUD_RET_SUCCESS;
 }
 
-#endif
-
-
-
-static int _save_fw_data(OTAContextData *ota_ctx, char *buf, int len)
+// source of delta firmware, which is patched against the running firmware
+static int _read_running_fw(void *user_data, uint32_t offset, char *buf, uint32_t len)
 {
-    if (esp_ota_write(ota_ctx->esp_ota->handle, buf, len) != ESP_OK) {
-        Log_e("write esp fw failed");
+    const esp_partition_t *running = esp_ota_get_running_partition();
+
+    if (running == NULL || esp_partition_read(running, offset, buf, len) != ESP_OK) {
+        Log_e("read running partition at %u failed", offset);
         return QCLOUD_ERR_FAILURE;
     }
 
-    return 0;
+    return QCLOUD_RET_SUCCESS;
 }
 
 static int _init_esp_fw_ota(EspOTAHandle *ota_handle, size_t fw_size)
@@ -212,24 +176,27 @@ static int _init_esp_fw_ota(EspOTAHandle *ota_handle, size_t fw_size)
 static int _pre_ota_download(OTAContextData *ota_ctx)
 {
 #ifdef SUPPORT_RESUMING_DOWNLOAD
-    // re-generate MD5 for resuming download */
-    if (ota_ctx->downloaded_size 
+    // resuming download in the same partition
+    // compressed or delta image can not be resumed as downloaded_size counts the decoded data
+    if (ota_ctx->downloaded_size && IOT_OTAC_NONE == ota_ctx->compress_type && IOT_OTAD_NONE == ota_ctx->delta_type
             && strncmp(ota_ctx->remote_version, ota_ctx->downloading_version, MAX_SIZE_OF_FW_VERSION) == 0) {
-        Log_i("setup local MD5 with offset: %d for version %s", ota_ctx->downloaded_size, ota_ctx->remote_version);
-        int ret = _cal_exist_fw_md5(ota_ctx);
-        if (ret) {
-            Log_e("regen OTA MD5 error: %d", ret);
-            ota_ctx->downloaded_size = 0;
-            return 0;
-        }
-        Log_d("local MD5 update done!");
+        // MD5 is restored from checkpoint by IOT_OTA_StartDownload, no need to read back the flash
+        Log_i("resume download with offset: %d for version %s", ota_ctx->downloaded_size, ota_ctx->remote_version);
         return 0;
     }
 #endif
 
     // new download, erase partition first
     ota_ctx->downloaded_size = 0;
-    if (_init_esp_fw_ota(ota_ctx->esp_ota, ota_ctx->fw_file_size)) {
+    uint32_t image_size      = ota_ctx->fw_file_size;
+    if (IOT_OTAC_NONE != ota_ctx->compress_type || IOT_OTAD_NONE != ota_ctx->delta_type) {
+        IOT_OTA_Ioctl(ota_ctx->ota_handle, IOT_OTAG_RAW_FILE_SIZE, &image_size, 4);
+        if (0 == image_size) {
+            image_size = OTA_SIZE_UNKNOWN;
+        }
+    }
+
+    if (_init_esp_fw_ota(ota_ctx->esp_ota, image_size)) {
         Log_e("init esp ota failed");
         return QCLOUD_ERR_FAILURE;
     }
@@ -259,10 +226,8 @@ static void _ota_update_task(void *pvParameters)
 {
     OTAContextData *ota_ctx               = (OTAContextData *)pvParameters;
     bool            upgrade_fetch_success = true;
-    char *          buf_ota               = NULL;
     int             rc;
     void *          h_ota               = ota_ctx->ota_handle;
-    int             mqtt_disconnect_cnt = 0;
     EspOTAHandle    esp_ota             = {0};
 
     if (h_ota == NULL) {
@@ -284,9 +249,24 @@ begin_of_ota:
             Log_i(">>>>>>>>>> start firmware download!");
 
             IOT_OTA_Ioctl(h_ota, IOT_OTAG_FILE_SIZE, &ota_ctx->fw_file_size, 4);
+            IOT_OTA_Ioctl(h_ota, IOT_OTAG_COMPRESS_TYPE, &ota_ctx->compress_type, 4);
+            IOT_OTA_Ioctl(h_ota, IOT_OTAG_DELTA_TYPE, &ota_ctx->delta_type, 4);
             memset(ota_ctx->remote_version, 0, MAX_SIZE_OF_FW_VERSION);
             IOT_OTA_Ioctl(h_ota, IOT_OTAG_VERSION, ota_ctx->remote_version, MAX_SIZE_OF_FW_VERSION);
 
+            if (IOT_OTAD_NONE != ota_ctx->delta_type) {
+                char source_version[MAX_SIZE_OF_FW_VERSION + 1] = {0};
+                IOT_OTA_Ioctl(h_ota, IOT_OTAG_SOURCE_VERSION, source_version, sizeof(source_version));
+                if (source_version[0] && strcmp(source_version, ota_ctx->local_version)) {
+                    Log_e("delta firmware is for version %s, local version %s", source_version,
+                          ota_ctx->local_version);
+                    upgrade_fetch_success = false;
+                    // don't retry for this error
+                    ota_ctx->ota_fail_cnt = MAX_OTA_RETRY_CNT + 1;
+                    goto end_of_ota;
+                }
+            }
+
             rc = _pre_ota_download(ota_ctx);
             if (rc) {
                 Log_e("pre ota download failed: %d", rc);
@@ -294,13 +274,6 @@ begin_of_ota:
                 goto end_of_ota;
             }
 
-            buf_ota = HAL_Malloc(ESP_OTA_BUF_LEN + 1);
-            if (buf_ota == NULL) {
-                Log_e("malloc ota buffer failed");
-                upgrade_fetch_success = false;
-                goto end_of_ota;
-            }
-
             /*set offset and start http connect*/
             rc = IOT_OTA_StartDownload(h_ota, ota_ctx->downloaded_size, ota_ctx->fw_file_size);
             if (QCLOUD_RET_SUCCESS != rc) {
@@ -309,50 +282,24 @@ begin_of_ota:
                 goto end_of_ota;
             }
 
-            // download and save the fw
-            while (!IOT_OTA_IsFetchFinish(h_ota)) {
-                if (!g_ota_task_running) {
-                    Log_e("OTA task stopped during downloading!");
-                    upgrade_fetch_success = false;
-                    goto end_of_ota;
-                }
-
-                memset(buf_ota, 0, ESP_OTA_BUF_LEN + 1);
-                int len = IOT_OTA_FetchYield(h_ota, buf_ota, ESP_OTA_BUF_LEN + 1, 20);
-                if (len > 0) {
-                    // Log_i("save fw data %d from addr %u", len, ota_ctx->downloaded_size);
-                    rc = _save_fw_data(ota_ctx, buf_ota, len);
-                    if (rc) {
-                        Log_e("write data to file failed");
-                        upgrade_fetch_success = false;
-                        goto end_of_ota;
-                    }
-                } else if (len < 0) {
-                    Log_e("download fail rc=%d, size_downloaded=%u", len, ota_ctx->downloaded_size);
-                    upgrade_fetch_success = false;
-                    goto end_of_ota;
-                } else {
-                    Log_e("OTA download timeout! size_downloaded=%u", ota_ctx->downloaded_size);
-                    upgrade_fetch_success = false;
-                    goto end_of_ota;
-                }
-
-                // get OTA downloaded size
-                IOT_OTA_Ioctl(h_ota, IOT_OTAG_FETCHED_SIZE, &ota_ctx->downloaded_size, 4);
-                // delay is needed to avoid TCP read timeout
-                HAL_SleepMs(500);
+            // download and save the fw, flash write overlaps with the next fetch
+            OTAPipelineParams pipeline_params = DEFAULT_OTA_PIPELINE_PARAMS;
+            pipeline_params.sink              = _sink_fw_data;
+            pipeline_params.user_data         = ota_ctx;
+            pipeline_params.buf_num           = ESP_OTA_BUF_NUM;
+            pipeline_params.buf_len           = ESP_OTA_BUF_LEN;
+            pipeline_params.timeout_s         = 20;
+            if (IOT_OTAD_NONE != ota_ctx->delta_type) {
+                const esp_partition_t *running = esp_ota_get_running_partition();
+                pipeline_params.source_read    = _read_running_fw;
+                pipeline_params.source_size    = running ? running->size : 0;
+            }
 
-                if (!IOT_MQTT_IsConnected(ota_ctx->mqtt_client)) {
-                    mqtt_disconnect_cnt++;
-                    Log_e("MQTT disconnect %d during OTA download!", mqtt_disconnect_cnt);
-                    if (mqtt_disconnect_cnt > 3) {
-                        upgrade_fetch_success = false;
-                        goto end_of_ota;
-                    }
-                    HAL_SleepMs(2000);
-                } else {
-                    mqtt_disconnect_cnt = 0;
-                }
+            rc = IOT_OTA_FetchPipeline(h_ota, &pipeline_params);
+            if (QCLOUD_RET_SUCCESS != rc) {
+                Log_e("download fail rc=%d, size_downloaded=%u", rc, ota_ctx->downloaded_size);
+                upgrade_fetch_success = false;
+                goto end_of_ota;
             }
 
             /* Must check MD5 match or not */
@@ -400,8 +347,6 @@ end_of_ota:
     // do it again
     if (g_ota_task_running && IOT_MQTT_IsConnected(ota_ctx->mqtt_client) && !upgrade_fetch_success &&
         ota_ctx->ota_fail_cnt <= MAX_OTA_RETRY_CNT) {
-        HAL_Free(buf_ota);
-        buf_ota               = NULL;
         g_fw_downloading      = false;
         upgrade_fetch_success = true;
 
@@ -440,11 +385,6 @@ end_of_ota:
     g_fw_downloading = false;
     Log_w(">>>>>>>>>> OTA task going to be deleted");
 
-    if (buf_ota) {
-        HAL_Free(buf_ota);
-        buf_ota = NULL;
-    }
-
     IOT_OTA_Destroy(ota_ctx->ota_handle);
     memset(ota_ctx, 0, sizeof(OTAContextData));
 
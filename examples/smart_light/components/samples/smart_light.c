@@ -701,6 +701,14 @@ int smart_light_demo(void)
         return QCLOUD_ERR_FAILURE;
     }
 
+#ifdef EVENT_POST_ENABLED
+    // alarm bursts are posted in a few events_post documents instead of one per event
+    rc = IOT_Event_Set_Batch(client, 500, 1024);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        ESP_LOGE(TAG, "set event batch fail: %d", rc);
+    }
+#endif
+
 #ifdef MULTITHREAD_ENABLED
     rc = IOT_Template_Start_Yield_Thread(client);
     if (rc != QCLOUD_RET_SUCCESS) {
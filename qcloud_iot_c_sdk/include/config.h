@@ -17,6 +17,9 @@
 // /* #undef AT_OS_USED */
 // /* #undef AT_DEBUG */
 // //#define OTA_USE_HTTPS
+// //#define OTA_PARALLEL_FETCH
+// //#define HASH_HW_ACCEL
+// //#define LOG_ASYNC
 // #define MULTITHREAD_ENABLED
 
 #undef AUTH_MODE_CERT 
@@ -37,4 +40,7 @@
 #undef AT_OS_USED
 #undef AT_DEBUG
 //#define OTA_USE_HTTPS
+//#define OTA_PARALLEL_FETCH
+//#define HASH_HW_ACCEL
+//#define LOG_ASYNC
 #define MULTITHREAD_ENABLED
\ No newline at end of file
@@ -82,6 +82,16 @@ typedef struct _sEvent_ {
 
 #endif
 
+/* The payload codec of upstream property/event/action documents.
+ * With CBOR, documents of IOT_Template_Report_Changed, IOT_Post_Event and IOT_ACTION_REPLY
+ * are encoded from the properties directly, and the pJsonDoc buffer passed to them holds
+ * the CBOR document. JSON documents passed by caller, like the one of IOT_Template_Report,
+ * are converted before publish. CBOR downstream messages are decoded into JSON. */
+typedef enum {
+    TEMPLATE_CODEC_JSON = 0,  // JSON text, default
+    TEMPLATE_CODEC_CBOR = 1,  // CBOR(RFC 7049) binary
+} eTemplateCodec;
+
 /* The structure of data_template init parameters */
 typedef struct {
     char *region;  // region
@@ -107,17 +117,19 @@ typedef struct {
 
     MQTTEventHandler event_handle;  // event callback
 
+    eTemplateCodec codec;  // payload codec of upstream documents
+
 } TemplateInitParams;
 
 #ifdef AUTH_MODE_CERT
-#define DEFAULT_TEMPLATE_INIT_PARAMS                                   \
-    {                                                                  \
-        "china", NULL, NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, { 0 } \
+#define DEFAULT_TEMPLATE_INIT_PARAMS                                                        \
+    {                                                                                       \
+        "china", NULL, NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, { 0 }, TEMPLATE_CODEC_JSON \
     }
 #else
-#define DEFAULT_TEMPLATE_INIT_PARAMS                             \
-    {                                                            \
-        "china", NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, { 0 } \
+#define DEFAULT_TEMPLATE_INIT_PARAMS                                                  \
+    {                                                                                 \
+        "china", NULL, NULL, NULL, 2000, 240 * 1000, 1, 1, { 0 }, TEMPLATE_CODEC_JSON \
     }
 #endif
 
@@ -348,6 +360,63 @@ int IOT_Template_Report(void *handle, char *pJsonDoc, size_t sizeOfBuffer, OnRep
  */
 int IOT_Template_Report_Sync(void *handle, char *pJsonDoc, size_t sizeOfBuffer, uint32_t timeout_ms);
 
+/**
+ * @brief report the registered properties whose value changed since last report.
+ * SDK keeps a copy of each registered property's last reported value, and only
+ * the properties differ from it are put into the report document. The copy is
+ * updated when the report is accepted, the properties are reported again if it is
+ * rejected or timeout.
+ * Changes happen within window_ms after a report are coalesced into the next one.
+ *
+ * @param pClient           handle to data_template client
+ * @param pJsonDoc          string buffer to construct the report JSON document
+ * @param sizeOfBuffer      size of string buffer
+ * @param window_ms         min interval between two reports (unit: ms)
+ * @param callback          callback when response arrive
+ * @param userContext       user data for callback
+ * @param timeout_ms        timeout value for this operation (unit: ms)
+ * @return                  number of properties reported (0 if nothing changed or
+ * still within window), or err code (<0) for failure
+ */
+int IOT_Template_Report_Changed(void *handle, char *pJsonDoc, size_t sizeOfBuffer, uint32_t window_ms,
+                                OnReplyCallback callback, void *userContext, uint32_t timeout_ms);
+
+/**
+ * @brief set the deadband of a registered float/double property, changes less
+ * than deadband are not reported by IOT_Template_Report_Changed
+ *
+ * @param pClient           handle to data_template client
+ * @param pProperty         registered device property
+ * @param deadband          min change to be reported, 0 means any change
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int IOT_Template_Set_Property_Deadband(void *handle, DeviceProperty *pProperty, float deadband);
+
+/**
+ * @brief force a registered property into next IOT_Template_Report_Changed,
+ * regardless of its value
+ *
+ * @param pClient           handle to data_template client
+ * @param pProperty         registered device property
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int IOT_Template_Mark_Property_Changed(void *handle, DeviceProperty *pProperty);
+
+/**
+ * @brief enable coalescing of IOT_Template_Report. Reports issued within window_ms
+ * are merged into one document (later value of the same property wins) and sent
+ * on next yield, every report callback is resolved by the single reply.
+ *
+ * @param pClient           handle to data_template client
+ * @param window_ms         time budget to hold a report for merging (unit: ms), 0 to disable
+ * @param max_size          size budget of the merged params, a full budget flushes the report
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int IOT_Template_Set_Report_Coalesce(void *handle, uint32_t window_ms, uint16_t max_size);
+
 /**
  * @brief Get data_template state from server in asynchronized way.
  * Generally it's a way to sync data_template data during offline
@@ -504,7 +573,30 @@ int IOT_Event_Init(void *c);
 void handle_template_expired_event(void *client);
 
 /**
- * @brief post event to cloud, SDK construct event json package
+ * @brief enable batching of IOT_Post_Event. Events posted within window_ms are
+ * queued and sent in one events_post document on next yield, the single reply
+ * calls back every distinct replyCb of the batch once.
+ *
+ * @param client            handle to data_template client
+ * @param window_ms         time budget to hold an event for batching (unit: ms), 0 to disable
+ * @param max_size          size budget of the batched events, a full budget posts the batch
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int IOT_Event_Set_Batch(void *client, uint32_t window_ms, uint16_t max_size);
+
+/**
+ * @brief post the pending event batch at once
+ *
+ * @param client            handle to data_template client
+ * @return @see IoT_Error_Code
+ */
+int IOT_Event_Flush(void *client);
+
+/**
+ * @brief post event to cloud, SDK construct event json package.
+ * If batching is enabled by IOT_Event_Set_Batch, the events are serialized into
+ * the pending batch and posted later, pJsonDoc is only used as scratch buffer.
  * @param pClient 		  handle to data_template client
  * @param pJsonDoc	  	  data buffer for event post
  * @param sizeOfBuffer    length of data buffer
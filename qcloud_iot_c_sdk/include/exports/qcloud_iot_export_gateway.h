@@ -26,7 +26,9 @@
 extern "C" {
 #endif
 
+#include "qcloud_iot_export_data_template.h"
 #include "qcloud_iot_export_mqtt.h"
+#include "qcloud_iot_export_ota.h"
 
 /* Gateway and sub-device parameter */
 typedef struct {
@@ -57,14 +59,15 @@ typedef void (*GatewayEventHandleFun)(void *client, void *context, void *msg);
 
 /* The structure of gateway init param */
 typedef struct {
-    MQTTInitParams        init_param;    /* MQTT params */
-    void *                event_context; /* the user context */
-    GatewayEventHandleFun event_handler; /* event handler for gateway user*/
+    MQTTInitParams        init_param;     /* MQTT params */
+    void *                event_context;  /* the user context */
+    GatewayEventHandleFun event_handler;  /* event handler for gateway user*/
+    int                   max_subdev_num; /* max number of sub-devices online, 0 for MAX_NUM_SUB_DEV */
 } GatewayInitParam;
 
-#define DEFAULT_GATEWAY_INIT_PARAMS         \
-    {                                       \
-        DEFAULT_MQTTINIT_PARAMS, NULL, NULL \
+#define DEFAULT_GATEWAY_INIT_PARAMS                          \
+    {                                                        \
+        DEFAULT_MQTTINIT_PARAMS, NULL, NULL, MAX_NUM_SUB_DEV \
     }
 
 /**
@@ -105,6 +108,106 @@ int IOT_Gateway_Subdev_Online(void *client, GatewayParam *param);
  */
 int IOT_Gateway_Subdev_Offline(void *client, GatewayParam *param);
 
+/* Sub-device of batch online/offline, result is set when the batch completes */
+typedef struct {
+    char *product_id;  /* product of sub-device */
+    char *device_name; /* name of sub-device */
+    int   result;      /* QCLOUD_RET_SUCCESS, or err code for failure */
+} GatewaySubdevStatus;
+
+/**
+ * @brief Define a callback to be invoked when batch online/offline completes
+ *
+ * @param client        handle to gateway client
+ * @param user_data     user data of GatewayBatchParam
+ * @param subdevs       sub-devices of the batch, with result of each
+ * @param subdev_num    number of sub-devices
+ * @param failed        number of sub-devices failed or timed out
+ */
+typedef void (*GatewayBatchCallback)(void *client, void *user_data, GatewaySubdevStatus *subdevs, int subdev_num,
+                                     int failed);
+
+/* Parameters of batch online/offline */
+typedef struct {
+    /*gateway device info */
+    char *product_id;
+    char *device_name;
+    /*sub-devices, kept by caller until the batch completes */
+    GatewaySubdevStatus *subdevs;
+    int                  subdev_num;
+
+    uint32_t             timeout_ms; /* timeout waiting for results of all sub-devices */
+    GatewayBatchCallback callback;   /* completion callback, NULL to block until completion */
+    void *               user_data;  /* user data of callback */
+} GatewayBatchParam;
+
+#define DEFAULT_GATEWAY_BATCH_PARAMS           \
+    {                                          \
+        NULL, NULL, NULL, 0, 20000, NULL, NULL \
+    }
+
+/**
+ * @brief Make sub-devices online in batch. Sub-devices are sent in as few messages as
+ *        the payload buffer allows, and results of them are matched as they arrive.
+ *        With callback, it returns once the messages are sent, and the callback is
+ *        invoked in IOT_Gateway_Yield (or yield thread) when all the results arrive or
+ *        timeout. Without callback, it blocks until then. Batches and single sub-device
+ *        operations may overlap, but not for the same sub-device and operation.
+ *
+ * @param client    handle to gateway client
+ * @param param     batch parameters
+ *
+ * @return QCLOUD_RET_SUCCESS when the batch is sent (with callback) or all sub-devices
+ *         are online (without callback), or err code for failure, see result of each
+ */
+int IOT_Gateway_Subdev_Batch_Online(void *client, GatewayBatchParam *param);
+
+/**
+ * @brief Make sub-devices offline in batch, the same way as IOT_Gateway_Subdev_Batch_Online
+ *
+ * @param client    handle to gateway client
+ * @param param     batch parameters
+ *
+ * @return QCLOUD_RET_SUCCESS when the batch is sent (with callback) or all sub-devices
+ *         are offline (without callback), or err code for failure, see result of each
+ */
+int IOT_Gateway_Subdev_Batch_Offline(void *client, GatewayBatchParam *param);
+
+/**
+ * @brief Get handle of sub-device session, to access the sub-device without looking up
+ *        by name. The handle is valid until the sub-device is offline, then it is
+ *        rejected by the APIs taking it.
+ *
+ * @param client        handle to gateway client
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ *
+ * @return handle of sub-device when it has session, or NULL otherwise
+ */
+void *IOT_Gateway_Subdev_Get_Handle(void *client, const char *product_id, const char *device_name);
+
+/**
+ * @brief Check if sub-device is online
+ *
+ * @param client    handle to gateway client
+ * @param subdev    handle of sub-device
+ *
+ * @return true when the sub-device is online, or false otherwise
+ */
+bool IOT_Gateway_Subdev_Is_Online(void *client, void *subdev);
+
+/**
+ * @brief Publish MQTT message of sub-device, which should be online
+ *
+ * @param client        handle to gateway client
+ * @param subdev        handle of sub-device
+ * @param topic_name    MQTT topic name
+ * @param params        publish parameters
+ *
+ * @return packet id (>=0) when success, or err code (<0) for failure
+ */
+int IOT_Gateway_Subdev_Publish(void *client, void *subdev, char *topic_name, PublishParams *params);
+
 /**
  * @brief Publish gateway MQTT message
  *
@@ -194,6 +297,244 @@ void IOT_Gateway_Stop_Yield_Thread(void *pClient);
 bool IOT_Gateway_Get_Yield_Status(void *pClient, int *exit_code);
 #endif
 
+#ifdef OTA_MQTT_CHANNEL
+/**
+ * @brief Write firmware image downloaded by gateway to local storage
+ *
+ * @param user_data     user data of GatewayOTAParams
+ * @param product_id    product of the image
+ * @param version       version of the image
+ * @param offset        offset of data in image, data is written in order from 0
+ * @param buf           image data
+ * @param len           length of data
+ *
+ * @return QCLOUD_RET_SUCCESS when success, or err code to abort the download
+ */
+typedef int (*GatewayOTAWriteCallback)(void *user_data, const char *product_id, const char *version, uint32_t offset,
+                                       const char *buf, uint32_t len);
+
+/**
+ * @brief Remove image from local storage, when it is replaced or the gateway OTA is destroyed
+ *
+ * @param user_data     user data of GatewayOTAParams
+ * @param product_id    product of the image
+ * @param version       version of the image
+ */
+typedef void (*GatewayOTARemoveCallback)(void *user_data, const char *product_id, const char *version);
+
+/**
+ * @brief Image for sub-device is downloaded and verified. Transfer it from local storage
+ *        to the sub-device over local transport, and report by IOT_Gateway_OTA_ReportProgress
+ *        and IOT_Gateway_OTA_ReportUpgrade.
+ *
+ * @param user_data     user data of GatewayOTAParams
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ * @param version       version of the image
+ * @param size          size of the image
+ * @param md5sum        MD5 of the image
+ */
+typedef void (*GatewayOTAReadyCallback)(void *user_data, const char *product_id, const char *device_name,
+                                        const char *version, uint32_t size, const char *md5sum);
+
+/* parameters of gateway OTA */
+typedef struct {
+    GatewayOTAWriteCallback  write;     /* write image to local storage */
+    GatewayOTARemoveCallback remove;    /* remove image from local storage, optional */
+    GatewayOTAReadyCallback  on_ready;  /* image is ready for sub-device */
+    void *                   user_data; /* user data of callbacks */
+    uint32_t                 buf_len;   /* length of download buffer */
+    uint32_t                 timeout_s; /* timeout of fetching each buffer (unit: second) */
+} GatewayOTAParams;
+
+#define DEFAULT_GATEWAY_OTA_PARAMS       \
+    {                                    \
+        NULL, NULL, NULL, NULL, 2048, 20 \
+    }
+
+/**
+ * @brief Create gateway OTA, which downloads the firmware of each product and version
+ *        once into local storage, and serves it to all the sub-devices upgrading to it.
+ *        Firmware is cached as it is published, compressed or delta firmware is left
+ *        for the sub-device to decode.
+ *
+ * @param client    handle to gateway client
+ * @param params    gateway OTA parameters
+ *
+ * @return a valid gateway OTA handle when success, or NULL otherwise
+ */
+void *IOT_Gateway_OTA_Init(void *client, GatewayOTAParams *params);
+
+/**
+ * @brief Destroy gateway OTA, OTA topics of sub-devices are unsubscribed and cached images removed
+ *
+ * @param handle    handle to gateway OTA
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_OTA_Destroy(void *handle);
+
+/**
+ * @brief Subscribe OTA topic of online sub-device and report its version
+ *
+ * @param handle        handle to gateway OTA
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ * @param version       running firmware version of sub-device
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_OTA_Subdev_Add(void *handle, const char *product_id, const char *device_name, const char *version);
+
+/**
+ * @brief Stop OTA of sub-device and unsubscribe its OTA topic
+ *
+ * @param handle        handle to gateway OTA
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_OTA_Subdev_Remove(void *handle, const char *product_id, const char *device_name);
+
+/**
+ * @brief Download one image requested by sub-devices if any, and call on_ready for
+ *        sub-devices whose image is cached. Call it periodically out of MQTT callback.
+ *
+ * @param handle    handle to gateway OTA
+ *
+ * @return QCLOUD_RET_SUCCESS when nothing to do or the image is cached,
+ *         or err code of download failure, which is reported to the sub-devices
+ */
+int IOT_Gateway_OTA_Yield(void *handle);
+
+/**
+ * @brief Report progress of transferring image to sub-device
+ *
+ * @param handle        handle to gateway OTA
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ * @param percent       progress percentage, [0, 100]
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_OTA_ReportProgress(void *handle, const char *product_id, const char *device_name, int percent);
+
+/**
+ * @brief Report upgrade state of sub-device. Sub-device is detached from its image
+ *        on IOT_OTAR_UPGRADE_SUCCESS or IOT_OTAR_UPGRADE_FAIL.
+ *
+ * @param handle        handle to gateway OTA
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ * @param type          IOT_OTAR_UPGRADE_BEGIN, IOT_OTAR_UPGRADE_SUCCESS or IOT_OTAR_UPGRADE_FAIL
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_OTA_ReportUpgrade(void *handle, const char *product_id, const char *device_name,
+                                  IOT_OTAReportType type);
+#endif
+
+/**
+ * @brief Property of sub-device is updated by control message. Reply to the message
+ *        by IOT_Gateway_Template_ControlReply with client_token.
+ *
+ * @param user_data     user data of the sub-device
+ * @param subdev        handle to sub-device template
+ * @param client_token  clientToken of the control message
+ * @param property      property updated
+ */
+typedef void (*GatewayTemplateControlCallback)(void *user_data, void *subdev, const char *client_token,
+                                               DeviceProperty *property);
+
+/**
+ * @brief Create data template of sub-devices. All the sub-devices share the gateway
+ *        connection and a single subscription of $thing/down/property/+/+, messages
+ *        are dispatched by product and device name of the topic. Replies are matched
+ *        and timed out in IOT_Gateway_Yield. One per gateway.
+ *
+ * @param client        handle to gateway client
+ * @param max_pending   max number of reports waiting for reply of all sub-devices
+ *
+ * @return a valid gateway template handle when success, or NULL otherwise
+ */
+void *IOT_Gateway_Template_Init(void *client, uint16_t max_pending);
+
+/**
+ * @brief Destroy data template of sub-devices, pending reports are dropped without callback.
+ *        It waits for the messages being handled by yield in other threads, so should not be
+ *        called in callbacks of the template
+ *
+ * @param handle    handle to gateway template
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_Template_Destroy(void *handle);
+
+/**
+ * @brief Add data template of online sub-device. The properties are kept by reference
+ *        and updated in place by control message, so they should outlive the sub-device
+ *        template. Keys of properties should be unique.
+ *
+ * @param handle        handle to gateway template
+ * @param product_id    product of sub-device
+ * @param device_name   name of sub-device
+ * @param properties    properties of sub-device
+ * @param property_num  number of properties
+ * @param callback      callback when property is updated by control message
+ * @param user_data     user data of callback
+ *
+ * @return handle to sub-device template, or NULL for failure
+ */
+void *IOT_Gateway_Template_Subdev_Add(void *handle, const char *product_id, const char *device_name,
+                                      DeviceProperty *properties, uint8_t property_num,
+                                      GatewayTemplateControlCallback callback, void *user_data);
+
+/**
+ * @brief Remove data template of sub-device, reports pending are dropped without callback,
+ *        and control messages are not delivered any more
+ *
+ * @param handle    handle to gateway template
+ * @param subdev    handle to sub-device template
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_Template_Subdev_Remove(void *handle, void *subdev);
+
+/**
+ * @brief Report properties of sub-device in asynchronized way
+ *
+ * @param handle        handle to gateway template
+ * @param subdev        handle to sub-device template
+ * @param buf           buffer to construct the report JSON document
+ * @param size          size of buffer
+ * @param count         number of properties to report
+ * @param properties    properties to report
+ * @param callback      callback when reply arrives or timeout, with subdev as pClient. NULL if no reply wanted
+ * @param user_context  user data of callback
+ * @param timeout_ms    timeout of reply (unit: ms)
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_Template_Report(void *handle, void *subdev, char *buf, size_t size, uint8_t count,
+                                DeviceProperty *properties[], OnReplyCallback callback, void *user_context,
+                                uint32_t timeout_ms);
+
+/**
+ * @brief Reply to control message of sub-device
+ *
+ * @param handle        handle to gateway template
+ * @param subdev        handle to sub-device template
+ * @param buf           buffer to construct the reply JSON document
+ * @param size          size of buffer
+ * @param client_token  clientToken of the control message
+ * @param reply         reply info
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int IOT_Gateway_Template_ControlReply(void *handle, void *subdev, char *buf, size_t size, const char *client_token,
+                                      sReplyPara *reply);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,7 @@ extern "C" {
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -37,6 +38,35 @@ extern "C" {
  */
 typedef enum { eLOG_DISABLE = 0, eLOG_ERROR = 1, eLOG_WARN = 2, eLOG_INFO = 3, eLOG_DEBUG = 4 } LOG_LEVEL;
 
+/**
+ * SDK modules with their own log print level
+ */
+typedef enum {
+    eLOG_MODULE_SDK = 0,  // modules not listed below and user application
+    eLOG_MODULE_MQTT,
+    eLOG_MODULE_TEMPLATE,
+    eLOG_MODULE_OTA,
+    eLOG_MODULE_HTTP,
+    eLOG_MODULE_TLS,
+    eLOG_MODULE_GATEWAY,
+    eLOG_MODULE_NUM,
+} LOG_MODULE;
+
+/**
+ * logs with level greater than this are removed at compile time, including evaluation of their
+ * arguments. Set it by compile option, e.g. -DLOG_COMPILE_LEVEL=2 keeps only error and warning logs
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 4
+#endif
+
+/**
+ * module of the logs in a source file, define it before any include to apply level of the module
+ */
+#ifndef LOG_LOCAL_MODULE
+#define LOG_LOCAL_MODULE eLOG_MODULE_SDK
+#endif
+
 /**
  * log print level control, only print logs with level less or equal to this
  * variable
@@ -49,6 +79,13 @@ extern LOG_LEVEL g_log_print_level;
  */
 extern LOG_LEVEL g_log_upload_level;
 
+/**
+ * logs of each module with level less or equal to this are generated, which is the greater one of
+ * module print level and upload level. Checked inline by Log_x macros before evaluating arguments,
+ * it is updated by IOT_Log_Set_Level, IOT_Log_Set_Module_Level and IOT_Log_Set_Upload_Level
+ */
+extern uint8_t g_log_module_gate[eLOG_MODULE_NUM];
+
 /* user's self defined log handler callback */
 typedef bool (*LogMessageHandler)(const char *message);
 
@@ -58,8 +95,9 @@ typedef bool (*LogMessageHandler)(const char *message);
  */
 // callback for saving logs into NVS(files/FLASH) after upload fail
 typedef size_t (*LogSaveFunc)(const char *msg, size_t wLen);
-// callback for reading logs from NVS(files/FLASH) when upload ready
-typedef size_t (*LogReadFunc)(char *buff, size_t rLen);
+// callback for reading logs from NVS(files/FLASH) when upload ready, up to rLen bytes
+// from offset of saved logs. return length read, 0 when nothing left
+typedef size_t (*LogReadFunc)(char *buff, size_t rLen, size_t offset);
 // callback for deleting logs in NVS(files/FLASH). return 0 when success
 typedef int (*LogDelFunc)();
 // callback for reading the size of logs in NVS(files/FLASH). return 0 when
@@ -81,6 +119,13 @@ typedef struct {
     LogReadFunc    read_func;
     LogDelFunc     del_func;
     LogGetSizeFunc get_size_func;
+    /* region of log server, NULL for default */
+    const char *region;
+    /* upload to this host instead of log server of region, e.g. a local server for test */
+    const char *host;
+    uint16_t    port;  // port of host, 0 for default
+    /* compress the post body with deflate, which costs about 5KB memory more */
+    bool compress;
 } LogUploadInitParams;
 
 /**
@@ -97,6 +142,23 @@ void IOT_Log_Set_Level(LOG_LEVEL level);
  */
 LOG_LEVEL IOT_Log_Get_Level();
 
+/**
+ * @brief Set the log level of print for one module, the others are not affected.
+ *        IOT_Log_Set_Level resets levels of all modules
+ *
+ * @param module
+ * @param level
+ */
+void IOT_Log_Set_Module_Level(LOG_MODULE module, LOG_LEVEL level);
+
+/**
+ * @brief Get the log level of print for one module
+ *
+ * @param module
+ * @return
+ */
+LOG_LEVEL IOT_Log_Get_Module_Level(LOG_MODULE module);
+
 /**
  * @brief Set the global log level of upload
  *
@@ -149,6 +211,10 @@ int IOT_Log_Upload(bool force_upload);
  *
  * When LOG_UPLOAD is enabled, the log will be uploaded to cloud server
  *
+ * When LOG_ASYNC is enabled, only the time, the format pointer and arguments are recorded,
+ * so fmt should be static as string literal of Log_x macros. The log is formatted
+ * and output later by IOT_Log_Flush.
+ *
  * @param file
  * @param func
  * @param line
@@ -156,11 +222,59 @@ int IOT_Log_Upload(bool force_upload);
  */
 void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...);
 
+/**
+ * @brief Generate log of a module, printed according to level of the module, as Log_x macros do
+ *
+ * @param module
+ * @param file
+ * @param func
+ * @param line
+ * @param level
+ */
+void IOT_Log_Gen_Module(const int module, const char *file, const char *func, const int line, const int level,
+                        const char *fmt, ...);
+
+#ifdef LOG_ASYNC
+/**
+ * @brief Format and output the logs deferred by LOG_ASYNC, in the caller's context.
+ *        Call it periodically if the async log thread is not started.
+ *
+ * @return number of logs output
+ */
+int IOT_Log_Flush(void);
+
+#ifdef MULTITHREAD_ENABLED
+/**
+ * @brief Start a thread calling IOT_Log_Flush periodically, low priority is recommended
+ *
+ * @param priority      thread priority
+ * @param stack_size    thread stack size, room for one formatted log line is needed
+ * @return QCLOUD_RET_SUCCESS when success, or error code when fail
+ */
+int IOT_Log_Start_Async_Thread(uint16_t priority, uint32_t stack_size);
+
+/**
+ * @brief Stop the async log thread, the thread flushes the logs left before exit
+ */
+void IOT_Log_Stop_Async_Thread(void);
+#endif
+#endif
+
+/* check if logs of level are generated in current module, to skip preparing of costly arguments */
+#define IOT_LOG_ENABLED(level) ((level) <= LOG_COMPILE_LEVEL && (level) <= g_log_module_gate[LOG_LOCAL_MODULE])
+
+#define IOT_LOG_GEN(level, fmt, ...)                                                                          \
+    do {                                                                                                      \
+        if (IOT_LOG_ENABLED(level)) {                                                                         \
+            IOT_Log_Gen_Module(LOG_LOCAL_MODULE, __FILE__, __FUNCTION__, __LINE__, level, fmt, ##__VA_ARGS__); \
+        }                                                                                                     \
+    } while (0)
+
 /* Simple APIs for log generation in different level */
-#define Log_d(fmt, ...) IOT_Log_Gen(__FILE__, __FUNCTION__, __LINE__, eLOG_DEBUG, fmt, ##__VA_ARGS__)
-#define Log_i(fmt, ...) IOT_Log_Gen(__FILE__, __FUNCTION__, __LINE__, eLOG_INFO, fmt, ##__VA_ARGS__)
-#define Log_w(fmt, ...) IOT_Log_Gen(__FILE__, __FUNCTION__, __LINE__, eLOG_WARN, fmt, ##__VA_ARGS__)
-#define Log_e(fmt, ...) IOT_Log_Gen(__FILE__, __FUNCTION__, __LINE__, eLOG_ERROR, fmt, ##__VA_ARGS__)
+#define Log_d(fmt, ...) IOT_LOG_GEN(eLOG_DEBUG, fmt, ##__VA_ARGS__)
+#define Log_i(fmt, ...) IOT_LOG_GEN(eLOG_INFO, fmt, ##__VA_ARGS__)
+#define Log_w(fmt, ...) IOT_LOG_GEN(eLOG_WARN, fmt, ##__VA_ARGS__)
+#define Log_e(fmt, ...) IOT_LOG_GEN(eLOG_ERROR, fmt, ##__VA_ARGS__)
 
 /* Macro for debug mode */
 #ifdef IOT_DEBUG
@@ -40,6 +40,9 @@ typedef enum {
     IOT_OTA_ERR_NOMEM           = -9,
     IOT_OTA_ERR_OSC_FAILED      = -10,
     IOT_OTA_ERR_REPORT_VERSION  = -11,
+    IOT_OTA_ERR_DECOMPRESS      = -12,
+    IOT_OTA_ERR_PATCH           = -13,
+    IOT_OTA_ERR_VERIFY          = -14,
     IOT_OTA_ERR_NONE            = 0
 
 } IOT_OTA_Error_Code;
@@ -83,11 +86,30 @@ typedef enum {
     IOT_OTAG_FETCHED_SIZE,  /* Size of firmware fetched */
     IOT_OTAG_FILE_SIZE,     /* Total size of firmware */
     IOT_OTAG_MD5SUM,        /* firmware md5 checksum (string) */
-    IOT_OTAG_VERSION,       /* firmware version (string) */
-    IOT_OTAG_CHECK_FIRMWARE /* check firmware */
+    IOT_OTAG_VERSION,        /* firmware version (string) */
+    IOT_OTAG_CHECK_FIRMWARE, /* check firmware */
+    IOT_OTAG_COMPRESS_TYPE,  /* compress type of firmware, refer to IOT_OTA_CompressType */
+    IOT_OTAG_RAW_FILE_SIZE,  /* size of decompressed firmware, 0 if unknown */
+    IOT_OTAG_DELTA_TYPE,     /* delta type of firmware, refer to IOT_OTA_DeltaType */
+    IOT_OTAG_SOURCE_VERSION, /* version the delta firmware applies to (string), empty if not given */
+    IOT_OTAG_SHA256SUM       /* firmware SHA-256 checksum (string), empty if not given */
 
 } IOT_OTA_CmdType;
 
+/* compress type of firmware, advertised by "compress" field of firmware info */
+typedef enum {
+    IOT_OTAC_NONE = 0,   /* not compressed */
+    IOT_OTAC_GZIP,       /* "gzip" */
+    IOT_OTAC_DEFLATE,    /* "deflate", zlib format */
+    IOT_OTAC_HEATSHRINK, /* "heatshrink", small window LZSS for RAM-constrained devices */
+} IOT_OTA_CompressType;
+
+/* delta type of firmware, advertised by "delta" field of firmware info */
+typedef enum {
+    IOT_OTAD_NONE = 0, /* full image */
+    IOT_OTAD_QDIFF,    /* "qdiff", patch against the running firmware, refer to utils_patch.h */
+} IOT_OTA_DeltaType;
+
 typedef enum {
 
     IOT_OTAR_DOWNLOAD_TIMEOUT = -1,
@@ -103,6 +125,91 @@ typedef enum {
 
 } IOT_OTAReportType;
 
+/**
+ * @brief Sink of downloaded firmware data, like writing to flash
+ *
+ * @param user_data:    user data of sink
+ * @param offset:       offset of data in firmware
+ * @param buf:          firmware data
+ * @param len:          length of data
+ *
+ * @return QCLOUD_RET_SUCCESS when success, or err code to abort the download
+ */
+typedef int (*OTASinkCallback)(void *user_data, uint32_t offset, const char *buf, uint32_t len);
+
+/**
+ * @brief Read the running firmware which the delta firmware applies to
+ *
+ * @param user_data:    user data of sink
+ * @param offset:       offset in running firmware
+ * @param buf:          buffer to read into
+ * @param len:          length to read
+ *
+ * @return QCLOUD_RET_SUCCESS when success, or err code to abort the download
+ */
+typedef int (*OTASourceReadCallback)(void *user_data, uint32_t offset, char *buf, uint32_t len);
+
+/* parameters of pipelined download */
+typedef struct {
+    OTASinkCallback       sink;        /* sink of downloaded data */
+    void *                user_data;   /* user data of sink and source_read */
+    uint16_t              buf_num;     /* number of buffers in the ring, 1 to download and sink serially */
+    uint32_t              buf_len;     /* length of each buffer */
+    uint32_t              timeout_s;   /* timeout of fetching each buffer (unit: second) */
+    OTASourceReadCallback source_read; /* reader of running firmware, required by delta firmware */
+    uint32_t              source_size; /* size readable by source_read */
+} OTAPipelineParams;
+
+#define DEFAULT_OTA_PIPELINE_PARAMS      \
+    {                                    \
+        NULL, NULL, 2, 2048, 20, NULL, 0 \
+    }
+
+#define OTA_SIGNATURE_LEN_MAX 256 /* max length of "signature" string in firmware info */
+
+/**
+ * @brief Verify signature of firmware over its SHA-256 digest, like ECDSA or Ed25519
+ *        with the public key kept by device
+ *
+ * @param user_data:    user data of verify params
+ * @param digest:       SHA-256 digest of downloaded firmware
+ * @param signature:    "signature" string of firmware info, encoded as agreed with the signer
+ *
+ * @return QCLOUD_RET_SUCCESS when the signature is valid, or err code otherwise
+ */
+typedef int (*OTASignatureVerifyCallback)(void *user_data, const unsigned char digest[32], const char *signature);
+
+/* parameters of firmware verification */
+typedef struct {
+    OTASignatureVerifyCallback verify_sign;   /* check signature at last, firmware without it is rejected */
+    void *                     user_data;     /* user data of verify_sign */
+    uint32_t                   block_size;    /* size of each block with digest, 0 to skip block check */
+    uint32_t                   block_num;     /* number of block digests */
+    const unsigned char (*block_digests)[32]; /* SHA-256 of each block of downloaded file, the last may be short */
+} OTAVerifyParams;
+
+#define DEFAULT_OTA_VERIFY_PARAMS \
+    {                             \
+        NULL, NULL, 0, 0, NULL    \
+    }
+
+#define OTA_PARALLEL_RANGE_MAX 8 /* max number of ranges fetched in parallel */
+
+/* parameters of parallel download */
+typedef struct {
+    OTASinkCallback       sink;      /* sparse writer, called in order within each range but not across ranges */
+    OTASourceReadCallback read_back; /* reader of data accepted by sink, for the final MD5 pass */
+    void *                user_data; /* user data of sink and read_back */
+    uint16_t              range_num; /* number of ranges, each fetched by its own task and connection */
+    uint32_t              buf_len;   /* length of buffer of each range */
+    uint32_t              timeout_s; /* timeout of fetching each buffer (unit: second) */
+} OTAParallelParams;
+
+#define DEFAULT_OTA_PARALLEL_PARAMS   \
+    {                                 \
+        NULL, NULL, NULL, 4, 4096, 20 \
+    }
+
 /**
  * @brief Init OTA module and resources
  *        MQTT/COAP Client should be constructed beforehand
@@ -126,6 +233,9 @@ int IOT_OTA_Destroy(void *handle);
 
 /**
  * @brief Setup HTTP connection and prepare OTA download
+ *        If offset is not 0, MD5 of the downloaded part is restored from the
+ *        checkpoint saved at the same offset of the same firmware; without such
+ *        checkpoint, MD5 regenerated by IOT_OTA_UpdateClientMd5 is used.
  *
  * @param handle: OTA module handle
  * @param offset: offset of firmware downloaded
@@ -153,6 +263,39 @@ void IOT_OTA_UpdateClientMd5(void *handle, char *buff, uint32_t size);
  */
 int IOT_OTA_ResetClientMD5(void *handle);
 
+/**
+ * @brief Save MD5 of local firmware with downloaded size and version to KV
+ *        store by HAL_Kv_Set, so the download can be resumed without reading
+ *        back the firmware. Call it when all the fetched data is written.
+ *        IOT_OTA_FetchPipeline saves checkpoints by itself.
+ *
+ * @param handle: OTA module handle
+ *
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_OTA_SaveCheckpoint(void *handle);
+
+/**
+ * @brief Set verification of firmware besides MD5. SHA-256 of the downloaded file is
+ *        calculated in the same pass as MD5, when firmware info gives "sha256" or
+ *        "signature", or pParams asks for it. With block digests, each block is
+ *        checked once it is downloaded, and the download is aborted with
+ *        IOT_OTA_ERR_VERIFY at the first corrupt block, checkpoint is cleared then.
+ *        IOT_OTA_FetchPipeline and IOT_OTA_FetchParallel hold each block in RAM until
+ *        it is checked, so a corrupt block never reaches the sink, which costs
+ *        block_size bytes, or block_size bytes per range. IOT_OTA_FetchYield returns
+ *        data before its block is complete, the caller has to drop the block written.
+ *        SHA-256 and signature are checked with IOT_OTAG_CHECK_FIRMWARE.
+ *        Call it before IOT_OTA_StartDownload or IOT_OTA_FetchParallel, pParams is copied but block_digests
+ *        should be kept until the download is done.
+ *
+ * @param handle: OTA module handle
+ * @param pParams: verify parameters, NULL to verify by firmware info only
+ *
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_OTA_SetVerify(void *handle, OTAVerifyParams *pParams);
+
 /**
  * @brief Report local firmware version to server
  *        NOTE: do this report before real download
@@ -215,6 +358,7 @@ int IOT_OTA_IsFetchFinish(void *handle);
 
 /**
  * @brief Download firmware from HTTP server and save to buffer
+ *        Compressed or delta firmware is returned as it is, use IOT_OTA_FetchPipeline to decode it
  *
  * @param handle:       OTA module handle
  * @param buf:          buffer to store firmware
@@ -227,6 +371,47 @@ int IOT_OTA_IsFetchFinish(void *handle);
  */
 int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s);
 
+/**
+ * @brief Download the whole firmware through a pipeline: the network stage
+ *        fetches in the calling task, while a sink task writes and updates MD5
+ *        of the previous buffers, connected by a ring of buf_num buffers.
+ *        Without MULTITHREAD_ENABLED, or buf_num is 1, fetch and sink run serially.
+ *        MD5 checkpoint is saved periodically and on failure for resuming download.
+ *        Compressed firmware is decompressed in the sink stage, the sink gets the
+ *        decompressed data, and its check value, size and MD5 are verified besides
+ *        MD5 of the compressed file. Delta firmware is applied against the running
+ *        firmware read by source_read after decompressing, and the sink gets the
+ *        new image, verified by raw size and MD5 in the same way.
+ *        Compressed or delta firmware is always downloaded from 0, as decoder state is
+ *        not checkpointed: if IOT_OTA_StartDownload is given an offset, it starts over.
+ *        Call it after IOT_OTA_StartDownload, and check firmware by IOT_OTA_Ioctl after.
+ *
+ * @param handle:       OTA module handle
+ * @param pParams:      pipeline parameters
+ *
+ * @return QCLOUD_RET_SUCCESS when all the data is fetched and sunk, or err code for failure
+ */
+int IOT_OTA_FetchPipeline(void *handle, OTAPipelineParams *pParams);
+
+#if defined(OTA_PARALLEL_FETCH) && defined(MULTITHREAD_ENABLED)
+/**
+ * @brief Download the whole firmware by splitting it into range_num ranges, which are
+ *        fetched in parallel over their own connections, to go beyond the throughput
+ *        of single TCP stream on lossy links. Data is handed to the sink by offset,
+ *        one call at a time. Failed range is refetched from where it stopped, and the
+ *        offset of each range is saved to KV store, so the next call resumes them.
+ *        When all ranges are done, MD5 is calculated in order over the data read back
+ *        by read_back. Compressed or delta firmware is not supported.
+ *        Call it instead of IOT_OTA_StartDownload, and check firmware by IOT_OTA_Ioctl after.
+ *
+ * @param handle:       OTA module handle
+ * @param pParams:      parallel download parameters
+ *
+ * @return QCLOUD_RET_SUCCESS when all the data is fetched, sunk and hashed, or err code for failure
+ */
+int IOT_OTA_FetchParallel(void *handle, OTAParallelParams *pParams);
+#endif
+
 /**
  * @brief Get OTA info (version, file_size, MD5, download state) from OTA module
  *
@@ -243,6 +428,12 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
  OTA_VERSION_LEN_MAX
       5) if type==IOT_OTAG_CHECK_FIRMWARE, 'buf' = uint32_t pointer, 'buf_len' =
  4
+      6) if type==IOT_OTAG_COMPRESS_TYPE, 'buf' = uint32_t pointer, 'buf_len' = 4
+      7) if type==IOT_OTAG_RAW_FILE_SIZE, 'buf' = uint32_t pointer, 'buf_len' = 4
+      8) if type==IOT_OTAG_DELTA_TYPE, 'buf' = uint32_t pointer, 'buf_len' = 4
+      9) if type==IOT_OTAG_SOURCE_VERSION, 'buf' = buffer of string, 'buf_len' =
+ OTA_VERSION_LEN_MAX
+      10) if type==IOT_OTAG_SHA256SUM, 'buf' = char array buffer, 'buf_len' = 65
  *
  * @retval   0 : success
  * @retval < 0 : error code for failure
@@ -188,12 +188,21 @@ int HAL_Snprintf(_IN_ char *str, const int len, const char *fmt, ...);
 int HAL_Vsnprintf(_OU_ char *str, _IN_ const int len, _IN_ const char *fmt, _IN_ va_list ap);
 
 /**
- * @brief Get timestamp in millisecond
+ * @brief Get monotonic time in millisecond, low 32 bits of HAL_GetTimeMs64.
+ *        Wraps every 49 days, compare by signed difference.
  *
- * @return   timestamp in millisecond
+ * @return   time in millisecond
  */
 uint32_t HAL_GetTimeMs(void);
 
+/**
+ * @brief Get monotonic time in millisecond since boot, which does not jump when
+ *        wall clock is set (e.g. by SNTP). Used by Timer and timer wheel.
+ *
+ * @return   time in millisecond
+ */
+uint64_t HAL_GetTimeMs64(void);
+
 /**
  * @brief Delay operation in blocking way
  *
@@ -243,6 +252,34 @@ int HAL_GetDevInfoFromFile(const char *file_name, void *dev_info);
 int HAL_GetGwDevInfo(void *pgwDeviceInfo);
 #endif
 
+/**
+ * @brief Save a value to key-value store in NVS(flash/files)
+ *
+ * @param key   key of the value
+ * @param val   value to save
+ * @param len   length of value
+ * @return      QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_Kv_Set(const char *key, const void *val, uint32_t len);
+
+/**
+ * @brief Get a value from key-value store in NVS(flash/files)
+ *
+ * @param key   key of the value
+ * @param val   buffer for the value
+ * @param len   length of buffer as input, length of value as output
+ * @return      QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_Kv_Get(const char *key, void *val, uint32_t *len);
+
+/**
+ * @brief Delete a value from key-value store in NVS(flash/files)
+ *
+ * @param key   key of the value
+ * @return      QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_Kv_Del(const char *key);
+
 /**
  * @brief Set the name of file which contain device info
  *
@@ -255,11 +292,7 @@ int HAL_SetDevInfoFile(const char *file_name);
  * Define timer structure, platform dependant
  */
 struct Timer {
-#if defined(__linux__) && defined(__GLIBC__)
-    struct timeval end_time;
-#else
-    uintptr_t end_time;
-#endif
+    uint64_t end_time;  // HAL_GetTimeMs64() when the timer expires
 };
 
 typedef struct Timer Timer;
@@ -312,12 +345,21 @@ void HAL_Timer_init(Timer *timer);
 char *HAL_Timer_current(char *time_str);
 
 /**
- * @brief Get timestamp in second
+ * @brief Get timestamp in second, wall clock (UTC) for signatures and reports
  *
  * @return   timestamp in second
  */
 long HAL_Timer_current_sec(void);
 
+/**
+ * @brief Format timestamp of HAL_Timer_current_sec as HAL_Timer_current does
+ *
+ * @param time_sec  timestamp in second
+ * @param time_str  buffer of TIME_FORMAT_STR_LEN
+ * @return string of formatted time
+ */
+char *HAL_Timer_format_sec(long time_sec, char *time_str);
+
 #ifdef AT_TCP_ENABLED
 int       HAL_AT_TCP_Init(void);
 uintptr_t HAL_AT_TCP_Connect(const char *host, uint16_t port);
@@ -581,6 +623,39 @@ int HAL_Log_Del(void);
 size_t HAL_Log_Get_Size(void);
 #endif
 
+#ifdef HASH_HW_ACCEL
+/* Functions for offloading hash blocks to hardware accelerator or crypto library of platform */
+/**
+ * @brief Process MD5 blocks with accelerator, from and into intermediate state
+ * @param state         MD5 state of 4 words, updated after the blocks
+ * @param data          message blocks, may be unaligned
+ * @param blocks        number of 64 bytes blocks
+ * @return              QCLOUD_RET_SUCCESS when success, or err code to fall back
+ *                      to software, e.g. accelerator is busy or not available
+ */
+int HAL_MD5_Process(uint32_t state[4], const unsigned char *data, size_t blocks);
+
+/**
+ * @brief Process SHA-1 blocks with accelerator, from and into intermediate state
+ * @param state         SHA-1 state of 5 words, updated after the blocks
+ * @param data          message blocks, may be unaligned
+ * @param blocks        number of 64 bytes blocks
+ * @return              QCLOUD_RET_SUCCESS when success, or err code to fall back
+ *                      to software, e.g. accelerator is busy or not available
+ */
+int HAL_SHA1_Process(uint32_t state[5], const unsigned char *data, size_t blocks);
+
+/**
+ * @brief Process SHA-256 blocks with accelerator, from and into intermediate state
+ * @param state         SHA-256 state of 8 words, updated after the blocks
+ * @param data          message blocks, may be unaligned
+ * @param blocks        number of 64 bytes blocks
+ * @return              QCLOUD_RET_SUCCESS when success, or err code to fall back
+ *                      to software, e.g. accelerator is busy or not available
+ */
+int HAL_SHA256_Process(uint32_t state[8], const unsigned char *data, size_t blocks);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
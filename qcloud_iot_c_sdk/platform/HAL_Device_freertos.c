@@ -27,6 +27,13 @@
 #include "qcloud_iot_import.h"
 #include "utils_param_check.h"
 
+#ifdef ESP_PLATFORM
+#include "nvs.h"
+
+/* NVS namespace of SDK key-value store, nvs_flash_init() should be called by app */
+#define HAL_KV_NAMESPACE "qcloud_kv"
+#endif
+
 /* Enable this macro (also control by cmake) to use static string buffer to
  * store device info */
 /* To use specific storing methods like files/flash, disable this macro and
@@ -176,3 +183,91 @@ int HAL_GetGwDevInfo(void *pgwDeviceInfo)
     return ret;
 }
 #endif
+
+int HAL_Kv_Set(const char *key, const void *val, uint32_t len)
+{
+    POINTER_SANITY_CHECK(key, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(val, QCLOUD_ERR_INVAL);
+
+#ifdef ESP_PLATFORM
+    nvs_handle handle;
+    esp_err_t  err;
+
+    err = nvs_open(HAL_KV_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK != err) {
+        Log_e("nvs open %s failed: %x", HAL_KV_NAMESPACE, err);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    err = nvs_set_blob(handle, key, val, len);
+    if (ESP_OK == err) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (ESP_OK != err) {
+        Log_e("nvs set %s failed: %x", key, err);
+        return QCLOUD_ERR_FAILURE;
+    }
+    return QCLOUD_RET_SUCCESS;
+#else
+    Log_e("HAL_Kv_Set not implement yet");
+    return QCLOUD_ERR_FAILURE;
+#endif
+}
+
+int HAL_Kv_Get(const char *key, void *val, uint32_t *len)
+{
+    POINTER_SANITY_CHECK(key, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(val, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(len, QCLOUD_ERR_INVAL);
+
+#ifdef ESP_PLATFORM
+    nvs_handle handle;
+    esp_err_t  err;
+    size_t     size = *len;
+
+    err = nvs_open(HAL_KV_NAMESPACE, NVS_READONLY, &handle);
+    if (ESP_OK != err) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    err = nvs_get_blob(handle, key, val, &size);
+    nvs_close(handle);
+
+    if (ESP_OK != err) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    *len = size;
+    return QCLOUD_RET_SUCCESS;
+#else
+    Log_e("HAL_Kv_Get not implement yet");
+    return QCLOUD_ERR_FAILURE;
+#endif
+}
+
+int HAL_Kv_Del(const char *key)
+{
+    POINTER_SANITY_CHECK(key, QCLOUD_ERR_INVAL);
+
+#ifdef ESP_PLATFORM
+    nvs_handle handle;
+    esp_err_t  err;
+
+    err = nvs_open(HAL_KV_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK != err) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    err = nvs_erase_key(handle, key);
+    if (ESP_OK == err) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    return (ESP_OK == err) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+#else
+    Log_e("HAL_Kv_Del not implement yet");
+    return QCLOUD_ERR_FAILURE;
+#endif
+}
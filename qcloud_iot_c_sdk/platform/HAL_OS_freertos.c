@@ -232,4 +232,40 @@ int HAL_SemaphoreWait(void *sem, uint32_t timeout_ms)
 {
     return osSemaphoreWait((osSemaphoreId)sem, timeout_ms);
 }
+
+#elif defined(MULTITHREAD_ENABLED)
+
+#define HAL_SEMAPHORE_MAX_COUNT 0xFFFF
+
+void *HAL_SemaphoreCreate(void)
+{
+    SemaphoreHandle_t sem = xSemaphoreCreateCounting(HAL_SEMAPHORE_MAX_COUNT, 0);
+    if (NULL == sem) {
+        HAL_Printf("%s: xSemaphoreCreateCounting failed\n", __FUNCTION__);
+        return NULL;
+    }
+
+    return sem;
+}
+
+void HAL_SemaphoreDestroy(void *sem)
+{
+    vSemaphoreDelete(sem);
+}
+
+void HAL_SemaphorePost(void *sem)
+{
+    if (xSemaphoreGive(sem) != pdTRUE) {
+        HAL_Printf("%s: xSemaphoreGive failed\n", __FUNCTION__);
+    }
+}
+
+int HAL_SemaphoreWait(void *sem, uint32_t timeout_ms)
+{
+    if (xSemaphoreTake(sem, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
 #endif
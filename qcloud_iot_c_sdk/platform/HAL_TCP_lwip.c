@@ -36,15 +36,10 @@
 
 static uint32_t _time_left(uint32_t t_end, uint32_t t_now)
 {
-    uint32_t t_left;
+    // signed difference is safe when HAL_GetTimeMs wraps
+    int32_t t_left = (int32_t)(t_end - t_now);
 
-    if (t_end > t_now) {
-        t_left = t_end - t_now;
-    } else {
-        t_left = 0;
-    }
-
-    return t_left;
+    return t_left > 0 ? (uint32_t)t_left : 0;
 }
 
 uintptr_t HAL_TCP_Connect(const char *host, uint16_t port)
@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TLS
+
 #ifdef __cplusplus
 extern "C" {
 #endif
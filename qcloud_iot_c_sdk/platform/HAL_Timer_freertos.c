@@ -38,71 +38,100 @@ extern "C" {
 #include <time.h>
 #endif
 
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#endif
+
 #ifdef PLATFORM_HAS_CMSIS
 #include "cmsis_os.h"
 #include "stm32l4xx_hal.h"
 #endif
 
-uint32_t HAL_GetTimeMs(void)
+uint64_t HAL_GetTimeMs64(void)
 {
-#if defined PLATFORM_HAS_TIME_FUNCS
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#if defined ESP_PLATFORM
+    /* microseconds since boot, not affected by SNTP */
+    return (uint64_t)(esp_timer_get_time() / 1000);
+
+#elif defined PLATFORM_HAS_TIME_FUNCS
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 
 #elif defined PLATFORM_HAS_CMSIS
-    return HAL_GetTick();
+    /* extend 32 bits tick, should be called at least once every 49 days */
+    static uint32_t last_tick;
+    static uint32_t wraps;
+    uint32_t        tick = HAL_GetTick();
+
+    if (tick < last_tick) {
+        wraps++;
+    }
+    last_tick = tick;
+    return ((uint64_t)wraps << 32) | tick;
 #endif
 }
 
-/*Get timestamp*/
-long HAL_Timer_current_sec(void)
+uint32_t HAL_GetTimeMs(void)
 {
-    return HAL_GetTimeMs() / 1000;
+    return (uint32_t)HAL_GetTimeMs64();
 }
 
-char *HAL_Timer_current(char *time_str)
+/*Get timestamp*/
+long HAL_Timer_current_sec(void)
 {
 #if defined PLATFORM_HAS_TIME_FUNCS
+    /* wall clock, as the timestamp is checked by server */
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    time_t    now_time = tv.tv_sec;
+    return tv.tv_sec;
+#else
+    return HAL_GetTimeMs64() / 1000;
+#endif
+}
+
+char *HAL_Timer_format_sec(long time_sec, char *time_str)
+{
+#if defined PLATFORM_HAS_TIME_FUNCS
+    time_t    now_time = time_sec;
     struct tm tm_tmp   = *localtime(&now_time);
     strftime(time_str, TIME_FORMAT_STR_LEN, "%F %T", &tm_tmp);
     return time_str;
 #else
-    long time_sec;
-    time_sec = HAL_Timer_current_sec();
     memset(time_str, 0, TIME_FORMAT_STR_LEN);
     snprintf(time_str, TIME_FORMAT_STR_LEN, "%ld", time_sec);
     return time_str;
 #endif
 }
 
-bool HAL_Timer_expired(Timer *timer)
+char *HAL_Timer_current(char *time_str)
 {
-    uint32_t now_ts;
-
-    now_ts = HAL_GetTimeMs();
+    return HAL_Timer_format_sec(HAL_Timer_current_sec(), time_str);
+}
 
-    return (now_ts > timer->end_time) ? true : false;
+bool HAL_Timer_expired(Timer *timer)
+{
+    return HAL_GetTimeMs64() > timer->end_time;
 }
 
 void HAL_Timer_countdown_ms(Timer *timer, unsigned int timeout_ms)
 {
-    timer->end_time = HAL_GetTimeMs();
-    timer->end_time += timeout_ms;
+    timer->end_time = HAL_GetTimeMs64() + timeout_ms;
 }
 
 void HAL_Timer_countdown(Timer *timer, unsigned int timeout)
 {
-    timer->end_time = HAL_GetTimeMs();
-    timer->end_time += timeout * 1000;
+    timer->end_time = HAL_GetTimeMs64() + (uint64_t)timeout * 1000;
 }
 
 int HAL_Timer_remain(Timer *timer)
 {
-    return (int)(timer->end_time - HAL_GetTimeMs());
+    int64_t remain = (int64_t)(timer->end_time - HAL_GetTimeMs64());
+
+    if (remain > INT32_MAX) {
+        return INT32_MAX;
+    }
+    return remain < INT32_MIN ? INT32_MIN : (int)remain;
 }
 
 void HAL_Timer_init(Timer *timer)
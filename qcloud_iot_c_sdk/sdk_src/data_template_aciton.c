@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TEMPLATE
+
 #include "config.h"
 
 #if defined(ACTION_ENABLED)
@@ -26,102 +28,144 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "utils_fnv1a.h"
 #include "utils_param_check.h"
 #include "lite-utils.h"
 #include "data_template_client.h"
 #include "data_template_action.h"
 #include "data_template_client_json.h"
+#include "json_parser.h"
 #include "qcloud_iot_export_data_template.h"
 
-// Action Subscribe
-static int _parse_action_input(DeviceAction *pAction, char *pInput)
+#define ACTION_MIN_BUCKETS 8
+
+static char sg_action_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];
+
+/* find registered action by id, caller should hold the template mutex */
+static ActionHandler *_find_action_handle(Qcloud_IoT_Template *pTemplate, const char *pActionId, int id_len)
 {
-    int             i;
-    char *          temp;
-    DeviceProperty *pActionInput = pAction->pInput;
+    uint32_t       hash = utils_fnv1a(UTILS_FNV1A_INIT, pActionId, id_len);
+    ActionHandler *action_handle;
 
-    // check and copy
-    for (i = 0; i < pAction->input_num; i++) {
-        if (JSTRING == pActionInput[i].type) {
-            pActionInput[i].data = LITE_json_value_of(pActionInput[i].key, pInput);
-            if (NULL == pActionInput[i].data) {
-                Log_e("action input data [%s] not found!", pActionInput[i].key);
-                return -1;
-            }
-        } else {
-            temp = LITE_json_value_of(pActionInput[i].key, pInput);
-            if (NULL == temp) {
-                Log_e("action input data [%s] not found!", pActionInput[i].key);
-                return -1;
-            }
-            if (JINT32 == pActionInput[i].type) {
-                if (sscanf(temp, "%" SCNi32, (int32_t *)pActionInput[i].data) != 1) {
-                    HAL_Free(temp);
-                    Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-                    return -1;
-                }
-            } else if (JFLOAT == pActionInput[i].type) {
-                if (sscanf(temp, "%f", (float *)pActionInput[i].data) != 1) {
-                    HAL_Free(temp);
-                    Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-                    return -1;
-                }
-            } else if (JUINT32 == pActionInput[i].type) {
-                if (sscanf(temp, "%" SCNu32, (uint32_t *)pActionInput[i].data) != 1) {
-                    HAL_Free(temp);
-                    Log_e("parse code failed, errCode: %d", QCLOUD_ERR_JSON_PARSE);
-                    return -1;
-                }
-            }
-            HAL_Free(temp);
+    if (NULL == pTemplate->inner_data.action_buckets) {
+        return NULL;
+    }
+
+    action_handle = pTemplate->inner_data.action_buckets[hash & pTemplate->inner_data.action_mask];
+    for (; NULL != action_handle; action_handle = action_handle->next) {
+        const char *action_id = ((DeviceAction *)action_handle->action)->pActionId;
+        if (action_handle->hash == hash && 0 == strncmp(action_id, pActionId, id_len) && '\0' == action_id[id_len]) {
+            break;
         }
     }
 
-    return 0;
+    return action_handle;
 }
 
-static void _handle_aciton(Qcloud_IoT_Template *pTemplate, List *list, const char *pClientToken, const char *pActionId,
-                           uint32_t timestamp, char *pInput)
+/* find input of action by key not NULL-terminated, return index of input or -1 */
+static int _find_action_input(ActionHandler *action_handle, const char *key, int key_len)
 {
-    IOT_FUNC_ENTRY;
-
-    HAL_MutexLock(pTemplate->mutex);
+    DeviceAction *pAction = (DeviceAction *)action_handle->action;
+    int           low = 0, high = pAction->input_num - 1, mid, diff;
+    const char *  input_key;
+
+    while (low <= high) {
+        mid       = (low + high) / 2;
+        input_key = pAction->pInput[action_handle->order[mid]].key;
+        diff      = strncmp(input_key, key, key_len);
+        if (0 == diff) {
+            diff = (uint8_t)input_key[key_len];
+        }
+        if (0 == diff) {
+            return action_handle->order[mid];
+        }
+        if (diff < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
 
-    if (list->len) {
-        ListIterator *iter;
-        ListNode *    node = NULL;
+    return -1;
+}
 
-        if (NULL == (iter = list_iterator_new(list, LIST_TAIL))) {
-            HAL_MutexUnlock(pTemplate->mutex);
-            IOT_FUNC_EXIT;
+// Action Subscribe
+/**
+ * @brief walk the input object once, parse each value into storage of the matched action input
+ */
+static int _parse_action_input(ActionHandler *action_handle, char *pInput)
+{
+    DeviceAction *  pAction = (DeviceAction *)action_handle->action;
+    DeviceProperty *pActionInput;
+    char *          pos = NULL, *key = NULL, *val = NULL;
+    int             klen = 0, vlen = 0, vtype = 0;
+    int             i, found_num = 0;
+    uint8_t         found[(ACTION_MAX_DATA_NUM + 8) / 8] = {0};
+
+    json_object_for_each_kv(pInput, pos, key, klen, val, vlen, vtype)
+    {
+        if (!key || !klen || !val || JSNULL == vtype) {
+            continue;
         }
 
-        for (;;) {
-            node = list_iterator_next(iter);
-            if (NULL == node) {
-                break;
-            }
+        i = _find_action_input(action_handle, key, klen);
+        if (i < 0 || (found[i / 8] & (1 << (i % 8)))) {
+            continue;
+        }
 
-            if (NULL == node->val) {
-                Log_e("node's value is invalid!");
-                continue;
+        pActionInput = &pAction->pInput[i];
+        if (JSTRING == pActionInput->type && 0 == pActionInput->data_buff_len) {
+            // no buffer given, hand over a copy of the string as before
+            pActionInput->data = HAL_Malloc(vlen + 1);
+            if (NULL == pActionInput->data) {
+                Log_e("run memory malloc is error!");
+                return -1;
             }
+            memcpy(pActionInput->data, val, vlen);
+            ((char *)pActionInput->data)[vlen] = '\0';
+        } else if (!update_value_from_json_token(val, vlen, pActionInput)) {
+            Log_e("parse action input [%s] failed", pActionInput->key);
+            return -1;
+        }
 
-            ActionHandler *pActionHandle = (ActionHandler *)node->val;
+        found[i / 8] |= 1 << (i % 8);
+        found_num++;
+    }
 
-            // check action id and call callback
-            if (0 == strcmp(pActionId, ((DeviceAction *)pActionHandle->action)->pActionId)) {
-                if (NULL != pActionHandle->callback) {
-                    if (!_parse_action_input(pActionHandle->action, pInput)) {
-                        ((DeviceAction *)pActionHandle->action)->timestamp = timestamp;
-                        pActionHandle->callback(pTemplate, pClientToken, pActionHandle->action);
-                    }
-                }
+    if (found_num < pAction->input_num) {
+        for (i = 0; i < pAction->input_num; i++) {
+            if (!(found[i / 8] & (1 << (i % 8)))) {
+                Log_e("action input data [%s] not found!", pAction->pInput[i].key);
+                break;
             }
         }
-        list_iterator_destroy(iter);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void _handle_aciton(Qcloud_IoT_Template *pTemplate, const char *pClientToken, const char *pActionId,
+                           uint32_t timestamp, char *pInput)
+{
+    IOT_FUNC_ENTRY;
+
+    ActionHandler *pActionHandle;
+
+    HAL_MutexLock(pTemplate->mutex);
+    pActionHandle = _find_action_handle(pTemplate, pActionId, strlen(pActionId));
+    if (NULL == pActionHandle) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        Log_w("action %s is not registered", pActionId);
+        IOT_FUNC_EXIT;
+    }
+
+    if (NULL != pActionHandle->callback && !_parse_action_input(pActionHandle, pInput)) {
+        ((DeviceAction *)pActionHandle->action)->timestamp = timestamp;
+        pActionHandle->callback(pTemplate, pClientToken, pActionHandle->action);
     }
     HAL_MutexUnlock(pTemplate->mutex);
+
     IOT_FUNC_EXIT;
 }
 
@@ -133,58 +177,94 @@ static void _on_action_handle_callback(void *pClient, MQTTMessage *message, void
     //  (Qcloud_IoT_Template*)mqtt_client->event_handle.context;
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)pUserData;
 
-    char *type_str     = NULL;
-    char *client_token = NULL;
-    char *action_id    = NULL;
-    char *pInput       = NULL;
-    int   timestamp    = 0;
+    char *   pos = NULL, *key = NULL, *val = NULL;
+    int      klen = 0, vlen = 0, vtype = 0;
+    char *   method = NULL, *client_token = NULL, *action_id = NULL, *pInput = NULL, *timestamp = NULL;
+    int      method_len = 0, token_len = 0, id_len = 0, input_len = 0, timestamp_len = 0;
+    uint32_t timestamp_val = 0;
+
+    if (NULL == template_client) {
+        return;
+    }
+
+    if (message->payload_len >= sizeof(sg_action_rcv_buf)) {
+        Log_e("The length of the received message exceeds the specified length!");
+        return;
+    }
+    if (utils_is_cbor_map(message->payload, message->payload_len)) {
+        size_t json_len;
+        if (utils_cbor_to_json((uint8_t *)message->payload, message->payload_len, sg_action_rcv_buf,
+                               sizeof(sg_action_rcv_buf), &json_len) != QCLOUD_RET_SUCCESS) {
+            Log_e("Fail to decode cbor payload!");
+            return;
+        }
+    } else {
+        memcpy(sg_action_rcv_buf, message->payload, message->payload_len);
+        sg_action_rcv_buf[message->payload_len] = '\0';  // jsmn_parse relies on a string
+    }
+
+    Log_d("recv:%s", sg_action_rcv_buf);
 
-    Log_d("recv:%.*s", (int)message->payload_len, (char *)message->payload);
+    // pick up all fields in one pass, then terminate them in place
+    json_object_for_each_kv(sg_action_rcv_buf, pos, key, klen, val, vlen, vtype)
+    {
+        if (!key || !val) {
+            continue;
+        }
 
-    // prase_method
-    if (!parse_template_method_type((char *)message->payload, &type_str)) {
-        Log_e("Fail to parse method!");
-        goto EXIT;
+        if (JSSTRING == vtype && klen == sizeof(METHOD_FIELD) - 1 && !strncmp(key, METHOD_FIELD, klen)) {
+            method     = val;
+            method_len = vlen;
+        } else if (JSSTRING == vtype && klen == sizeof(CLIENT_TOKEN_FIELD) - 1 &&
+                   !strncmp(key, CLIENT_TOKEN_FIELD, klen)) {
+            client_token = val;
+            token_len    = vlen;
+        } else if (JSSTRING == vtype && klen == sizeof(ACTION_ID_FIELD) - 1 && !strncmp(key, ACTION_ID_FIELD, klen)) {
+            action_id = val;
+            id_len    = vlen;
+        } else if (klen == sizeof(TIME_STAMP_FIELD) - 1 && !strncmp(key, TIME_STAMP_FIELD, klen)) {
+            timestamp     = val;
+            timestamp_len = vlen;
+        } else if (JSOBJECT == vtype && klen == sizeof(CMD_CONTROL_PARA) - 1 && !strncmp(key, CMD_CONTROL_PARA, klen)) {
+            pInput    = val;
+            input_len = vlen;
+        }
     }
 
-    if (strcmp(type_str, CALL_ACTION)) {
-        goto EXIT;
+    if (NULL == method || method_len != sizeof(CALL_ACTION) - 1 || strncmp(method, CALL_ACTION, method_len)) {
+        return;
     }
 
-    // prase client Token
-    if (!parse_client_token((char *)message->payload, &client_token)) {
+    if (NULL == client_token) {
         Log_e("fail to parse client token!");
-        goto EXIT;
+        return;
     }
 
-    // prase action ID
-    if (!parse_action_id((char *)message->payload, &action_id)) {
+    if (NULL == action_id) {
         Log_e("fail to parse action id!");
-        goto EXIT;
+        return;
     }
 
-    // prase timestamp
-    if (!parse_time_stamp((char *)message->payload, &timestamp)) {
-        Log_e("fail to parse timestamp!");
-        goto EXIT;
+    if (NULL == pInput) {
+        Log_e("fail to parse action input!");
+        return;
     }
 
-    // prase action input
-    if (!parse_action_input((char *)message->payload, &pInput)) {
-        Log_e("fail to parse action input!");
-        goto EXIT;
+    // the chars after the tokens are parsed already
+    client_token[token_len] = '\0';
+    action_id[id_len]       = '\0';
+    pInput[input_len]       = '\0';
+    if (NULL != timestamp) {
+        timestamp[timestamp_len] = '\0';
     }
 
-    // find action ID in register list and call handle
-    if (template_client != NULL)
-        _handle_aciton(template_client, template_client->inner_data.action_handle_list, client_token, action_id,
-                       timestamp, pInput);
+    if (NULL == timestamp || sscanf(timestamp, "%" SCNu32, &timestamp_val) != 1) {
+        Log_e("fail to parse timestamp!");
+        return;
+    }
 
-EXIT:
-    HAL_Free(type_str);
-    HAL_Free(client_token);
-    HAL_Free(pInput);
-    return;
+    // find action ID in register table and call handle
+    _handle_aciton(template_client, client_token, action_id, timestamp_val, pInput);
 }
 
 int IOT_Action_Init(void *c)
@@ -208,37 +288,88 @@ int IOT_Action_Init(void *c)
 }
 
 // Action register
-static int _add_action_handle_to_template_list(Qcloud_IoT_Template *pTemplate, DeviceAction *pAction,
-                                               OnActionHandleCallback callback)
+/* double the action buckets when they are as many as the actions, caller should hold the template mutex */
+static int _grow_action_buckets(Qcloud_IoT_Template *pTemplate)
 {
-    IOT_FUNC_ENTRY;
+    TemplateInnerData *inner_data = &pTemplate->inner_data;
+    ActionHandler **   buckets;
+    ActionHandler *    action_handle, *next;
+    uint16_t           size, i;
 
-    ActionHandler *action_handle = (ActionHandler *)HAL_Malloc(sizeof(ActionHandler));
-    if (NULL == action_handle) {
+    if (NULL != inner_data->action_buckets && inner_data->action_num <= inner_data->action_mask) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    size    = (NULL != inner_data->action_buckets) ? (inner_data->action_mask + 1) * 2 : ACTION_MIN_BUCKETS;
+    buckets = (ActionHandler **)HAL_Malloc(size * sizeof(ActionHandler *));
+    if (NULL == buckets) {
         Log_e("run memory malloc is error!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+        return QCLOUD_ERR_MALLOC;
     }
+    memset(buckets, 0, size * sizeof(ActionHandler *));
 
-    action_handle->callback = callback;
-    action_handle->action   = pAction;
+    if (NULL != inner_data->action_buckets) {
+        for (i = 0; i <= inner_data->action_mask; i++) {
+            for (action_handle = inner_data->action_buckets[i]; NULL != action_handle; action_handle = next) {
+                next                = action_handle->next;
+                action_handle->next = buckets[action_handle->hash & (size - 1)];
 
-    ListNode *node = list_node_new(action_handle);
-    if (NULL == node) {
-        Log_e("run list_node_new is error!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+                buckets[action_handle->hash & (size - 1)] = action_handle;
+            }
+        }
+        HAL_Free(inner_data->action_buckets);
     }
-    list_rpush(pTemplate->inner_data.action_handle_list, node);
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    inner_data->action_buckets = buckets;
+    inner_data->action_mask    = size - 1;
+
+    return QCLOUD_RET_SUCCESS;
 }
 
-static int _check_action_existence(Qcloud_IoT_Template *ptemplate, DeviceAction *pAction)
+/**
+ * @brief create the handle of action, with inputs sorted by key for dispatch of action input
+ */
+static ActionHandler *_new_action_handle(DeviceAction *pAction, OnActionHandleCallback callback)
 {
-    ListNode *node;
-    HAL_MutexLock(ptemplate->mutex);
-    node = list_find(ptemplate->inner_data.action_handle_list, pAction);
-    HAL_MutexUnlock(ptemplate->mutex);
-    return (NULL != node);
+    ActionHandler *action_handle;
+    int            i, j;
+
+    if (NULL == pAction->pActionId || (pAction->input_num > 0 && NULL == pAction->pInput)) {
+        Log_e("invalid action");
+        return NULL;
+    }
+
+    action_handle = (ActionHandler *)HAL_Malloc(sizeof(ActionHandler) + pAction->input_num);
+    if (NULL == action_handle) {
+        Log_e("run memory malloc is error!");
+        return NULL;
+    }
+
+    memset(action_handle, 0, sizeof(ActionHandler));
+    action_handle->callback = callback;
+    action_handle->action   = pAction;
+    action_handle->hash     = utils_fnv1a(UTILS_FNV1A_INIT, pAction->pActionId, strlen(pAction->pActionId));
+
+    // insertion sort of input keys, action input is dispatched by binary search
+    for (i = 0; i < pAction->input_num; i++) {
+        if (NULL == pAction->pInput[i].key) {
+            Log_e("key of action input %d is NULL", i);
+            HAL_Free(action_handle);
+            return NULL;
+        }
+        for (j = i; j > 0 && strcmp(pAction->pInput[action_handle->order[j - 1]].key, pAction->pInput[i].key) > 0;
+             j--) {
+            action_handle->order[j] = action_handle->order[j - 1];
+        }
+        if (j > 0 && 0 == strcmp(pAction->pInput[action_handle->order[j - 1]].key, pAction->pInput[i].key)) {
+            Log_e("duplicated action input key: %s", pAction->pInput[i].key);
+            HAL_Free(action_handle);
+            return NULL;
+        }
+        action_handle->order[j] = (uint8_t)i;
+    }
+
+    return action_handle;
 }
 
 int IOT_Action_Register(void *pTemplate, DeviceAction *pAction, OnActionHandleCallback callback)
@@ -246,42 +377,71 @@ int IOT_Action_Register(void *pTemplate, DeviceAction *pAction, OnActionHandleCa
     IOT_FUNC_ENTRY;
 
     Qcloud_IoT_Template *ptemplate = (Qcloud_IoT_Template *)pTemplate;
+    ActionHandler *      action_handle;
+    ActionHandler **     bucket;
+    int                  rc;
 
     POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(callback, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pAction, QCLOUD_ERR_INVAL);
 
-    if (_check_action_existence(ptemplate, pAction))
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_ACTION_EXIST);
+    action_handle = _new_action_handle(pAction, callback);
+    if (NULL == action_handle) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
 
-    int rc;
     HAL_MutexLock(ptemplate->mutex);
-    rc = _add_action_handle_to_template_list(ptemplate, pAction, callback);
+    if (NULL != _find_action_handle(ptemplate, pAction->pActionId, strlen(pAction->pActionId))) {
+        HAL_MutexUnlock(ptemplate->mutex);
+        HAL_Free(action_handle);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_ACTION_EXIST);
+    }
+
+    ptemplate->inner_data.action_num++;
+    rc = _grow_action_buckets(ptemplate);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        ptemplate->inner_data.action_num--;
+        HAL_MutexUnlock(ptemplate->mutex);
+        HAL_Free(action_handle);
+        IOT_FUNC_EXIT_RC(rc);
+    }
+
+    bucket = &ptemplate->inner_data.action_buckets[action_handle->hash & ptemplate->inner_data.action_mask];
+
+    action_handle->next = *bucket;
+    *bucket             = action_handle;
     HAL_MutexUnlock(ptemplate->mutex);
 
-    IOT_FUNC_EXIT_RC(rc);
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
 int IOT_Action_Remove(void *pTemplate, DeviceAction *pAction)
 {
-    Qcloud_IoT_Template *ptemplate = (Qcloud_IoT_Template *)pTemplate;
-    if (!_check_action_existence(ptemplate, pAction))
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_NOT_ACTION_EXIST);
+    POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pAction, QCLOUD_ERR_INVAL);
 
-    int rc = QCLOUD_RET_SUCCESS;
+    Qcloud_IoT_Template *ptemplate = (Qcloud_IoT_Template *)pTemplate;
+    ActionHandler *      action_handle;
+    ActionHandler **     link;
 
-    ListNode *node;
     HAL_MutexLock(ptemplate->mutex);
-    node = list_find(ptemplate->inner_data.action_handle_list, pAction);
-    if (NULL == node) {
-        rc = QCLOUD_ERR_NOT_PROPERTY_EXIST;
+    action_handle = _find_action_handle(ptemplate, pAction->pActionId, strlen(pAction->pActionId));
+    if (NULL == action_handle || action_handle->action != pAction) {
+        HAL_MutexUnlock(ptemplate->mutex);
         Log_e("Try to remove a non-existent action.");
-    } else {
-        list_remove(ptemplate->inner_data.action_handle_list, node);
+        return QCLOUD_ERR_NOT_ACTION_EXIST;
+    }
+
+    link = &ptemplate->inner_data.action_buckets[action_handle->hash & ptemplate->inner_data.action_mask];
+    for (; *link != action_handle; link = &(*link)->next) {
     }
+    *link = action_handle->next;
+    ptemplate->inner_data.action_num--;
     HAL_MutexUnlock(ptemplate->mutex);
 
-    return rc;
+    HAL_Free(action_handle);
+
+    return QCLOUD_RET_SUCCESS;
 }
 
 // Action post to server
@@ -367,7 +527,53 @@ static int _iot_construct_action_json(void *handle, char *jsonBuffer, size_t siz
     return check_snprintf_return(rc_of_snprintf, remain_size);
 }
 
-static int _publish_action_to_cloud(void *c, char *pJsonDoc)
+/**
+ * @brief construct action reply document in CBOR from the output properties directly, in the same layout as the JSON
+ * one
+ */
+static int _iot_construct_action_cbor(uint8_t *buf, size_t size, const char *pClientToken, DeviceAction *pAction,
+                                      sReplyPara *replyPara, size_t *len)
+{
+    int             rc;
+    uint8_t         i;
+    CborWriter      writer;
+    DeviceProperty *pJsonNode = pAction->pOutput;
+
+    POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pClientToken, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pAction, QCLOUD_ERR_INVAL);
+
+    utils_cbor_writer_init(&writer, buf, size);
+    utils_cbor_put_map(&writer, 5);
+    utils_cbor_put_text(&writer, METHOD_FIELD);
+    utils_cbor_put_text(&writer, REPORT_ACTION);
+    utils_cbor_put_text(&writer, CLIENT_TOKEN_FIELD);
+    utils_cbor_put_text(&writer, pClientToken);
+    utils_cbor_put_text(&writer, "code");
+    utils_cbor_put_int(&writer, replyPara->code);
+    utils_cbor_put_text(&writer, "status");
+    utils_cbor_put_text(&writer, replyPara->status_msg);
+    utils_cbor_put_text(&writer, "response");
+    utils_cbor_put_map(&writer, pAction->output_num);
+
+    for (i = 0; i < pAction->output_num; i++) {
+        if (pJsonNode == NULL || pJsonNode->key == NULL) {
+            Log_e("%dth/%d null event property data", i, pAction->output_num);
+            return QCLOUD_ERR_INVAL;
+        }
+
+        rc = template_put_cbor_node(&writer, pJsonNode->key, pJsonNode->data, pJsonNode->type, true);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+        pJsonNode++;
+    }
+
+    *len = writer.len;
+    return utils_cbor_writer_result(&writer);
+}
+
+static int _publish_action_to_cloud(void *c, void *pPayload, size_t len)
 {
     IOT_FUNC_ENTRY;
     int                  rc                             = QCLOUD_RET_SUCCESS;
@@ -381,12 +587,7 @@ static int _publish_action_to_cloud(void *c, char *pJsonDoc)
         return QCLOUD_ERR_FAILURE;
     }
 
-    PublishParams pubParams = DEFAULT_PUB_PARAMS;
-    pubParams.qos           = QOS1;
-    pubParams.payload_len   = strlen(pJsonDoc);
-    pubParams.payload       = (char *)pJsonDoc;
-
-    rc = IOT_MQTT_Publish(ptemplate->mqtt, topic, &pubParams);
+    rc = publish_template_payload(ptemplate, topic, QOS1, pPayload, len);
 
     IOT_FUNC_EXIT_RC(rc);
 }
@@ -394,15 +595,24 @@ static int _publish_action_to_cloud(void *c, char *pJsonDoc)
 int IOT_ACTION_REPLY(void *pClient, const char *pClientToken, char *pJsonDoc, size_t sizeOfBuffer,
                      DeviceAction *pAction, sReplyPara *replyPara)
 {
-    int rc;
+    int                  rc;
+    size_t               doc_len   = 0;
+    Qcloud_IoT_Template *ptemplate = (Qcloud_IoT_Template *)pClient;
 
-    rc = _iot_construct_action_json(pClient, pJsonDoc, sizeOfBuffer, pClientToken, pAction, replyPara);
+    POINTER_SANITY_CHECK(ptemplate, QCLOUD_ERR_INVAL);
+
+    if (TEMPLATE_CODEC_CBOR == ptemplate->codec) {
+        rc = _iot_construct_action_cbor((uint8_t *)pJsonDoc, sizeOfBuffer, pClientToken, pAction, replyPara, &doc_len);
+    } else {
+        rc      = _iot_construct_action_json(pClient, pJsonDoc, sizeOfBuffer, pClientToken, pAction, replyPara);
+        doc_len = (rc == QCLOUD_RET_SUCCESS) ? strlen(pJsonDoc) : 0;
+    }
     if (rc != QCLOUD_RET_SUCCESS) {
-        Log_e("construct action json fail, %d", rc);
+        Log_e("construct action reply fail, %d", rc);
         return rc;
     }
 
-    rc = _publish_action_to_cloud(pClient, pJsonDoc);
+    rc = _publish_action_to_cloud(pClient, pJsonDoc, doc_len);
     if (rc < 0) {
         Log_e("publish action to cloud fail, %d", rc);
     }
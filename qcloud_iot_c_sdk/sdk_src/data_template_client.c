@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TEMPLATE
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -348,6 +350,276 @@ int IOT_Template_JSON_ConstructReportArray(void *pClient, char *jsonBuffer, size
     return rc;
 }
 
+int IOT_Template_Set_Property_Deadband(void *pClient, DeviceProperty *pProperty, float deadband)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pProperty, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pProperty->key, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    PropertyHandler *    property_handle;
+    int                  rc = QCLOUD_ERR_NOT_PROPERTY_EXIST;
+
+    HAL_MutexLock(pTemplate->mutex);
+    property_handle = template_common_find_property_handle(pTemplate, pProperty->key, strlen(pProperty->key));
+    if (NULL != property_handle) {
+        property_handle->deadband = (deadband < 0) ? -deadband : deadband;
+        rc                        = QCLOUD_RET_SUCCESS;
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    return rc;
+}
+
+int IOT_Template_Mark_Property_Changed(void *pClient, DeviceProperty *pProperty)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pProperty, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pProperty->key, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    PropertyHandler *    property_handle;
+    int                  rc = QCLOUD_ERR_NOT_PROPERTY_EXIST;
+
+    HAL_MutexLock(pTemplate->mutex);
+    property_handle = template_common_find_property_handle(pTemplate, pProperty->key, strlen(pProperty->key));
+    if (NULL != property_handle) {
+        property_handle->dirty = true;
+        rc                     = QCLOUD_RET_SUCCESS;
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    return rc;
+}
+
+/**
+ * @brief count the properties to be reported in changed report, caller holds the mutex
+ */
+static int _template_count_changed_properties(Qcloud_IoT_Template *pTemplate)
+{
+    int      count = 0;
+    uint16_t i;
+
+    for (i = 0; i < pTemplate->inner_data.property_index_num; i++) {
+        if (template_common_property_changed(pTemplate->inner_data.property_index[i])) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief construct report document of the changed properties and take snapshot of them, caller holds the mutex
+ *
+ * @return number of properties in document, or err code (<0) for failure
+ */
+static int _template_construct_changed_report(Qcloud_IoT_Template *pTemplate, char *jsonBuffer, size_t sizeOfBuffer,
+                                              uint32_t report_seq)
+{
+    size_t           remain_size    = 0;
+    int32_t          rc_of_snprintf = 0;
+    int              rc, count = 0;
+    uint16_t         i;
+    PropertyHandler *property_handle;
+    DeviceProperty * pProperty;
+
+    build_empty_json(&(pTemplate->inner_data.token_num), jsonBuffer, pTemplate->device_info.product_id);
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+
+    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, ", \"params\":{");
+    rc             = check_snprintf_return(rc_of_snprintf, remain_size);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    for (i = 0; i < pTemplate->inner_data.property_index_num; i++) {
+        property_handle = pTemplate->inner_data.property_index[i];
+        if (!template_common_property_changed(property_handle)) {
+            continue;
+        }
+
+        pProperty = (DeviceProperty *)property_handle->property;
+        rc        = put_json_node(jsonBuffer, sizeOfBuffer, pProperty->key, pProperty->data, pProperty->type);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+
+        rc = template_common_snapshot_property(property_handle, report_seq);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+        count++;
+    }
+
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}}");
+    rc             = check_snprintf_return(rc_of_snprintf, remain_size);
+
+    return (rc == QCLOUD_RET_SUCCESS) ? count : rc;
+}
+
+/**
+ * @brief construct CBOR report document of the count changed properties and take snapshot of them, caller holds the
+ * mutex
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+static int _template_construct_changed_cbor(Qcloud_IoT_Template *pTemplate, uint8_t *buf, size_t size, int count,
+                                            uint32_t report_seq, char *client_token, size_t *len)
+{
+    int              rc;
+    uint16_t         i;
+    CborWriter       writer;
+    PropertyHandler *property_handle;
+    DeviceProperty * pProperty;
+
+    HAL_Snprintf(client_token, MAX_SIZE_OF_CLIENT_TOKEN, "%s-%u", pTemplate->device_info.product_id,
+                 pTemplate->inner_data.token_num++);
+
+    utils_cbor_writer_init(&writer, buf, size);
+    utils_cbor_put_map(&writer, 3);
+    utils_cbor_put_text(&writer, METHOD_FIELD);
+    utils_cbor_put_text(&writer, REPORT_CMD);
+    utils_cbor_put_text(&writer, CLIENT_TOKEN_FIELD);
+    utils_cbor_put_text(&writer, client_token);
+    utils_cbor_put_text(&writer, CMD_CONTROL_PARA);
+    utils_cbor_put_map(&writer, count);
+
+    for (i = 0; i < pTemplate->inner_data.property_index_num; i++) {
+        property_handle = pTemplate->inner_data.property_index[i];
+        if (!template_common_property_changed(property_handle)) {
+            continue;
+        }
+
+        pProperty = (DeviceProperty *)property_handle->property;
+        rc        = template_put_cbor_node(&writer, pProperty->key, pProperty->data, pProperty->type, false);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+
+        rc = template_common_snapshot_property(property_handle, report_seq);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+    }
+
+    *len = writer.len;
+    return utils_cbor_writer_result(&writer);
+}
+
+/**
+ * @brief send report document, CBOR one built directly if client_token is not NULL, or JSON one
+ */
+static int _template_report(Qcloud_IoT_Template *pTemplate, char *pJsonDoc, size_t sizeOfBuffer,
+                            OnReplyCallback callback, void *userContext, uint32_t timeout_ms, uint32_t report_seq,
+                            const char *client_token)
+{
+    int rc;
+
+    // if topic $thing/down/property subscribe not success before, subsrcibe again
+    if (pTemplate->inner_data.sync_status < 0) {
+        rc = subscribe_template_downstream_topic(pTemplate);
+        if (rc < 0) {
+            Log_e("Subcribe $thing/down/property fail!");
+        }
+    }
+
+    // Log_d("Report Document: %s", pJsonDoc);
+
+    RequestParams request_params = DEFAULT_REQUEST_PARAMS;
+    _init_request_params(&request_params, REPORT, callback, userContext, timeout_ms / 1000);
+    request_params.report_seq = report_seq;
+
+    if (NULL != client_token) {
+        return send_template_cbor_request(pTemplate, &request_params, client_token, (uint8_t *)pJsonDoc,
+                                          sizeOfBuffer);
+    }
+
+    return send_template_request(pTemplate, &request_params, pJsonDoc, sizeOfBuffer);
+}
+
+int IOT_Template_Report_Changed(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, uint32_t window_ms,
+                                OnReplyCallback callback, void *userContext, uint32_t timeout_ms)
+{
+    IOT_FUNC_ENTRY;
+    int      rc, count;
+    uint32_t report_seq;
+    size_t   cbor_len = 0;
+    char     client_token[MAX_SIZE_OF_CLIENT_TOKEN];
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(timeout_ms, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+
+    if (IOT_MQTT_IsConnected(pTemplate->mqtt) == false) {
+        Log_e("template is disconnected");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
+    }
+
+    // changes within the window are coalesced into the next report
+    if (!expired(&pTemplate->inner_data.report_timer)) {
+        IOT_FUNC_EXIT_RC(0);
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    // nothing to report, don't waste a client token
+    count = _template_count_changed_properties(pTemplate);
+    if (0 == count) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT_RC(0);
+    }
+
+    // each report owns the properties it takes by seq, they are committed or marked dirty on its reply
+    report_seq = ++pTemplate->inner_data.report_seq;
+    if (0 == report_seq) {
+        report_seq = ++pTemplate->inner_data.report_seq;
+    }
+    if (TEMPLATE_CODEC_CBOR == pTemplate->codec) {
+        // encode from the properties directly, the document is not coalesced
+        rc = _template_construct_changed_cbor(pTemplate, (uint8_t *)pJsonDoc, sizeOfBuffer, count, report_seq,
+                                              client_token, &cbor_len);
+        count = (rc == QCLOUD_RET_SUCCESS) ? count : rc;
+    } else {
+        count = _template_construct_changed_report(pTemplate, pJsonDoc, sizeOfBuffer, report_seq);
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    if (count < 0) {
+        Log_e("construct changed report failed: %d", count);
+        template_common_finish_changed_report(pTemplate, report_seq, false);
+        IOT_FUNC_EXIT_RC(count);
+    }
+
+    if (TEMPLATE_CODEC_CBOR == pTemplate->codec) {
+        rc = _template_report(pTemplate, pJsonDoc, cbor_len, callback, userContext, timeout_ms, report_seq,
+                              client_token);
+    } else {
+        rc = _template_report(pTemplate, pJsonDoc, sizeOfBuffer, callback, userContext, timeout_ms, report_seq, NULL);
+    }
+    if (rc != QCLOUD_RET_SUCCESS) {
+        template_common_finish_changed_report(pTemplate, report_seq, false);
+        IOT_FUNC_EXIT_RC(rc);
+    }
+
+    countdown_ms(&pTemplate->inner_data.report_timer, window_ms);
+
+    IOT_FUNC_EXIT_RC(count);
+}
+
+int IOT_Template_Set_Report_Coalesce(void *pClient, uint32_t window_ms, uint16_t max_size)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    return set_template_report_coalesce((Qcloud_IoT_Template *)pClient, window_ms, max_size);
+}
+
 int IOT_Template_ClearControl(void *pClient, char *pClientToken, OnReplyCallback callback, uint32_t timeout_ms)
 {
     IOT_FUNC_ENTRY;
@@ -403,20 +675,7 @@ int IOT_Template_Report(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, OnRe
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
     }
 
-    // if topic $thing/down/property subscribe not success before, subsrcibe again
-    if (pTemplate->inner_data.sync_status < 0) {
-        rc = subscribe_template_downstream_topic(pTemplate);
-        if (rc < 0) {
-            Log_e("Subcribe $thing/down/property fail!");
-        }
-    }
-
-    // Log_d("Report Document: %s", pJsonDoc);
-
-    RequestParams request_params = DEFAULT_REQUEST_PARAMS;
-    _init_request_params(&request_params, REPORT, callback, userContext, timeout_ms / 1000);
-
-    rc = send_template_request(pTemplate, &request_params, pJsonDoc, sizeOfBuffer);
+    rc = _template_report(pTemplate, pJsonDoc, sizeOfBuffer, callback, userContext, timeout_ms, 0, NULL);
     IOT_FUNC_EXIT_RC(rc);
 }
 
@@ -723,6 +982,10 @@ static void template_yield_thread(void *ptr)
 
     Log_d("template yield thread start ...");
     while (pTemplate->yield_thread_running) {
+        flush_template_pending_report(pTemplate, false);
+#ifdef EVENT_POST_ENABLED
+        flush_template_pending_event(pTemplate, false);
+#endif
         rc = IOT_MQTT_Yield(pTemplate->mqtt, 200);
         if (rc == QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT) {
             HAL_SleepMs(THREAD_SLEEP_INTERVAL_MS);
@@ -833,9 +1096,11 @@ int IOT_Template_Yield(void *pClient, uint32_t timeout_ms)
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
 
+    flush_template_pending_report(pTemplate, false);
     handle_template_expired_reply(pTemplate);
 
 #ifdef EVENT_POST_ENABLED
+    flush_template_pending_event(pTemplate, false);
     handle_template_expired_event(pTemplate);
 #endif
 
@@ -899,10 +1164,27 @@ void *IOT_Template_Construct(TemplateInitParams *pParams, void *pMqttClient)
 
     pTemplate->mqtt                        = mqtt_client;
     pTemplate->event_handle                = pParams->event_handle;
-    pTemplate->inner_data.upstream_topic   = NULL;
-    pTemplate->inner_data.downstream_topic = NULL;
-    pTemplate->inner_data.token_num        = 0;
-    pTemplate->inner_data.eventflags       = 0;
+    pTemplate->codec                       = pParams->codec;
+    pTemplate->inner_data.upstream_topic      = NULL;
+    pTemplate->inner_data.downstream_topic    = NULL;
+    pTemplate->inner_data.token_num           = 0;
+    pTemplate->inner_data.eventflags          = 0;
+    pTemplate->inner_data.property_index      = NULL;
+    pTemplate->inner_data.property_index_num  = 0;
+    pTemplate->inner_data.property_index_size = 0;
+    pTemplate->inner_data.pending_report      = NULL;
+    pTemplate->inner_data.pending_params      = NULL;
+    pTemplate->inner_data.coalesce_ms         = 0;
+    pTemplate->inner_data.coalesce_size       = 0;
+    pTemplate->inner_data.pending_events      = NULL;
+    pTemplate->inner_data.pending_event_reply = NULL;
+    pTemplate->inner_data.pending_event_num   = 0;
+    pTemplate->inner_data.pending_events_len  = 0;
+    pTemplate->inner_data.event_batch_ms      = 0;
+    pTemplate->inner_data.event_batch_size    = 0;
+    InitTimer(&pTemplate->inner_data.report_timer);
+    InitTimer(&pTemplate->inner_data.pending_timer);
+    InitTimer(&pTemplate->inner_data.event_timer);
 
     rc = qcloud_iot_template_init(pTemplate);
     if (rc != QCLOUD_RET_SUCCESS) {
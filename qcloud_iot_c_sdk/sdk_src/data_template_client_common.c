@@ -18,14 +18,102 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TEMPLATE
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include "data_template_client_common.h"
 
+#include <string.h>
+
 #include "qcloud_iot_import.h"
 
+#define PROPERTY_INDEX_INIT_SIZE (8)
+
+/**
+ * @brief compare a key (not NULL-terminated) with the key of a property
+ */
+static int _property_key_cmp(const char *key, int key_len, const char *prop_key)
+{
+    int rc = strncmp(key, prop_key, key_len);
+    if (0 == rc && '\0' != prop_key[key_len]) {
+        rc = -1;
+    }
+
+    return rc;
+}
+
+/**
+ * @brief binary search the property index
+ *
+ * @return position of the key if found, or the insert position otherwise
+ */
+static int _property_index_search(Qcloud_IoT_Template *pTemplate, const char *key, int key_len, bool *found)
+{
+    int             low  = 0;
+    int             high = pTemplate->inner_data.property_index_num - 1;
+    int             mid, rc;
+    DeviceProperty *pProperty;
+
+    *found = false;
+    while (low <= high) {
+        mid       = (low + high) / 2;
+        pProperty = (DeviceProperty *)pTemplate->inner_data.property_index[mid]->property;
+        rc        = _property_key_cmp(key, key_len, pProperty->key);
+        if (0 == rc) {
+            *found = true;
+            return mid;
+        } else if (rc < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return low;
+}
+
+static int _property_index_insert(Qcloud_IoT_Template *pTemplate, PropertyHandler *property_handle)
+{
+    TemplateInnerData *inner_data = &pTemplate->inner_data;
+    DeviceProperty *   pProperty  = (DeviceProperty *)property_handle->property;
+    bool               found;
+    int                pos;
+
+    pos = _property_index_search(pTemplate, pProperty->key, strlen(pProperty->key), &found);
+    if (found) {
+        Log_e("property key %s already registered", pProperty->key);
+        return QCLOUD_ERR_PROPERTY_EXIST;
+    }
+
+    if (inner_data->property_index_num >= inner_data->property_index_size) {
+        uint16_t new_size = inner_data->property_index_size ? inner_data->property_index_size * 2
+                                                            : PROPERTY_INDEX_INIT_SIZE;
+
+        PropertyHandler **new_index = (PropertyHandler **)HAL_Malloc(new_size * sizeof(PropertyHandler *));
+        if (NULL == new_index) {
+            Log_e("run memory malloc is error!");
+            return QCLOUD_ERR_MALLOC;
+        }
+
+        if (inner_data->property_index) {
+            memcpy(new_index, inner_data->property_index, inner_data->property_index_num * sizeof(PropertyHandler *));
+            HAL_Free(inner_data->property_index);
+        }
+        inner_data->property_index      = new_index;
+        inner_data->property_index_size = new_size;
+    }
+
+    memmove(&inner_data->property_index[pos + 1], &inner_data->property_index[pos],
+            (inner_data->property_index_num - pos) * sizeof(PropertyHandler *));
+    inner_data->property_index[pos] = property_handle;
+    inner_data->property_index_num++;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
 /**
  * @brief add registered propery's call back to data_template handle list
  */
@@ -34,18 +122,35 @@ static int _add_property_handle_to_template_list(Qcloud_IoT_Template *pTemplate,
 {
     IOT_FUNC_ENTRY;
 
+    int rc;
+
     PropertyHandler *property_handle = (PropertyHandler *)HAL_Malloc(sizeof(PropertyHandler));
     if (NULL == property_handle) {
         Log_e("run memory malloc is error!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    property_handle->callback = callback;
-    property_handle->property = pProperty;
+    property_handle->callback   = callback;
+    property_handle->property   = pProperty;
+    property_handle->shadow     = NULL;
+    property_handle->shadow_len  = 0;
+    property_handle->pending     = NULL;
+    property_handle->pending_len = 0;
+    property_handle->report_seq  = 0;
+    property_handle->deadband    = 0;
+    property_handle->dirty       = false;
+
+    rc = _property_index_insert(pTemplate, property_handle);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        HAL_Free(property_handle);
+        IOT_FUNC_EXIT_RC(rc);
+    }
 
     ListNode *node = list_node_new(property_handle);
     if (NULL == node) {
         Log_e("run list_node_new is error!");
+        template_common_remove_property_index(pTemplate, pProperty);
+        HAL_Free(property_handle);
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
     list_rpush(pTemplate->inner_data.property_handle_list, node);
@@ -53,24 +158,202 @@ static int _add_property_handle_to_template_list(Qcloud_IoT_Template *pTemplate,
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+ * @brief size of the property value, including the terminator for string types
+ */
+static uint16_t _property_value_size(DeviceProperty *pProperty)
+{
+    switch (pProperty->type) {
+        case JINT32:
+        case JUINT32:
+            return sizeof(int32_t);
+        case JINT16:
+        case JUINT16:
+            return sizeof(int16_t);
+        case JINT8:
+        case JUINT8:
+            return sizeof(int8_t);
+        case JFLOAT:
+            return sizeof(float);
+        case JDOUBLE:
+            return sizeof(double);
+        case JBOOL:
+            return sizeof(bool);
+        case JSTRING:
+        case JOBJECT:
+            return strlen((char *)pProperty->data) + 1;
+        default:
+            return 0;
+    }
+}
+
+static bool _property_exceed_deadband(double current, double last, float deadband)
+{
+    double diff = current > last ? current - last : last - current;
+
+    return (0 == deadband) ? (diff != 0) : (diff >= deadband);
+}
+
+void template_common_free_property_handle(void *val)
+{
+    PropertyHandler *property_handle = (PropertyHandler *)val;
+
+    if (NULL != property_handle) {
+        HAL_Free(property_handle->shadow);
+        HAL_Free(property_handle->pending);
+        HAL_Free(property_handle);
+    }
+}
+
+bool template_common_property_changed(PropertyHandler *property_handle)
+{
+    DeviceProperty *pProperty = (DeviceProperty *)property_handle->property;
+    uint16_t        size;
+    void *          last     = property_handle->shadow;
+    uint16_t        last_len = property_handle->shadow_len;
+
+    // value in flight is compared, so it's not reported again before reply
+    if (0 != property_handle->report_seq) {
+        last     = property_handle->pending;
+        last_len = property_handle->pending_len;
+    }
+
+    if (property_handle->dirty || NULL == last) {
+        return true;
+    }
+
+    if (JFLOAT == pProperty->type) {
+        return _property_exceed_deadband(*(float *)pProperty->data, *(float *)last, property_handle->deadband);
+    } else if (JDOUBLE == pProperty->type) {
+        return _property_exceed_deadband(*(double *)pProperty->data, *(double *)last, property_handle->deadband);
+    }
+
+    size = _property_value_size(pProperty);
+    return (size != last_len) || memcmp(last, pProperty->data, size);
+}
+
+int template_common_snapshot_property(PropertyHandler *property_handle, uint32_t report_seq)
+{
+    DeviceProperty *pProperty = (DeviceProperty *)property_handle->property;
+    uint16_t        size      = _property_value_size(pProperty);
+
+    if (0 == size) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    if (size != property_handle->pending_len) {
+        void *pending = HAL_Malloc(size);
+        if (NULL == pending) {
+            Log_e("run memory malloc is error!");
+            return QCLOUD_ERR_MALLOC;
+        }
+        HAL_Free(property_handle->pending);
+        property_handle->pending     = pending;
+        property_handle->pending_len = size;
+    }
+
+    memcpy(property_handle->pending, pProperty->data, size);
+    property_handle->report_seq = report_seq;
+    property_handle->dirty      = false;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void template_common_finish_changed_report(Qcloud_IoT_Template *pTemplate, uint32_t report_seq, bool accepted)
+{
+    uint16_t         i;
+    void *           buf;
+    uint16_t         len;
+    PropertyHandler *property_handle;
+
+    HAL_MutexLock(pTemplate->mutex);
+    for (i = 0; i < pTemplate->inner_data.property_index_num; i++) {
+        property_handle = pTemplate->inner_data.property_index[i];
+        // taken over by a later report, leave it to the reply of that one
+        if (report_seq != property_handle->report_seq) {
+            continue;
+        }
+
+        if (accepted) {
+            // pending value becomes the last reported one, swap to reuse the buffer
+            buf                          = property_handle->shadow;
+            len                          = property_handle->shadow_len;
+            property_handle->shadow      = property_handle->pending;
+            property_handle->shadow_len  = property_handle->pending_len;
+            property_handle->pending     = buf;
+            property_handle->pending_len = len;
+        } else {
+            property_handle->dirty = true;
+        }
+        property_handle->report_seq = 0;
+    }
+    HAL_MutexUnlock(pTemplate->mutex);
+}
+
+PropertyHandler *template_common_find_property_handle(Qcloud_IoT_Template *pTemplate, const char *key, int key_len)
+{
+    bool found;
+    int  pos = _property_index_search(pTemplate, key, key_len, &found);
+
+    return found ? pTemplate->inner_data.property_index[pos] : NULL;
+}
+
+PropertyHandler *template_common_remove_property_index(Qcloud_IoT_Template *pTemplate, DeviceProperty *pProperty)
+{
+    TemplateInnerData *inner_data = &pTemplate->inner_data;
+    PropertyHandler *  property_handle;
+    bool               found;
+    int                pos;
+
+    pos = _property_index_search(pTemplate, pProperty->key, strlen(pProperty->key), &found);
+    if (!found || inner_data->property_index[pos]->property != pProperty) {
+        return NULL;
+    }
+
+    property_handle = inner_data->property_index[pos];
+    memmove(&inner_data->property_index[pos], &inner_data->property_index[pos + 1],
+            (inner_data->property_index_num - pos - 1) * sizeof(PropertyHandler *));
+    inner_data->property_index_num--;
+
+    return property_handle;
+}
+
+void template_common_clear_property_index(Qcloud_IoT_Template *pTemplate)
+{
+    HAL_Free(pTemplate->inner_data.property_index);
+    pTemplate->inner_data.property_index      = NULL;
+    pTemplate->inner_data.property_index_num  = 0;
+    pTemplate->inner_data.property_index_size = 0;
+}
+
 int template_common_check_property_existence(Qcloud_IoT_Template *ptemplate, DeviceProperty *pProperty)
 {
-    ListNode *node;
+    bool found = false;
+
+    if (NULL == pProperty || NULL == pProperty->key) {
+        return 0;
+    }
 
     HAL_MutexLock(ptemplate->mutex);
-    node = list_find(ptemplate->inner_data.property_handle_list, pProperty);
+    _property_index_search(ptemplate, pProperty->key, strlen(pProperty->key), &found);
     HAL_MutexUnlock(ptemplate->mutex);
 
-    return (NULL != node);
+    return found;
 }
 
 int template_common_remove_property(Qcloud_IoT_Template *ptemplate, DeviceProperty *pProperty)
 {
     int rc = QCLOUD_RET_SUCCESS;
 
-    ListNode *node;
+    PropertyHandler *property_handle;
+    ListNode *       node = NULL;
+
     HAL_MutexLock(ptemplate->mutex);
-    node = list_find(ptemplate->inner_data.property_handle_list, pProperty);
+    property_handle = template_common_remove_property_index(ptemplate, pProperty);
+    if (NULL != property_handle) {
+        node = list_find(ptemplate->inner_data.property_handle_list, property_handle);
+    }
+
     if (NULL == node) {
         rc = QCLOUD_ERR_NOT_PROPERTY_EXIST;
         Log_e("Try to remove a non-existent property.");
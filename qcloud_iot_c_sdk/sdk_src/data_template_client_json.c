@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TEMPLATE
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -30,9 +32,11 @@ extern "C" {
 #include <stdio.h>
 #include <string.h>
 
+#include "json_parser.h"
 #include "lite-utils.h"
 #include "qcloud_iot_device.h"
 #include "qcloud_iot_export_method.h"
+#include "utils_fnv1a.h"
 
 int check_snprintf_return(int32_t returnCode, size_t maxSizeOfWrite)
 {
@@ -212,6 +216,59 @@ int template_put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pK
     return rc;
 }
 
+int template_put_cbor_node(CborWriter *writer, const char *pKey, void *pData, JsonDataType type, bool boolAsNumber)
+{
+    utils_cbor_put_text(writer, pKey);
+
+    if (pData == NULL) {
+        utils_cbor_put_null(writer);
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    switch (type) {
+        case JINT32:
+            utils_cbor_put_int(writer, *(int32_t *)(pData));
+            break;
+        case JINT16:
+            utils_cbor_put_int(writer, *(int16_t *)(pData));
+            break;
+        case JINT8:
+            utils_cbor_put_int(writer, *(int8_t *)(pData));
+            break;
+        case JUINT32:
+            utils_cbor_put_int(writer, *(uint32_t *)(pData));
+            break;
+        case JUINT16:
+            utils_cbor_put_int(writer, *(uint16_t *)(pData));
+            break;
+        case JUINT8:
+            utils_cbor_put_int(writer, *(uint8_t *)(pData));
+            break;
+        case JDOUBLE:
+            utils_cbor_put_float(writer, *(double *)(pData));
+            break;
+        case JFLOAT:
+            utils_cbor_put_float(writer, *(float *)(pData));
+            break;
+        case JBOOL:
+            if (boolAsNumber) {
+                utils_cbor_put_int(writer, *(bool *)(pData) ? 1 : 0);
+            } else {
+                utils_cbor_put_bool(writer, *(bool *)(pData));
+            }
+            break;
+        case JSTRING:
+            utils_cbor_put_text(writer, (char *)(pData));
+            break;
+        case JOBJECT:
+            return utils_cbor_put_json(writer, (char *)(pData), strlen((char *)(pData)));
+        default:
+            return QCLOUD_ERR_INVAL;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
 void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer, char *tokenPrefix)
 {
     HAL_Snprintf(pJsonBuffer, MAX_SIZE_OF_JSON_WITH_CLIENT_TOKEN, "{\"clientToken\":\"%s-%u\"}", tokenPrefix,
@@ -224,6 +281,27 @@ bool parse_client_token(char *pJsonDoc, char **pClientToken)
     return *pClientToken == NULL ? false : true;
 }
 
+uint32_t get_client_token_key(const char *pClientToken, const char *tokenPrefix)
+{
+    size_t      prefix_len = strlen(tokenPrefix);
+    const char *pos;
+    uint32_t    key;
+
+    if (!strncmp(pClientToken, tokenPrefix, prefix_len) && '-' == pClientToken[prefix_len] &&
+        '\0' != pClientToken[prefix_len + 1]) {
+        key = 0;
+        for (pos = pClientToken + prefix_len + 1; *pos >= '0' && *pos <= '9'; pos++) {
+            key = key * 10 + (*pos - '0');
+        }
+        if ('\0' == *pos) {
+            return key;
+        }
+    }
+
+    // FNV-1a for token not built by SDK
+    return utils_fnv1a(UTILS_FNV1A_INIT, pClientToken, strlen(pClientToken));
+}
+
 bool parse_action_id(char *pJsonDoc, char **pActionID)
 {
     *pActionID = LITE_json_value_of(ACTION_ID_FIELD, pJsonDoc);
@@ -295,6 +373,23 @@ bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty)
     return ret;
 }
 
+bool update_value_from_json_token(char *pValue, int valueLen, DeviceProperty *pProperty)
+{
+    char last_char;
+
+    // empty string is a value, while other types have at least one character
+    if (NULL == pValue || valueLen < 0 || (0 == valueLen && JSTRING != pProperty->type)) {
+        return false;
+    }
+
+    // value token points into the source JSON, terminate it temporarily instead of copying
+    backup_json_str_last_char(pValue, valueLen, last_char);
+    _direct_update_value(pValue, pProperty);
+    restore_json_str_last_char(pValue, valueLen, last_char);
+
+    return true;
+}
+
 bool parse_template_method_type(char *pJsonDoc, char **pMethod)
 {
     *pMethod = LITE_json_value_of(METHOD_FIELD, pJsonDoc);
@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TEMPLATE
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,14 +30,15 @@ extern "C" {
 #include <string.h>
 
 #include "data_template_client.h"
+#include "data_template_client_common.h"
 #include "data_template_client_json.h"
+#include "data_template_event.h"
+#include "json_parser.h"
 #include "qcloud_iot_import.h"
+#include "utils_cbor.h"
 #include "utils_list.h"
 #include "utils_param_check.h"
 
-typedef void (*TraverseTemplateHandle)(Qcloud_IoT_Template *pTemplate, ListNode **node, List *list,
-                                       const char *pClientToken, const char *pType);
-
 static char sg_template_cloud_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];
 static char sg_template_clientToken[MAX_SIZE_OF_CLIENT_TOKEN];
 
@@ -64,6 +67,57 @@ static int _unsubscribe_template_downstream_topic(Qcloud_IoT_Template *pTemplate
     IOT_FUNC_EXIT_RC(rc);
 }
 
+/**
+ * @brief free a request together with the requests coalesced into it
+ */
+static void _free_template_request(void *val)
+{
+    Request *request = (Request *)val;
+    Request *next;
+
+    while (NULL != request) {
+        next = request->merged;
+        HAL_Free(request);
+        request = next;
+    }
+}
+
+/**
+ * @brief call back every request coalesced into the same document
+ */
+static void _template_request_done(Qcloud_IoT_Template *pTemplate, Request *request, ReplyAck status)
+{
+    for (; NULL != request; request = request->merged) {
+        if (0 != request->report_seq) {
+            template_common_finish_changed_report(pTemplate, request->report_seq, ACK_ACCEPTED == status);
+        }
+        if (request->callback != NULL) {
+            request->callback(pTemplate, request->method, status, sg_template_cloud_rcv_buf, request);
+        }
+    }
+}
+
+/**
+ * @brief push request to data_template request wait for reply table
+ */
+static int _push_request_to_template_list(Qcloud_IoT_Template *pTemplate, Request *request, uint32_t timeout_ms)
+{
+    IOT_FUNC_ENTRY;
+
+    int      rc;
+    uint32_t key = get_client_token_key(request->client_token, pTemplate->device_info.product_id);
+
+    HAL_MutexLock(pTemplate->mutex);
+    rc = reply_table_add(&pTemplate->inner_data.reply_table, key, request, timeout_ms);
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("add request %s to reply table failed: %d", request->client_token, rc);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
 /**
  * @brief add request to data_template request wait for reply list
  */
@@ -72,15 +126,10 @@ static int _add_request_to_template_list(Qcloud_IoT_Template *pTemplate, const c
 {
     IOT_FUNC_ENTRY;
 
-    HAL_MutexLock(pTemplate->mutex);
-    if (pTemplate->inner_data.reply_list->len >= MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME) {
-        HAL_MutexUnlock(pTemplate->mutex);
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_APPENDING_REQUEST);
-    }
+    int rc;
 
     Request *request = (Request *)HAL_Malloc(sizeof(Request));
     if (NULL == request) {
-        HAL_MutexUnlock(pTemplate->mutex);
         Log_e("run memory malloc is error!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
@@ -90,22 +139,57 @@ static int _add_request_to_template_list(Qcloud_IoT_Template *pTemplate, const c
 
     request->user_context = pParams->user_context;
     request->method       = pParams->method;
+    request->report_seq   = pParams->report_seq;
+    request->merged       = NULL;
 
-    InitTimer(&(request->timer));
-    countdown(&(request->timer), pParams->timeout_sec);
+    rc = _push_request_to_template_list(pTemplate, request, pParams->timeout_sec * 1000);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        HAL_Free(request);
+    }
 
-    ListNode *node = list_node_new(request);
-    if (NULL == node) {
-        HAL_MutexUnlock(pTemplate->mutex);
-        Log_e("run list_node_new is error!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+int publish_template_payload(Qcloud_IoT_Template *pTemplate, char *topic, QoS qos, void *pPayload, size_t len)
+{
+    IOT_FUNC_ENTRY;
+
+    int      rc;
+    size_t   cbor_len  = len;
+    uint8_t *cbor_data = NULL;
+
+    PublishParams pubParams = DEFAULT_PUB_PARAMS;
+    pubParams.qos           = qos;
+    pubParams.payload_len   = len;
+    pubParams.payload       = pPayload;
+
+    // documents built directly in CBOR are published as they are, JSON ones are converted
+    if (TEMPLATE_CODEC_CBOR == pTemplate->codec && !utils_is_cbor_map(pPayload, len)) {
+        // CBOR is mostly shorter than JSON, encode once and retry with the exact length if it's not
+        do {
+            HAL_Free(cbor_data);
+            cbor_data = (uint8_t *)HAL_Malloc(cbor_len);
+            if (NULL == cbor_data) {
+                Log_e("run memory malloc is error!");
+                IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+            }
+            rc = utils_json_to_cbor((char *)pPayload, len, cbor_data, cbor_len, &cbor_len);
+        } while (rc == QCLOUD_ERR_JSON_BUFFER_TOO_SMALL);
+
+        if (rc != QCLOUD_RET_SUCCESS) {
+            Log_e("encode cbor failed: %d", rc);
+            HAL_Free(cbor_data);
+            IOT_FUNC_EXIT_RC(rc);
+        }
+        pubParams.payload_len = cbor_len;
+        pubParams.payload     = cbor_data;
     }
 
-    list_rpush(pTemplate->inner_data.reply_list, node);
+    rc = IOT_MQTT_Publish(pTemplate->mqtt, topic, &pubParams);
 
-    HAL_MutexUnlock(pTemplate->mutex);
+    HAL_Free(cbor_data);
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    IOT_FUNC_EXIT_RC(rc);
 }
 
 /**
@@ -113,10 +197,11 @@ static int _add_request_to_template_list(Qcloud_IoT_Template *pTemplate, const c
  *
  * @param pClient                   handle to data_template client
  * @param method                    method type
- * @param pJsonDoc                  JSON to publish
+ * @param pPayload                  JSON or CBOR document to publish
+ * @param len                       length of document
  * @return QCLOUD_RET_SUCCESS for success, or err code for failure
  */
-int _publish_to_template_upstream_topic(Qcloud_IoT_Template *pTemplate, Method method, char *pJsonDoc)
+int _publish_to_template_upstream_topic(Qcloud_IoT_Template *pTemplate, Method method, void *pPayload, size_t len)
 {
     IOT_FUNC_ENTRY;
     int rc = QCLOUD_RET_SUCCESS;
@@ -132,12 +217,7 @@ int _publish_to_template_upstream_topic(Qcloud_IoT_Template *pTemplate, Method m
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    PublishParams pubParams = DEFAULT_PUB_PARAMS;
-    pubParams.qos           = QOS0;
-    pubParams.payload_len   = strlen(pJsonDoc);
-    pubParams.payload       = (char *)pJsonDoc;
-
-    rc = IOT_MQTT_Publish(pTemplate->mqtt, topic, &pubParams);
+    rc = publish_template_payload(pTemplate, topic, QOS0, pPayload, len);
 
     IOT_FUNC_EXIT_RC(rc);
 }
@@ -193,70 +273,6 @@ static int _set_template_json_type(char *pJsonDoc, size_t sizeOfBuffer, Method m
     IOT_FUNC_EXIT_RC(rc);
 }
 
-/**
- * @brief iterator list and call traverseHandle for each node
- */
-static void _traverse_template_list(Qcloud_IoT_Template *pTemplate, List *list, const char *pClientToken,
-                                    const char *pType, TraverseTemplateHandle traverseHandle)
-{
-    IOT_FUNC_ENTRY;
-
-    HAL_MutexLock(pTemplate->mutex);
-
-    if (list->len) {
-        ListIterator *iter;
-        ListNode *    node = NULL;
-
-        if (NULL == (iter = list_iterator_new(list, LIST_TAIL))) {
-            HAL_MutexUnlock(pTemplate->mutex);
-            IOT_FUNC_EXIT;
-        }
-
-        for (;;) {
-            node = list_iterator_next(iter);
-            if (NULL == node) {
-                break;
-            }
-
-            if (NULL == node->val) {
-                Log_e("node's value is invalid!");
-                continue;
-            }
-
-            traverseHandle(pTemplate, &node, list, pClientToken, pType);
-        }
-
-        list_iterator_destroy(iter);
-    }
-    HAL_MutexUnlock(pTemplate->mutex);
-
-    IOT_FUNC_EXIT;
-}
-
-/**
- * @brief handle the timeout request wait for reply
- */
-static void _handle_template_expired_reply_callback(Qcloud_IoT_Template *pTemplate, ListNode **node, List *list,
-                                                    const char *pClientToken, const char *pType)
-{
-    IOT_FUNC_ENTRY;
-
-    Request *request = (Request *)(*node)->val;
-    if (NULL == request)
-        IOT_FUNC_EXIT;
-
-    if (expired(&request->timer)) {
-        if (request->callback != NULL) {
-            request->callback(pTemplate, request->method, ACK_TIMEOUT, sg_template_cloud_rcv_buf, request);
-        }
-
-        list_remove(list, *node);
-        *node = NULL;
-    }
-
-    IOT_FUNC_EXIT;
-}
-
 static void _set_control_clientToken(const char *pClientToken)
 {
     memset(sg_template_clientToken, '\0', MAX_SIZE_OF_CLIENT_TOKEN);
@@ -273,27 +289,49 @@ void qcloud_iot_template_reset(void *pClient)
     POINTER_SANITY_CHECK_RTN(pClient);
 
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)pClient;
+    Request *            request;
+    void *               reply;
+    ActionHandler *      action_handle;
+    uint16_t             i;
 
     _unsubscribe_template_downstream_topic(template_client);
 
+    template_common_clear_property_index(template_client);
     if (template_client->inner_data.property_handle_list) {
         list_destroy(template_client->inner_data.property_handle_list);
         template_client->inner_data.property_handle_list = NULL;
     }
 
-    if (template_client->inner_data.reply_list) {
-        list_destroy(template_client->inner_data.reply_list);
-        template_client->inner_data.reply_list = NULL;
+    while (NULL != (request = reply_table_pop(&template_client->inner_data.reply_table))) {
+        _free_template_request(request);
     }
+    reply_table_deinit(&template_client->inner_data.reply_table);
+
+    _free_template_request(template_client->inner_data.pending_report);
+    template_client->inner_data.pending_report = NULL;
+    HAL_Free(template_client->inner_data.pending_params);
+    template_client->inner_data.pending_params = NULL;
 
-    if (template_client->inner_data.event_list) {
-        list_destroy(template_client->inner_data.event_list);
-        template_client->inner_data.event_list = NULL;
+    HAL_Free(template_client->inner_data.pending_events);
+    template_client->inner_data.pending_events = NULL;
+    HAL_Free(template_client->inner_data.pending_event_reply);
+    template_client->inner_data.pending_event_reply = NULL;
+
+    while (NULL != (reply = reply_table_pop(&template_client->inner_data.event_table))) {
+        HAL_Free(reply);
     }
+    reply_table_deinit(&template_client->inner_data.event_table);
 
-    if (NULL != template_client->inner_data.action_handle_list) {
-        list_destroy(template_client->inner_data.action_handle_list);
-        template_client->inner_data.action_handle_list = NULL;
+    if (NULL != template_client->inner_data.action_buckets) {
+        for (i = 0; i <= template_client->inner_data.action_mask; i++) {
+            while (NULL != (action_handle = template_client->inner_data.action_buckets[i])) {
+                template_client->inner_data.action_buckets[i] = action_handle->next;
+                HAL_Free(action_handle);
+            }
+        }
+        HAL_Free(template_client->inner_data.action_buckets);
+        template_client->inner_data.action_buckets = NULL;
+        template_client->inner_data.action_num     = 0;
     }
 }
 
@@ -309,35 +347,27 @@ int qcloud_iot_template_init(Qcloud_IoT_Template *pTemplate)
 
     pTemplate->inner_data.property_handle_list = list_new();
     if (pTemplate->inner_data.property_handle_list) {
-        pTemplate->inner_data.property_handle_list->free = HAL_Free;
+        pTemplate->inner_data.property_handle_list->free = template_common_free_property_handle;
     } else {
         Log_e("no memory to allocate property_handle_list");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    pTemplate->inner_data.reply_list = list_new();
-    if (pTemplate->inner_data.reply_list) {
-        pTemplate->inner_data.reply_list->free = HAL_Free;
-    } else {
-        Log_e("no memory to allocate reply_list");
+    if (reply_table_init(&pTemplate->inner_data.reply_table, MAX_APPENDING_REQUEST_AT_ANY_GIVEN_TIME) !=
+        QCLOUD_RET_SUCCESS) {
+        Log_e("no memory to allocate reply_table");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    pTemplate->inner_data.event_list = list_new();
-    if (pTemplate->inner_data.event_list) {
-        pTemplate->inner_data.event_list->free = HAL_Free;
-    } else {
-        Log_e("no memory to allocate event_list");
+    if (reply_table_init(&pTemplate->inner_data.event_table, MAX_EVENT_WAIT_REPLY) != QCLOUD_RET_SUCCESS) {
+        Log_e("no memory to allocate event_table");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    pTemplate->inner_data.action_handle_list = list_new();
-    if (pTemplate->inner_data.action_handle_list) {
-        pTemplate->inner_data.action_handle_list->free = HAL_Free;
-    } else {
-        Log_e("no memory to allocate action_handle_list");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
+    // action buckets are allocated by the first registration
+    pTemplate->inner_data.action_buckets = NULL;
+    pTemplate->inner_data.action_mask    = 0;
+    pTemplate->inner_data.action_num     = 0;
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
@@ -346,12 +376,260 @@ void handle_template_expired_reply(Qcloud_IoT_Template *pTemplate)
 {
     IOT_FUNC_ENTRY;
 
-    _traverse_template_list(pTemplate, pTemplate->inner_data.reply_list, NULL, NULL,
-                            _handle_template_expired_reply_callback);
+    Request *request;
+
+    for (;;) {
+        HAL_MutexLock(pTemplate->mutex);
+        request = (Request *)reply_table_pop_expired(&pTemplate->inner_data.reply_table);
+        HAL_MutexUnlock(pTemplate->mutex);
+        if (NULL == request) {
+            break;
+        }
+
+        _template_request_done(pTemplate, request, ACK_TIMEOUT);
+        _free_template_request(request);
+    }
 
     IOT_FUNC_EXIT;
 }
 
+/**
+ * @brief remove the entry of key from the pending params, so value of the later report wins
+ */
+static void _remove_pending_param(char *params, const char *key, int key_len)
+{
+    char *pos = NULL, *pkey = NULL, *val = NULL;
+    char *entry_start, *entry_end;
+    int   klen = 0, vlen = 0, vtype = 0;
+
+    json_object_for_each_kv(params, pos, pkey, klen, val, vlen, vtype)
+    {
+        if (klen != key_len || strncmp(pkey, key, klen)) {
+            continue;
+        }
+
+        entry_start = pkey - 1;
+        entry_end   = val + vlen + (JSSTRING == vtype ? 1 : 0);
+        while (' ' == *entry_end) {
+            entry_end++;
+        }
+
+        if (',' == *entry_end) {
+            entry_end++;
+        } else {
+            // last entry, remove the comma before it
+            while (entry_start > params + 1 && ',' != *(entry_start - 1)) {
+                entry_start--;
+            }
+            if (entry_start > params + 1) {
+                entry_start--;
+            }
+        }
+
+        memmove(entry_start, entry_end, strlen(entry_end) + 1);
+        break;
+    }
+}
+
+/**
+ * @brief merge params of a report into the pending report
+ *
+ * @return QCLOUD_RET_SUCCESS if merged, or err code if the report should be sent directly
+ */
+static int _coalesce_template_report(Qcloud_IoT_Template *pTemplate, RequestParams *pParams, char *pJsonDoc)
+{
+    IOT_FUNC_ENTRY;
+
+    TemplateInnerData *inner_data = &pTemplate->inner_data;
+    Request *          request    = NULL;
+    Request **         tail;
+    char *             params, *pos = NULL, *key = NULL, *val = NULL;
+    char *             entry_end, *params_end;
+    int                params_len = 0, params_type = JSNONE;
+    int                klen = 0, vlen = 0, vtype = 0;
+    char               last_char;
+    size_t             len;
+
+    params = json_get_value_by_name(pJsonDoc, strlen(pJsonDoc), CMD_CONTROL_PARA, &params_len, &params_type);
+    if (NULL == params || JSOBJECT != params_type) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_JSON_PARSE);
+    }
+
+    if (params_len >= inner_data->coalesce_size) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL);
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    len = (NULL != inner_data->pending_params) ? strlen(inner_data->pending_params) : 0;
+    HAL_MutexUnlock(pTemplate->mutex);
+    if (len + params_len > inner_data->coalesce_size) {
+        flush_template_pending_report(pTemplate, true);
+    }
+
+    if (NULL != pParams->request_callback || 0 != pParams->report_seq) {
+        request = (Request *)HAL_Malloc(sizeof(Request));
+        if (NULL == request) {
+            Log_e("run memory malloc is error!");
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+        }
+
+        memset(request, 0, sizeof(Request));
+        request->callback     = pParams->request_callback;
+        request->user_context = pParams->user_context;
+        request->method       = pParams->method;
+        request->report_seq   = pParams->report_seq;
+        request->merged       = NULL;
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (NULL == inner_data->pending_params) {
+        inner_data->pending_params = (char *)HAL_Malloc(inner_data->coalesce_size + 1);
+        if (NULL == inner_data->pending_params) {
+            HAL_MutexUnlock(pTemplate->mutex);
+            HAL_Free(request);
+            Log_e("run memory malloc is error!");
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+        }
+        strcpy(inner_data->pending_params, "{}");
+        inner_data->pending_timeout_sec = 0;
+        countdown_ms(&inner_data->pending_timer, inner_data->coalesce_ms);
+    } else if (strlen(inner_data->pending_params) + params_len > inner_data->coalesce_size) {
+        // filled by another thread after the flush
+        HAL_MutexUnlock(pTemplate->mutex);
+        HAL_Free(request);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL);
+    }
+
+    backup_json_str_last_char(params, params_len, last_char);
+    json_object_for_each_kv(params, pos, key, klen, val, vlen, vtype)
+    {
+        if (!key || !klen || !val || (!vlen && JSSTRING != vtype)) {
+            continue;
+        }
+
+        _remove_pending_param(inner_data->pending_params, key, klen);
+
+        entry_end  = val + vlen + (JSSTRING == vtype ? 1 : 0);
+        params_end = inner_data->pending_params + strlen(inner_data->pending_params) - 1;
+        if (params_end > inner_data->pending_params + 1) {
+            *params_end++ = ',';
+        }
+        memcpy(params_end, key - 1, entry_end - key + 1);
+        params_end += entry_end - key + 1;
+        strcpy(params_end, "}");
+    }
+    restore_json_str_last_char(params, params_len, last_char);
+
+    if (NULL != request) {
+        for (tail = &inner_data->pending_report; NULL != *tail; tail = &(*tail)->merged) {
+        }
+        *tail = request;
+    }
+    inner_data->pending_timeout_sec = Max(inner_data->pending_timeout_sec, pParams->timeout_sec);
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int flush_template_pending_report(Qcloud_IoT_Template *pTemplate, bool force)
+{
+    IOT_FUNC_ENTRY;
+
+    int      rc = QCLOUD_RET_SUCCESS;
+    char *   params;
+    char *   json_doc     = NULL;
+    char *   client_token = NULL;
+    Request *request, *merged;
+    uint32_t timeout_sec;
+    size_t   doc_size;
+    int32_t  rc_of_snprintf;
+
+    POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (NULL == pTemplate->inner_data.pending_params || (!force && !expired(&pTemplate->inner_data.pending_timer))) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+    params                               = pTemplate->inner_data.pending_params;
+    request                              = pTemplate->inner_data.pending_report;
+    timeout_sec                          = pTemplate->inner_data.pending_timeout_sec;
+    pTemplate->inner_data.pending_params = NULL;
+    pTemplate->inner_data.pending_report = NULL;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    doc_size = strlen(params) + MAX_SIZE_OF_JSON_WITH_CLIENT_TOKEN + 64;
+    json_doc = (char *)HAL_Malloc(doc_size);
+    if (NULL == json_doc) {
+        Log_e("run memory malloc is error!");
+        rc = QCLOUD_ERR_MALLOC;
+        goto End;
+    }
+
+    build_empty_json(&(pTemplate->inner_data.token_num), json_doc, pTemplate->device_info.product_id);
+    rc_of_snprintf = HAL_Snprintf(json_doc + strlen(json_doc) - 1, doc_size - strlen(json_doc) + 1,
+                                  ", \"params\":%s}", params);
+    rc = check_snprintf_return(rc_of_snprintf, doc_size - strlen(json_doc) + 1);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        goto End;
+    }
+
+    if (!parse_client_token(json_doc, &client_token)) {
+        rc = QCLOUD_ERR_INVAL;
+        goto End;
+    }
+
+    rc = _set_template_json_type(json_doc, doc_size, REPORT);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        goto End;
+    }
+
+    rc = _publish_to_template_upstream_topic(pTemplate, REPORT, json_doc, strlen(json_doc));
+    if ((rc == QCLOUD_RET_SUCCESS) && (NULL != request)) {
+        for (merged = request; NULL != merged; merged = merged->merged) {
+            strncpy(merged->client_token, client_token, MAX_SIZE_OF_CLIENT_TOKEN);
+        }
+        rc = _push_request_to_template_list(pTemplate, request, timeout_sec * 1000);
+        if (rc == QCLOUD_RET_SUCCESS) {
+            request = NULL;
+        }
+    }
+
+End:
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("publish coalesced report failed: %d", rc);
+        _template_request_done(pTemplate, request, ACK_TIMEOUT);
+    }
+    _free_template_request(request);
+    HAL_Free(client_token);
+    HAL_Free(json_doc);
+    HAL_Free(params);
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+int set_template_report_coalesce(Qcloud_IoT_Template *pTemplate, uint32_t window_ms, uint16_t max_size)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
+
+    if (window_ms > 0 && max_size < MAX_SIZE_OF_JSON_WITH_CLIENT_TOKEN) {
+        Log_e("coalesce size %u too small", max_size);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    // the pending report is sent with the old budget
+    flush_template_pending_report(pTemplate, true);
+
+    HAL_MutexLock(pTemplate->mutex);
+    pTemplate->inner_data.coalesce_ms   = window_ms;
+    pTemplate->inner_data.coalesce_size = max_size;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
 int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams, char *pJsonDoc, size_t sizeOfBuffer)
 {
     IOT_FUNC_ENTRY;
@@ -363,6 +641,15 @@ int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams
 
     char *client_token = NULL;
 
+    if (REPORT == pParams->method && pTemplate->inner_data.coalesce_ms > 0) {
+        if (QCLOUD_RET_SUCCESS == _coalesce_template_report(pTemplate, pParams, pJsonDoc)) {
+            IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+        }
+
+        // can't be merged, keep the order with the pending report
+        flush_template_pending_report(pTemplate, true);
+    }
+
     // parse clientToken in pJsonDoc, return err if parse failed
     if (!parse_client_token(pJsonDoc, &client_token)) {
         Log_e("fail to parse client token!");
@@ -377,10 +664,10 @@ int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams
         IOT_FUNC_EXIT_RC(rc);
 
     if (rc == QCLOUD_RET_SUCCESS) {
-        rc = _publish_to_template_upstream_topic(pTemplate, pParams->method, pJsonDoc);
+        rc = _publish_to_template_upstream_topic(pTemplate, pParams->method, pJsonDoc, strlen(pJsonDoc));
     }
 
-    if ((rc == QCLOUD_RET_SUCCESS) && (NULL != pParams->request_callback)) {
+    if ((rc == QCLOUD_RET_SUCCESS) && (NULL != pParams->request_callback || 0 != pParams->report_seq)) {
         rc = _add_request_to_template_list(pTemplate, client_token, pParams);
     }
 
@@ -389,92 +676,114 @@ int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams
     IOT_FUNC_EXIT_RC(rc);
 }
 
+int send_template_cbor_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams, const char *pClientToken,
+                               uint8_t *pCbor, size_t len)
+{
+    IOT_FUNC_ENTRY;
+    int rc;
+
+    POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pClientToken, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pCbor, QCLOUD_ERR_INVAL);
+
+    // keep the order with the pending report, which is merged in JSON
+    if (REPORT == pParams->method) {
+        flush_template_pending_report(pTemplate, true);
+    }
+
+    rc = _publish_to_template_upstream_topic(pTemplate, pParams->method, pCbor, len);
+    if ((rc == QCLOUD_RET_SUCCESS) && (NULL != pParams->request_callback || 0 != pParams->report_seq)) {
+        rc = _add_request_to_template_list(pTemplate, pClientToken, pParams);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief walk the control document once, dispatch each key to its registered property via the key index
+ */
 static void _handle_control(Qcloud_IoT_Template *pTemplate, char *control_str)
 {
     IOT_FUNC_ENTRY;
-    if (pTemplate->inner_data.property_handle_list->len) {
-        ListIterator *   iter;
-        ListNode *       node            = NULL;
-        PropertyHandler *property_handle = NULL;
 
-        if (NULL == (iter = list_iterator_new(pTemplate->inner_data.property_handle_list, LIST_TAIL))) {
-            HAL_MutexUnlock(pTemplate->mutex);
-            IOT_FUNC_EXIT;
-        }
+    char *           pos = NULL, *key = NULL, *val = NULL;
+    int              klen = 0, vlen = 0, vtype = 0;
+    PropertyHandler *property_handle = NULL;
+    DeviceProperty * pProperty       = NULL;
 
-        for (;;) {
-            node = list_iterator_next(iter);
-            if (NULL == node) {
-                break;
-            }
+    if (0 == pTemplate->inner_data.property_index_num) {
+        IOT_FUNC_EXIT;
+    }
 
-            property_handle = (PropertyHandler *)(node->val);
-            if (NULL == property_handle) {
-                Log_e("node's value is invalid!");
-                continue;
-            }
+    json_object_for_each_kv(control_str, pos, key, klen, val, vlen, vtype)
+    {
+        if (!key || !klen || !val || (!vlen && JSSTRING != vtype) || JSNULL == vtype) {
+            continue;
+        }
 
-            if (property_handle->property != NULL) {
-                if (update_value_if_key_match(control_str, property_handle->property)) {
-                    if (property_handle->callback != NULL) {
-                        property_handle->callback(pTemplate, control_str, strlen(control_str),
-                                                  property_handle->property);
-                    }
-                    node = NULL;
-                }
-            }
+        property_handle = template_common_find_property_handle(pTemplate, key, klen);
+        if (NULL == property_handle || NULL == property_handle->property) {
+            continue;
         }
 
-        list_iterator_destroy(iter);
+        pProperty = (DeviceProperty *)property_handle->property;
+        if (update_value_from_json_token(val, vlen, pProperty) && property_handle->callback != NULL) {
+            property_handle->callback(pTemplate, control_str, strlen(control_str), pProperty);
+        }
     }
 
     IOT_FUNC_EXIT;
 }
 
-static void _handle_template_reply_callback(Qcloud_IoT_Template *pTemplate, ListNode **node, List *list,
-                                            const char *pClientToken, const char *pType)
+/**
+ * @brief match the reply with request wait for reply by clientToken
+ */
+static void _handle_template_reply(Qcloud_IoT_Template *pTemplate, const char *pClientToken, const char *pType)
 {
     IOT_FUNC_ENTRY;
 
-    Request *request = (Request *)(*node)->val;
-    if (NULL == request)
-        IOT_FUNC_EXIT;
-
-    if (strcmp(request->client_token, pClientToken) == 0) {
-        ReplyAck status = ACK_NONE;
+    ReplyAck status     = ACK_NONE;
+    int32_t  reply_code = 0;
+    uint32_t key        = get_client_token_key(pClientToken, pTemplate->device_info.product_id);
+    Request *request, *merged;
 
-        // check operation success or not according to code field of reply message
-        int32_t reply_code = 0;
-
-        bool parse_success = parse_code_return(sg_template_cloud_rcv_buf, &reply_code);
-        if (parse_success) {
-            if (reply_code == 0) {
-                status = ACK_ACCEPTED;
-            } else {
-                status = ACK_REJECTED;
-            }
-
-            if (strcmp(pType, GET_STATUS_REPLY) == 0 && status == ACK_ACCEPTED) {
-                char *control_str = NULL;
-                if (parse_template_get_control(sg_template_cloud_rcv_buf, &control_str)) {
-                    Log_d("control data from get_status_reply");
-                    _set_control_clientToken(pClientToken);
-                    _handle_control(pTemplate, control_str);
-                    HAL_Free(control_str);
-                    *((ReplyAck *)request->user_context) = ACK_ACCEPTED;  // prepare for clear_control
-                }
-            }
+    HAL_MutexLock(pTemplate->mutex);
+    request = (Request *)reply_table_find(&pTemplate->inner_data.reply_table, key);
+    if (NULL == request || strcmp(request->client_token, pClientToken)) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT;
+    }
+    reply_table_remove(&pTemplate->inner_data.reply_table, key);
 
-            if (request->callback != NULL) {
-                request->callback(pTemplate, request->method, status, sg_template_cloud_rcv_buf, request);
+    // check operation success or not according to code field of reply message
+    if (!parse_code_return(sg_template_cloud_rcv_buf, &reply_code)) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        Log_e("parse template operation result code failed.");
+        for (merged = request; NULL != merged; merged = merged->merged) {
+            if (0 != merged->report_seq) {
+                template_common_finish_changed_report(pTemplate, merged->report_seq, false);
             }
-        } else {
-            Log_e("parse template operation result code failed.");
         }
+        _free_template_request(request);
+        IOT_FUNC_EXIT;
+    }
 
-        list_remove(list, *node);
-        *node = NULL;
+    status = (reply_code == 0) ? ACK_ACCEPTED : ACK_REJECTED;
+    if (strcmp(pType, GET_STATUS_REPLY) == 0 && status == ACK_ACCEPTED) {
+        char *control_str = NULL;
+        if (parse_template_get_control(sg_template_cloud_rcv_buf, &control_str)) {
+            Log_d("control data from get_status_reply");
+            _set_control_clientToken(pClientToken);
+            _handle_control(pTemplate, control_str);
+            HAL_Free(control_str);
+            *((ReplyAck *)request->user_context) = ACK_ACCEPTED;  // prepare for clear_control
+        }
     }
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    _template_request_done(pTemplate, request, status);
+    _free_template_request(request);
 
     IOT_FUNC_EXIT;
 }
@@ -505,10 +814,19 @@ static void _on_template_downstream_topic_handler(void *pClient, MQTTMessage *me
         goto End;
     }
 
-    int cloud_rcv_len = min(CLOUD_IOT_JSON_RX_BUF_LEN - 1, message->payload_len);
-    memset(sg_template_cloud_rcv_buf, 0, sizeof(sg_template_cloud_rcv_buf));
-    memcpy(sg_template_cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
-    sg_template_cloud_rcv_buf[cloud_rcv_len] = '\0';  // jsmn_parse relies on a string
+    if (utils_is_cbor_map(message->payload, message->payload_len)) {
+        size_t json_len;
+        if (utils_cbor_to_json((uint8_t *)message->payload, message->payload_len, sg_template_cloud_rcv_buf,
+                               sizeof(sg_template_cloud_rcv_buf), &json_len) != QCLOUD_RET_SUCCESS) {
+            Log_e("Fail to decode cbor payload!");
+            goto End;
+        }
+    } else {
+        int cloud_rcv_len = min(CLOUD_IOT_JSON_RX_BUF_LEN - 1, message->payload_len);
+        memset(sg_template_cloud_rcv_buf, 0, sizeof(sg_template_cloud_rcv_buf));
+        memcpy(sg_template_cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
+        sg_template_cloud_rcv_buf[cloud_rcv_len] = '\0';  // jsmn_parse relies on a string
+    }
     Log_d("recv:%s", sg_template_cloud_rcv_buf);
 
     // parse the message type from topic $thing/down/property
@@ -538,8 +856,7 @@ static void _on_template_downstream_topic_handler(void *pClient, MQTTMessage *me
     }
 
     if (template_client != NULL)
-        _traverse_template_list(template_client, template_client->inner_data.reply_list, client_token, type_str,
-                                _handle_template_reply_callback);
+        _handle_template_reply(template_client, client_token, type_str);
 
 End:
     HAL_Free(type_str);
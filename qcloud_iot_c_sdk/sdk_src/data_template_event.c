@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TEMPLATE
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -38,60 +40,31 @@ extern "C" {
 #include "utils_param_check.h"
 
 /**
- * @brief iterator event list and call traverseHandle for each node
+ * @brief match the event reply by clientToken and call back
  */
-static void _traverse_event_list(Qcloud_IoT_Template *pTemplate, List *list, const char *pClientToken,
-                                 MQTTMessage *message, eEventDealType eDealType)
+static void _handle_event_reply(Qcloud_IoT_Template *pTemplate, const char *pClientToken, MQTTMessage *message)
 {
     IOT_FUNC_ENTRY;
 
-    HAL_MutexLock(pTemplate->mutex);
-
-    if (list->len) {
-        ListIterator *iter;
-        ListNode *    node = NULL;
-
-        if (NULL == (iter = list_iterator_new(list, LIST_TAIL))) {
-            HAL_MutexUnlock(pTemplate->mutex);
-            IOT_FUNC_EXIT;
-        }
-
-        for (;;) {
-            node = list_iterator_next(iter);
-            if (NULL == node) {
-                break;
-            }
-
-            if (NULL == node->val) {
-                Log_e("node's value is invalid!");
-                continue;
-            }
+    uint32_t     key = get_client_token_key(pClientToken, pTemplate->device_info.product_id);
+    sEventReply *pReply;
+    uint8_t      i;
 
-            sEventReply *pReply = (sEventReply *)node->val;
-            /*timeout check*/
-            if (eDEAL_EXPIRED == eDealType) {
-                if (expired(&pReply->timer)) {
-                    Log_e("eventToken[%s] timeout", pReply->client_token);
-                    list_remove(list, node);
-                    node = NULL;
-                }
-            }
-
-            /*match event wait for reply by clientToken*/
-            if ((eDEAL_REPLY_CB == eDealType) && (0 == strcmp(pClientToken, pReply->client_token))) {
-                if (NULL != pReply->callback) {
-                    pReply->callback(pTemplate, message);
-                    Log_d("eventToken[%s] released", pReply->client_token);
-                    list_remove(list, node);
-                    node = NULL;
-                }
-            }
-        }
-
-        list_iterator_destroy(iter);
+    HAL_MutexLock(pTemplate->mutex);
+    pReply = (sEventReply *)reply_table_find(&pTemplate->inner_data.event_table, key);
+    if (NULL == pReply || strcmp(pClientToken, pReply->client_token)) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT;
     }
+    reply_table_remove(&pTemplate->inner_data.event_table, key);
     HAL_MutexUnlock(pTemplate->mutex);
 
+    for (i = 0; i < pReply->callback_num; i++) {
+        pReply->callback[i](pTemplate, message);
+    }
+    Log_d("eventToken[%s] released", pReply->client_token);
+    HAL_Free(pReply);
+
     IOT_FUNC_EXIT;
 }
 
@@ -103,22 +76,46 @@ static void _on_event_reply_callback(void *pClient, MQTTMessage *message, void *
     //  (Qcloud_IoT_Template*)mqtt_client->event_handle.context;
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)userData;
 
-    int32_t code;
-    char *  client_token = NULL;
-    char *  status       = NULL;
+    int32_t     code;
+    char *      client_token = NULL;
+    char *      status       = NULL;
+    char *      json_buf     = NULL;
+    size_t      json_len;
+    MQTTMessage json_msg;
+
+    // the reply is handled and passed to callbacks in JSON
+    if (utils_is_cbor_map(message->payload, message->payload_len)) {
+        json_buf = (char *)HAL_Malloc(CLOUD_IOT_JSON_RX_BUF_LEN);
+        if (NULL == json_buf) {
+            Log_e("run memory malloc is error!");
+            return;
+        }
+
+        if (utils_cbor_to_json((uint8_t *)message->payload, message->payload_len, json_buf, CLOUD_IOT_JSON_RX_BUF_LEN,
+                               &json_len) != QCLOUD_RET_SUCCESS) {
+            Log_e("Fail to decode cbor payload!");
+            HAL_Free(json_buf);
+            return;
+        }
+
+        json_msg             = *message;
+        json_msg.payload     = json_buf;
+        json_msg.payload_len = json_len;
+        message              = &json_msg;
+    }
 
     Log_d("recv:%.*s", (int)message->payload_len, (char *)message->payload);
 
     // parse clientToken from payload
     if (!parse_client_token((char *)message->payload, &client_token)) {
         Log_e("fail to parse client token!");
-        return;
+        goto End;
     }
 
     // parse code from payload
     if (!parse_code_return((char *)message->payload, &code)) {
         Log_e("fail to parse code");
-        return;
+        goto End;
     }
 
 #if 0
@@ -130,57 +127,96 @@ static void _on_event_reply_callback(void *pClient, MQTTMessage *message, void *
 #endif
 
     if (template_client != NULL)
-        _traverse_event_list(template_client, template_client->inner_data.event_list, client_token, message,
-                             eDEAL_REPLY_CB);
+        _handle_event_reply(template_client, client_token, message);
 
+End:
     HAL_Free(client_token);
     HAL_Free(status);
+    HAL_Free(json_buf);
 
     return;
 }
 
 /**
- * @brief create event reply struct and add to event_list
+ * @brief add a callback to event reply, return false if no room for it
  */
-static sEventReply *_create_event_add_to_list(Qcloud_IoT_Template *pTemplate, OnEventReplyCallback replyCb,
-                                              uint32_t reply_timeout_ms)
+static bool _add_event_reply_callback(sEventReply *pReply, OnEventReplyCallback replyCb)
 {
-    IOT_FUNC_ENTRY;
+    uint8_t i;
 
-    HAL_MutexLock(pTemplate->mutex);
-    if (pTemplate->inner_data.event_list->len >= MAX_EVENT_WAIT_REPLY) {
-        HAL_MutexUnlock(pTemplate->mutex);
-        Log_e("Too many event wait for reply");
-        IOT_FUNC_EXIT_RC(NULL);
+    if (NULL == replyCb) {
+        return true;
+    }
+
+    for (i = 0; i < pReply->callback_num; i++) {
+        if (pReply->callback[i] == replyCb) {
+            return true;
+        }
     }
 
-    sEventReply *pReply = (sEventReply *)HAL_Malloc(sizeof(Request));
+    if (pReply->callback_num >= MAX_EVENT_BATCH_CALLBACK) {
+        return false;
+    }
+
+    pReply->callback[pReply->callback_num++] = replyCb;
+    return true;
+}
+
+static sEventReply *_new_event_reply(Qcloud_IoT_Template *pTemplate, OnEventReplyCallback replyCb)
+{
+    sEventReply *pReply = (sEventReply *)HAL_Malloc(sizeof(sEventReply));
     if (NULL == pReply) {
-        HAL_MutexUnlock(pTemplate->mutex);
         Log_e("run memory malloc is error!");
-        IOT_FUNC_EXIT_RC(NULL);
+        return NULL;
     }
 
-    pReply->callback     = replyCb;
+    memset(pReply, 0, sizeof(sEventReply));
     pReply->user_context = pTemplate;
+    _add_event_reply_callback(pReply, replyCb);
 
-    InitTimer(&(pReply->timer));
-    countdown(&(pReply->timer), reply_timeout_ms);
-    HAL_Snprintf(pReply->client_token, EVENT_TOKEN_MAX_LEN, "%s-%u", pTemplate->device_info.product_id,
-                 pTemplate->inner_data.token_num++);
+    return pReply;
+}
 
-    ListNode *node = list_node_new(pReply);
-    if (NULL == node) {
-        HAL_MutexUnlock(pTemplate->mutex);
-        Log_e("run list_node_new is error!");
-        HAL_Free(pReply);
-        IOT_FUNC_EXIT_RC(NULL);
-    }
+/**
+ * @brief assign clientToken to event reply and add it to event_table
+ */
+static int _add_event_reply_to_list(Qcloud_IoT_Template *pTemplate, sEventReply *pReply, uint32_t reply_timeout_ms)
+{
+    int      rc;
+    uint32_t token_num;
 
-    list_rpush(pTemplate->inner_data.event_list, node);
+    HAL_MutexLock(pTemplate->mutex);
+    token_num = pTemplate->inner_data.token_num++;
+    HAL_Snprintf(pReply->client_token, EVENT_TOKEN_MAX_LEN, "%s-%u", pTemplate->device_info.product_id, token_num);
 
+    rc = reply_table_add(&pTemplate->inner_data.event_table, token_num, pReply, reply_timeout_ms);
     HAL_MutexUnlock(pTemplate->mutex);
 
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("Too many event wait for reply");
+    }
+
+    return rc;
+}
+
+/**
+ * @brief create event reply struct and add to event_table
+ */
+static sEventReply *_create_event_add_to_list(Qcloud_IoT_Template *pTemplate, OnEventReplyCallback replyCb,
+                                              uint32_t reply_timeout_ms)
+{
+    IOT_FUNC_ENTRY;
+
+    sEventReply *pReply = _new_event_reply(pTemplate, replyCb);
+    if (NULL == pReply) {
+        IOT_FUNC_EXIT_RC(NULL);
+    }
+
+    if (_add_event_reply_to_list(pTemplate, pReply, reply_timeout_ms) != QCLOUD_RET_SUCCESS) {
+        HAL_Free(pReply);
+        IOT_FUNC_EXIT_RC(NULL);
+    }
+
     IOT_FUNC_EXIT_RC(pReply);
 }
 
@@ -211,12 +247,74 @@ static int _iot_event_json_init(void *handle, char *jsonBuffer, size_t sizeOfBuf
     return check_snprintf_return(rc_of_snprintf, sizeOfBuffer);
 }
 
+/**
+ * @brief append one event object {"eventId":..., "params":{...}} to jsonBuffer
+ */
+static int _iot_append_event_json(char *jsonBuffer, size_t sizeOfBuffer, sEvent *pEvent)
+{
+    size_t          remain_size    = 0;
+    int32_t         rc_of_snprintf = 0;
+    int             rc;
+    uint8_t         i;
+    DeviceProperty *pJsonNode;
+
+    if (NULL == pEvent) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+
+    if (0 == pEvent->timestamp) {  // no accurate UTC time, set 0
+        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size,
+                                      "{\"eventId\":\"%s\", \"type\":\"%s\", \"timestamp\":0, \"params\":{",
+                                      pEvent->event_name, pEvent->type);
+    } else {  // accurate UTC time is second,change to ms
+        rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size,
+                                      "{\"eventId\":\"%s\", \"type\":\"%s\", "
+                                      "\"timestamp\":%u000, \"params\":{",
+                                      pEvent->event_name, pEvent->type, pEvent->timestamp);
+    }
+
+    rc = check_snprintf_return(rc_of_snprintf, remain_size);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    pJsonNode = pEvent->pEventData;
+    for (i = 0; i < pEvent->eventDataNum; i++) {
+        if (pJsonNode == NULL || pJsonNode->key == NULL) {
+            Log_e("%dth/%d null event property data", i, pEvent->eventDataNum);
+            return QCLOUD_ERR_INVAL;
+        }
+
+        rc = template_put_json_node(jsonBuffer, sizeOfBuffer, pJsonNode->key, pJsonNode->data, pJsonNode->type);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+        pJsonNode++;
+    }
+
+    // overwrite the ',' after last property
+    if (pEvent->eventDataNum > 0) {
+        jsonBuffer[strlen(jsonBuffer) - 1] = '\0';
+    }
+
+    if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+
+    rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, "}}");
+    return check_snprintf_return(rc_of_snprintf, remain_size);
+}
+
 static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t sizeOfBuffer, uint8_t event_count,
                                      sEvent *pEventArry[], OnEventReplyCallback replyCb, uint32_t reply_timeout_ms)
 {
     size_t               remain_size    = 0;
     int32_t              rc_of_snprintf = 0;
-    uint8_t              i, j;
+    uint8_t              i;
     Qcloud_IoT_Template *ptemplate = (Qcloud_IoT_Template *)handle;
 
     POINTER_SANITY_CHECK(ptemplate, QCLOUD_ERR_INVAL);
@@ -247,25 +345,12 @@ static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t size
         }
 
         for (i = 0; i < event_count; i++) {
-            sEvent *pEvent = pEventArry[i];
-            if (NULL == pEvent) {
+            if (NULL == pEventArry[i]) {
                 Log_e("%dth/%d null event", i, event_count);
                 return QCLOUD_ERR_INVAL;
             }
 
-            if (0 == pEvent->timestamp) {  // no accurate UTC time, set 0
-                rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size,
-                                              "{\"eventId\":\"%s\", \"type\":\"%s\", "
-                                              "\"timestamp\":0, \"params\":{",
-                                              pEvent->event_name, pEvent->type);
-            } else {  // accurate UTC time is second,change to ms
-                rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size,
-                                              "{\"eventId\":\"%s\", \"type\":\"%s\", "
-                                              "\"timestamp\":%u000, \"params\":{",
-                                              pEvent->event_name, pEvent->type, pEvent->timestamp);
-            }
-
-            rc = check_snprintf_return(rc_of_snprintf, remain_size);
+            rc = _iot_append_event_json(jsonBuffer, sizeOfBuffer, pEventArry[i]);
             if (rc != QCLOUD_RET_SUCCESS) {
                 return rc;
             }
@@ -273,34 +358,11 @@ static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t size
             if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
                 return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
             }
-
-            DeviceProperty *pJsonNode = pEvent->pEventData;
-            for (j = 0; j < pEvent->eventDataNum; j++) {
-                if (pJsonNode != NULL && pJsonNode->key != NULL) {
-                    rc = template_put_json_node(jsonBuffer, remain_size, pJsonNode->key, pJsonNode->data,
-                                                pJsonNode->type);
-
-                    if (rc != QCLOUD_RET_SUCCESS) {
-                        return rc;
-                    }
-                } else {
-                    Log_e("%dth/%d null event property data", i, pEvent->eventDataNum);
-                    return QCLOUD_ERR_INVAL;
-                }
-                pJsonNode++;
-            }
-            if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
-                return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
-            }
-
-            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer) - 1, remain_size, "}},");
-
-            rc = check_snprintf_return(rc_of_snprintf, remain_size);
+            rc_of_snprintf = HAL_Snprintf(jsonBuffer + strlen(jsonBuffer), remain_size, ",");
+            rc             = check_snprintf_return(rc_of_snprintf, remain_size);
             if (rc != QCLOUD_RET_SUCCESS) {
                 return rc;
             }
-
-            pEvent++;
         }
 
         if ((remain_size = sizeOfBuffer - strlen(jsonBuffer)) <= 1) {
@@ -369,7 +431,111 @@ static int _iot_construct_event_json(void *handle, char *jsonBuffer, size_t size
     return check_snprintf_return(rc_of_snprintf, remain_size);
 }
 
-static int _publish_event_to_cloud(void *c, char *pJsonDoc)
+/**
+ * @brief put eventId, type, timestamp and params of one event to CBOR map
+ */
+static int _iot_put_event_cbor_fields(CborWriter *writer, sEvent *pEvent)
+{
+    int             rc;
+    uint8_t         i;
+    DeviceProperty *pJsonNode;
+
+    if (NULL == pEvent) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    utils_cbor_put_text(writer, "eventId");
+    utils_cbor_put_text(writer, pEvent->event_name);
+    utils_cbor_put_text(writer, "type");
+    utils_cbor_put_text(writer, pEvent->type);
+    utils_cbor_put_text(writer, "timestamp");
+    utils_cbor_put_int(writer, (int64_t)pEvent->timestamp * 1000);  // accurate UTC time is second,change to ms
+    utils_cbor_put_text(writer, CMD_CONTROL_PARA);
+    utils_cbor_put_map(writer, pEvent->eventDataNum);
+
+    pJsonNode = pEvent->pEventData;
+    for (i = 0; i < pEvent->eventDataNum; i++) {
+        if (pJsonNode == NULL || pJsonNode->key == NULL) {
+            Log_e("%dth/%d null event property data", i, pEvent->eventDataNum);
+            return QCLOUD_ERR_INVAL;
+        }
+
+        rc = template_put_cbor_node(writer, pJsonNode->key, pJsonNode->data, pJsonNode->type, true);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+        pJsonNode++;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/**
+ * @brief append one event object {"eventId":..., "params":{...}} to CBOR
+ */
+static int _iot_append_event_cbor(CborWriter *writer, sEvent *pEvent)
+{
+    utils_cbor_put_map(writer, 4);
+    return _iot_put_event_cbor_fields(writer, pEvent);
+}
+
+/**
+ * @brief construct event document in CBOR from the events directly, in the same layout as the JSON one
+ */
+static int _iot_construct_event_cbor(Qcloud_IoT_Template *pTemplate, uint8_t *buf, size_t size, uint8_t event_count,
+                                     sEvent *pEventArry[], OnEventReplyCallback replyCb, uint32_t reply_timeout_ms,
+                                     size_t *len)
+{
+    int          rc;
+    uint8_t      i;
+    CborWriter   writer;
+    sEventReply *pReply;
+
+    for (i = 0; i < event_count; i++) {
+        if (NULL == pEventArry[i]) {
+            Log_e("%dth/%d null event", i, event_count);
+            return QCLOUD_ERR_INVAL;
+        }
+    }
+
+    pReply = _create_event_add_to_list(pTemplate, replyCb, reply_timeout_ms);
+    if (!pReply) {
+        Log_e("create event failed");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    utils_cbor_writer_init(&writer, buf, size);
+    if (event_count > SIGLE_EVENT) {
+        utils_cbor_put_map(&writer, 3);
+        utils_cbor_put_text(&writer, METHOD_FIELD);
+        utils_cbor_put_text(&writer, POST_EVENTS);
+        utils_cbor_put_text(&writer, CLIENT_TOKEN_FIELD);
+        utils_cbor_put_text(&writer, pReply->client_token);
+        utils_cbor_put_text(&writer, "events");
+        utils_cbor_put_array(&writer, event_count);
+        for (i = 0; i < event_count; i++) {
+            rc = _iot_append_event_cbor(&writer, pEventArry[i]);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                return rc;
+            }
+        }
+    } else {
+        utils_cbor_put_map(&writer, 6);
+        utils_cbor_put_text(&writer, METHOD_FIELD);
+        utils_cbor_put_text(&writer, POST_EVENT);
+        utils_cbor_put_text(&writer, CLIENT_TOKEN_FIELD);
+        utils_cbor_put_text(&writer, pReply->client_token);
+        rc = _iot_put_event_cbor_fields(&writer, pEventArry[0]);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+    }
+
+    *len = writer.len;
+    return utils_cbor_writer_result(&writer);
+}
+
+static int _publish_event_to_cloud(void *c, void *pPayload, size_t len)
 {
     IOT_FUNC_ENTRY;
     int                  rc                             = QCLOUD_RET_SUCCESS;
@@ -383,12 +549,226 @@ static int _publish_event_to_cloud(void *c, char *pJsonDoc)
         return QCLOUD_ERR_FAILURE;
     }
 
-    PublishParams pubParams = DEFAULT_PUB_PARAMS;
-    pubParams.qos           = QOS1;
-    pubParams.payload_len   = strlen(pJsonDoc);
-    pubParams.payload       = (char *)pJsonDoc;
+    rc = publish_template_payload(pTemplate, topic, QOS1, pPayload, len);
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+/**
+ * @brief check if events of events_len posted with replyCb fit in the pending batch, called with mutex locked
+ */
+static bool _event_batch_fits(TemplateInnerData *inner_data, size_t events_len, OnEventReplyCallback replyCb)
+{
+    sEventReply *pReply = (sEventReply *)inner_data->pending_event_reply;
+    uint8_t      i;
+
+    if (NULL == inner_data->pending_events) {
+        return true;
+    }
+
+    if (inner_data->pending_events_len + events_len > inner_data->event_batch_size) {
+        return false;
+    }
 
-    rc = IOT_MQTT_Publish(pTemplate->mqtt, topic, &pubParams);
+    if (NULL == replyCb || pReply->callback_num < MAX_EVENT_BATCH_CALLBACK) {
+        return true;
+    }
+
+    for (i = 0; i < pReply->callback_num; i++) {
+        if (pReply->callback[i] == replyCb) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief serialize events and add them to the pending batch
+ *
+ * @return QCLOUD_RET_SUCCESS if queued, or err code if the events should be posted directly
+ */
+static int _enqueue_template_event(Qcloud_IoT_Template *pTemplate, char *pJsonDoc, size_t sizeOfBuffer,
+                                   uint8_t event_count, sEvent *pEventArry[], OnEventReplyCallback replyCb)
+{
+    IOT_FUNC_ENTRY;
+
+    TemplateInnerData *inner_data = &pTemplate->inner_data;
+    int                rc;
+    uint8_t            i;
+    size_t             events_len;
+    int32_t            rc_of_snprintf;
+
+    // serialize now as the events may be changed by caller after return
+    if (TEMPLATE_CODEC_CBOR == pTemplate->codec) {
+        CborWriter writer;
+
+        utils_cbor_writer_init(&writer, (uint8_t *)pJsonDoc, sizeOfBuffer);
+        for (i = 0; i < event_count; i++) {
+            rc = _iot_append_event_cbor(&writer, pEventArry[i]);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                IOT_FUNC_EXIT_RC(rc);
+            }
+        }
+
+        rc = utils_cbor_writer_result(&writer);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            IOT_FUNC_EXIT_RC(rc);
+        }
+        events_len = writer.len;
+    } else {
+        memset(pJsonDoc, 0, sizeOfBuffer);
+        for (i = 0; i < event_count; i++) {
+            if (NULL == pEventArry[i]) {
+                Log_e("%dth/%d null event", i, event_count);
+                IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+            }
+
+            rc = _iot_append_event_json(pJsonDoc, sizeOfBuffer, pEventArry[i]);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                IOT_FUNC_EXIT_RC(rc);
+            }
+
+            rc_of_snprintf = HAL_Snprintf(pJsonDoc + strlen(pJsonDoc), sizeOfBuffer - strlen(pJsonDoc), ",");
+            rc             = check_snprintf_return(rc_of_snprintf, sizeOfBuffer - strlen(pJsonDoc));
+            if (rc != QCLOUD_RET_SUCCESS) {
+                IOT_FUNC_EXIT_RC(rc);
+            }
+        }
+        events_len = strlen(pJsonDoc);
+    }
+    if (events_len > inner_data->event_batch_size) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL);
+    }
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (!_event_batch_fits(inner_data, events_len, replyCb)) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        flush_template_pending_event(pTemplate, true);
+        HAL_MutexLock(pTemplate->mutex);
+    }
+
+    if (NULL == inner_data->pending_events) {
+        inner_data->pending_events      = (char *)HAL_Malloc(inner_data->event_batch_size + 1);
+        inner_data->pending_event_reply = _new_event_reply(pTemplate, NULL);
+        if (NULL == inner_data->pending_events || NULL == inner_data->pending_event_reply) {
+            HAL_Free(inner_data->pending_events);
+            HAL_Free(inner_data->pending_event_reply);
+            inner_data->pending_events      = NULL;
+            inner_data->pending_event_reply = NULL;
+            HAL_MutexUnlock(pTemplate->mutex);
+            Log_e("run memory malloc is error!");
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+        }
+        inner_data->pending_events_len = 0;
+        inner_data->pending_event_num  = 0;
+        countdown_ms(&inner_data->event_timer, inner_data->event_batch_ms);
+    } else if (!_event_batch_fits(inner_data, events_len, replyCb)) {
+        // filled by another thread after the flush
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL);
+    }
+
+    memcpy(inner_data->pending_events + inner_data->pending_events_len, pJsonDoc, events_len);
+    inner_data->pending_events_len += events_len;
+    inner_data->pending_events[inner_data->pending_events_len] = '\0';
+    inner_data->pending_event_num += event_count;
+    _add_event_reply_callback((sEventReply *)inner_data->pending_event_reply, replyCb);
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int flush_template_pending_event(Qcloud_IoT_Template *pTemplate, bool force)
+{
+    IOT_FUNC_ENTRY;
+
+    int          rc = QCLOUD_RET_SUCCESS;
+    char *       events;
+    char *       json_doc = NULL;
+    sEventReply *pReply;
+    uint16_t     event_num;
+    size_t       events_len;
+    size_t       doc_size, doc_len = 0;
+    int32_t      rc_of_snprintf;
+
+    POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
+
+    HAL_MutexLock(pTemplate->mutex);
+    if (NULL == pTemplate->inner_data.pending_events || (!force && !expired(&pTemplate->inner_data.event_timer))) {
+        HAL_MutexUnlock(pTemplate->mutex);
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+    events                                    = pTemplate->inner_data.pending_events;
+    events_len                                = pTemplate->inner_data.pending_events_len;
+    pReply                                    = (sEventReply *)pTemplate->inner_data.pending_event_reply;
+    event_num                                 = pTemplate->inner_data.pending_event_num;
+    pTemplate->inner_data.pending_events      = NULL;
+    pTemplate->inner_data.pending_event_reply = NULL;
+    pTemplate->inner_data.pending_event_num   = 0;
+    pTemplate->inner_data.pending_events_len  = 0;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    doc_size = events_len + EVENT_TOKEN_MAX_LEN + 64;
+    json_doc = (char *)HAL_Malloc(doc_size);
+    if (NULL == json_doc) {
+        Log_e("run memory malloc is error!");
+        rc = QCLOUD_ERR_MALLOC;
+        goto End;
+    }
+
+    rc = _add_event_reply_to_list(pTemplate, pReply, QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        goto End;
+    }
+
+    // the reply is released by event_table from now on, as a direct post does
+    if (TEMPLATE_CODEC_CBOR == pTemplate->codec) {
+        CborWriter writer;
+
+        utils_cbor_writer_init(&writer, (uint8_t *)json_doc, doc_size);
+        utils_cbor_put_map(&writer, 3);
+        utils_cbor_put_text(&writer, METHOD_FIELD);
+        utils_cbor_put_text(&writer, POST_EVENTS);
+        utils_cbor_put_text(&writer, CLIENT_TOKEN_FIELD);
+        utils_cbor_put_text(&writer, pReply->client_token);
+        utils_cbor_put_text(&writer, "events");
+        utils_cbor_put_array(&writer, event_num);
+        pReply  = NULL;
+        rc      = utils_cbor_writer_result(&writer);
+        doc_len = writer.len + events_len;
+        if (rc != QCLOUD_RET_SUCCESS || doc_len > doc_size) {
+            rc = QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+            goto End;
+        }
+        memcpy(json_doc + writer.len, events, events_len);
+    } else {
+        events[events_len - 1] = '\0';
+
+        rc_of_snprintf = HAL_Snprintf(json_doc, doc_size,
+                                      "{\"method\":\"%s\", \"clientToken\":\"%s\", \"events\":[%s]}", POST_EVENTS,
+                                      pReply->client_token, events);
+        pReply  = NULL;
+        rc      = check_snprintf_return(rc_of_snprintf, doc_size);
+        doc_len = strlen(json_doc);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            goto End;
+        }
+    }
+
+    Log_d("post %u events in one document", event_num);
+    rc = _publish_event_to_cloud(pTemplate, json_doc, doc_len);
+    if (rc >= 0) {
+        rc = QCLOUD_RET_SUCCESS;
+    }
+
+End:
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("post %u batched events failed: %d", event_num, rc);
+    }
+    HAL_Free(pReply);
+    HAL_Free(json_doc);
+    HAL_Free(events);
 
     IOT_FUNC_EXIT_RC(rc);
 }
@@ -398,7 +778,19 @@ void handle_template_expired_event(void *client)
     IOT_FUNC_ENTRY;
     Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)client;
 
-    _traverse_event_list(pTemplate, pTemplate->inner_data.event_list, NULL, NULL, eDEAL_EXPIRED);
+    sEventReply *pReply;
+
+    for (;;) {
+        HAL_MutexLock(pTemplate->mutex);
+        pReply = (sEventReply *)reply_table_pop_expired(&pTemplate->inner_data.event_table);
+        HAL_MutexUnlock(pTemplate->mutex);
+        if (NULL == pReply) {
+            break;
+        }
+
+        Log_e("eventToken[%s] timeout", pReply->client_token);
+        HAL_Free(pReply);
+    }
 
     IOT_FUNC_EXIT;
 }
@@ -443,19 +835,72 @@ int IOT_Event_Init(void *c)
     return IOT_MQTT_Subscribe(pTemplate->mqtt, topic_name, &sub_params);
 }
 
+int IOT_Event_Set_Batch(void *client, uint32_t window_ms, uint16_t max_size)
+{
+    IOT_FUNC_ENTRY;
+
+    POINTER_SANITY_CHECK(client, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)client;
+
+    if (window_ms > 0 && max_size < MIN_EVENT_BATCH_SIZE) {
+        Log_e("event batch size %u too small", max_size);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    // the pending batch is posted with the old budget
+    flush_template_pending_event(pTemplate, true);
+
+    HAL_MutexLock(pTemplate->mutex);
+    pTemplate->inner_data.event_batch_ms   = window_ms;
+    pTemplate->inner_data.event_batch_size = max_size;
+    HAL_MutexUnlock(pTemplate->mutex);
+
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+}
+
+int IOT_Event_Flush(void *client)
+{
+    POINTER_SANITY_CHECK(client, QCLOUD_ERR_INVAL);
+
+    return flush_template_pending_event((Qcloud_IoT_Template *)client, true);
+}
+
 int IOT_Post_Event(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, uint8_t event_count, sEvent *pEventArry[],
                    OnEventReplyCallback replyCb)
 {
-    int rc;
+    int                  rc;
+    size_t               doc_len   = 0;
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+
+    POINTER_SANITY_CHECK(pTemplate, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pEventArry, QCLOUD_ERR_INVAL);
 
-    rc = _iot_construct_event_json(pClient, pJsonDoc, sizeOfBuffer, event_count, pEventArry, replyCb,
-                                   QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
+    if (pTemplate->inner_data.event_batch_ms > 0) {
+        rc = _enqueue_template_event(pTemplate, pJsonDoc, sizeOfBuffer, event_count, pEventArry, replyCb);
+        if (rc == QCLOUD_RET_SUCCESS || rc == QCLOUD_ERR_INVAL) {
+            return rc;
+        }
+
+        // can't be queued, keep the order with the pending batch
+        flush_template_pending_event(pTemplate, true);
+    }
+
+    if (TEMPLATE_CODEC_CBOR == pTemplate->codec) {
+        rc = _iot_construct_event_cbor(pTemplate, (uint8_t *)pJsonDoc, sizeOfBuffer, event_count, pEventArry, replyCb,
+                                       QCLOUD_IOT_MQTT_COMMAND_TIMEOUT, &doc_len);
+    } else {
+        rc      = _iot_construct_event_json(pClient, pJsonDoc, sizeOfBuffer, event_count, pEventArry, replyCb,
+                                            QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
+        doc_len = strlen(pJsonDoc);
+    }
     if (rc != QCLOUD_RET_SUCCESS) {
-        Log_e("construct event json fail, %d", rc);
+        Log_e("construct event fail, %d", rc);
         return rc;
     }
 
-    rc = _publish_event_to_cloud(pClient, pJsonDoc);
+    rc = _publish_event_to_cloud(pClient, pJsonDoc, doc_len);
     if (rc < 0) {
         Log_e("publish event to cloud fail, %d", rc);
     }
@@ -476,6 +921,8 @@ int IOT_Post_Event_Raw(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, char
     POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pEventMsg, QCLOUD_ERR_INVAL);
 
+    flush_template_pending_event(ptemplate, true);
+
     rc = _iot_event_json_init(ptemplate, pJsonDoc, sizeOfBuffer, MUTLTI_EVENTS, replyCb,
                               QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
     if (rc != QCLOUD_RET_SUCCESS) {
@@ -495,7 +942,7 @@ int IOT_Post_Event_Raw(void *pClient, char *pJsonDoc, size_t sizeOfBuffer, char
 
     Log_d("JsonDoc:%s", pJsonDoc);
 
-    rc = _publish_event_to_cloud(pClient, pJsonDoc);
+    rc = _publish_event_to_cloud(pClient, pJsonDoc, strlen(pJsonDoc));
     if (rc < 0) {
         Log_e("publish event raw to cloud fail, %d", rc);
     }
@@ -470,7 +470,7 @@ static int _post_reg_request_by_http(char *request_buf, DeviceInfo *pDevInfo)
         }
     }
 
-    qcloud_http_client_close(&http_client);
+    qcloud_http_client_release(&http_client, &http_data);
 
     return Ret;
 }
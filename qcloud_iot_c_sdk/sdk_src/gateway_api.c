@@ -19,6 +19,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_GATEWAY
+
 #include <string.h>
 
 #include "gateway_common.h"
@@ -112,8 +114,7 @@ void _gateway_event_handler(void *client, void *context, MQTTEventMsg *msg)
         case MQTT_EVENT_SUBCRIBE_SUCCESS:
         case MQTT_EVENT_UNSUBCRIBE_SUCCESS:
             Log_d("gateway sub|unsub(%d) success, packet-id=%u", msg->event_type, (unsigned int)packet_id);
-            if (gateway->gateway_data.sync_status == packet_id) {
-                gateway->gateway_data.sync_status = 0;
+            if (gateway_sync_ack(gateway, packet_id, QCLOUD_RET_SUCCESS)) {
                 return;
             }
             break;
@@ -123,8 +124,7 @@ void _gateway_event_handler(void *client, void *context, MQTTEventMsg *msg)
         case MQTT_EVENT_SUBCRIBE_NACK:
         case MQTT_EVENT_UNSUBCRIBE_NACK:
             Log_d("gateway timeout|nack(%d) event, packet-id=%u", msg->event_type, (unsigned int)packet_id);
-            if (gateway->gateway_data.sync_status == packet_id) {
-                gateway->gateway_data.sync_status = -1;
+            if (gateway_sync_ack(gateway, packet_id, QCLOUD_ERR_FAILURE)) {
                 return;
             }
             break;
@@ -161,6 +161,21 @@ void *IOT_Gateway_Construct(GatewayInitParam *init_param)
 
     memset(gateway, 0, sizeof(Gateway));
 
+    rc = subdev_session_init(gateway, init_param->max_subdev_num > 0 ? init_param->max_subdev_num : MAX_NUM_SUB_DEV);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("init session table failed: %d", rc);
+        HAL_Free(gateway);
+        IOT_FUNC_EXIT_RC(NULL);
+    }
+
+    rc = gateway_batch_init(gateway, gateway->sessions.max_count);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("init operation table failed: %d", rc);
+        subdev_session_deinit(gateway);
+        HAL_Free(gateway);
+        IOT_FUNC_EXIT_RC(NULL);
+    }
+
     /* replace user event handle */
     gateway->event_handle.h_fp    = init_param->init_param.event_handle.h_fp;
     gateway->event_handle.context = init_param->init_param.event_handle.context;
@@ -173,6 +188,8 @@ void *IOT_Gateway_Construct(GatewayInitParam *init_param)
     gateway->mqtt = IOT_MQTT_Construct(&init_param->init_param);
     if (NULL == gateway->mqtt) {
         Log_e("construct MQTT failed");
+        gateway_batch_deinit(gateway);
+        subdev_session_deinit(gateway);
         HAL_Free(gateway);
         IOT_FUNC_EXIT_RC(NULL);
     }
@@ -194,15 +211,13 @@ void *IOT_Gateway_Construct(GatewayInitParam *init_param)
     return (void *)gateway;
 }
 
-int IOT_Gateway_Subdev_Online(void *client, GatewayParam *param)
+/* online/offline of one sub-device is a batch of it */
+static int _gateway_subdev_operation(void *client, GatewayParam *param, const char *type)
 {
-    int            rc                                      = 0;
-    char           topic[MAX_SIZE_OF_CLOUD_TOPIC + 1]      = {0};
-    char           payload[GATEWAY_PAYLOAD_BUFFER_LEN + 1] = {0};
-    int            size                                    = 0;
-    SubdevSession *session                                 = NULL;
-    PublishParams  params                                  = DEFAULT_PUB_PARAMS;
-    Gateway *      gateway                                 = (Gateway *)client;
+    int                 rc      = 0;
+    GatewaySubdevStatus subdev  = {NULL, NULL, QCLOUD_ERR_FAILURE};
+    GatewayBatchParam   batch   = DEFAULT_GATEWAY_BATCH_PARAMS;
+    Gateway *           gateway = (Gateway *)client;
 
     POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(param, QCLOUD_ERR_INVAL);
@@ -212,128 +227,131 @@ int IOT_Gateway_Subdev_Online(void *client, GatewayParam *param)
     STRING_PTR_SANITY_CHECK(param->subdev_product_id, QCLOUD_ERR_INVAL);
     STRING_PTR_SANITY_CHECK(param->subdev_device_name, QCLOUD_ERR_INVAL);
 
-    session = subdev_find_session(gateway, param->subdev_product_id, param->subdev_device_name);
-    if (NULL == session) {
-        Log_d("there is no session, create a new session");
-
-        /* create subdev session */
-        session = subdev_add_session(gateway, param->subdev_product_id, param->subdev_device_name);
-        if (NULL == session) {
-            Log_e("create session error!");
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_GATEWAY_CREATE_SESSION_FAIL);
-        }
-    } else {
-        if (SUBDEV_SEESION_STATUS_ONLINE == session->session_status) {
-            Log_i("device have online");
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_GATEWAY_SUBDEV_ONLINE);
-        }
-    }
+    subdev.product_id  = param->subdev_product_id;
+    subdev.device_name = param->subdev_device_name;
+    batch.product_id   = param->product_id;
+    batch.device_name  = param->device_name;
+    batch.subdevs      = &subdev;
+    batch.subdev_num   = 1;
 
-    size = HAL_Snprintf(topic, MAX_SIZE_OF_CLOUD_TOPIC + 1, GATEWAY_TOPIC_OPERATION_FMT, param->product_id,
-                        param->device_name);
-    if (size < 0 || size > MAX_SIZE_OF_CLOUD_TOPIC) {
-        Log_e("buf size < topic length!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    rc = gateway_batch_run(gateway, &batch, type);
+    if (QCLOUD_ERR_FAILURE == rc) {
+        rc = subdev.result;
     }
 
-    size = HAL_Snprintf(payload, GATEWAY_PAYLOAD_BUFFER_LEN + 1, GATEWAY_PAYLOAD_STATUS_FMT, "online",
-                        param->subdev_product_id, param->subdev_device_name);
-    if (size < 0 || size > GATEWAY_PAYLOAD_BUFFER_LEN) {
-        Log_e("buf size < payload length!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
-
-    size = HAL_Snprintf(gateway->gateway_data.online.client_id, MAX_SIZE_OF_CLIENT_ID, GATEWAY_CLIENT_ID_FMT,
-                        param->subdev_product_id, param->subdev_device_name);
-    if (size < 0 || size > MAX_SIZE_OF_CLIENT_ID) {
-        Log_e("buf size < client_id length!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
-    gateway->gateway_data.online.result = -1;
-
-    params.qos         = QOS0;
-    params.payload_len = strlen(payload);
-    params.payload     = (char *)payload;
-
-    /* publish packet */
-    rc = gateway_publish_sync(gateway, topic, &params, &gateway->gateway_data.online.result);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        subdev_remove_session(gateway, param->subdev_product_id, param->subdev_device_name);
-        IOT_FUNC_EXIT_RC(rc);
-    }
+    IOT_FUNC_EXIT_RC(rc);
+}
 
-    session->session_status = SUBDEV_SEESION_STATUS_ONLINE;
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+int IOT_Gateway_Subdev_Online(void *client, GatewayParam *param)
+{
+    return _gateway_subdev_operation(client, param, "online");
 }
 
 int IOT_Gateway_Subdev_Offline(void *client, GatewayParam *param)
 {
-    int            rc                                      = 0;
-    char           topic[MAX_SIZE_OF_CLOUD_TOPIC + 1]      = {0};
-    char           payload[GATEWAY_PAYLOAD_BUFFER_LEN + 1] = {0};
-    int            size                                    = 0;
-    SubdevSession *session                                 = NULL;
-    Gateway *      gateway                                 = (Gateway *)client;
+    return _gateway_subdev_operation(client, param, "offline");
+}
+
+static int _gateway_subdev_batch(void *client, GatewayBatchParam *param, const char *type)
+{
+    Gateway *gateway = (Gateway *)client;
+    int      i;
 
     POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(param, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(param->subdevs, QCLOUD_ERR_INVAL);
+    if (param->subdev_num <= 0) {
+        Log_e("invalid subdev_num: %d", param->subdev_num);
+        return QCLOUD_ERR_INVAL;
+    }
 
     STRING_PTR_SANITY_CHECK(param->product_id, QCLOUD_ERR_INVAL);
     STRING_PTR_SANITY_CHECK(param->device_name, QCLOUD_ERR_INVAL);
-    STRING_PTR_SANITY_CHECK(param->subdev_product_id, QCLOUD_ERR_INVAL);
-    STRING_PTR_SANITY_CHECK(param->subdev_device_name, QCLOUD_ERR_INVAL);
-
-    session = subdev_find_session(gateway, param->subdev_product_id, param->subdev_device_name);
-    if (NULL == session) {
-        Log_d("no session, can not offline");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_GATEWAY_SESSION_NO_EXIST);
-    }
-    if (SUBDEV_SEESION_STATUS_OFFLINE == session->session_status) {
-        Log_i("device have offline");
-        /* free session */
-        subdev_remove_session(gateway, param->subdev_product_id, param->subdev_device_name);
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_GATEWAY_SUBDEV_OFFLINE);
+    for (i = 0; i < param->subdev_num; i++) {
+        STRING_PTR_SANITY_CHECK(param->subdevs[i].product_id, QCLOUD_ERR_INVAL);
+        STRING_PTR_SANITY_CHECK(param->subdevs[i].device_name, QCLOUD_ERR_INVAL);
     }
 
-    size = HAL_Snprintf(topic, MAX_SIZE_OF_CLOUD_TOPIC + 1, GATEWAY_TOPIC_OPERATION_FMT, param->product_id,
-                        param->device_name);
-    if (size < 0 || size > MAX_SIZE_OF_CLOUD_TOPIC) {
-        Log_e("buf size < topic length!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
+    return gateway_batch_run(gateway, param, type);
+}
 
-    size = HAL_Snprintf(payload, GATEWAY_PAYLOAD_BUFFER_LEN + 1, GATEWAY_PAYLOAD_STATUS_FMT, "offline",
-                        param->subdev_product_id, param->subdev_device_name);
-    if (size < 0 || size > GATEWAY_PAYLOAD_BUFFER_LEN) {
-        Log_e("buf size < payload length!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
+int IOT_Gateway_Subdev_Batch_Online(void *client, GatewayBatchParam *param)
+{
+    return _gateway_subdev_batch(client, param, "online");
+}
 
-    size = HAL_Snprintf(gateway->gateway_data.offline.client_id, MAX_SIZE_OF_CLIENT_ID, GATEWAY_CLIENT_ID_FMT,
-                        param->subdev_product_id, param->subdev_device_name);
-    if (size < 0 || size > MAX_SIZE_OF_CLIENT_ID) {
-        Log_e("buf size < client_id length!");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+int IOT_Gateway_Subdev_Batch_Offline(void *client, GatewayBatchParam *param)
+{
+    return _gateway_subdev_batch(client, param, "offline");
+}
+
+void *IOT_Gateway_Subdev_Get_Handle(void *client, const char *product_id, const char *device_name)
+{
+    Gateway *      gateway = (Gateway *)client;
+    SubdevSession *session = NULL;
+    void *         subdev  = NULL;
+
+    POINTER_SANITY_CHECK(gateway, NULL);
+
+    HAL_MutexLock(gateway->lock);
+    session = subdev_find_session(gateway, (char *)product_id, (char *)device_name);
+    if (NULL != session) {
+        subdev = subdev_session_handle(gateway, session);
     }
-    gateway->gateway_data.offline.result = -1;
+    HAL_MutexUnlock(gateway->lock);
 
-    PublishParams params = DEFAULT_PUB_PARAMS;
-    params.qos           = QOS0;
-    params.payload_len   = strlen(payload);
-    params.payload       = (char *)payload;
+    return subdev;
+}
 
-    /* publish packet */
-    rc = gateway_publish_sync(gateway, topic, &params, &gateway->gateway_data.offline.result);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        IOT_FUNC_EXIT_RC(rc);
+bool IOT_Gateway_Subdev_Is_Online(void *client, void *subdev)
+{
+    Gateway *      gateway = (Gateway *)client;
+    SubdevSession *session = NULL;
+    bool           online  = false;
+
+    POINTER_SANITY_CHECK(gateway, false);
+
+    HAL_MutexLock(gateway->lock);
+    session = subdev_handle_session(gateway, subdev);
+    online  = NULL != session && SUBDEV_SEESION_STATUS_ONLINE == session->session_status;
+    HAL_MutexUnlock(gateway->lock);
+
+    return online;
+}
+
+int IOT_Gateway_Subdev_Publish(void *client, void *subdev, char *topic_name, PublishParams *params)
+{
+    Gateway *      gateway = (Gateway *)client;
+    SubdevSession *session = NULL;
+    char           product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char           device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    int            rc = QCLOUD_RET_SUCCESS;
+
+    POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
+
+    // session may be removed by yield, what is needed is copied out under lock
+    HAL_MutexLock(gateway->lock);
+    session = subdev_handle_session(gateway, subdev);
+    if (NULL == session) {
+        rc = QCLOUD_ERR_GATEWAY_SESSION_NO_EXIST;
+    } else if (SUBDEV_SEESION_STATUS_ONLINE != session->session_status) {
+        rc = QCLOUD_ERR_GATEWAY_SUBDEV_OFFLINE;
+        strcpy(product_id, session->product_id);
+        strcpy(device_name, session->device_name);
     }
+    HAL_MutexUnlock(gateway->lock);
 
-    session->session_status = SUBDEV_SEESION_STATUS_OFFLINE;
+    if (QCLOUD_ERR_GATEWAY_SESSION_NO_EXIST == rc) {
+        Log_e("invalid sub-device handle");
+        return rc;
+    }
 
-    /* free session */
-    subdev_remove_session(gateway, param->subdev_product_id, param->subdev_device_name);
+    if (QCLOUD_ERR_GATEWAY_SUBDEV_OFFLINE == rc) {
+        Log_e("sub-device %s/%s is not online", product_id, device_name);
+        return rc;
+    }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    return IOT_MQTT_Publish(gateway->mqtt, topic_name, params);
 }
 
 void *IOT_Gateway_Get_Mqtt_Client(void *handle)
@@ -350,12 +368,8 @@ int IOT_Gateway_Destroy(void *client)
     Gateway *gateway = (Gateway *)client;
     POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
 
-    SubdevSession *cur_session = gateway->session_list;
-    while (cur_session) {
-        SubdevSession *session = cur_session;
-        cur_session            = cur_session->next;
-        HAL_Free(session);
-    }
+    gateway_batch_deinit(gateway);
+    subdev_session_deinit(gateway);
 
     IOT_MQTT_Destroy(&gateway->mqtt);
     HAL_Free(client);
@@ -368,7 +382,11 @@ int IOT_Gateway_Yield(void *client, uint32_t timeout_ms)
     Gateway *gateway = (Gateway *)client;
     POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
 
-    return IOT_MQTT_Yield(gateway->mqtt, timeout_ms);
+    int rc = IOT_MQTT_Yield(gateway->mqtt, timeout_ms);
+    gateway_batch_check_timeout(gateway);
+    gateway_template_check_timeout(gateway);
+
+    return rc;
 }
 
 int IOT_Gateway_Subscribe(void *client, char *topic_filter, SubscribeParams *params)
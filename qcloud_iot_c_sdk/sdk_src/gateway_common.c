@@ -19,10 +19,16 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_GATEWAY
+
 #include "gateway_common.h"
 
+#include "json_parser.h"
 #include "lite-utils.h"
 #include "mqtt_client.h"
+#include "utils_fnv1a.h"
+
+#define SUBDEV_SESSION_MIN_SLOTS 4
 
 static char cloud_rcv_buf[GATEWAY_RECEIVE_BUFFER_LEN];
 
@@ -64,6 +70,37 @@ static bool get_json_device_name(char *json, char **v)
     return *v == NULL ? false : true;
 }
 
+static void _gateway_op_on_result(Gateway *gateway, const char *type, const char *product_id,
+                                  const char *device_name, int32_t result);
+
+/* handle result of one device in reply, device is a null-terminated json object */
+static void _gateway_reply_device(Gateway *gateway, const char *type, char *device)
+{
+    char *  product_id  = NULL;
+    char *  device_name = NULL;
+    int32_t result      = 0;
+
+    if (!get_json_result(device, &result)) {
+        Log_e("Fail to parse result from msg: %s", device);
+        return;
+    }
+    if (!get_json_product_id(device, &product_id)) {
+        Log_e("Fail to parse product_id from msg: %s", device);
+        return;
+    }
+    if (!get_json_device_name(device, &device_name)) {
+        Log_e("Fail to parse device_name from msg: %s", device);
+        HAL_Free(product_id);
+        return;
+    }
+
+    Log_i("client_id(%s/%s), %s result %d", product_id, device_name, type, result);
+    _gateway_op_on_result(gateway, type, product_id, device_name, result);
+
+    HAL_Free(product_id);
+    HAL_Free(device_name);
+}
+
 static void _gateway_message_handler(void *client, MQTTMessage *message, void *user_data)
 {
     Qcloud_IoT_Client *mqtt          = NULL;
@@ -72,12 +109,12 @@ static void _gateway_message_handler(void *client, MQTTMessage *message, void *u
     size_t             topic_len     = 0;
     int                cloud_rcv_len = 0;
     char *             type          = NULL;
-    char *             devices = NULL, *devices_strip = NULL;
-    char *             product_id                           = NULL;
-    char *             device_name                          = NULL;
-    int32_t            result                               = 0;
-    char               client_id[MAX_SIZE_OF_CLIENT_ID + 1] = {0};
-    int                size                                 = 0;
+    char *             devices       = NULL;
+    char *             pos           = NULL;
+    char *             entry         = NULL;
+    int                entry_len     = 0;
+    int                entry_type    = 0;
+    char               old_ch        = 0;
 
     POINTER_SANITY_CHECK_RTN(client);
     POINTER_SANITY_CHECK_RTN(message);
@@ -115,73 +152,86 @@ static void _gateway_message_handler(void *client, MQTTMessage *message, void *u
     }
 
     if (devices[0] == '[') {
-        devices_strip = devices + 1;
+        // reply of batch has result of each device
+        json_array_for_each_entry(devices, pos, entry, entry_len, entry_type)
+        {
+            if (JSOBJECT != entry_type) {
+                continue;
+            }
+            backup_json_str_last_char(entry, entry_len, old_ch);
+            _gateway_reply_device(gateway, type, entry);
+            restore_json_str_last_char(entry, entry_len, old_ch);
+        }
     } else {
-        devices_strip = devices;
+        _gateway_reply_device(gateway, type, devices);
     }
 
-    if (!get_json_result(devices_strip, &result)) {
-        Log_e("Fail to parse result from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
-        HAL_Free(devices);
-        return;
-    }
-    if (!get_json_product_id(devices_strip, &product_id)) {
-        Log_e("Fail to parse product_id from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
-        HAL_Free(devices);
-        return;
-    }
-    if (!get_json_device_name(devices_strip, &device_name)) {
-        Log_e("Fail to parse device_name from msg: %s", cloud_rcv_buf);
-        HAL_Free(type);
-        HAL_Free(devices);
-        HAL_Free(product_id);
-        return;
-    }
-
-    size = HAL_Snprintf(client_id, MAX_SIZE_OF_CLIENT_ID + 1, GATEWAY_CLIENT_ID_FMT, product_id, device_name);
-    if (size < 0 || size > MAX_SIZE_OF_CLIENT_ID) {
-        Log_e("generate client_id fail.");
-        HAL_Free(type);
-        HAL_Free(devices);
-        HAL_Free(product_id);
-        HAL_Free(device_name);
-        return;
-    }
+    HAL_Free(type);
+    HAL_Free(devices);
+    return;
+}
 
-    if (strncmp(type, "online", sizeof("online") - 1) == 0) {
-        if (strncmp(client_id, gateway->gateway_data.online.client_id, size) == 0) {
-            Log_i("client_id(%s), online result %d", client_id, result);
-            gateway->gateway_data.online.result = result;
-        }
-    } else if (strncmp(type, "offline", sizeof("offline") - 1) == 0) {
-        if (strncmp(client_id, gateway->gateway_data.offline.client_id, size) == 0) {
-            Log_i("client_id(%s), offline result %d", client_id, result);
-            gateway->gateway_data.offline.result = result;
+bool gateway_sync_ack(Gateway *gateway, uint16_t packet_id, int result)
+{
+    GatewaySync *sync    = NULL;
+    bool         matched = false;
+
+    HAL_MutexLock(gateway->lock);
+    sync = gateway->sync;
+    if (NULL != sync && !sync->done) {
+        if (sync->packet_id == packet_id) {
+            sync->result = result;
+            sync->done   = 1;
+            matched      = true;
+            if (NULL != sync->sem) {
+                HAL_SemaphorePost(sync->sem);
+            }
+        } else if (0 == sync->packet_id) {
+            // ack may be handled by yield thread before subscribe returns its packet id
+            sync->early_id     = packet_id;
+            sync->early_result = result;
         }
     }
+    HAL_MutexUnlock(gateway->lock);
 
-    HAL_Free(type);
-    HAL_Free(devices);
-    HAL_Free(product_id);
-    HAL_Free(device_name);
-    return;
+    return matched;
 }
 
 int gateway_subscribe_unsubscribe_topic(Gateway *gateway, char *topic_filter, SubscribeParams *params, int is_subscribe)
 {
-    int      rc         = 0;
-    int      loop_count = 0;
-    uint32_t status     = -1;
+    int         rc   = 0;
+    GatewaySync sync = {0};
+    Timer       timer;
 
     POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(params, QCLOUD_ERR_INVAL);
 
     STRING_PTR_SANITY_CHECK(topic_filter, QCLOUD_ERR_INVAL);
 
-    params->qos                       = QOS1;
-    gateway->gateway_data.sync_status = status;
+    params->qos = QOS1;
+    sync.result = QCLOUD_ERR_MQTT_REQUEST_TIMEOUT;
+    InitTimer(&timer);
+    countdown_ms(&timer, GATEWAY_SYNC_TIMEOUT_MS);
+
+#ifdef MULTITHREAD_ENABLED
+    if (gateway->yield_thread_running) {
+        sync.sem = HAL_SemaphoreCreate();
+        if (NULL == sync.sem) {
+            Log_e("create semaphore fail");
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+        }
+    }
+#endif
+
+    HAL_MutexLock(gateway->lock);
+    if (NULL != gateway->sync) {
+        HAL_MutexUnlock(gateway->lock);
+        Log_e("another subscribe or unsubscribe is waiting for ack");
+        rc = QCLOUD_ERR_FAILURE;
+        goto exit;
+    }
+    gateway->sync = &sync;
+    HAL_MutexUnlock(gateway->lock);
 
     if (is_subscribe) {
         /* subscribe */
@@ -191,27 +241,57 @@ int gateway_subscribe_unsubscribe_topic(Gateway *gateway, char *topic_filter, Su
         rc = IOT_MQTT_Unsubscribe(gateway->mqtt, topic_filter);
     }
 
+    HAL_MutexLock(gateway->lock);
+    if (rc >= 0) {
+        sync.packet_id = rc;
+        if (sync.early_id == sync.packet_id) {
+            sync.result = sync.early_result;
+            sync.done   = 1;
+        }
+    } else {
+        gateway->sync = NULL;
+    }
+    HAL_MutexUnlock(gateway->lock);
+
     if (rc < 0) {
         Log_e("subscribe or un(%d), result(%d)", is_subscribe, rc);
-        IOT_FUNC_EXIT_RC(rc);
+        goto exit;
     }
 
-    gateway->gateway_data.sync_status = status = rc;
-    while (status == gateway->gateway_data.sync_status) {
-        if (loop_count > GATEWAY_LOOP_MAX_COUNT) {
-            Log_i("loop max count, time out");
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    /* wait for ack, MQTT reports timeout of the request in yield */
+#ifdef MULTITHREAD_ENABLED
+    if (NULL != sync.sem) {
+        int wait_ms;
+
+        while (!sync.done && !expired(&timer)) {
+            // poll in case yield thread has stopped
+            wait_ms = Min(Max(left_ms(&timer), GATEWAY_BATCH_POLL_MIN_MS), GATEWAY_BATCH_POLL_MAX_MS);
+            HAL_SemaphoreWait(sync.sem, wait_ms);
+        }
+    } else
+#endif
+    {
+        while (!sync.done && !expired(&timer)) {
+            IOT_Gateway_Yield(gateway, 200);
         }
-        IOT_Gateway_Yield(gateway, 200);
-        loop_count++;
     }
 
-    if (gateway->gateway_data.sync_status != 0) {
-        Log_e("gateway->gateway_data.sync_status(%u) != 0", gateway->gateway_data.sync_status);
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    HAL_MutexLock(gateway->lock);
+    gateway->sync = NULL;
+    rc            = sync.result;
+    HAL_MutexUnlock(gateway->lock);
+
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("subscribe or un(%d) of %s not acked: %d", is_subscribe, topic_filter, rc);
     }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+exit:
+#ifdef MULTITHREAD_ENABLED
+    if (NULL != sync.sem) {
+        HAL_SemaphoreDestroy(sync.sem);
+    }
+#endif
+    IOT_FUNC_EXIT_RC(rc);
 }
 
 int gateway_subscribe_unsubscribe_default(Gateway *gateway, GatewayParam *param)
@@ -242,124 +322,649 @@ int gateway_subscribe_unsubscribe_default(Gateway *gateway, GatewayParam *param)
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
-SubdevSession *subdev_find_session(Gateway *gateway, char *product_id, char *device_name)
+static uint32_t _gateway_fnv1a(uint32_t hash, const char *str)
+{
+    return utils_fnv1a(hash, str, strlen(str));
+}
+
+uint32_t subdev_client_id_hash(const char *product_id, const char *device_name)
+{
+    // FNV-1a of "product_id/device_name"
+    return _gateway_fnv1a(_gateway_fnv1a(_gateway_fnv1a(UTILS_FNV1A_INIT, product_id), "/"), device_name);
+}
+
+static SubdevSession *_subdev_slot_session(SubdevSessionTable *table, uint16_t idx)
+{
+    return (0 == table->slots[idx]) ? NULL : &table->slab[table->slots[idx] - 1];
+}
+
+static int _subdev_session_lookup(SubdevSessionTable *table, const char *product_id, const char *device_name)
 {
     SubdevSession *session = NULL;
+    uint32_t       hash;
+    uint16_t       idx;
+
+    if (NULL == table->slots) {
+        return -1;
+    }
+
+    hash = subdev_client_id_hash(product_id, device_name);
+    for (idx = hash & table->mask; NULL != (session = _subdev_slot_session(table, idx));
+         idx = (idx + 1) & table->mask) {
+        if (session->hash == hash && 0 == strcmp(session->product_id, product_id) &&
+            0 == strcmp(session->device_name, device_name)) {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+int subdev_session_init(Gateway *gateway, uint16_t max_count)
+{
+    SubdevSessionTable *table    = &gateway->sessions;
+    uint32_t            slot_num = SUBDEV_SESSION_MIN_SLOTS;
+    int                 i;
+
+    // keep load factor no more than 0.5
+    while (slot_num < (uint32_t)max_count * 2) {
+        slot_num <<= 1;
+    }
+
+    if (0 == max_count || slot_num > UINT16_MAX + 1UL) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    table->slab  = (SubdevSession *)HAL_Malloc(max_count * sizeof(SubdevSession));
+    table->slots = (uint16_t *)HAL_Malloc(slot_num * sizeof(uint16_t));
+    if (NULL == table->slab || NULL == table->slots) {
+        subdev_session_deinit(gateway);
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    memset(table->slab, 0, max_count * sizeof(SubdevSession));
+    memset(table->slots, 0, slot_num * sizeof(uint16_t));
+    table->free_list = NULL;
+    for (i = max_count - 1; i >= 0; i--) {
+        table->slab[i].next = table->free_list;
+        table->free_list    = &table->slab[i];
+    }
+    table->mask      = slot_num - 1;
+    table->max_count = max_count;
+    table->count     = 0;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void subdev_session_deinit(Gateway *gateway)
+{
+    HAL_Free(gateway->sessions.slab);
+    HAL_Free(gateway->sessions.slots);
+    memset(&gateway->sessions, 0, sizeof(SubdevSessionTable));
+}
+
+SubdevSession *subdev_find_session(Gateway *gateway, char *product_id, char *device_name)
+{
+    int idx;
 
     POINTER_SANITY_CHECK(gateway, NULL);
     STRING_PTR_SANITY_CHECK(product_id, NULL);
     STRING_PTR_SANITY_CHECK(device_name, NULL);
 
-    session = gateway->session_list;
+    idx = _subdev_session_lookup(&gateway->sessions, product_id, device_name);
 
-    /* session is exist */
-    while (session) {
-        if (0 == strcmp(session->product_id, product_id) && 0 == strcmp(session->device_name, device_name)) {
-            IOT_FUNC_EXIT_RC(session);
-        }
-        session = session->next;
-    }
-
-    IOT_FUNC_EXIT_RC(NULL);
+    IOT_FUNC_EXIT_RC(idx < 0 ? NULL : _subdev_slot_session(&gateway->sessions, idx));
 }
 
 SubdevSession *subdev_add_session(Gateway *gateway, char *product_id, char *device_name)
 {
-    SubdevSession *session = NULL;
+    SubdevSessionTable *table   = NULL;
+    SubdevSession *     session = NULL;
+    uint16_t            idx;
 
     POINTER_SANITY_CHECK(gateway, NULL);
     STRING_PTR_SANITY_CHECK(product_id, NULL);
     STRING_PTR_SANITY_CHECK(device_name, NULL);
 
-    session = HAL_Malloc(sizeof(SubdevSession));
-    if (session == NULL) {
-        Log_e("Not enough memory");
+    table = &gateway->sessions;
+    if (NULL == table->free_list) {
+        Log_e("session table is full, max %u", table->max_count);
         IOT_FUNC_EXIT_RC(NULL);
     }
 
-    /* add session to list */
-    session->next         = gateway->session_list;
-    gateway->session_list = session;
-
-    int size = strlen(product_id);
-    strncpy(session->product_id, product_id, size);
-    session->product_id[size] = '\0';
-    size                      = strlen(device_name);
-    strncpy(session->device_name, device_name, size);
-    session->device_name[size] = '\0';
-    session->session_status    = SUBDEV_SEESION_STATUS_INIT;
+    session          = table->free_list;
+    table->free_list = session->next;
+    table->count++;
+
+    strncpy(session->product_id, product_id, MAX_SIZE_OF_PRODUCT_ID);
+    session->product_id[MAX_SIZE_OF_PRODUCT_ID] = '\0';
+    strncpy(session->device_name, device_name, MAX_SIZE_OF_DEVICE_NAME);
+    session->device_name[MAX_SIZE_OF_DEVICE_NAME] = '\0';
+    session->session_status                       = SUBDEV_SEESION_STATUS_INIT;
+    session->hash                                 = subdev_client_id_hash(session->product_id, session->device_name);
+    session->used                                 = 1;
+    session->next                                 = NULL;
+
+    /* add session to hash */
+    idx = session->hash & table->mask;
+    while (0 != table->slots[idx]) {
+        idx = (idx + 1) & table->mask;
+    }
+    table->slots[idx] = session - table->slab + 1;
 
     IOT_FUNC_EXIT_RC(session);
 }
 
 int subdev_remove_session(Gateway *gateway, char *product_id, char *device_name)
 {
-    SubdevSession *cur_session = NULL;
-    SubdevSession *pre_session = NULL;
+    SubdevSessionTable *table   = NULL;
+    SubdevSession *     session = NULL;
+    uint16_t            idx, next, home;
+    int                 found;
 
     POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_FAILURE);
     STRING_PTR_SANITY_CHECK(product_id, QCLOUD_ERR_FAILURE);
     STRING_PTR_SANITY_CHECK(device_name, QCLOUD_ERR_FAILURE);
 
-    pre_session = cur_session = gateway->session_list;
-
-    if (NULL == cur_session) {
+    table = &gateway->sessions;
+    if (0 == table->count) {
         Log_e("session list is empty");
         IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
     }
 
-    /* session is exist */
-    while (cur_session) {
-        if (0 == strcmp(cur_session->product_id, product_id) && 0 == strcmp(cur_session->device_name, device_name)) {
-            if (cur_session == gateway->session_list) {
-                gateway->session_list = cur_session->next;
-            } else {
-                pre_session->next = cur_session->next;
-            }
-            HAL_Free(cur_session);
-            IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    found = _subdev_session_lookup(table, product_id, device_name);
+    if (found < 0) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    }
+
+    idx     = found;
+    session = _subdev_slot_session(table, idx);
+
+    session->used = 0;
+    session->generation++;
+    session->next    = table->free_list;
+    table->free_list = session;
+    table->count--;
+
+    // shift the following slots of the probe sequence back, so lookup needs no tombstones
+    table->slots[idx] = 0;
+    for (next = (idx + 1) & table->mask; 0 != table->slots[next]; next = (next + 1) & table->mask) {
+        home = _subdev_slot_session(table, next)->hash & table->mask;
+        // keep the slot if its home lies cyclically in (idx, next]
+        if ((idx <= next) ? (home > idx && home <= next) : (home > idx || home <= next)) {
+            continue;
         }
-        pre_session = cur_session;
-        cur_session = cur_session->next;
+
+        table->slots[idx]  = table->slots[next];
+        table->slots[next] = 0;
+        idx                = next;
     }
 
-    IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
-int gateway_publish_sync(Gateway *gateway, char *topic, PublishParams *params, int32_t *result)
+bool subdev_session_is_online(Gateway *gateway, const char *product_id, const char *device_name)
 {
-    int     rc         = 0;
-    int     loop_count = 0;
-    int32_t res        = *result;
+    SubdevSession *session = NULL;
+    bool           online  = false;
 
-    POINTER_SANITY_CHECK(gateway, QCLOUD_ERR_INVAL);
+    HAL_MutexLock(gateway->lock);
+    session = subdev_find_session(gateway, (char *)product_id, (char *)device_name);
+    online  = NULL != session && SUBDEV_SEESION_STATUS_ONLINE == session->session_status;
+    HAL_MutexUnlock(gateway->lock);
 
-    rc = IOT_Gateway_Publish(gateway, topic, params);
-    if (rc < 0) {
-        Log_e("publish fail.");
+    return online;
+}
+
+void *subdev_session_handle(Gateway *gateway, SubdevSession *session)
+{
+    uint32_t index = session - gateway->sessions.slab;
+
+    // generation in high bits, never NULL
+    return (void *)(uintptr_t)(((uint32_t)session->generation << 16) | (index + 1));
+}
+
+SubdevSession *subdev_handle_session(Gateway *gateway, void *handle)
+{
+    uint32_t       value   = (uint32_t)(uintptr_t)handle;
+    uint32_t       index   = (value & 0xFFFF) - 1;
+    SubdevSession *session = NULL;
+
+    if (0 == (value & 0xFFFF) || index >= gateway->sessions.max_count) {
+        return NULL;
+    }
+
+    session = &gateway->sessions.slab[index];
+    if (!session->used || session->generation != (value >> 16)) {
+        return NULL;
+    }
+
+    return session;
+}
+
+/* key of operation in table, hash of "type:product_id/device_name" */
+static uint32_t _gateway_op_key(const char *type, const char *product_id, const char *device_name)
+{
+    uint32_t hash = _gateway_fnv1a(UTILS_FNV1A_INIT, type);
+
+    hash = _gateway_fnv1a(hash, ":");
+    hash = _gateway_fnv1a(hash, product_id);
+    hash = _gateway_fnv1a(hash, "/");
+    return _gateway_fnv1a(hash, device_name);
+}
+
+int gateway_batch_init(Gateway *gateway, uint16_t max_count)
+{
+    int rc;
+
+    rc = reply_table_init(&gateway->ops, max_count);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        return rc;
+    }
+
+    gateway->lock = HAL_MutexCreate();
+    if (NULL == gateway->lock) {
+        reply_table_deinit(&gateway->ops);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* update session of sub-device by result of operation, with lock held */
+static void _gateway_op_update_session(Gateway *gateway, GatewayBatch *batch, GatewaySubdevStatus *subdev)
+{
+    SubdevSession *session = subdev_find_session(gateway, subdev->product_id, subdev->device_name);
+
+    if (NULL == session) {
+        return;
+    }
+
+    if (0 == strcmp(batch->type, "online")) {
+        if (QCLOUD_RET_SUCCESS == subdev->result) {
+            session->session_status = SUBDEV_SEESION_STATUS_ONLINE;
+        } else if (SUBDEV_SEESION_STATUS_ONLINE != session->session_status) {
+            subdev_remove_session(gateway, subdev->product_id, subdev->device_name);
+        }
+    } else if (QCLOUD_RET_SUCCESS == subdev->result) {
+        session->session_status = SUBDEV_SEESION_STATUS_OFFLINE;
+        subdev_remove_session(gateway, subdev->product_id, subdev->device_name);
+    }
+}
+
+/* one less to wait for, returns the batch if it is finished, with lock held */
+static GatewayBatch *_gateway_batch_put(GatewayBatch *batch)
+{
+    return (--batch->left > 0) ? NULL : batch;
+}
+
+/* operation is removed from table with result, with lock held */
+static GatewayBatch *_gateway_op_done(Gateway *gateway, GatewayOp *op, int result)
+{
+    GatewayBatch *       batch  = op->batch;
+    GatewaySubdevStatus *subdev = &batch->subdevs[op - batch->ops];
+
+    op->pending    = 0;
+    subdev->result = result;
+    _gateway_op_update_session(gateway, batch, subdev);
+
+    return _gateway_batch_put(batch);
+}
+
+/* fail operations expired, or all if force, returns list of batches finished, with lock held */
+static GatewayBatch *_gateway_op_expire(Gateway *gateway, int force)
+{
+    GatewayBatch *       finished = NULL;
+    GatewayBatch *       batch    = NULL;
+    GatewayOp *          op       = NULL;
+    GatewaySubdevStatus *subdev   = NULL;
+
+    while (NULL != (op = (GatewayOp *)(force ? reply_table_pop(&gateway->ops)
+                                             : reply_table_pop_expired(&gateway->ops)))) {
+        subdev = &op->batch->subdevs[op - op->batch->ops];
+        Log_e("client_id(%s/%s), %s timeout", subdev->product_id, subdev->device_name, op->batch->type);
+
+        batch = _gateway_op_done(gateway, op, QCLOUD_ERR_GATEWAY_SESSION_TIMEOUT);
+        if (NULL != batch) {
+            batch->next = finished;
+            finished    = batch;
+        }
+    }
+
+    return finished;
+}
+
+static int _gateway_batch_failed(GatewayBatch *batch)
+{
+    int i, failed = 0;
+
+    for (i = 0; i < batch->subdev_num; i++) {
+        if (QCLOUD_RET_SUCCESS != batch->subdevs[i].result) {
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+/* signal completion out of lock, batch with callback is freed here */
+static void _gateway_batch_notify(Gateway *gateway, GatewayBatch *batch)
+{
+    if (NULL == batch->callback) {
+        // waiter frees the batch once it sees done under lock, so post before unlocking
+        HAL_MutexLock(gateway->lock);
+        batch->done = 1;
+        if (NULL != batch->sem) {
+            HAL_SemaphorePost(batch->sem);
+        }
+        HAL_MutexUnlock(gateway->lock);
+        return;
+    }
+
+    batch->callback(gateway, batch->user_data, batch->subdevs, batch->subdev_num, _gateway_batch_failed(batch));
+    HAL_Free(batch);
+}
+
+static int _gateway_batch_is_done(Gateway *gateway, GatewayBatch *batch)
+{
+    int done;
+
+    HAL_MutexLock(gateway->lock);
+    done = batch->done;
+    HAL_MutexUnlock(gateway->lock);
+
+    return done;
+}
+
+static void _gateway_batch_notify_list(Gateway *gateway, GatewayBatch *finished)
+{
+    GatewayBatch *next = NULL;
+
+    for (; NULL != finished; finished = next) {
+        next = finished->next;
+        _gateway_batch_notify(gateway, finished);
+    }
+}
+
+static void _gateway_op_on_result(Gateway *gateway, const char *type, const char *product_id,
+                                  const char *device_name, int32_t result)
+{
+    uint32_t             key      = _gateway_op_key(type, product_id, device_name);
+    GatewayOp *          op       = NULL;
+    GatewaySubdevStatus *subdev   = NULL;
+    GatewayBatch *       finished = NULL;
+
+    HAL_MutexLock(gateway->lock);
+    op = (GatewayOp *)reply_table_find(&gateway->ops, key);
+    if (NULL != op) {
+        subdev = &op->batch->subdevs[op - op->batch->ops];
+        // key is a hash, make sure the operation is of the device
+        if (0 == strcmp(type, op->batch->type) && 0 == strcmp(product_id, subdev->product_id) &&
+            0 == strcmp(device_name, subdev->device_name)) {
+            reply_table_remove(&gateway->ops, key);
+            finished = _gateway_op_done(gateway, op, (0 == result) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE);
+        }
+    }
+    HAL_MutexUnlock(gateway->lock);
+
+    if (NULL != finished) {
+        _gateway_batch_notify(gateway, finished);
+    }
+}
+
+void gateway_batch_check_timeout(Gateway *gateway)
+{
+    GatewayBatch *finished = NULL;
+
+    if (0 == reply_table_count(&gateway->ops)) {
+        return;
+    }
+
+    HAL_MutexLock(gateway->lock);
+    finished = _gateway_op_expire(gateway, 0);
+    HAL_MutexUnlock(gateway->lock);
+
+    _gateway_batch_notify_list(gateway, finished);
+}
+
+/* check sessions and add operations of sub-devices to table, with lock held */
+static void _gateway_batch_prepare(Gateway *gateway, GatewayBatch *batch, uint32_t timeout_ms)
+{
+    GatewaySubdevStatus *subdev    = NULL;
+    SubdevSession *      session   = NULL;
+    GatewayOp *          op        = NULL;
+    int                  is_online = (0 == strcmp(batch->type, "online"));
+    int                  created, rc, i;
+
+    for (i = 0; i < batch->subdev_num; i++) {
+        subdev         = &batch->subdevs[i];
+        op             = &batch->ops[i];
+        op->batch      = batch;
+        subdev->result = QCLOUD_RET_SUCCESS;
+        session        = subdev_find_session(gateway, subdev->product_id, subdev->device_name);
+        created        = 0;
+
+        if (is_online) {
+            if (NULL != session && SUBDEV_SEESION_STATUS_ONLINE == session->session_status) {
+                subdev->result = QCLOUD_ERR_GATEWAY_SUBDEV_ONLINE;
+                continue;
+            }
+            if (NULL == session) {
+                if (NULL == subdev_add_session(gateway, subdev->product_id, subdev->device_name)) {
+                    subdev->result = QCLOUD_ERR_GATEWAY_CREATE_SESSION_FAIL;
+                    continue;
+                }
+                created = 1;
+            }
+        } else {
+            if (NULL == session) {
+                subdev->result = QCLOUD_ERR_GATEWAY_SESSION_NO_EXIST;
+                continue;
+            }
+            if (SUBDEV_SEESION_STATUS_OFFLINE == session->session_status) {
+                subdev_remove_session(gateway, subdev->product_id, subdev->device_name);
+                subdev->result = QCLOUD_ERR_GATEWAY_SUBDEV_OFFLINE;
+                continue;
+            }
+        }
+
+        // the same operation of the sub-device in progress is rejected
+        op->key = _gateway_op_key(batch->type, subdev->product_id, subdev->device_name);
+        rc      = reply_table_add(&gateway->ops, op->key, op, timeout_ms);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            Log_e("client_id(%s/%s), %s operation not added: %d", subdev->product_id, subdev->device_name,
+                  batch->type, rc);
+            subdev->result = rc;
+            if (created) {
+                subdev_remove_session(gateway, subdev->product_id, subdev->device_name);
+            }
+            continue;
+        }
+
+        op->pending = 1;
+        batch->left++;
+    }
+}
+
+/* send pending sub-devices from *index in one message as many as fits, returns number sent */
+static int _gateway_batch_send(Gateway *gateway, GatewayBatch *batch, char *topic, int *index)
+{
+    char                 payload[GATEWAY_PAYLOAD_BUFFER_LEN + 1];
+    GatewaySubdevStatus *subdev   = NULL;
+    PublishParams        params   = DEFAULT_PUB_PARAMS;
+    int                  tail_len = sizeof(GATEWAY_PAYLOAD_BATCH_TAIL) - 1;
+    int                  len, size, num = 0;
+    int                  i, first = *index;
+
+    len = HAL_Snprintf(payload, GATEWAY_PAYLOAD_BUFFER_LEN + 1, GATEWAY_PAYLOAD_BATCH_HEAD_FMT, batch->type);
+
+    HAL_MutexLock(gateway->lock);
+    for (i = *index; i < batch->subdev_num; i++) {
+        if (!batch->ops[i].pending) {
+            continue;
+        }
+
+        subdev = &batch->subdevs[i];
+        size   = HAL_Snprintf(payload + len, GATEWAY_PAYLOAD_BUFFER_LEN + 1 - len, "%s" GATEWAY_PAYLOAD_DEVICE_FMT,
+                            num > 0 ? "," : "", subdev->product_id, subdev->device_name);
+        // reply adds result to each device, which has to fit in receive buffer too
+        if (size < 0 || len + size + tail_len > GATEWAY_PAYLOAD_BUFFER_LEN ||
+            len + size + tail_len + (num + 1) * GATEWAY_REPLY_RESULT_LEN >= GATEWAY_RECEIVE_BUFFER_LEN) {
+            break;
+        }
+        len += size;
+        num++;
+    }
+    HAL_MutexUnlock(gateway->lock);
+    *index = i;
+
+    if (0 == num) {
+        return 0;
+    }
+    strcpy(payload + len, GATEWAY_PAYLOAD_BATCH_TAIL);
+
+    params.qos         = QOS0;
+    params.payload_len = len + tail_len;
+    params.payload     = payload;
+
+    size = IOT_Gateway_Publish(gateway, topic, &params);
+    if (size < 0) {
+        Log_e("publish %d sub-devices %s fail: %d", num, batch->type, size);
+        return size;
+    }
+
+    Log_d("%d sub-devices from %d %s sent", num, first, batch->type);
+    return num;
+}
+
+int gateway_batch_run(Gateway *gateway, GatewayBatchParam *param, const char *type)
+{
+    int           rc                                 = 0;
+    int           size                               = 0;
+    int           index                              = 0;
+    int           i                                  = 0;
+    char          topic[MAX_SIZE_OF_CLOUD_TOPIC + 1] = {0};
+    GatewayBatch *batch                              = NULL;
+    GatewayBatch *finished                           = NULL;
+    GatewayOp *   op                                 = NULL;
+
+    size = HAL_Snprintf(topic, MAX_SIZE_OF_CLOUD_TOPIC + 1, GATEWAY_TOPIC_OPERATION_FMT, param->product_id,
+                        param->device_name);
+    if (size < 0 || size > MAX_SIZE_OF_CLOUD_TOPIC) {
+        Log_e("buf size < topic length!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    /* wait for response */
-    while (res == *result) {
-        if (loop_count > GATEWAY_LOOP_MAX_COUNT) {
-            Log_i("loop max count, time out.");
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_GATEWAY_SESSION_TIMEOUT);
+    size  = sizeof(GatewayBatch) + param->subdev_num * sizeof(GatewayOp);
+    batch = (GatewayBatch *)HAL_Malloc(size);
+    if (NULL == batch) {
+        Log_e("Not enough memory");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MALLOC);
+    }
+    memset(batch, 0, size);
+    batch->type       = type;
+    batch->subdevs    = param->subdevs;
+    batch->ops        = (GatewayOp *)(batch + 1);
+    batch->subdev_num = param->subdev_num;
+    batch->left       = 1;  // released when all sent, so batch is not finished while being sent
+    batch->callback   = param->callback;
+    batch->user_data  = param->user_data;
+    InitTimer(&batch->timer);
+    countdown_ms(&batch->timer, param->timeout_ms);
+
+#ifdef MULTITHREAD_ENABLED
+    if (NULL == batch->callback && gateway->yield_thread_running) {
+        batch->sem = HAL_SemaphoreCreate();
+        if (NULL == batch->sem) {
+            Log_e("create semaphore fail");
+            HAL_Free(batch);
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
         }
-#ifdef MULTITHREAD_ENABLED		
-        if((gateway->yield_thread_running)){
-            HAL_SleepMs(200);
-        }else
-#endif        
-        {
+    }
+#endif
+
+    HAL_MutexLock(gateway->lock);
+    _gateway_batch_prepare(gateway, batch, param->timeout_ms);
+    HAL_MutexUnlock(gateway->lock);
+
+    while (index < batch->subdev_num) {
+        i  = index;
+        rc = _gateway_batch_send(gateway, batch, topic, &index);
+        if (rc > 0) {
+            continue;
+        }
+
+        // sub-devices not sent fail at once, and the one too long for a message is skipped
+        if (0 == rc && index < batch->subdev_num) {
+            index++;
+        }
+        HAL_MutexLock(gateway->lock);
+        for (; i < index; i++) {
+            op = &batch->ops[i];
+            if (op->pending) {
+                reply_table_remove(&gateway->ops, op->key);
+                _gateway_op_done(gateway, op, rc < 0 ? rc : QCLOUD_ERR_FAILURE);
+            }
+        }
+        HAL_MutexUnlock(gateway->lock);
+    }
+
+    HAL_MutexLock(gateway->lock);
+    finished = _gateway_batch_put(batch);
+    HAL_MutexUnlock(gateway->lock);
+
+    if (NULL != finished) {
+        _gateway_batch_notify(gateway, finished);
+    }
+
+    if (NULL != param->callback) {
+        // batch is owned by notification then
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+
+    /* wait for results, operations time out in yield */
+#ifdef MULTITHREAD_ENABLED
+    if (NULL != batch->sem) {
+        int wait_ms;
+
+        while (!_gateway_batch_is_done(gateway, batch)) {
+            // poll in case yield thread has stopped, operations expire a bit later than the batch timer
+            wait_ms = left_ms(&batch->timer);
+            wait_ms = Min(Max(wait_ms, GATEWAY_BATCH_POLL_MIN_MS), GATEWAY_BATCH_POLL_MAX_MS);
+            if (QCLOUD_RET_SUCCESS != HAL_SemaphoreWait(batch->sem, wait_ms)) {
+                gateway_batch_check_timeout(gateway);
+            }
+        }
+        HAL_SemaphoreDestroy(batch->sem);
+    } else
+#endif
+    {
+        while (!batch->done) {
             IOT_Gateway_Yield(gateway, 200);
-		}
-        
-        loop_count++;
+        }
     }
 
-    if (*result != 0) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    rc = _gateway_batch_failed(batch) > 0 ? QCLOUD_ERR_FAILURE : QCLOUD_RET_SUCCESS;
+    HAL_Free(batch);
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+void gateway_batch_deinit(Gateway *gateway)
+{
+    GatewayBatch *finished = NULL;
+
+    if (NULL == gateway->lock) {
+        return;
     }
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+
+    // operations waiting for reply are done as timed out
+    HAL_MutexLock(gateway->lock);
+    finished = _gateway_op_expire(gateway, 1);
+    HAL_MutexUnlock(gateway->lock);
+
+    _gateway_batch_notify_list(gateway, finished);
+
+    reply_table_deinit(&gateway->ops);
+    HAL_MutexDestroy(gateway->lock);
+    gateway->lock = NULL;
 }
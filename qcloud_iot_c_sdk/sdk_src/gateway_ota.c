@@ -0,0 +1,622 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2018-2020 THL A29 Limited, a Tencent company. All rights
+ reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define LOG_LOCAL_MODULE eLOG_MODULE_GATEWAY
+
+#include <string.h>
+
+#include "gateway_common.h"
+
+#ifdef OTA_MQTT_CHANNEL
+
+#include "ota_client.h"
+#include "ota_fetch.h"
+#include "ota_lib.h"
+#include "utils_param_check.h"
+
+#define GATEWAY_OTA_IMAGE_MAX   4 /* images cached at the same time */
+#define GATEWAY_OTA_VERSION_LEN 32
+#define GATEWAY_OTA_MSG_LEN     256
+
+typedef enum {
+    GATEWAY_OTA_IMAGE_FREE = 0,
+    GATEWAY_OTA_IMAGE_PENDING,  /* requested by sub-device, to be downloaded */
+    GATEWAY_OTA_IMAGE_FETCHING, /* downloading by IOT_Gateway_OTA_Yield */
+    GATEWAY_OTA_IMAGE_READY,    /* downloaded and verified in local storage */
+} GatewayOTAImageState;
+
+/* firmware image cached by gateway, one for each product, version and MD5 */
+typedef struct {
+    GatewayOTAImageState state;
+    char                 product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char                 version[GATEWAY_OTA_VERSION_LEN + 1];
+    char                 md5sum[33];
+    char *               url;
+    uint32_t             size;
+} GatewayOTAImage;
+
+typedef struct _GatewayOTA GatewayOTA;
+
+/* OTA state of sub-device */
+typedef struct _GatewayOTASubdev {
+    GatewayOTA *              ota;
+    char                      product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char                      device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    void *                    ch_signal; /* OTA topic of sub-device */
+    GatewayOTAImage *         image;     /* image upgrading to, NULL if none */
+    int                       notified;  /* on_ready is called for image */
+    struct _GatewayOTASubdev *next;
+} GatewayOTASubdev;
+
+struct _GatewayOTA {
+    Gateway *         gateway;
+    GatewayOTAParams  params;
+    GatewayOTASubdev *subdev_list;
+    GatewayOTAImage   images[GATEWAY_OTA_IMAGE_MAX];
+    void *            lock; /* sub-devices and images are changed in MQTT callback */
+};
+
+static GatewayOTASubdev *_gateway_ota_find_subdev(GatewayOTA *ota, const char *product_id, const char *device_name)
+{
+    GatewayOTASubdev *subdev = ota->subdev_list;
+
+    while (subdev) {
+        if (0 == strcmp(subdev->product_id, product_id) && 0 == strcmp(subdev->device_name, device_name)) {
+            return subdev;
+        }
+        subdev = subdev->next;
+    }
+
+    return NULL;
+}
+
+static int _gateway_ota_image_refs(GatewayOTA *ota, GatewayOTAImage *image)
+{
+    GatewayOTASubdev *subdev = ota->subdev_list;
+    int               refs   = 0;
+
+    for (; subdev; subdev = subdev->next) {
+        refs += (subdev->image == image);
+    }
+
+    return refs;
+}
+
+static void _gateway_ota_image_free(GatewayOTA *ota, GatewayOTAImage *image)
+{
+    if (GATEWAY_OTA_IMAGE_READY == image->state && NULL != ota->params.remove) {
+        ota->params.remove(ota->params.user_data, image->product_id, image->version);
+    }
+
+    if (NULL != image->url) {
+        HAL_Free(image->url);
+    }
+    memset(image, 0, sizeof(GatewayOTAImage));
+}
+
+/* report to OTA topic of sub-device, version is the image upgrading to */
+static int _gateway_ota_report(GatewayOTASubdev *subdev, const char *version, int progress, IOT_OTAReportType type)
+{
+    char msg[GATEWAY_OTA_MSG_LEN];
+    int  ret;
+
+    ret = qcloud_otalib_gen_report_msg(msg, sizeof(msg), 0, version, progress, type);
+    if (QCLOUD_RET_SUCCESS != ret) {
+        Log_e("generate report message of %s/%s failed", subdev->product_id, subdev->device_name);
+        return ret;
+    }
+
+    if (IOT_OTAR_DOWNLOAD_BEGIN == type || IOT_OTAR_DOWNLOADING == type) {
+        ret = qcloud_osc_report_progress(subdev->ch_signal, msg);
+    } else {
+        ret = qcloud_osc_report_upgrade_result(subdev->ch_signal, msg);
+    }
+
+    return (ret < 0) ? ret : QCLOUD_RET_SUCCESS;
+}
+
+/* attach sub-device to image of the firmware, which is downloaded only once for all sub-devices */
+static int _gateway_ota_attach(GatewayOTA *ota, GatewayOTASubdev *subdev, char *url, const char *version,
+                               const char *md5sum, uint32_t size)
+{
+    GatewayOTAImage *image = NULL;
+    GatewayOTAImage *slot  = NULL;
+    int              i;
+
+    for (i = 0; i < GATEWAY_OTA_IMAGE_MAX; i++) {
+        GatewayOTAImage *cur = &ota->images[i];
+        if (GATEWAY_OTA_IMAGE_FREE == cur->state) {
+            slot = slot ? slot : cur;
+        } else if (0 == strcmp(cur->product_id, subdev->product_id) && 0 == strcmp(cur->version, version) &&
+                   0 == strcmp(cur->md5sum, md5sum)) {
+            image = cur;
+        }
+    }
+
+    subdev->image    = NULL;
+    subdev->notified = 0;
+
+    if (NULL == image) {
+        // replace cached image not used by any sub-device
+        for (i = 0; NULL == slot && i < GATEWAY_OTA_IMAGE_MAX; i++) {
+            if (GATEWAY_OTA_IMAGE_READY == ota->images[i].state && 0 == _gateway_ota_image_refs(ota, &ota->images[i])) {
+                _gateway_ota_image_free(ota, &ota->images[i]);
+                slot = &ota->images[i];
+            }
+        }
+
+        if (NULL == slot) {
+            Log_e("no room for image %s of %s", version, subdev->product_id);
+            HAL_Free(url);
+            return QCLOUD_ERR_FAILURE;
+        }
+
+        image        = slot;
+        image->state = GATEWAY_OTA_IMAGE_PENDING;
+        image->url   = url;
+        image->size  = size;
+        strncpy(image->product_id, subdev->product_id, MAX_SIZE_OF_PRODUCT_ID);
+        strncpy(image->version, version, GATEWAY_OTA_VERSION_LEN);
+        strncpy(image->md5sum, md5sum, sizeof(image->md5sum) - 1);
+        Log_i("image %s of %s to download for %s", version, subdev->product_id, subdev->device_name);
+    } else {
+        HAL_Free(url);
+        Log_i("image %s of %s is shared with %s", version, subdev->product_id, subdev->device_name);
+    }
+
+    subdev->image = image;
+
+    // older images of the product are not needed by new sub-devices
+    for (i = 0; i < GATEWAY_OTA_IMAGE_MAX; i++) {
+        GatewayOTAImage *cur = &ota->images[i];
+        if (cur != image && GATEWAY_OTA_IMAGE_READY == cur->state && 0 == strcmp(cur->product_id, image->product_id) &&
+            0 == _gateway_ota_image_refs(ota, cur)) {
+            _gateway_ota_image_free(ota, cur);
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* callback of OTA topic of sub-device */
+static void _gateway_ota_callback(void *pcontext, const char *msg, uint32_t msg_len)
+{
+    GatewayOTASubdev *subdev    = (GatewayOTASubdev *)pcontext;
+    GatewayOTA *      ota       = subdev->ota;
+    char *            json_type = NULL;
+    char *            url       = NULL;
+    char *            version   = NULL;
+    char              md5sum[33];
+    uint32_t          size;
+    OTACompressInfo   compress;
+
+    if (NULL == msg || 0 == msg_len) {
+        Log_e("OTA message of %s/%s is NULL", subdev->product_id, subdev->device_name);
+        return;
+    }
+
+    if (QCLOUD_RET_SUCCESS != qcloud_otalib_get_firmware_type(msg, &json_type)) {
+        Log_e("Get firmware type failed!");
+        return;
+    }
+
+    if (0 == strcmp(json_type, REPORT_VERSION_RSP)) {
+        if (qcloud_otalib_get_report_version_result(msg) < QCLOUD_RET_SUCCESS) {
+            Log_e("Report version of %s/%s failed!", subdev->product_id, subdev->device_name);
+        }
+        goto exit;
+    }
+
+    if (0 != strcmp(json_type, UPDATE_FIRMWARE)) {
+        Log_e("Netheir Report version result nor update firmware! type: %s", json_type);
+        goto exit;
+    }
+
+    HAL_Free(json_type);
+    json_type = NULL;
+    if (QCLOUD_RET_SUCCESS !=
+        qcloud_otalib_get_params(msg, &json_type, &url, &version, md5sum, &size, &compress)) {
+        Log_e("Get firmware parameter of %s/%s failed", subdev->product_id, subdev->device_name);
+        goto exit;
+    }
+
+    if (strlen(version) > GATEWAY_OTA_VERSION_LEN) {
+        Log_e("version %s is too long", version);
+        goto exit;
+    }
+
+    HAL_MutexLock(ota->lock);
+    _gateway_ota_attach(ota, subdev, url, version, md5sum, size);
+    url = NULL;
+    HAL_MutexUnlock(ota->lock);
+
+exit:
+    if (NULL != json_type) {
+        HAL_Free(json_type);
+    }
+    if (NULL != url) {
+        HAL_Free(url);
+    }
+    if (NULL != version) {
+        HAL_Free(version);
+    }
+}
+
+/* download image into local storage and verify it, return type of failure report */
+static IOT_OTAReportType _gateway_ota_download(GatewayOTA *ota, GatewayOTAImage *image)
+{
+    IOT_OTAReportType result  = IOT_OTAR_UPGRADE_FAIL;
+    void *            ch      = NULL;
+    void *            md5     = NULL;
+    char *            buf     = NULL;
+    uint32_t          fetched = 0;
+    char              md5_str[33];
+    int               ret;
+
+    ch  = ofc_Init(image->url, 0, image->size);
+    md5 = qcloud_otalib_md5_init();
+    buf = HAL_Malloc(ota->params.buf_len);
+    if (NULL == ch || NULL == md5 || NULL == buf) {
+        Log_e("allocate for image download failed");
+        goto exit;
+    }
+
+    ret = qcloud_ofc_connect(ch);
+    while (QCLOUD_RET_SUCCESS == ret && fetched < image->size) {
+        ret = qcloud_ofc_fetch(ch, buf, ota->params.buf_len, ota->params.timeout_s);
+        if (ret <= 0) {
+            ret = (0 == ret) ? IOT_OTA_ERR_FETCH_TIMEOUT : ret;
+            break;
+        }
+
+        if ((uint32_t)ret > image->size - fetched) {
+            ret = image->size - fetched;
+        }
+
+        if (QCLOUD_RET_SUCCESS !=
+            ota->params.write(ota->params.user_data, image->product_id, image->version, fetched, buf, ret)) {
+            Log_e("write image %s of %s at offset %u failed", image->version, image->product_id, fetched);
+            ret = QCLOUD_ERR_FAILURE;
+            break;
+        }
+
+        qcloud_otalib_md5_update(md5, buf, ret);
+        fetched += ret;
+        ret = QCLOUD_RET_SUCCESS;
+    }
+
+    if (fetched < image->size) {
+        Log_e("download image %s of %s failed at offset %u: %d", image->version, image->product_id, fetched, ret);
+        if (IOT_OTA_ERR_FETCH_NOT_EXIST == ret) {
+            result = IOT_OTAR_FILE_NOT_EXIST;
+        } else if (IOT_OTA_ERR_FETCH_AUTH_FAIL == ret) {
+            result = IOT_OTAR_AUTH_FAIL;
+        } else if (IOT_OTA_ERR_FETCH_TIMEOUT == ret) {
+            result = IOT_OTAR_DOWNLOAD_TIMEOUT;
+        }
+        goto exit;
+    }
+
+    qcloud_otalib_md5_finalize(md5, md5_str);
+    if (0 != strcmp(md5_str, image->md5sum)) {
+        Log_e("image %s of %s md5 %s mismatch, expect %s", image->version, image->product_id, md5_str, image->md5sum);
+        result = IOT_OTAR_MD5_NOT_MATCH;
+        goto exit;
+    }
+
+    result = IOT_OTAR_NONE;
+
+exit:
+    qcloud_ofc_deinit(ch);
+    qcloud_otalib_md5_deinit(md5);
+    if (NULL != buf) {
+        HAL_Free(buf);
+    }
+    return result;
+}
+
+void *IOT_Gateway_OTA_Init(void *client, GatewayOTAParams *params)
+{
+    POINTER_SANITY_CHECK(client, NULL);
+    POINTER_SANITY_CHECK(params, NULL);
+    POINTER_SANITY_CHECK(params->write, NULL);
+    POINTER_SANITY_CHECK(params->on_ready, NULL);
+    NUMBERIC_SANITY_CHECK(params->buf_len, NULL);
+
+    GatewayOTA *ota = (GatewayOTA *)HAL_Malloc(sizeof(GatewayOTA));
+    if (NULL == ota) {
+        Log_e("allocate for gateway OTA failed");
+        return NULL;
+    }
+    memset(ota, 0, sizeof(GatewayOTA));
+
+    ota->lock = HAL_MutexCreate();
+    if (NULL == ota->lock) {
+        Log_e("create lock of gateway OTA failed");
+        HAL_Free(ota);
+        return NULL;
+    }
+
+    ota->gateway = (Gateway *)client;
+    ota->params  = *params;
+
+    return ota;
+}
+
+int IOT_Gateway_OTA_Destroy(void *handle)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    GatewayOTA *      ota = (GatewayOTA *)handle;
+    GatewayOTASubdev *subdev;
+    int               i;
+
+    while (NULL != (subdev = ota->subdev_list)) {
+        ota->subdev_list = subdev->next;
+        qcloud_osc_deinit(subdev->ch_signal);
+        HAL_Free(subdev);
+    }
+
+    for (i = 0; i < GATEWAY_OTA_IMAGE_MAX; i++) {
+        _gateway_ota_image_free(ota, &ota->images[i]);
+    }
+
+    HAL_MutexDestroy(ota->lock);
+    HAL_Free(ota);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Gateway_OTA_Subdev_Add(void *handle, const char *product_id, const char *device_name, const char *version)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(product_id, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(device_name, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(version, QCLOUD_ERR_INVAL);
+
+    GatewayOTA *      ota = (GatewayOTA *)handle;
+    GatewayOTASubdev *subdev;
+    char              msg[GATEWAY_OTA_MSG_LEN];
+    int               ret;
+
+    if (strlen(product_id) > MAX_SIZE_OF_PRODUCT_ID || strlen(device_name) > MAX_SIZE_OF_DEVICE_NAME) {
+        Log_e("product_id or device_name is too long");
+        return QCLOUD_ERR_INVAL;
+    }
+
+    if (!subdev_session_is_online(ota->gateway, product_id, device_name)) {
+        Log_e("sub-device %s/%s is not online", product_id, device_name);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    HAL_MutexLock(ota->lock);
+    subdev = _gateway_ota_find_subdev(ota, product_id, device_name);
+    HAL_MutexUnlock(ota->lock);
+    if (NULL != subdev) {
+        Log_e("sub-device %s/%s is added already", product_id, device_name);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    subdev = (GatewayOTASubdev *)HAL_Malloc(sizeof(GatewayOTASubdev));
+    if (NULL == subdev) {
+        Log_e("allocate for sub-device OTA failed");
+        return QCLOUD_ERR_MALLOC;
+    }
+    memset(subdev, 0, sizeof(GatewayOTASubdev));
+    subdev->ota = ota;
+    strncpy(subdev->product_id, product_id, MAX_SIZE_OF_PRODUCT_ID);
+    strncpy(subdev->device_name, device_name, MAX_SIZE_OF_DEVICE_NAME);
+
+    // OTA topic of sub-device is subscribed by gateway connection
+    subdev->ch_signal =
+        qcloud_osc_init(subdev->product_id, subdev->device_name, ota->gateway->mqtt, _gateway_ota_callback, subdev);
+    if (NULL == subdev->ch_signal) {
+        Log_e("initialize OTA signal channel of %s/%s failed", product_id, device_name);
+        HAL_Free(subdev);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    HAL_MutexLock(ota->lock);
+    subdev->next     = ota->subdev_list;
+    ota->subdev_list = subdev;
+    HAL_MutexUnlock(ota->lock);
+
+    ret = qcloud_otalib_gen_info_msg(msg, sizeof(msg), 0, version);
+    if (QCLOUD_RET_SUCCESS == ret) {
+        ret = qcloud_osc_report_version(subdev->ch_signal, msg);
+        ret = (ret < 0) ? ret : QCLOUD_RET_SUCCESS;
+    }
+    if (QCLOUD_RET_SUCCESS != ret) {
+        Log_e("report version of %s/%s failed: %d", product_id, device_name, ret);
+    }
+
+    return ret;
+}
+
+int IOT_Gateway_OTA_Subdev_Remove(void *handle, const char *product_id, const char *device_name)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(product_id, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(device_name, QCLOUD_ERR_INVAL);
+
+    GatewayOTA *       ota = (GatewayOTA *)handle;
+    GatewayOTASubdev * subdev;
+    GatewayOTASubdev **link;
+
+    HAL_MutexLock(ota->lock);
+    for (link = &ota->subdev_list; NULL != *link; link = &(*link)->next) {
+        if (0 == strcmp((*link)->product_id, product_id) && 0 == strcmp((*link)->device_name, device_name)) {
+            break;
+        }
+    }
+    subdev = *link;
+    if (NULL != subdev) {
+        *link = subdev->next;
+    }
+    HAL_MutexUnlock(ota->lock);
+
+    if (NULL == subdev) {
+        Log_e("sub-device %s/%s is not added", product_id, device_name);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    qcloud_osc_deinit(subdev->ch_signal);
+    HAL_Free(subdev);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Gateway_OTA_Yield(void *handle)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    GatewayOTA *      ota   = (GatewayOTA *)handle;
+    GatewayOTAImage * image = NULL;
+    GatewayOTASubdev *subdev;
+    IOT_OTAReportType result;
+    char              product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char              device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    char              version[GATEWAY_OTA_VERSION_LEN + 1];
+    char              md5sum[33];
+    uint32_t          size;
+    int               ret = QCLOUD_RET_SUCCESS;
+    int               i;
+
+    HAL_MutexLock(ota->lock);
+    for (i = 0; i < GATEWAY_OTA_IMAGE_MAX; i++) {
+        if (GATEWAY_OTA_IMAGE_PENDING == ota->images[i].state) {
+            image        = &ota->images[i];
+            image->state = GATEWAY_OTA_IMAGE_FETCHING;
+            break;
+        }
+    }
+    for (subdev = ota->subdev_list; NULL != image && NULL != subdev; subdev = subdev->next) {
+        if (subdev->image == image) {
+            _gateway_ota_report(subdev, image->version, 0, IOT_OTAR_DOWNLOAD_BEGIN);
+        }
+    }
+    HAL_MutexUnlock(ota->lock);
+
+    if (NULL != image) {
+        // image in FETCHING state is not replaced, download it out of lock
+        result = _gateway_ota_download(ota, image);
+
+        HAL_MutexLock(ota->lock);
+        if (IOT_OTAR_NONE == result) {
+            image->state = GATEWAY_OTA_IMAGE_READY;
+            Log_i("image %s of %s is cached, size: %u", image->version, image->product_id, image->size);
+        } else {
+            for (subdev = ota->subdev_list; NULL != subdev; subdev = subdev->next) {
+                if (subdev->image == image) {
+                    _gateway_ota_report(subdev, image->version, 0, result);
+                    subdev->image = NULL;
+                }
+            }
+            // partial image is removed from local storage
+            image->state = GATEWAY_OTA_IMAGE_READY;
+            _gateway_ota_image_free(ota, image);
+            ret = QCLOUD_ERR_FAILURE;
+        }
+        HAL_MutexUnlock(ota->lock);
+    }
+
+    // notify sub-devices whose image is ready, one at a time out of lock
+    for (;;) {
+        HAL_MutexLock(ota->lock);
+        for (subdev = ota->subdev_list; NULL != subdev; subdev = subdev->next) {
+            if (NULL != subdev->image && !subdev->notified && GATEWAY_OTA_IMAGE_READY == subdev->image->state) {
+                break;
+            }
+        }
+        if (NULL != subdev) {
+            subdev->notified = 1;
+            strcpy(product_id, subdev->product_id);
+            strcpy(device_name, subdev->device_name);
+            strcpy(version, subdev->image->version);
+            strcpy(md5sum, subdev->image->md5sum);
+            size = subdev->image->size;
+        }
+        HAL_MutexUnlock(ota->lock);
+
+        if (NULL == subdev) {
+            break;
+        }
+        ota->params.on_ready(ota->params.user_data, product_id, device_name, version, size, md5sum);
+    }
+
+    return ret;
+}
+
+/* report for sub-device upgrading, and detach it from its image when upgrade is done */
+static int _gateway_ota_report_subdev(GatewayOTA *ota, const char *product_id, const char *device_name, int progress,
+                                      IOT_OTAReportType type)
+{
+    GatewayOTASubdev *subdev;
+    int               ret;
+
+    HAL_MutexLock(ota->lock);
+    subdev = _gateway_ota_find_subdev(ota, product_id, device_name);
+    if (NULL == subdev || NULL == subdev->image) {
+        HAL_MutexUnlock(ota->lock);
+        Log_e("sub-device %s/%s is not upgrading", product_id, device_name);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    ret = _gateway_ota_report(subdev, subdev->image->version, progress, type);
+    if (IOT_OTAR_UPGRADE_SUCCESS == type || IOT_OTAR_UPGRADE_FAIL == type) {
+        subdev->image    = NULL;
+        subdev->notified = 0;
+    }
+    HAL_MutexUnlock(ota->lock);
+
+    return ret;
+}
+
+int IOT_Gateway_OTA_ReportProgress(void *handle, const char *product_id, const char *device_name, int percent)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(product_id, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(device_name, QCLOUD_ERR_INVAL);
+
+    if (percent < 0 || percent > 100) {
+        Log_e("percent %d is out of range", percent);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    return _gateway_ota_report_subdev((GatewayOTA *)handle, product_id, device_name, percent, IOT_OTAR_DOWNLOADING);
+}
+
+int IOT_Gateway_OTA_ReportUpgrade(void *handle, const char *product_id, const char *device_name,
+                                  IOT_OTAReportType type)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(product_id, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(device_name, QCLOUD_ERR_INVAL);
+
+    if (IOT_OTAR_UPGRADE_BEGIN != type && IOT_OTAR_UPGRADE_SUCCESS != type && IOT_OTAR_UPGRADE_FAIL != type) {
+        Log_e("report type %d is not upgrade state", type);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    return _gateway_ota_report_subdev((GatewayOTA *)handle, product_id, device_name, 0, type);
+}
+
+#endif /* OTA_MQTT_CHANNEL */
@@ -0,0 +1,663 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2018-2020 THL A29 Limited, a Tencent company. All rights
+ reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define LOG_LOCAL_MODULE eLOG_MODULE_GATEWAY
+
+#include <string.h>
+
+#include "data_template_client_json.h"
+#include "gateway_common.h"
+#include "json_parser.h"
+#include "mqtt_client.h"
+#include "utils_param_check.h"
+
+#define GATEWAY_TEMPLATE_DOWN_PREFIX   "$thing/down/property/"
+#define GATEWAY_TEMPLATE_DOWN_WILDCARD "$thing/down/property/+/+"
+#define GATEWAY_TEMPLATE_UP_FMT        "$thing/up/property/%s/%s"
+#define GATEWAY_TEMPLATE_MIN_BUCKETS   4
+#define GATEWAY_TEMPLATE_DRAIN_MS      10
+
+typedef struct _GatewayTemplate GatewayTemplate;
+
+/* data template of sub-device, properties are owned by application */
+typedef struct _GatewaySubdevTemplate {
+    GatewayTemplate *               templates;
+    struct _GatewaySubdevTemplate * next;  // next in hash bucket
+    char                            product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char                            device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    uint32_t                        hash;
+    DeviceProperty *                properties;
+    GatewayTemplateControlCallback  callback;
+    void *                          user_data;
+    uint16_t                        refs;     // reports pending and messages in handling, plus one while added
+    uint8_t                         removed;  // callbacks of pending reports are not called
+    uint8_t                         property_num;
+    uint8_t                         order[];  // index of properties sorted by key
+} GatewaySubdevTemplate;
+
+/* report of sub-device waiting for reply, keyed by token number */
+typedef struct {
+    GatewaySubdevTemplate *subdev;
+    OnReplyCallback        callback;
+    void *                 user_context;
+} GatewayTemplateRequest;
+
+struct _GatewayTemplate {
+    Gateway *               gateway;
+    GatewaySubdevTemplate **buckets;  // sub-devices chained by hash of product_id and device_name
+    uint16_t                mask;     // number of buckets - 1
+    uint32_t                token_num;
+    ReplyTable              replies;
+    void *                  lock;
+    uint16_t                running;  // message handlers and timeout checks using it, guarded by gateway lock
+};
+
+static char sg_gateway_template_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];
+
+static GatewaySubdevTemplate *_gateway_template_find(GatewayTemplate *templates, const char *product_id,
+                                                     const char *device_name)
+{
+    uint32_t               hash   = subdev_client_id_hash(product_id, device_name);
+    GatewaySubdevTemplate *subdev = templates->buckets[hash & templates->mask];
+
+    for (; NULL != subdev; subdev = subdev->next) {
+        if (subdev->hash == hash && 0 == strcmp(subdev->product_id, product_id) &&
+            0 == strcmp(subdev->device_name, device_name)) {
+            break;
+        }
+    }
+
+    return subdev;
+}
+
+/* drop a reference of sub-device, caller should hold the lock */
+static void _gateway_template_put(GatewaySubdevTemplate *subdev)
+{
+    if (0 == --subdev->refs) {
+        HAL_Free(subdev);
+    }
+}
+
+/* get templates of gateway for a message handler or timeout check, which may run in another thread than
+ * IOT_Gateway_Template_Destroy, NULL if not created or being destroyed */
+static GatewayTemplate *_gateway_template_enter(Gateway *gateway)
+{
+    GatewayTemplate *templates;
+
+    HAL_MutexLock(gateway->lock);
+    templates = gateway->templates;
+    if (NULL != templates) {
+        templates->running++;
+    }
+    HAL_MutexUnlock(gateway->lock);
+
+    return templates;
+}
+
+static void _gateway_template_leave(GatewayTemplate *templates)
+{
+    Gateway *gateway = templates->gateway;
+
+    HAL_MutexLock(gateway->lock);
+    templates->running--;
+    HAL_MutexUnlock(gateway->lock);
+}
+
+/* compare key of property with key not NULL-terminated */
+static int _gateway_template_key_cmp(const char *property_key, const char *key, int key_len)
+{
+    int diff = strncmp(property_key, key, key_len);
+
+    return diff ? diff : (uint8_t)property_key[key_len];
+}
+
+static DeviceProperty *_gateway_template_find_property(GatewaySubdevTemplate *subdev, const char *key, int key_len)
+{
+    int             low = 0, high = subdev->property_num - 1, mid, diff;
+    DeviceProperty *property;
+
+    while (low <= high) {
+        mid      = (low + high) / 2;
+        property = &subdev->properties[subdev->order[mid]];
+        diff     = _gateway_template_key_cmp(property->key, key, key_len);
+        if (0 == diff) {
+            return property;
+        }
+        if (diff < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return NULL;
+}
+
+static void _gateway_template_handle_control(GatewaySubdevTemplate *subdev, const char *client_token)
+{
+    char *          control_str = NULL;
+    char *          pos = NULL, *key = NULL, *val = NULL;
+    int             klen = 0, vlen = 0, vtype = 0;
+    DeviceProperty *property;
+
+    if (!parse_template_cmd_control(sg_gateway_template_rcv_buf, &control_str)) {
+        return;
+    }
+
+    json_object_for_each_kv(control_str, pos, key, klen, val, vlen, vtype)
+    {
+        if (!key || !klen || !val || (!vlen && JSSTRING != vtype) || JSNULL == vtype) {
+            continue;
+        }
+
+        property = _gateway_template_find_property(subdev, key, klen);
+        if (NULL != property && update_value_from_json_token(val, vlen, property) && NULL != subdev->callback &&
+            !subdev->removed) {
+            subdev->callback(subdev->user_data, subdev, client_token, property);
+        }
+    }
+
+    HAL_Free(control_str);
+}
+
+static void _gateway_template_handle_reply(GatewaySubdevTemplate *subdev, const char *client_token)
+{
+    GatewayTemplate *       templates = subdev->templates;
+    GatewayTemplateRequest *request;
+    uint32_t                key        = get_client_token_key(client_token, subdev->product_id);
+    int32_t                 reply_code = 0;
+    bool                    removed;
+
+    HAL_MutexLock(templates->lock);
+    request = (GatewayTemplateRequest *)reply_table_find(&templates->replies, key);
+    if (NULL == request || request->subdev != subdev) {
+        HAL_MutexUnlock(templates->lock);
+        return;
+    }
+    reply_table_remove(&templates->replies, key);
+    removed = subdev->removed;
+    HAL_MutexUnlock(templates->lock);
+
+    // reports of removed sub-device are dropped without callback, as they are on timeout
+    if (!removed) {
+        if (!parse_code_return(sg_gateway_template_rcv_buf, &reply_code)) {
+            Log_e("parse reply code of %s/%s failed", subdev->product_id, subdev->device_name);
+            reply_code = -1;
+        }
+        request->callback(subdev, REPORT, (0 == reply_code) ? ACK_ACCEPTED : ACK_REJECTED,
+                          sg_gateway_template_rcv_buf, request->user_context);
+    }
+
+    HAL_MutexLock(templates->lock);
+    _gateway_template_put(subdev);
+    HAL_MutexUnlock(templates->lock);
+    HAL_Free(request);
+}
+
+/* handler of $thing/down/property/{ProductId}/{DeviceName} of all the sub-devices */
+static void _gateway_template_message_handler(void *client, MQTTMessage *message, void *user_data)
+{
+    GatewayTemplate *      templates;
+    GatewaySubdevTemplate *subdev;
+    char                   product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char                   device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    const char *           topic      = message->ptopic;
+    size_t                 prefix_len = strlen(GATEWAY_TEMPLATE_DOWN_PREFIX);
+    size_t                 pid_len, dn_len;
+    const char *           slash;
+    char *                 method       = NULL;
+    char *                 client_token = NULL;
+
+    if (NULL == topic || message->topic_len <= prefix_len) {
+        return;
+    }
+
+    slash = memchr(topic + prefix_len, '/', message->topic_len - prefix_len);
+    if (NULL == slash) {
+        return;
+    }
+    pid_len = slash - topic - prefix_len;
+    dn_len  = message->topic_len - prefix_len - pid_len - 1;
+    if (0 == pid_len || pid_len > MAX_SIZE_OF_PRODUCT_ID || 0 == dn_len || dn_len > MAX_SIZE_OF_DEVICE_NAME) {
+        Log_e("invalid topic: %.*s", (int)message->topic_len, topic);
+        return;
+    }
+    memcpy(product_id, topic + prefix_len, pid_len);
+    product_id[pid_len] = '\0';
+    memcpy(device_name, slash + 1, dn_len);
+    device_name[dn_len] = '\0';
+
+    if (message->payload_len > CLOUD_IOT_JSON_RX_BUF_LEN - 1) {
+        Log_e("message of %s/%s is too long: %u", product_id, device_name, (unsigned)message->payload_len);
+        return;
+    }
+
+    // user data is the gateway, as the message may be delivered after templates are destroyed
+    templates = _gateway_template_enter((Gateway *)user_data);
+    if (NULL == templates) {
+        return;
+    }
+
+    // the sub-device is kept until the message is handled out of lock
+    HAL_MutexLock(templates->lock);
+    subdev = _gateway_template_find(templates, product_id, device_name);
+    if (NULL != subdev) {
+        subdev->refs++;
+    }
+    HAL_MutexUnlock(templates->lock);
+    if (NULL == subdev) {
+        Log_d("no template of %s/%s", product_id, device_name);
+        _gateway_template_leave(templates);
+        return;
+    }
+
+    memcpy(sg_gateway_template_rcv_buf, message->payload, message->payload_len);
+    sg_gateway_template_rcv_buf[message->payload_len] = '\0';
+    Log_d("recv of %s/%s: %s", product_id, device_name, sg_gateway_template_rcv_buf);
+
+    if (!parse_template_method_type(sg_gateway_template_rcv_buf, &method) ||
+        !parse_client_token(sg_gateway_template_rcv_buf, &client_token)) {
+        Log_e("fail to parse method or client token of %s/%s", product_id, device_name);
+    } else if (0 == strcmp(method, CONTROL_CMD)) {
+        _gateway_template_handle_control(subdev, client_token);
+    } else {
+        _gateway_template_handle_reply(subdev, client_token);
+    }
+
+    HAL_Free(method);
+    HAL_Free(client_token);
+
+    HAL_MutexLock(templates->lock);
+    _gateway_template_put(subdev);
+    HAL_MutexUnlock(templates->lock);
+    _gateway_template_leave(templates);
+}
+
+void gateway_template_check_timeout(Gateway *gateway)
+{
+    GatewayTemplate *       templates;
+    GatewayTemplateRequest *request;
+    bool                    removed;
+
+    if (NULL == gateway->templates || NULL == (templates = _gateway_template_enter(gateway))) {
+        return;
+    }
+
+    for (;;) {
+        HAL_MutexLock(templates->lock);
+        request = (GatewayTemplateRequest *)reply_table_pop_expired(&templates->replies);
+        removed = (NULL != request) && request->subdev->removed;
+        HAL_MutexUnlock(templates->lock);
+        if (NULL == request) {
+            break;
+        }
+
+        if (!removed) {
+            request->callback(request->subdev, REPORT, ACK_TIMEOUT, NULL, request->user_context);
+        }
+
+        HAL_MutexLock(templates->lock);
+        _gateway_template_put(request->subdev);
+        HAL_MutexUnlock(templates->lock);
+        HAL_Free(request);
+    }
+
+    _gateway_template_leave(templates);
+}
+
+void *IOT_Gateway_Template_Init(void *client, uint16_t max_pending)
+{
+    POINTER_SANITY_CHECK(client, NULL);
+    NUMBERIC_SANITY_CHECK(max_pending, NULL);
+
+    Gateway *        gateway   = (Gateway *)client;
+    GatewayTemplate *templates = NULL;
+    SubscribeParams  params    = DEFAULT_SUB_PARAMS;
+    uint32_t         buckets   = GATEWAY_TEMPLATE_MIN_BUCKETS;
+    int              rc;
+
+    if (NULL != gateway->templates) {
+        Log_e("gateway template is created already");
+        return NULL;
+    }
+
+    while (buckets < gateway->sessions.max_count) {
+        buckets <<= 1;
+    }
+
+    templates = (GatewayTemplate *)HAL_Malloc(sizeof(GatewayTemplate));
+    if (NULL == templates) {
+        Log_e("allocate for gateway template failed");
+        return NULL;
+    }
+    memset(templates, 0, sizeof(GatewayTemplate));
+    templates->gateway = gateway;
+    templates->mask    = buckets - 1;
+
+    templates->buckets = (GatewaySubdevTemplate **)HAL_Malloc(buckets * sizeof(GatewaySubdevTemplate *));
+    templates->lock    = HAL_MutexCreate();
+    if (NULL == templates->buckets || NULL == templates->lock ||
+        QCLOUD_RET_SUCCESS != reply_table_init(&templates->replies, max_pending)) {
+        Log_e("allocate for gateway template failed");
+        goto error;
+    }
+    memset(templates->buckets, 0, buckets * sizeof(GatewaySubdevTemplate *));
+
+    params.on_message_handler = _gateway_template_message_handler;
+    params.qos                = QOS0;
+    params.user_data          = gateway;
+    rc                        = IOT_MQTT_Subscribe(gateway->mqtt, GATEWAY_TEMPLATE_DOWN_WILDCARD, &params);
+    if (rc < 0) {
+        Log_e("subscribe %s failed: %d", GATEWAY_TEMPLATE_DOWN_WILDCARD, rc);
+        goto error;
+    }
+
+    HAL_MutexLock(gateway->lock);
+    gateway->templates = templates;
+    HAL_MutexUnlock(gateway->lock);
+    return templates;
+
+error:
+    reply_table_deinit(&templates->replies);
+    if (NULL != templates->lock) {
+        HAL_MutexDestroy(templates->lock);
+    }
+    HAL_Free(templates->buckets);
+    HAL_Free(templates);
+    return NULL;
+}
+
+int IOT_Gateway_Template_Destroy(void *handle)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    GatewayTemplate *       templates = (GatewayTemplate *)handle;
+    Gateway *               gateway   = templates->gateway;
+    GatewaySubdevTemplate * subdev;
+    GatewayTemplateRequest *request;
+    uint16_t                running;
+    uint32_t                i;
+
+    IOT_MQTT_Unsubscribe(gateway->mqtt, GATEWAY_TEMPLATE_DOWN_WILDCARD);
+
+    // no more handlers get it, wait for the ones running in other threads
+    HAL_MutexLock(gateway->lock);
+    gateway->templates = NULL;
+    running            = templates->running;
+    HAL_MutexUnlock(gateway->lock);
+    while (running > 0) {
+        HAL_SleepMs(GATEWAY_TEMPLATE_DRAIN_MS);
+        HAL_MutexLock(gateway->lock);
+        running = templates->running;
+        HAL_MutexUnlock(gateway->lock);
+    }
+
+    HAL_MutexLock(templates->lock);
+    while (NULL != (request = (GatewayTemplateRequest *)reply_table_pop(&templates->replies))) {
+        _gateway_template_put(request->subdev);
+        HAL_Free(request);
+    }
+    reply_table_deinit(&templates->replies);
+
+    for (i = 0; i <= templates->mask; i++) {
+        while (NULL != (subdev = templates->buckets[i])) {
+            templates->buckets[i] = subdev->next;
+            _gateway_template_put(subdev);
+        }
+    }
+    HAL_MutexUnlock(templates->lock);
+
+    HAL_MutexDestroy(templates->lock);
+    HAL_Free(templates->buckets);
+    HAL_Free(templates);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void *IOT_Gateway_Template_Subdev_Add(void *handle, const char *product_id, const char *device_name,
+                                      DeviceProperty *properties, uint8_t property_num,
+                                      GatewayTemplateControlCallback callback, void *user_data)
+{
+    POINTER_SANITY_CHECK(handle, NULL);
+    STRING_PTR_SANITY_CHECK(product_id, NULL);
+    STRING_PTR_SANITY_CHECK(device_name, NULL);
+    if (property_num > 0) {
+        POINTER_SANITY_CHECK(properties, NULL);
+    }
+
+    GatewayTemplate *       templates = (GatewayTemplate *)handle;
+    GatewaySubdevTemplate * subdev;
+    GatewaySubdevTemplate **bucket;
+    int                     i, j;
+
+    if (strlen(product_id) > MAX_SIZE_OF_PRODUCT_ID || strlen(device_name) > MAX_SIZE_OF_DEVICE_NAME) {
+        Log_e("product_id or device_name is too long");
+        return NULL;
+    }
+
+    if (!subdev_session_is_online(templates->gateway, product_id, device_name)) {
+        Log_e("sub-device %s/%s is not online", product_id, device_name);
+        return NULL;
+    }
+
+    subdev = (GatewaySubdevTemplate *)HAL_Malloc(sizeof(GatewaySubdevTemplate) + property_num);
+    if (NULL == subdev) {
+        Log_e("allocate for sub-device template failed");
+        return NULL;
+    }
+    memset(subdev, 0, sizeof(GatewaySubdevTemplate));
+    subdev->templates = templates;
+    strncpy(subdev->product_id, product_id, MAX_SIZE_OF_PRODUCT_ID);
+    strncpy(subdev->device_name, device_name, MAX_SIZE_OF_DEVICE_NAME);
+    subdev->hash         = subdev_client_id_hash(subdev->product_id, subdev->device_name);
+    subdev->properties   = properties;
+    subdev->property_num = property_num;
+    subdev->callback     = callback;
+    subdev->user_data    = user_data;
+    subdev->refs         = 1;
+
+    // insertion sort of property keys, control message is dispatched by binary search
+    for (i = 0; i < property_num; i++) {
+        if (NULL == properties[i].key) {
+            Log_e("key of property %d is NULL", i);
+            HAL_Free(subdev);
+            return NULL;
+        }
+        for (j = i; j > 0 && strcmp(properties[subdev->order[j - 1]].key, properties[i].key) > 0; j--) {
+            subdev->order[j] = subdev->order[j - 1];
+        }
+        if (j > 0 && 0 == strcmp(properties[subdev->order[j - 1]].key, properties[i].key)) {
+            Log_e("duplicated property key: %s", properties[i].key);
+            HAL_Free(subdev);
+            return NULL;
+        }
+        subdev->order[j] = (uint8_t)i;
+    }
+
+    HAL_MutexLock(templates->lock);
+    if (NULL != _gateway_template_find(templates, subdev->product_id, subdev->device_name)) {
+        HAL_MutexUnlock(templates->lock);
+        Log_e("sub-device %s/%s is added already", product_id, device_name);
+        HAL_Free(subdev);
+        return NULL;
+    }
+    bucket       = &templates->buckets[subdev->hash & templates->mask];
+    subdev->next = *bucket;
+    *bucket      = subdev;
+    HAL_MutexUnlock(templates->lock);
+
+    return subdev;
+}
+
+int IOT_Gateway_Template_Subdev_Remove(void *handle, void *subdev)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(subdev, QCLOUD_ERR_INVAL);
+
+    GatewayTemplate *       templates = (GatewayTemplate *)handle;
+    GatewaySubdevTemplate **link;
+
+    HAL_MutexLock(templates->lock);
+    link = &templates->buckets[((GatewaySubdevTemplate *)subdev)->hash & templates->mask];
+    for (; NULL != *link && *link != subdev; link = &(*link)->next) {
+    }
+    if (NULL == *link) {
+        HAL_MutexUnlock(templates->lock);
+        Log_e("sub-device template is not added");
+        return QCLOUD_ERR_INVAL;
+    }
+    *link = (*link)->next;
+
+    // freed when the pending reports time out, their callbacks are not called
+    ((GatewaySubdevTemplate *)subdev)->removed = 1;
+    _gateway_template_put((GatewaySubdevTemplate *)subdev);
+    HAL_MutexUnlock(templates->lock);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _gateway_template_publish(GatewaySubdevTemplate *subdev, char *payload)
+{
+    char          topic[MAX_SIZE_OF_CLOUD_TOPIC];
+    PublishParams params = DEFAULT_PUB_PARAMS;
+    int           size;
+
+    size = HAL_Snprintf(topic, MAX_SIZE_OF_CLOUD_TOPIC, GATEWAY_TEMPLATE_UP_FMT, subdev->product_id,
+                        subdev->device_name);
+    if (size < 0 || size > MAX_SIZE_OF_CLOUD_TOPIC - 1) {
+        Log_e("buf size < topic length!");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    params.qos         = QOS0;
+    params.payload     = payload;
+    params.payload_len = strlen(payload);
+
+    size = IOT_MQTT_Publish(subdev->templates->gateway->mqtt, topic, &params);
+    return (size < 0) ? size : QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Gateway_Template_Report(void *handle, void *subdev, char *buf, size_t size, uint8_t count,
+                                DeviceProperty *properties[], OnReplyCallback callback, void *user_context,
+                                uint32_t timeout_ms)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(subdev, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(properties, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(size, QCLOUD_ERR_INVAL);
+
+    GatewayTemplate *       templates = (GatewayTemplate *)handle;
+    GatewaySubdevTemplate * tmpl      = (GatewaySubdevTemplate *)subdev;
+    GatewayTemplateRequest *request   = NULL;
+    uint32_t                token;
+    size_t                  len;
+    int                     rc, i;
+
+    HAL_MutexLock(templates->lock);
+    token = templates->token_num++;
+    HAL_MutexUnlock(templates->lock);
+
+    rc = HAL_Snprintf(buf, size, "{\"method\":\"%s\", \"clientToken\":\"%s-%u\", \"params\":{", REPORT_CMD,
+                      tmpl->product_id, token);
+    rc = check_snprintf_return(rc, size);
+    for (i = 0; QCLOUD_RET_SUCCESS == rc && i < count; i++) {
+        if (NULL == properties[i] || NULL == properties[i]->key) {
+            rc = QCLOUD_ERR_INVAL;
+            break;
+        }
+        rc = template_put_json_node(buf, size, properties[i]->key, properties[i]->data, properties[i]->type);
+    }
+    if (QCLOUD_RET_SUCCESS == rc) {
+        // overwrite the trailing comma of the last property, or append to "{" if none
+        len = strlen(buf) - (count > 0);
+        rc  = check_snprintf_return(HAL_Snprintf(buf + len, size - len, "}}"), size - len);
+    }
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("construct report of %s/%s failed: %d", tmpl->product_id, tmpl->device_name, rc);
+        return rc;
+    }
+
+    if (NULL != callback) {
+        request = (GatewayTemplateRequest *)HAL_Malloc(sizeof(GatewayTemplateRequest));
+        if (NULL == request) {
+            Log_e("allocate for report request failed");
+            return QCLOUD_ERR_MALLOC;
+        }
+        request->subdev       = tmpl;
+        request->callback     = callback;
+        request->user_context = user_context;
+
+        // added before publish so that a fast reply is matched
+        HAL_MutexLock(templates->lock);
+        rc = reply_table_add(&templates->replies, token, request, timeout_ms);
+        if (QCLOUD_RET_SUCCESS == rc) {
+            tmpl->refs++;
+        }
+        HAL_MutexUnlock(templates->lock);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            Log_e("add report of %s/%s to reply table failed: %d", tmpl->product_id, tmpl->device_name, rc);
+            HAL_Free(request);
+            return rc;
+        }
+    }
+
+    rc = _gateway_template_publish(tmpl, buf);
+    if (QCLOUD_RET_SUCCESS != rc && NULL != request) {
+        HAL_MutexLock(templates->lock);
+        if (request == reply_table_find(&templates->replies, token)) {
+            reply_table_remove(&templates->replies, token);
+            _gateway_template_put(tmpl);
+            HAL_Free(request);
+        }
+        HAL_MutexUnlock(templates->lock);
+    }
+
+    return rc;
+}
+
+int IOT_Gateway_Template_ControlReply(void *handle, void *subdev, char *buf, size_t size, const char *client_token,
+                                      sReplyPara *reply)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(subdev, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(reply, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(client_token, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(size, QCLOUD_ERR_INVAL);
+
+    int rc;
+
+    if (strlen(reply->status_msg) > 0) {
+        rc = HAL_Snprintf(buf, size, "{\"method\":\"%s\", \"code\":%d, \"clientToken\":\"%s\", \"status\":\"%s\"}",
+                          CONTROL_CMD_REPLY, reply->code, client_token, reply->status_msg);
+    } else {
+        rc = HAL_Snprintf(buf, size, "{\"method\":\"%s\", \"code\":%d, \"clientToken\":\"%s\"}", CONTROL_CMD_REPLY,
+                          reply->code, client_token);
+    }
+    rc = check_snprintf_return(rc, size);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("construct control reply failed: %d", rc);
+        return rc;
+    }
+
+    return _gateway_template_publish((GatewaySubdevTemplate *)subdev, buf);
+}
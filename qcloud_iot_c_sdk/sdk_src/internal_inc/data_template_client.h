@@ -37,19 +37,40 @@ extern "C" {
 #include "qcloud_iot_export.h"
 #include "qcloud_iot_import.h"
 #include "utils_param_check.h"
+#include "utils_reply_table.h"
 
 #define MAX_CLEAE_DOC_LEN 256
 
 typedef struct _TemplateInnerData {
-    uint32_t token_num;
-    int32_t  sync_status;
-    uint32_t eventflags;
-    List *   event_list;
-    List *   reply_list;
-    List *   action_handle_list;
-    List *   property_handle_list;
-    char *   upstream_topic;    // upstream topic
-    char *   downstream_topic;  // downstream topic
+    uint32_t          token_num;
+    int32_t           sync_status;
+    uint32_t          eventflags;
+    ReplyTable        event_table;          // events wait for reply, keyed by token number
+    ReplyTable        reply_table;          // requests wait for reply, keyed by token number
+    ActionHandler **  action_buckets;       // registered actions chained by hash of action id
+    uint16_t          action_mask;          // number of action buckets - 1
+    uint16_t          action_num;           // num of registered actions
+    List *            property_handle_list;
+    PropertyHandler **property_index;       // registered properties sorted by key
+    uint16_t          property_index_num;   // num of properties in index
+    uint16_t          property_index_size;  // capacity of index
+    char *            upstream_topic;       // upstream topic
+    char *            downstream_topic;     // downstream topic
+    Timer             report_timer;         // coalescing window of changed property report
+    uint32_t          report_seq;           // seq of the last changed property report
+    Request *         pending_report;       // requests coalesced into the pending report
+    char *            pending_params;       // params of the pending report
+    uint32_t          pending_timeout_sec;  // reply timeout of the pending report
+    Timer             pending_timer;        // flush timer of the pending report
+    uint32_t          coalesce_ms;          // time budget of report coalescing, 0 means disabled
+    uint16_t          coalesce_size;        // size budget of coalesced report params
+    char *            pending_events;       // event objects of the pending batch, comma terminated, or CBOR maps
+    uint16_t          pending_events_len;   // length of the pending event objects
+    void *            pending_event_reply;  // reply of the pending event batch
+    uint16_t          pending_event_num;    // num of events in the pending batch
+    Timer             event_timer;          // flush timer of the pending event batch
+    uint32_t          event_batch_ms;       // time budget of event batching, 0 means disabled
+    uint16_t          event_batch_size;     // size budget of the pending event batch
 } TemplateInnerData;
 
 typedef struct _Template {
@@ -58,6 +79,7 @@ typedef struct _Template {
     void *                pDataTemplate;
     DeviceInfo            device_info;
     MQTTEventHandler      event_handle;
+    eTemplateCodec        codec;
     TemplateInnerData     inner_data;
     DataTemplateDestroyCb DataTemplateDestroyCb;
 
@@ -97,6 +119,19 @@ void handle_template_expired_reply(Qcloud_IoT_Template *pTemplate);
  */
 char *get_control_clientToken(void);
 
+/**
+ * @brief publish upstream document, encoded with the codec of data_template client
+ *
+ * @param pTemplate     handle to data_template client
+ * @param topic         topic to publish
+ * @param qos           MQTT QoS
+ * @param pPayload      JSON document, or CBOR document built directly for CBOR codec
+ * @param len           length of document
+ * @return				QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int publish_template_payload(Qcloud_IoT_Template *pTemplate, char *topic, QoS qos, void *pPayload, size_t len);
+
 /**
  * @brief all the upstream data by the way of request
  *
@@ -109,6 +144,53 @@ char *get_control_clientToken(void);
  */
 int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams, char *pJsonDoc, size_t sizeOfBuffer);
 
+/**
+ * @brief send request of a CBOR document built directly, which is not coalesced
+ *
+ * @param pTemplate     handle to data_template client
+ * @param pParams       request params
+ * @param pClientToken  clientToken in the document
+ * @param pCbor         CBOR document
+ * @param len           length of CBOR document
+ * @return				QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int send_template_cbor_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams, const char *pClientToken,
+                               uint8_t *pCbor, size_t len);
+
+/**
+ * @brief set the budget of coalescing reports, reports within the budget are merged into one document
+ *
+ * @param pTemplate     handle to data_template client
+ * @param window_ms     max time a report waits for merging, 0 to disable coalescing
+ * @param max_size      max size of the merged params
+ * @return				QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int set_template_report_coalesce(Qcloud_IoT_Template *pTemplate, uint32_t window_ms, uint16_t max_size);
+
+/**
+ * @brief publish the pending coalesced report if its time budget is used up
+ *
+ * @param pTemplate     handle to data_template client
+ * @param force         publish even if the time budget is not used up
+ * @return				QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int flush_template_pending_report(Qcloud_IoT_Template *pTemplate, bool force);
+
+#ifdef EVENT_POST_ENABLED
+/**
+ * @brief post the pending event batch in one document if its time budget is used up
+ *
+ * @param pTemplate     handle to data_template client
+ * @param force         post even if the time budget is not used up
+ * @return				QCLOUD_RET_SUCCESS when success, or err code for
+ * failure
+ */
+int flush_template_pending_event(Qcloud_IoT_Template *pTemplate, bool force);
+#endif
+
 /**
  * @brief subscribe data_template topic $thing/down/property/%s/%s
  *
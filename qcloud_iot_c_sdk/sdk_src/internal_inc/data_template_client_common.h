@@ -57,6 +57,65 @@ int template_common_remove_property(Qcloud_IoT_Template *ptemplate, DeviceProper
  */
 int template_common_check_property_existence(Qcloud_IoT_Template *ptemplate, DeviceProperty *pProperty);
 
+/**
+ * @brief find the registered property handle by key, caller should hold the template mutex
+ *
+ * @param pTemplate handle to data_template client
+ * @param key       property key, not necessarily NULL-terminated
+ * @param key_len   length of key
+ * @return          property handle, or NULL if not registered
+ */
+PropertyHandler *template_common_find_property_handle(Qcloud_IoT_Template *pTemplate, const char *key, int key_len);
+
+/**
+ * @brief take a property out of the key index, caller should hold the template mutex
+ *
+ * @param pTemplate handle to data_template client
+ * @param pProperty device property
+ * @return          property handle removed from index, or NULL if not registered
+ */
+PropertyHandler *template_common_remove_property_index(Qcloud_IoT_Template *pTemplate, DeviceProperty *pProperty);
+
+/**
+ * @brief free a property handle together with its shadow value, used as free function of property list
+ *
+ * @param val   property handle
+ */
+void template_common_free_property_handle(void *val);
+
+/**
+ * @brief check if the property value differs from the one in last report, or the one waiting for reply
+ *
+ * @param property_handle   property handle
+ * @return                  true if property should be reported
+ */
+bool template_common_property_changed(PropertyHandler *property_handle);
+
+/**
+ * @brief save current property value as the one in changed report waiting for reply
+ *
+ * @param property_handle   property handle
+ * @param report_seq        seq of the changed report
+ * @return                  QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int template_common_snapshot_property(PropertyHandler *property_handle, uint32_t report_seq);
+
+/**
+ * @brief finish the properties in changed report, commit their values if accepted, mark them dirty otherwise
+ *
+ * @param pTemplate     handle to data_template client
+ * @param report_seq    seq of the changed report
+ * @param accepted      report is accepted by server
+ */
+void template_common_finish_changed_report(Qcloud_IoT_Template *pTemplate, uint32_t report_seq, bool accepted);
+
+/**
+ * @brief release the property key index
+ *
+ * @param pTemplate handle to data_template client
+ */
+void template_common_clear_property_index(Qcloud_IoT_Template *pTemplate);
+
 #ifdef __cplusplus
 }
 #endif
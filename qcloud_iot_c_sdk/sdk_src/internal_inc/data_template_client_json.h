@@ -26,6 +26,7 @@ extern "C" {
 #endif
 #include "qcloud_iot_export.h"
 #include "qcloud_iot_import.h"
+#include "utils_cbor.h"
 
 #define min(a, b) (a) < (b) ? (a) : (b)
 
@@ -79,21 +80,26 @@ typedef struct _RequestParam {
 
     void *user_context;  // user context for callback
 
+    uint32_t report_seq;  // changed report to finish on reply, 0 for none
+
 } RequestParams;
 
-#define DEFAULT_REQUEST_PARAMS {GET, 4, NULL, NULL};
+#define DEFAULT_REQUEST_PARAMS {GET, 4, NULL, NULL, 0};
 
 /**
  * @brief type for document request
  */
-typedef struct {
+typedef struct _Request {
     char   client_token[MAX_SIZE_OF_CLIENT_TOKEN];  // clientToken
     Method method;                                  // method type
 
     void *user_context;  // user context
-    Timer timer;         // timer for timeout
 
     OnReplyCallback callback;  // request response callback
+
+    uint32_t report_seq;  // changed report to finish on reply, 0 for none
+
+    struct _Request *merged;  // next request coalesced into the same document
 } Request;
 
 /**
@@ -104,16 +110,27 @@ typedef struct {
 
     OnPropRegCallback callback;
 
+    void *   shadow;       // copy of the value in last accepted report, NULL if never accepted
+    uint16_t shadow_len;   // size of shadow buffer
+    void *   pending;      // copy of the value in the changed report waiting for reply
+    uint16_t pending_len;  // size of pending buffer
+    uint32_t report_seq;   // seq of the changed report waiting for reply, 0 for none
+    float    deadband;     // min change of float/double value to be reported
+    bool     dirty;        // force the property into next changed report
+
 } PropertyHandler;
 
 /**
  * @brief save the action registed and its callback
  */
-typedef struct {
+typedef struct _ActionHandler {
     void *action;
 
     OnActionHandleCallback callback;
 
+    struct _ActionHandler *next;     // next in hash bucket
+    uint32_t               hash;     // hash of action id
+    uint8_t                order[];  // index of inputs sorted by key
 } ActionHandler;
 
 /**
@@ -161,6 +178,19 @@ int put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pKey, void
  */
 int template_put_json_node(char *jsonBuffer, size_t sizeOfBuffer, const char *pKey, void *pData, JsonDataType type);
 
+/**
+ * add a key/value pair to CBOR map, encoded as the JSON node put by put_json_node
+ * or template_put_json_node
+ *
+ * @param writer        CBOR writer
+ * @param pKey          key of node
+ * @param pData         value of node
+ * @param type          value type of node
+ * @param boolAsNumber  encode bool as 0/1 like template_put_json_node
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int template_put_cbor_node(CborWriter *writer, const char *pKey, void *pData, JsonDataType type, bool boolAsNumber);
+
 /**
  * @brief generate an empty JSON with only clientToken
  *
@@ -179,6 +209,16 @@ void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer, char *tokenPrefi
  */
 bool parse_client_token(char *pJsonDoc, char **pClientToken);
 
+/**
+ * @brief get the numeric key of clientToken to match the reply
+ *
+ * @param pClientToken   clientToken
+ * @param tokenPrefix    prefix of token, like product_id
+ * @return               token number of "<tokenPrefix>-<number>" built by SDK,
+ *                       or hash value of other tokens
+ */
+uint32_t get_client_token_key(const char *pClientToken, const char *tokenPrefix);
+
 /**
  * @brief parse field of aciont_id from JSON string
  *
@@ -233,6 +273,16 @@ bool parse_code_return(char *pJsonDoc, int32_t *pCode);
  */
 bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty);
 
+/**
+ * @brief update value from a JSON value token which is located by the JSON parser, not for OBJECT type
+ *
+ * @param pValue         start of the value within source JSON string, not NULL-terminated
+ * @param valueLen       length of the value, 0 for empty string
+ * @param pProperty      device property
+ * @return               true for success
+ */
+bool update_value_from_json_token(char *pValue, int valueLen, DeviceProperty *pProperty);
+
 /**
  * @brief parse field of method from JSON string
  *
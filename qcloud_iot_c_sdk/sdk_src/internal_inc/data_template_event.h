@@ -39,6 +39,9 @@ extern "C" {
 #define MAX_EVENT_WAIT_REPLY (10)
 #define EVENT_MAX_DATA_NUM   (255)
 
+#define MAX_EVENT_BATCH_CALLBACK (4)
+#define MIN_EVENT_BATCH_SIZE     (128)
+
 #define POST_EVENT  "event_post"
 #define POST_EVENTS "events_post"
 #define REPLY_EVENT "event_reply"
@@ -51,17 +54,12 @@ typedef enum {
     eEVENT_REPLY,
 } eEventMethod;
 
-typedef enum _eEventDealType_ {
-    eDEAL_REPLY_CB = 0,
-    eDEAL_EXPIRED  = 1,
-} eEventDealType;
-
 typedef struct _sReply_ {
     char  client_token[EVENT_TOKEN_MAX_LEN];  // clientToken for this event reply
     void *user_context;                       // user context
-    Timer timer;                              // timer for request timeout
 
-    OnEventReplyCallback callback;  // callback for this event reply
+    OnEventReplyCallback callback[MAX_EVENT_BATCH_CALLBACK];  // callbacks of the events posted in one document
+    uint8_t              callback_num;                        // num of callbacks
 } sEventReply;
 
 #ifdef __cplusplus
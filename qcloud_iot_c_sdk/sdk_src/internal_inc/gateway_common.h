@@ -23,10 +23,18 @@
 #define IOT_GATEWAY_COMMON_H_
 
 #include "qcloud_iot_export.h"
+#include "utils_reply_table.h"
+#include "utils_timer.h"
 
 #define GATEWAY_PAYLOAD_BUFFER_LEN 1024
 #define GATEWAY_RECEIVE_BUFFER_LEN 1024
-#define GATEWAY_LOOP_MAX_COUNT     100
+
+/* bound of waiting for subscribe/unsubscribe ack, MQTT reports its timeout earlier */
+#define GATEWAY_SYNC_TIMEOUT_MS 20000
+
+/* interval to poll for timeout of a batch waited on, at least one tick of the OS */
+#define GATEWAY_BATCH_POLL_MIN_MS 10
+#define GATEWAY_BATCH_POLL_MAX_MS 100
 
 /* The format of operation of gateway topic */
 #define GATEWAY_TOPIC_OPERATION_FMT "$gateway/operation/%s/%s"
@@ -37,10 +45,13 @@
 /* The format of gateway client id */
 #define GATEWAY_CLIENT_ID_FMT "%s/%s"
 
-/* The format of operation result of gateway topic */
-#define GATEWAY_PAYLOAD_STATUS_FMT                                       \
-    "{\"type\":\"%s\",\"payload\":{\"devices\":[{\"product_id\":\"%s\"," \
-    "\"device_name\":\"%s\"}]}}"
+/* Format of batch payload, devices of GATEWAY_PAYLOAD_DEVICE_FMT are joined by comma */
+#define GATEWAY_PAYLOAD_BATCH_HEAD_FMT "{\"type\":\"%s\",\"payload\":{\"devices\":["
+#define GATEWAY_PAYLOAD_DEVICE_FMT     "{\"product_id\":\"%s\",\"device_name\":\"%s\"}"
+#define GATEWAY_PAYLOAD_BATCH_TAIL     "]}}"
+
+/* Room for ",\"result\":<int>" added to each device in reply, so the reply fits receive buffer */
+#define GATEWAY_REPLY_RESULT_LEN 24
 
 /* Subdevice    seesion status */
 typedef enum _SubdevSessionStatus {
@@ -62,29 +73,67 @@ typedef struct _SubdevSession {
     char                   product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
     char                   device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
     SubdevSessionStatus    session_status;
-    struct _SubdevSession *next;
+    uint32_t               hash;        // hash of product_id and device_name
+    uint16_t               generation;  // changed when session is removed, so stale handle is rejected
+    uint8_t                used;
+    struct _SubdevSession *next;  // next free session
 } SubdevSession;
 
-/* The structure of common reply data */
-typedef struct _ReplyData {
-    int32_t result;
-    char    client_id[MAX_SIZE_OF_CLIENT_ID + 1];
-} ReplyData;
-
-/* The structure of gateway data */
-typedef struct _GatewayData {
-    int32_t   sync_status;
-    ReplyData online;
-    ReplyData offline;
-} GatewayData;
+/**
+ * sessions of subdevices, preallocated in a slab so handles stay valid, and
+ * indexed by an open-addressed hash of product_id and device_name
+ */
+typedef struct {
+    SubdevSession *slab;       // max_count sessions
+    uint16_t *     slots;      // index of session in slab plus 1, 0 for empty slot
+    SubdevSession *free_list;  // unused sessions of slab
+    uint16_t       mask;       // number of slots - 1
+    uint16_t       max_count;  // max number of sessions
+    uint16_t       count;      // number of sessions
+} SubdevSessionTable;
+
+/* subscribe/unsubscribe of gateway topic waiting for ack */
+typedef struct _GatewaySync {
+    uint16_t packet_id;     // 0 until sent
+    uint16_t early_id;      // last ack received before packet_id is known
+    int      early_result;  // result of early_id
+    int      done;
+    int      result;        // QCLOUD_RET_SUCCESS if acked
+    void *   sem;           // posted on ack when caller waits for yield thread
+} GatewaySync;
+
+/* online/offline operation of one sub-device, waiting for reply in operation table */
+typedef struct _GatewayOp {
+    struct _GatewayBatch *batch;
+    uint32_t              key;      // key in operation table, hash of type and client_id
+    uint8_t               pending;  // in operation table
+} GatewayOp;
+
+/* The structure of batch online/offline in progress */
+typedef struct _GatewayBatch {
+    const char *          type;  // "online" or "offline"
+    GatewaySubdevStatus * subdevs;
+    GatewayOp *           ops;  // operation of each sub-device
+    int                   subdev_num;
+    int                   left;  // pending operations, plus one while the batch is being sent
+    int                   done;
+    Timer                 timer;
+    GatewayBatchCallback  callback;
+    void *                user_data;
+    void *                sem;   // posted on completion when caller waits for yield thread
+    struct _GatewayBatch *next;  // next batch to notify
+} GatewayBatch;
 
 /* The structure of gateway context */
 typedef struct _Gateway {
-    void *           mqtt;
-    SubdevSession *  session_list;
-    GatewayData      gateway_data;
-    MQTTEventHandler event_handle;
-    int              is_construct;
+    void *                   mqtt;
+    SubdevSessionTable       sessions;
+    GatewaySync *            sync;  // subscribe/unsubscribe waiting for ack, NULL if none
+    MQTTEventHandler         event_handle;
+    int                      is_construct;
+    ReplyTable               ops;        // online/offline operations waiting for reply
+    void *                   lock;       // lock of ops and sessions
+    struct _GatewayTemplate *templates;  // data template of sub-devices, NULL if not created
 
 #ifdef MULTITHREAD_ENABLED
     bool yield_thread_running;
@@ -92,17 +141,41 @@ typedef struct _Gateway {
 #endif
 } Gateway;
 
+/* session table is changed by yield, functions on sessions below are called with gateway->lock held */
+int subdev_session_init(Gateway *gateway, uint16_t max_count);
+
+void subdev_session_deinit(Gateway *gateway);
+
 SubdevSession *subdev_add_session(Gateway *gateway, char *product_id, char *device_name);
 
 SubdevSession *subdev_find_session(Gateway *gateway, char *product_id, char *device_name);
 
 int subdev_remove_session(Gateway *gateway, char *product_id, char *device_name);
 
+void *subdev_session_handle(Gateway *gateway, SubdevSession *session);
+
+SubdevSession *subdev_handle_session(Gateway *gateway, void *handle);
+
+/* takes gateway->lock */
+bool subdev_session_is_online(Gateway *gateway, const char *product_id, const char *device_name);
+
+uint32_t subdev_client_id_hash(const char *product_id, const char *device_name);
+
 int gateway_subscribe_unsubscribe_topic(Gateway *gateway, char *topic_filter, SubscribeParams *params,
                                         int is_subscribe);
 
+bool gateway_sync_ack(Gateway *gateway, uint16_t packet_id, int result);
+
 int gateway_subscribe_unsubscribe_default(Gateway *gateway, GatewayParam *param);
 
-int gateway_publish_sync(Gateway *gateway, char *topic, PublishParams *params, int32_t *result);
+int gateway_batch_init(Gateway *gateway, uint16_t max_count);
+
+void gateway_batch_deinit(Gateway *gateway);
+
+int gateway_batch_run(Gateway *gateway, GatewayBatchParam *param, const char *type);
+
+void gateway_batch_check_timeout(Gateway *gateway);
+
+void gateway_template_check_timeout(Gateway *gateway);
 
 #endif /* IOT_GATEWAY_COMMON_H_ */
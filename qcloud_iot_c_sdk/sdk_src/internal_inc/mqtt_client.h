@@ -37,6 +37,7 @@ extern "C" {
 #include "utils_list.h"
 #include "utils_param_check.h"
 #include "utils_timer.h"
+#include "utils_timer_wheel.h"
 
 /* packet id, random from [1 - 65536] */
 #define MAX_PACKET_ID (65535)
@@ -67,6 +68,11 @@ extern "C" {
 
 #define MQTT_RMDUP_MSG_ENABLED
 
+/* events of MQTT client timers, set when timer fires and handled by yield */
+#define MQTT_TIMER_EVENT_PING    0x01  // keep alive interval passed
+#define MQTT_TIMER_EVENT_PUB_ACK 0x02  // some publish waits ACK timeout
+#define MQTT_TIMER_EVENT_SUB_ACK 0x04  // some subscribe(unsubscribe) waits ACK timeout
+
 /**
  * @brief MQTT Message Type
  */
@@ -210,6 +216,7 @@ typedef struct Client {
 
     void *lock_list_pub;  // mutex/lock for puback waiting list
     void *lock_list_sub;  // mutex/lock for suback waiting list
+    void *lock_timer;     // mutex/lock for timer wheel and timer events
 
     List *list_pub_wait_ack;  // puback waiting list
     List *list_sub_wait_ack;  // suback waiting list
@@ -220,8 +227,10 @@ typedef struct Client {
 
     Network network_stack;  // MQTT network stack
 
-    Timer ping_timer;             // MQTT ping timer
-    Timer reconnect_delay_timer;  // MQTT reconnect delay timer
+    TimerWheel timer_wheel;            // timers of keep alive, reconnect and ACK waiting
+    WheelTimer ping_timer;             // MQTT ping timer
+    WheelTimer reconnect_delay_timer;  // MQTT reconnect delay timer
+    uint8_t    timer_events;           // MQTT_TIMER_EVENT_XXX of fired timers
 
     SubTopicHandle sub_handles[MAX_MESSAGE_HANDLERS];  // subscription handle array
 
@@ -257,7 +266,7 @@ typedef enum MQTT_NODE_STATE {
 
 /* topic publish info */
 typedef struct REPUBLISH_INFO {
-    Timer          pub_start_time; /* timer for puback waiting */
+    WheelTimer     ack_timer;      /* timer for puback waiting */
     MQTTNodeState  node_state;     /* node state in wait list */
     uint16_t       msg_id;         /* packet id */
     uint32_t       len;            /* msg length */
@@ -268,7 +277,7 @@ typedef struct REPUBLISH_INFO {
 typedef struct SUBSCRIBE_INFO {
     enum msgTypes  type;           /* type: sub or unsub */
     uint16_t       msg_id;         /* packet id */
-    Timer          sub_start_time; /* timer for suback waiting */
+    WheelTimer     ack_timer;      /* timer for suback waiting */
     MQTTNodeState  node_state;     /* node state in wait list */
     SubTopicHandle handler;        /* handle of topic subscribed(unsubcribed) */
     uint16_t       len;            /* msg length */
@@ -500,8 +509,8 @@ void set_client_conn_state(Qcloud_IoT_Client *pClient, uint8_t connected);
 uint8_t get_client_conn_state(Qcloud_IoT_Client *pClient);
 
 /**
- * @brief Check Publish ACK waiting list, remove the node if PUBACK received or
- * timeout
+ * @brief Check Publish ACK waiting list, remove the node if timeout. Called when
+ * MQTT_TIMER_EVENT_PUB_ACK is set, as node is removed at once when PUBACK received
  *
  * @param pClient MQTT client
  * @return QCLOUD_RET_SUCCESS for success, or err code for failure
@@ -509,14 +518,73 @@ uint8_t get_client_conn_state(Qcloud_IoT_Client *pClient);
 int qcloud_iot_mqtt_pub_info_proc(Qcloud_IoT_Client *pClient);
 
 /**
- * @brief Check Subscribe ACK waiting list, remove the node if SUBACK received
- * or timeout
+ * @brief Check Subscribe ACK waiting list, remove the node if timeout. Called when
+ * MQTT_TIMER_EVENT_SUB_ACK is set, as node is removed at once when SUBACK received
  *
  * @param pClient MQTT client
  * @return QCLOUD_RET_SUCCESS for success, or err code for failure
  */
 int qcloud_iot_mqtt_sub_info_proc(Qcloud_IoT_Client *pClient);
 
+/**
+ * @brief Init timer wheel and timers of MQTT client
+ *
+ * @param pClient       MQTT Client
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_timer_init(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Release resources of timer wheel
+ *
+ * @param pClient       MQTT Client
+ */
+void qcloud_iot_mqtt_timer_deinit(Qcloud_IoT_Client *pClient);
+
+/**
+ * @brief Init ACK waiting timer of wait list node, which sets MQTT_TIMER_EVENT_PUB_ACK
+ * or MQTT_TIMER_EVENT_SUB_ACK when fired
+ *
+ * @param pClient       MQTT Client
+ * @param timer         timer in wait list node
+ * @param type          PUBLISH, SUBSCRIBE or UNSUBSCRIBE
+ */
+void qcloud_iot_mqtt_ack_timer_init(Qcloud_IoT_Client *pClient, WheelTimer *timer, MessageTypes type);
+
+/**
+ * @brief Start timer of MQTT client, a pending timer is restarted
+ *
+ * @param pClient       MQTT Client
+ * @param timer         timer in MQTT Client or wait list node
+ * @param timeout_ms    timeout value (unit: ms)
+ */
+void qcloud_iot_mqtt_timer_start(Qcloud_IoT_Client *pClient, WheelTimer *timer, uint32_t timeout_ms);
+
+/**
+ * @brief Stop timer of MQTT client, should be called before the node of timer is freed
+ *
+ * @param pClient       MQTT Client
+ * @param timer         timer in MQTT Client or wait list node
+ */
+void qcloud_iot_mqtt_timer_stop(Qcloud_IoT_Client *pClient, WheelTimer *timer);
+
+/**
+ * @brief Fire the expired timers of MQTT client, then take the events
+ *
+ * @param pClient       MQTT Client
+ * @param events        MQTT_TIMER_EVENT_XXX to take, the others are kept
+ * @return              events taken
+ */
+uint8_t qcloud_iot_mqtt_timer_run(Qcloud_IoT_Client *pClient, uint8_t events);
+
+/**
+ * @brief Time to the next timer of MQTT client may fire
+ *
+ * @param pClient       MQTT Client
+ * @return              time in millisecond, UINT32_MAX if no timer is pending
+ */
+uint32_t qcloud_iot_mqtt_timer_next_ms(Qcloud_IoT_Client *pClient);
+
 int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, MessageTypes type, SubTopicHandle *handler,
                      ListNode **node);
 
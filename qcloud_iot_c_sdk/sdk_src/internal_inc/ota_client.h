@@ -37,6 +37,21 @@ extern "C" {
 #define FILESIZE_FIELD "file_size"
 #define RESULT_FIELD   "result_code"
 
+/* optional fields of compressed firmware */
+#define COMPRESS_FIELD       "compress"
+#define RAW_MD5_FIELD        "raw_md5sum"
+#define RAW_FILESIZE_FIELD   "raw_file_size"
+#define WINDOW_BITS_FIELD    "window_bits"
+#define LOOKAHEAD_BITS_FIELD "lookahead_bits"
+
+/* optional fields of delta firmware */
+#define DELTA_FIELD          "delta"
+#define SOURCE_VERSION_FIELD "source_version"
+
+/* optional fields of firmware verification */
+#define SHA256_FIELD    "sha256"
+#define SIGNATURE_FIELD "signature"
+
 #define REPORT_VERSION_RSP "report_version_rsp"
 #define UPDATE_FIRMWARE    "update_firmware"
 
@@ -30,6 +30,19 @@ extern "C" {
 
 #include "qcloud_iot_export_ota.h"
 
+/* compress, delta and verify info of firmware, raw_* describe the image after decompressing and patching */
+typedef struct {
+    IOT_OTA_CompressType type;
+    uint32_t             raw_size;                             /* size of decompressed firmware, 0 if unknown */
+    char                 raw_md5sum[33];                       /* MD5 of decompressed firmware, empty if unknown */
+    uint8_t              window_bits;                          /* log2 of window size, 0 for default */
+    uint8_t              lookahead_bits;                       /* heatshrink only, 0 for default */
+    IOT_OTA_DeltaType    delta;                                /* IOT_OTAD_NONE for full image */
+    char                 source_version[33];                   /* version the delta applies to, empty if not given */
+    char                 sha256sum[65];                        /* SHA-256 of downloaded file, empty if not given */
+    char                 signature[OTA_SIGNATURE_LEN_MAX + 1]; /* signature over sha256, empty if not given */
+} OTACompressInfo;
+
 void *qcloud_otalib_md5_init(void);
 
 void qcloud_otalib_md5_update(void *md5, const char *buf, size_t buf_len);
@@ -51,9 +64,11 @@ int qcloud_otalib_get_report_version_result(const char *json);
  * @param version       parsed version
  * @param md5           parsed MD5
  * @param fileSize      parsed file size
+ * @param compress      parsed compress, delta and verify info, type is IOT_OTAC_NONE if not compressed
  * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
  */
-int qcloud_otalib_get_params(const char *json, char **type, char **url, char **version, char *md5, uint32_t *fileSize);
+int qcloud_otalib_get_params(const char *json, char **type, char **url, char **version, char *md5, uint32_t *fileSize,
+                             OTACompressInfo *compress);
 
 /**
  * @brief Generate firmware info from id and version
@@ -0,0 +1,138 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef QCLOUD_IOT_UTILS_CBOR_H_
+#define QCLOUD_IOT_UTILS_CBOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+/**
+ * @brief CBOR output of writer functions, errors are reported once by utils_cbor_writer_result
+ */
+typedef struct {
+    uint8_t *buf;   // NULL to calculate length only
+    size_t   size;  // size of buf
+    size_t   len;   // length of encoded data, may exceed size, which means buffer too small
+} CborWriter;
+
+/**
+ * @brief encode a JSON document into CBOR(RFC 7049)
+ *
+ * Objects and arrays become definite-length maps and arrays, integers become
+ * major type 0/1, other numbers become float32 when exact or float64.
+ *
+ * @param json      JSON document
+ * @param json_len  length of JSON document
+ * @param cbor      output buffer, NULL to only calculate the encoded length
+ * @param cbor_size size of output buffer
+ * @param olen      length of the encoded data
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int utils_json_to_cbor(const char *json, size_t json_len, uint8_t *cbor, size_t cbor_size, size_t *olen);
+
+/**
+ * @brief decode a CBOR data item into JSON text, terminated by '\0'
+ *
+ * @param cbor      CBOR data
+ * @param cbor_len  length of CBOR data
+ * @param json      output buffer
+ * @param json_size size of output buffer
+ * @param olen      length of the JSON text, '\0' excluded
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int utils_cbor_to_json(const uint8_t *cbor, size_t cbor_len, char *json, size_t json_size, size_t *olen);
+
+/**
+ * @brief init CBOR writer
+ *
+ * @param writer    CBOR writer
+ * @param buf       output buffer, NULL to only calculate the encoded length
+ * @param size      size of output buffer
+ */
+void utils_cbor_writer_init(CborWriter *writer, uint8_t *buf, size_t size);
+
+/**
+ * @brief put head of a map with count key/value pairs, which should be put next
+ */
+void utils_cbor_put_map(CborWriter *writer, size_t count);
+
+/**
+ * @brief put head of an array with count items, which should be put next
+ */
+void utils_cbor_put_array(CborWriter *writer, size_t count);
+
+/**
+ * @brief put a text string terminated by '\0'
+ */
+void utils_cbor_put_text(CborWriter *writer, const char *text);
+
+/**
+ * @brief put an integer as major type 0/1
+ */
+void utils_cbor_put_int(CborWriter *writer, int64_t value);
+
+/**
+ * @brief put a number as float32 when exact, or float64
+ */
+void utils_cbor_put_float(CborWriter *writer, double value);
+
+/**
+ * @brief put true or false
+ */
+void utils_cbor_put_bool(CborWriter *writer, bool value);
+
+/**
+ * @brief put null
+ */
+void utils_cbor_put_null(CborWriter *writer);
+
+/**
+ * @brief put a JSON value, encoded as utils_json_to_cbor does
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_JSON_PARSE for invalid JSON
+ */
+int utils_cbor_put_json(CborWriter *writer, const char *json, size_t json_len);
+
+/**
+ * @brief check if everything put fits in the output buffer
+ *
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_JSON_BUFFER_TOO_SMALL
+ */
+int utils_cbor_writer_result(CborWriter *writer);
+
+/**
+ * @brief check if payload starts with a CBOR map, which never starts a JSON text
+ */
+#define utils_is_cbor_map(payload, len) ((len) > 0 && (((const uint8_t *)(payload))[0] & 0xE0) == 0xA0)
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_CBOR_H_ */
@@ -0,0 +1,59 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_UTILS_COMPRESS_H_
+#define QCLOUD_IOT_UTILS_COMPRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+#define COMPRESS_HASH_BITS 10
+
+/* size of work memory for match finding, provided by caller so that it can be allocated once */
+#define COMPRESS_WORK_SIZE (sizeof(uint16_t) << COMPRESS_HASH_BITS)
+
+/* max input length, as positions are kept in 16 bits in work memory */
+#define COMPRESS_MAX_INPUT_LEN 0xFFFF
+
+/**
+ * @brief compress a buffer into a zlib stream(RFC 1950) of one deflate block with fixed Huffman codes.
+ *        Matches are found by single probe hashing over the input itself, so no window is copied.
+ *        Good for text like logs, and cheap in memory and CPU rather than best in ratio.
+ *
+ * @param in       input data, no longer than COMPRESS_MAX_INPUT_LEN
+ * @param in_len   length of input
+ * @param out      output buffer
+ * @param out_size size of output buffer
+ * @param work     work memory of COMPRESS_WORK_SIZE
+ * @return length of compressed stream, or QCLOUD_ERR_BUF_TOO_SHORT if it does not fit in out buffer,
+ *         in which case the input may be sent uncompressed
+ */
+int utils_compress_zlib(const char *in, uint32_t in_len, char *out, uint32_t out_size, void *work);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_COMPRESS_H_ */
@@ -0,0 +1,100 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef QCLOUD_IOT_UTILS_DECOMPRESS_H_
+#define QCLOUD_IOT_UTILS_DECOMPRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+/* compressed stream formats */
+typedef enum {
+    DECOMPRESS_DEFLATE = 0, /* raw deflate stream(RFC 1951) */
+    DECOMPRESS_ZLIB,        /* zlib wrapped deflate with Adler-32(RFC 1950) */
+    DECOMPRESS_GZIP,        /* gzip wrapped deflate with CRC-32 and size(RFC 1952) */
+    DECOMPRESS_HEATSHRINK,  /* heatshrink LZSS with small window, no check value */
+} eDecompressFormat;
+
+#define DECOMPRESS_WINDOW_BITS_MIN 4
+#define DECOMPRESS_WINDOW_BITS_MAX 15
+
+/**
+ * @brief output of decompressed data, called when the window is full or the input is consumed
+ *
+ * @param user_data user data
+ * @param offset    offset of data in decompressed stream
+ * @param buf       decompressed data
+ * @param len       length of data
+ * @return QCLOUD_RET_SUCCESS for success, or err code to abort decompression
+ */
+typedef int (*DecompressOutputCallback)(void *user_data, uint32_t offset, const char *buf, uint32_t len);
+
+/**
+ * @brief create a streaming decompressor, memory used is about (1 << window_bits) + 2KB
+ *
+ * @param format         stream format
+ * @param window_bits    log2 of window size, deflate streams must not refer further than it
+ * @param lookahead_bits heatshrink only, log2 of max back reference length
+ * @param output         output callback
+ * @param user_data      user data of output callback
+ * @return handle of decompressor, or NULL for failure
+ */
+void *utils_decompress_init(eDecompressFormat format, uint8_t window_bits, uint8_t lookahead_bits,
+                            DecompressOutputCallback output, void *user_data);
+
+/**
+ * @brief feed a piece of compressed stream, the decompressed data is sent to output callback
+ *
+ * @param handle handle of decompressor
+ * @param in     compressed data
+ * @param len    length of data
+ * @return QCLOUD_RET_SUCCESS for success, or err code for corrupted stream or output failure
+ */
+int utils_decompress_feed(void *handle, const char *in, uint32_t len);
+
+/**
+ * @brief check the stream is complete and its check value matches
+ *
+ * @param handle handle of decompressor
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_FAILURE otherwise
+ */
+int utils_decompress_finish(void *handle);
+
+/**
+ * @brief get size of decompressed data
+ */
+uint32_t utils_decompress_total_out(void *handle);
+
+/**
+ * @brief destroy the decompressor
+ */
+void utils_decompress_deinit(void *handle);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_DECOMPRESS_H_ */
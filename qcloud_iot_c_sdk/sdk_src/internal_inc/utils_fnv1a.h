@@ -0,0 +1,46 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_UTILS_FNV1A_H_
+#define QCLOUD_IOT_UTILS_FNV1A_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UTILS_FNV1A_INIT 2166136261UL  // FNV-1a offset basis of 32 bits
+
+/**
+ * @brief continue 32-bit FNV-1a hash over data
+ *
+ * @param hash  UTILS_FNV1A_INIT to start, or hash of the data before
+ * @param data  data to hash
+ * @param len   length of data
+ * @return      hash of data appended
+ */
+uint32_t utils_fnv1a(uint32_t hash, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_FNV1A_H_ */
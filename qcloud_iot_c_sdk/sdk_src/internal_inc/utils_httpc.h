@@ -32,8 +32,30 @@ extern "C" {
 #define HTTP_PORT  80
 #define HTTPS_PORT 443
 
+#define HTTP_CLIENT_MAX_HOST_LEN 64
+
 typedef enum { HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_DELETE, HTTP_HEAD } HttpMethod;
 
+#define HTTP_CLIENT_RX_BUF_SIZE 512 /* buffer of status, header and chunk size lines */
+#define HTTP_CLIENT_LINE_SIZE   96  /* head of each header line kept for parsing */
+
+/* incremental response parser, body bytes are read into response_buf directly */
+typedef struct {
+    uint8_t  state;
+    uint8_t  is_head;      // response of HEAD request has no body
+    uint8_t  has_length;   // Content-Length is given
+    uint8_t  cr_seen;      // CR before LF of chunk data end
+    uint8_t  closed;       // connection closed by server
+    uint8_t  digits;       // hex digits of chunk size
+    uint8_t  close_after;  // server closes connection after the response, by HTTP/1.0 or "Connection: close"
+    uint16_t line_len;     // length of line kept
+    uint32_t body_left;    // left of Content-Length or current chunk
+    uint16_t rx_pos;       // read position of rx_buf
+    uint16_t rx_len;       // valid length of rx_buf
+    char     line[HTTP_CLIENT_LINE_SIZE];
+    char     rx_buf[HTTP_CLIENT_RX_BUF_SIZE];
+} HTTPResponseParser;
+
 typedef struct {
     int     remote_port;
     int     response_code;
@@ -41,6 +63,9 @@ typedef struct {
     char *  auth_user;
     char *  auth_password;
     Network network_stack;
+    char    host[HTTP_CLIENT_MAX_HOST_LEN];  // host connected, network_stack.host points to it
+
+    HTTPResponseParser *parser;  // allocated by qcloud_http_client_common, freed by qcloud_http_client_release
 } HTTPClient;
 
 typedef struct {
@@ -56,7 +81,7 @@ typedef struct {
 } HTTPClientData;
 
 /**
- * @brief do one http request
+ * @brief do one http request, client is released by qcloud_http_client_release after success
  *
  * @param client        http client
  * @param url           server url
@@ -69,12 +94,36 @@ typedef struct {
 int qcloud_http_client_common(HTTPClient *client, const char *url, int port, const char *ca_crt, HttpMethod method,
                               HTTPClientData *client_data);
 
+/**
+ * @brief receive response body into client_data->response_buf, which is null-terminated
+ *
+ * @param client        http client
+ * @param timeout_ms    timeout
+ * @param client_data   http data, is_more is false when the whole body is received
+ * @return              QCLOUD_RET_SUCCESS when the buffer is full, the body ends or some data
+ *                      is received before timeout, or err code for failure
+ */
 int qcloud_http_recv_data(HTTPClient *client, uint32_t timeout_ms, HTTPClientData *client_data);
 
 int qcloud_http_client_connect(HTTPClient *client, const char *url, int port, const char *ca_crt);
 
 void qcloud_http_client_close(HTTPClient *client);
 
+/**
+ * @brief release connection and response parser after the request is done. If the response is read up and server keeps
+ *        the connection alive, it is cached for next request to the same host, port and ca,
+ *        which saves DNS lookup, TCP and TLS handshake. Otherwise the connection is closed.
+ *
+ * @param client        http client
+ * @param client_data   http data of the last request
+ */
+void qcloud_http_client_release(HTTPClient *client, HTTPClientData *client_data);
+
+/**
+ * @brief close all idle connections cached
+ */
+void qcloud_http_conn_cache_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,117 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef QCLOUD_IOT_UTILS_PATCH_H_
+#define QCLOUD_IOT_UTILS_PATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+/*
+ * QDIFF patch format, bsdiff style control/diff/extra records interleaved so
+ * it can be applied in one pass, all integers are little endian:
+ *
+ *   header:  "QDF1" | uint32 target_size | uint32 source_size
+ *   record:  uint32 diff_len | uint32 extra_len | int32 seek
+ *            diff_len bytes, each added(mod 256) to source byte at source position
+ *            extra_len bytes, copied as they are
+ *
+ * Records repeat until target_size bytes are produced. Source position starts
+ * from 0, advances by diff_len after the diff bytes and then by seek.
+ * The diff bytes are mostly zero, so the patch is usually compressed.
+ */
+#define PATCH_MAGIC       "QDF1"
+#define PATCH_HEADER_LEN  12
+#define PATCH_RECORD_LEN  12
+#define PATCH_SOURCE_READ 512 /* max length of each source read */
+
+/**
+ * @brief read data of source(old) image
+ *
+ * @param user_data user data
+ * @param offset    offset in source image
+ * @param buf       buffer to read into
+ * @param len       length to read
+ * @return QCLOUD_RET_SUCCESS for success, or err code to abort patching
+ */
+typedef int (*PatchSourceReadCallback)(void *user_data, uint32_t offset, char *buf, uint32_t len);
+
+/**
+ * @brief output of target(new) image
+ *
+ * @param user_data user data
+ * @param offset    offset of data in target image
+ * @param buf       target data
+ * @param len       length of data
+ * @return QCLOUD_RET_SUCCESS for success, or err code to abort patching
+ */
+typedef int (*PatchOutputCallback)(void *user_data, uint32_t offset, const char *buf, uint32_t len);
+
+/**
+ * @brief create a streaming patcher, memory used is about PATCH_SOURCE_READ + 64 bytes
+ *
+ * @param source_size size of source readable, patch referring beyond it is rejected
+ * @param read        source read callback
+ * @param output      output callback
+ * @param user_data   user data of callbacks
+ * @return handle of patcher, or NULL for failure
+ */
+void *utils_patch_init(uint32_t source_size, PatchSourceReadCallback read, PatchOutputCallback output,
+                       void *user_data);
+
+/**
+ * @brief feed a piece of patch, the target data is sent to output callback
+ *
+ * @param handle handle of patcher
+ * @param in     patch data
+ * @param len    length of data
+ * @return QCLOUD_RET_SUCCESS for success, or err code for corrupted patch or callback failure
+ */
+int utils_patch_feed(void *handle, const char *in, uint32_t len);
+
+/**
+ * @brief check the patch is complete
+ *
+ * @param handle handle of patcher
+ * @return QCLOUD_RET_SUCCESS for success, or QCLOUD_ERR_FAILURE otherwise
+ */
+int utils_patch_finish(void *handle);
+
+/**
+ * @brief get size of target data produced
+ */
+uint32_t utils_patch_total_out(void *handle);
+
+/**
+ * @brief destroy the patcher
+ */
+void utils_patch_deinit(void *handle);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_PATCH_H_ */
@@ -0,0 +1,112 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef QCLOUD_IOT_UTILS_REPLY_TABLE_H_
+#define QCLOUD_IOT_UTILS_REPLY_TABLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+typedef struct {
+    uint32_t key;       // numeric client token
+    uint16_t heap_pos;  // position in the deadline heap
+    void *   data;      // pending request, NULL for empty slot
+    Timer    timer;     // reply deadline
+} ReplyTableSlot;
+
+/**
+ * @brief table of requests wait for reply, an open-addressed hash keyed by the
+ * numeric client token together with a binary heap ordered by deadline.
+ * Not thread safe, caller should hold the lock of the owner.
+ */
+typedef struct {
+    ReplyTableSlot *slots;
+    uint16_t *      heap;       // slot index, root has the earliest deadline
+    uint16_t        mask;       // number of slots - 1
+    uint16_t        max_count;  // max number of requests
+    uint16_t        count;      // number of requests
+} ReplyTable;
+
+/**
+ * @brief init reply table
+ *
+ * @param table     reply table
+ * @param max_count max number of requests wait for reply at the same time
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int reply_table_init(ReplyTable *table, uint16_t max_count);
+
+/**
+ * @brief release memory of reply table, data of the requests is not freed
+ */
+void reply_table_deinit(ReplyTable *table);
+
+/**
+ * @brief add request to reply table
+ *
+ * @param table      reply table
+ * @param key        numeric client token of request
+ * @param data       request
+ * @param timeout_ms timeout of reply
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int reply_table_add(ReplyTable *table, uint32_t key, void *data, uint32_t timeout_ms);
+
+/**
+ * @brief find request by key
+ *
+ * @return request, NULL if not found
+ */
+void *reply_table_find(ReplyTable *table, uint32_t key);
+
+/**
+ * @brief remove request by key
+ *
+ * @return request removed, NULL if not found
+ */
+void *reply_table_remove(ReplyTable *table, uint32_t key);
+
+/**
+ * @brief remove the request with the earliest deadline if it is expired
+ *
+ * @return request expired, NULL if none
+ */
+void *reply_table_pop_expired(ReplyTable *table);
+
+/**
+ * @brief remove any request, used to drain the table
+ *
+ * @return request removed, NULL if the table is empty
+ */
+void *reply_table_pop(ReplyTable *table);
+
+#define reply_table_count(table) ((table)->count)
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_REPLY_TABLE_H_ */
@@ -0,0 +1,119 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef QCLOUD_IOT_UTILS_TIMER_WHEEL_H_
+#define QCLOUD_IOT_UTILS_TIMER_WHEEL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "qcloud_iot_import.h"
+
+/* 4 levels of 64 slots in millisecond tick, cover 4.6 hours, longer timeouts are relinked on cascade */
+#define TIMER_WHEEL_LEVELS    4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS     (1 << TIMER_WHEEL_SLOT_BITS)
+
+typedef void (*WheelTimerHandler)(void *user_data);
+
+/**
+ * @brief timer registered with timer wheel, embedded in the owner object
+ */
+typedef struct WheelTimer {
+    struct WheelTimer * next;
+    struct WheelTimer **pprev;      // link to this timer, NULL if not pending
+    uint64_t            expire;     // HAL_GetTimeMs64() when the timer fires
+    WheelTimerHandler   handler;    // called by timer_wheel_run when fired, can be NULL
+    void *              user_data;  // argument of handler
+} WheelTimer;
+
+/**
+ * @brief hierarchical timer wheel, add/del in O(1) and run only visits the
+ * slots which are due. Not thread safe, caller should hold the lock of the owner.
+ */
+typedef struct {
+    uint64_t    now;                                           // next tick to run
+    uint64_t    bitmap[TIMER_WHEEL_LEVELS];                    // slots may be not empty
+    WheelTimer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // timers linked by slot
+    uint16_t    count;                                         // number of pending timers
+} TimerWheel;
+
+/**
+ * @brief init timer wheel
+ *
+ * @param wheel timer wheel
+ */
+void timer_wheel_init(TimerWheel *wheel);
+
+/**
+ * @brief init timer, should be called once before the timer is added
+ *
+ * @param timer     timer
+ * @param handler   called when timer fires
+ * @param user_data argument of handler
+ */
+void wheel_timer_init(WheelTimer *timer, WheelTimerHandler handler, void *user_data);
+
+/**
+ * @brief start timer, a pending timer is restarted
+ *
+ * @param wheel      timer wheel
+ * @param timer      timer
+ * @param timeout_ms time from now to fire
+ */
+void timer_wheel_add(TimerWheel *wheel, WheelTimer *timer, uint32_t timeout_ms);
+
+/**
+ * @brief stop timer, nothing done if the timer is not pending
+ *
+ * @param wheel timer wheel
+ * @param timer timer
+ */
+void timer_wheel_del(TimerWheel *wheel, WheelTimer *timer);
+
+/**
+ * @brief fire the timers expired, handlers are called in order of expiration
+ *
+ * @param wheel timer wheel
+ * @return number of timers fired
+ */
+int timer_wheel_run(TimerWheel *wheel);
+
+/**
+ * @brief time to the next run which may fire timers, to sleep until then
+ *
+ * @param wheel timer wheel
+ * @return time in millisecond, 0 if due, UINT32_MAX if no timer is pending
+ */
+uint32_t timer_wheel_next_ms(TimerWheel *wheel);
+
+#define wheel_timer_pending(timer) (NULL != (timer)->pprev)
+
+#define timer_wheel_count(wheel) ((wheel)->count)
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* QCLOUD_IOT_UTILS_TIMER_WHEEL_H_ */
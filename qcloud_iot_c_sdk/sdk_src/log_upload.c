@@ -0,0 +1,732 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+
+#ifdef LOG_UPLOAD
+
+#include <string.h>
+
+#include "lite-utils.h"
+#include "log_upload.h"
+#include "mqtt_client.h"
+#include "qcloud_iot_ca.h"
+#include "qcloud_iot_common.h"
+#include "utils_compress.h"
+#include "utils_hmac.h"
+#include "utils_httpc.h"
+#include "utils_param_check.h"
+#include "utils_timer.h"
+
+/*
+ * Logs are appended to a fixed ring by the generating thread, which costs one copy under lock.
+ * do_log_upload takes whole lines from the ring and posts them in batches of MAX_HTTP_LOG_POST_SIZE.
+ * When the server is unreachable, the ring is saved to flash, and saved logs are read back in
+ * batches and posted first when the server is back. Body of one post:
+ *   <signature>;<timestamp>;<product id>;<device name>\n<log lines>
+ * signature is HMAC-SHA1 in hex with sign key over the rest of body, which is compressed as a
+ * zlib stream with "Content-Encoding: deflate" if enabled.
+ */
+#define LOG_SIGN_KEY_SIZE  24
+#define LOG_SIGNATURE_SIZE 40
+
+/* upload before the interval expires when the ring is filled above this */
+#define LOG_UPLOAD_WATERMARK (LOG_UPLOAD_BUFFER_SIZE * 3 / 4)
+
+/* interval of retry doubles after each failure, up to this times of LOG_UPLOAD_INTERVAL_MS */
+#define LOG_UPLOAD_BACKOFF_MAX 32
+
+#define LOG_UPLOAD_URL_FORMAT      "http://%s/cgi-bin/report-log"
+#define LOG_UPLOAD_URL_LEN         (HTTP_CLIENT_MAX_HOST_LEN + 32)
+#define LOG_UPLOAD_RESP_BUF_LEN    64
+#define LOG_UPLOAD_RESP_TIMEOUT_MS 5000
+#define LOG_UPLOAD_DROP_MSG_LEN    64
+
+#define LOG_UPLOAD_HTTP_HEADER         "Accept: application/json;*/*\r\n"
+#define LOG_UPLOAD_HTTP_HEADER_DEFLATE "Accept: application/json;*/*\r\nContent-Encoding: deflate\r\n"
+#define LOG_UPLOAD_CONTENT_TYPE        "text/plain;charset=utf-8"
+
+/* topics and payload of upload log level from IoT Hub */
+#define LOG_TOPIC_OPERATION    "$log/operation/%s/%s"
+#define LOG_TOPIC_RESULT       "$log/operation/result/%s/%s"
+#define LOG_MQTT_PAYLOAD_LEN   128
+#define LOG_TYPE_GET_LOG_LEVEL "get_log_level"
+
+typedef struct {
+    /* ring of log lines, appended by log generating threads under sg_log_lock */
+    char *   ring;
+    uint32_t read_pos;
+    uint32_t used;
+    uint32_t dropped;         // logs dropped as the ring is full
+    bool     upload_request;  // ring is filled above watermark
+    bool     uploading;
+    uint32_t refs;            // one of sg_log_uploader, and one of each user out of sg_log_lock
+    size_t   saved_posted;    // saved logs already posted, deleted when all are posted
+
+    /* post body and its compressed form */
+    char *post_buf;
+    char *zip_buf;
+    void *zip_work;
+
+    char url[LOG_UPLOAD_URL_LEN];
+    int  port;
+    char product_id[MAX_SIZE_OF_PRODUCT_ID + 1];
+    char device_name[MAX_SIZE_OF_DEVICE_NAME + 1];
+    char sign_key[LOG_SIGN_KEY_SIZE + 1];
+
+    LogSaveFunc    save_func;
+    LogReadFunc    read_func;
+    LogDelFunc     del_func;
+    LogGetSizeFunc get_size_func;
+
+    Timer    upload_timer;
+    uint32_t backoff;  // times of LOG_UPLOAD_INTERVAL_MS before retry, 0 when last upload succeeded
+} LogUploader;
+
+/* created by first init_log_uploader and kept, so that it is valid for users racing with fini */
+static void *       sg_log_lock           = NULL;
+static LogUploader *sg_log_uploader       = NULL;
+static void *       sg_log_mqtt_client    = NULL;
+static bool         sg_log_topic_sub      = false;  // log level topic is subscribed or being subscribed
+static bool         sg_upload_in_comm_err = false;
+static uint32_t     sg_log_client_token   = 0;
+
+static void _log_uploader_free(LogUploader *up)
+{
+    HAL_Free(up->ring);
+    HAL_Free(up->post_buf);
+    HAL_Free(up->zip_buf);
+    HAL_Free(up->zip_work);
+    HAL_Free(up);
+}
+
+/* take a reference of the uploader to use it out of sg_log_lock, NULL if not initialized */
+static LogUploader *_log_uploader_get(void)
+{
+    LogUploader *up;
+
+    if (NULL == sg_log_lock) {
+        return NULL;
+    }
+
+    HAL_MutexLock(sg_log_lock);
+    up = sg_log_uploader;
+    if (up) {
+        up->refs++;
+    }
+    HAL_MutexUnlock(sg_log_lock);
+
+    return up;
+}
+
+/* drop a reference, the last one frees the uploader */
+static void _log_uploader_put(LogUploader *up)
+{
+    bool last;
+
+    HAL_MutexLock(sg_log_lock);
+    last = 0 == --up->refs;
+    HAL_MutexUnlock(sg_log_lock);
+
+    if (last) {
+        _log_uploader_free(up);
+    }
+}
+
+int init_log_uploader(LogUploadInitParams *init_params)
+{
+    POINTER_SANITY_CHECK(init_params, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(init_params->product_id, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(init_params->device_name, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(init_params->sign_key, QCLOUD_ERR_INVAL);
+
+    LogUploader *up;
+    const char * host;
+    bool         has_save = init_params->save_func != NULL;
+
+    if (sg_log_uploader != NULL) {
+        Log_e("log uploader is already initialized");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if (has_save != (init_params->read_func != NULL) || has_save != (init_params->del_func != NULL) ||
+        has_save != (init_params->get_size_func != NULL)) {
+        Log_e("log save/read/del/get_size functions should be all set or none");
+        return QCLOUD_ERR_INVAL;
+    }
+
+    up = (LogUploader *)HAL_Malloc(sizeof(LogUploader));
+    if (NULL == up) {
+        Log_e("malloc log uploader failed");
+        return QCLOUD_ERR_MALLOC;
+    }
+    memset(up, 0, sizeof(LogUploader));
+
+    up->ring     = (char *)HAL_Malloc(LOG_UPLOAD_BUFFER_SIZE);
+    up->post_buf = (char *)HAL_Malloc(MAX_HTTP_LOG_POST_SIZE);
+    if (init_params->compress) {
+        up->zip_buf  = (char *)HAL_Malloc(MAX_HTTP_LOG_POST_SIZE);
+        up->zip_work = HAL_Malloc(COMPRESS_WORK_SIZE);
+    }
+    if (NULL == up->ring || NULL == up->post_buf || (init_params->compress && (!up->zip_buf || !up->zip_work))) {
+        Log_e("malloc log buffer failed");
+        _log_uploader_free(up);
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    if (NULL == sg_log_lock && NULL == (sg_log_lock = HAL_MutexCreate())) {
+        Log_e("create log buffer lock failed");
+        _log_uploader_free(up);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    strncpy(up->product_id, init_params->product_id, MAX_SIZE_OF_PRODUCT_ID);
+    strncpy(up->device_name, init_params->device_name, MAX_SIZE_OF_DEVICE_NAME);
+    strncpy(up->sign_key, init_params->sign_key, LOG_SIGN_KEY_SIZE);
+
+    host = init_params->host ? init_params->host : iot_get_log_domain((char *)init_params->region);
+    HAL_Snprintf(up->url, sizeof(up->url), LOG_UPLOAD_URL_FORMAT, host);
+    up->port = init_params->port ? init_params->port : LOG_UPLOAD_SERVER_PORT;
+
+    up->save_func     = init_params->save_func;
+    up->read_func     = init_params->read_func;
+    up->del_func      = init_params->del_func;
+    up->get_size_func = init_params->get_size_func;
+
+    InitTimer(&up->upload_timer);
+    countdown_ms(&up->upload_timer, LOG_UPLOAD_INTERVAL_MS);
+    up->refs = 1;
+
+    HAL_MutexLock(sg_log_lock);
+    sg_log_uploader = up;
+    HAL_MutexUnlock(sg_log_lock);
+    return QCLOUD_RET_SUCCESS;
+}
+
+void fini_log_uploader(void)
+{
+    LogUploader *up;
+
+    if (NULL == sg_log_lock) {
+        return;
+    }
+
+    // stop appending, the upload in progress frees the uploader when it ends
+    HAL_MutexLock(sg_log_lock);
+    up              = sg_log_uploader;
+    sg_log_uploader = NULL;
+    HAL_MutexUnlock(sg_log_lock);
+
+    if (up) {
+        _log_uploader_put(up);
+    }
+}
+
+bool is_log_uploader_init(void)
+{
+    return sg_log_uploader != NULL;
+}
+
+int append_to_upload_buffer(const char *log_content, size_t log_size)
+{
+    LogUploader *up;
+    uint32_t     write_pos, first;
+
+    if (NULL == sg_log_lock || NULL == log_content || 0 == log_size) {
+        return -1;
+    }
+
+    HAL_MutexLock(sg_log_lock);
+    up = sg_log_uploader;
+    if (NULL == up) {
+        HAL_MutexUnlock(sg_log_lock);
+        return -1;
+    }
+
+    if (log_size > LOG_UPLOAD_BUFFER_SIZE - up->used) {
+        up->dropped++;
+        HAL_MutexUnlock(sg_log_lock);
+        return -1;
+    }
+
+    write_pos = (up->read_pos + up->used) % LOG_UPLOAD_BUFFER_SIZE;
+    first     = LOG_UPLOAD_BUFFER_SIZE - write_pos;
+    if (first > log_size) {
+        first = log_size;
+    }
+    memcpy(up->ring + write_pos, log_content, first);
+    memcpy(up->ring, log_content + first, log_size - first);
+
+    up->used += log_size;
+    if (up->used >= LOG_UPLOAD_WATERMARK) {
+        up->upload_request = true;
+    }
+    HAL_MutexUnlock(sg_log_lock);
+
+    return 0;
+}
+
+void clear_upload_buffer(void)
+{
+    LogUploader *up;
+
+    if (NULL == sg_log_lock) {
+        return;
+    }
+
+    HAL_MutexLock(sg_log_lock);
+    up = sg_log_uploader;
+    if (up) {
+        up->read_pos       = 0;
+        up->used           = 0;
+        up->upload_request = false;
+    }
+    HAL_MutexUnlock(sg_log_lock);
+}
+
+/* copy whole lines from head of the ring without consuming them, return length copied */
+static uint32_t _ring_peek_lines(LogUploader *up, char *dst, uint32_t max)
+{
+    uint32_t len, first;
+
+    HAL_MutexLock(sg_log_lock);
+    len   = up->used < max ? up->used : max;
+    first = LOG_UPLOAD_BUFFER_SIZE - up->read_pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, up->ring + up->read_pos, first);
+    memcpy(dst + first, up->ring, len - first);
+    HAL_MutexUnlock(sg_log_lock);
+
+    // do not split a line between posts, unless the line is longer than max
+    if (len == max) {
+        while (len > 0 && dst[len - 1] != '\n') {
+            len--;
+        }
+        if (0 == len) {
+            len = max;
+        }
+    }
+
+    return len;
+}
+
+static void _ring_consume(LogUploader *up, uint32_t len)
+{
+    HAL_MutexLock(sg_log_lock);
+    up->read_pos = (up->read_pos + len) % LOG_UPLOAD_BUFFER_SIZE;
+    up->used -= len;
+    if (up->used < LOG_UPLOAD_WATERMARK) {
+        up->upload_request = false;
+    }
+    HAL_MutexUnlock(sg_log_lock);
+}
+
+/* write header after room of signature, return length of both */
+static uint32_t _build_post_header(LogUploader *up)
+{
+    int len = HAL_Snprintf(up->post_buf + LOG_SIGNATURE_SIZE, MAX_HTTP_LOG_POST_SIZE - LOG_SIGNATURE_SIZE,
+                           ";%ld;%s;%s\n", HAL_Timer_current_sec(), up->product_id, up->device_name);
+
+    return LOG_SIGNATURE_SIZE + len;
+}
+
+/* sign the body of len in post_buf and post it, compressed if enabled and smaller */
+static int _post_logs(LogUploader *up, uint32_t len)
+{
+    HTTPClient     http_client;
+    HTTPClientData http_data;
+    char           resp_buf[LOG_UPLOAD_RESP_BUF_LEN];
+    int            zip_len;
+    int            rc;
+
+    utils_hmac_sha1(up->post_buf + LOG_SIGNATURE_SIZE, len - LOG_SIGNATURE_SIZE, up->post_buf, up->sign_key,
+                    strlen(up->sign_key));
+
+    memset(&http_client, 0, sizeof(HTTPClient));
+    memset(&http_data, 0, sizeof(HTTPClientData));
+
+    http_client.header          = LOG_UPLOAD_HTTP_HEADER;
+    http_data.post_content_type = LOG_UPLOAD_CONTENT_TYPE;
+    http_data.post_buf          = up->post_buf;
+    http_data.post_buf_len      = len;
+
+    if (up->zip_buf) {
+        zip_len = utils_compress_zlib(up->post_buf, len, up->zip_buf, MAX_HTTP_LOG_POST_SIZE, up->zip_work);
+        if (zip_len > 0 && zip_len < len) {
+            http_client.header     = LOG_UPLOAD_HTTP_HEADER_DEFLATE;
+            http_data.post_buf     = up->zip_buf;
+            http_data.post_buf_len = zip_len;
+        }
+    }
+
+    rc = qcloud_http_client_common(&http_client, up->url, up->port, NULL, HTTP_POST, &http_data);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        UPLOAD_ERR("post log failed: %d", rc);
+        return rc;
+    }
+
+    memset(resp_buf, 0, sizeof(resp_buf));
+    http_data.response_buf     = resp_buf;
+    http_data.response_buf_len = sizeof(resp_buf);
+
+    rc = qcloud_http_recv_data(&http_client, LOG_UPLOAD_RESP_TIMEOUT_MS, &http_data);
+    if (QCLOUD_RET_SUCCESS == rc && (http_client.response_code < 200 || http_client.response_code >= 300)) {
+        UPLOAD_ERR("log server response code: %d", http_client.response_code);
+        rc = QCLOUD_ERR_HTTP;
+    }
+    qcloud_http_client_release(&http_client, &http_data);
+
+    UPLOAD_DBG("post %u bytes of log as %d bytes, rc: %d", len, http_data.post_buf_len, rc);
+    return rc;
+}
+
+/* post logs saved in flash in batches read into post_buf, saved logs are removed when all are posted */
+static int _upload_saved_logs(LogUploader *up)
+{
+    size_t   size, room, len;
+    uint32_t hdr_len;
+    int      rc = QCLOUD_RET_SUCCESS;
+
+    if (NULL == up->get_size_func || 0 == (size = up->get_size_func())) {
+        up->saved_posted = 0;
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    // logs posted before a failed batch are skipped, unless they are removed out of SDK
+    if (up->saved_posted >= size) {
+        up->saved_posted = 0;
+    }
+
+    while (up->saved_posted < size) {
+        hdr_len = _build_post_header(up);
+        room    = MAX_HTTP_LOG_POST_SIZE - hdr_len;
+        len     = up->read_func(up->post_buf + hdr_len, room, up->saved_posted);
+        if (0 == len || len > room) {
+            UPLOAD_ERR("read saved log failed at %u", (unsigned)up->saved_posted);
+            return QCLOUD_RET_SUCCESS;
+        }
+
+        // do not split a line between posts, unless the line is longer than a post
+        if (len == room && up->saved_posted + len < size) {
+            while (len > 0 && up->post_buf[hdr_len + len - 1] != '\n') {
+                len--;
+            }
+            if (0 == len) {
+                len = room;
+            }
+        }
+
+        rc = _post_logs(up, hdr_len + len);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            return rc;
+        }
+        up->saved_posted += len;
+    }
+
+    if (up->del_func()) {
+        UPLOAD_ERR("delete saved log failed");
+    }
+    up->saved_posted = 0;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* save logs in ring to flash when server is unreachable, up to MAX_LOG_SAVE_SIZE in flash */
+static void _save_ring_logs(LogUploader *up)
+{
+    size_t   saved;
+    uint32_t len, room;
+
+    if (NULL == up->save_func) {
+        return;
+    }
+
+    saved = up->get_size_func();
+    while (saved < MAX_LOG_SAVE_SIZE) {
+        room = MAX_LOG_SAVE_SIZE - saved;
+        len  = _ring_peek_lines(up, up->post_buf, room < MAX_HTTP_LOG_POST_SIZE ? room : MAX_HTTP_LOG_POST_SIZE);
+        if (0 == len) {
+            break;
+        }
+
+        if (up->save_func(up->post_buf, len) != len) {
+            UPLOAD_ERR("save log failed");
+            break;
+        }
+        _ring_consume(up, len);
+        saved += len;
+    }
+}
+
+/* write a line of dropped count after header, so that the loss is visible on server, return its length */
+static uint32_t _build_dropped_line(LogUploader *up, uint32_t hdr_len, uint32_t *dropped)
+{
+    HAL_MutexLock(sg_log_lock);
+    *dropped    = up->dropped;
+    up->dropped = 0;
+    HAL_MutexUnlock(sg_log_lock);
+
+    if (0 == *dropped) {
+        return 0;
+    }
+
+    return HAL_Snprintf(up->post_buf + hdr_len, LOG_UPLOAD_DROP_MSG_LEN,
+                        "WRN|%u logs dropped as upload buffer is full\r\n", *dropped);
+}
+
+int do_log_upload(bool force_upload)
+{
+    LogUploader *up;
+    uint32_t     pending, dropped, hdr_len, len, room;
+    bool         post;
+    int          rc = QCLOUD_RET_SUCCESS;
+
+    if (!force_upload && sg_upload_in_comm_err) {
+        return is_log_uploader_init() ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+    }
+
+    up = _log_uploader_get();
+    if (NULL == up) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    HAL_MutexLock(sg_log_lock);
+    if (up->uploading) {
+        HAL_MutexUnlock(sg_log_lock);
+        _log_uploader_put(up);
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (expired(&up->upload_timer)) {
+        post = true;
+    } else if (up->backoff > 0) {
+        // server is unreachable until retry, save logs if the ring is filling up
+        post = false;
+    } else {
+        post = force_upload || up->upload_request;
+    }
+
+    if (!post && !(up->backoff > 0 && up->upload_request)) {
+        HAL_MutexUnlock(sg_log_lock);
+        _log_uploader_put(up);
+        return QCLOUD_RET_SUCCESS;
+    }
+    up->uploading = true;
+    HAL_MutexUnlock(sg_log_lock);
+
+    if (!post) {
+        _save_ring_logs(up);
+        goto exit;
+    }
+
+    rc = _upload_saved_logs(up);
+
+    // logs appended while posting are left to next upload, so that it ends in bounded time
+    HAL_MutexLock(sg_log_lock);
+    pending = up->used;
+    dropped = up->dropped;
+    HAL_MutexUnlock(sg_log_lock);
+
+    while (QCLOUD_RET_SUCCESS == rc && (pending > 0 || dropped > 0)) {
+        hdr_len = _build_post_header(up);
+        hdr_len += _build_dropped_line(up, hdr_len, &dropped);
+        room = MAX_HTTP_LOG_POST_SIZE - hdr_len;
+        len  = _ring_peek_lines(up, up->post_buf + hdr_len, pending < room ? pending : room);
+        rc   = _post_logs(up, hdr_len + len);
+        if (QCLOUD_RET_SUCCESS == rc) {
+            _ring_consume(up, len);
+            pending -= len;
+        } else {
+            HAL_MutexLock(sg_log_lock);
+            up->dropped += dropped;
+            HAL_MutexUnlock(sg_log_lock);
+        }
+        dropped = 0;
+    }
+
+    if (QCLOUD_RET_SUCCESS == rc) {
+        up->backoff = 0;
+    } else {
+        _save_ring_logs(up);
+        up->backoff = up->backoff ? up->backoff * 2 : 1;
+        if (up->backoff > LOG_UPLOAD_BACKOFF_MAX) {
+            up->backoff = LOG_UPLOAD_BACKOFF_MAX;
+        }
+        UPLOAD_ERR("log upload failed: %d, retry in %u ms", rc, up->backoff * LOG_UPLOAD_INTERVAL_MS);
+    }
+    countdown_ms(&up->upload_timer, (up->backoff ? up->backoff : 1) * LOG_UPLOAD_INTERVAL_MS);
+
+exit:
+    HAL_MutexLock(sg_log_lock);
+    up->uploading = false;
+    HAL_MutexUnlock(sg_log_lock);
+    _log_uploader_put(up);
+
+    return rc;
+}
+
+void set_log_mqtt_client(void *client)
+{
+    sg_log_mqtt_client = client;
+    if (NULL == client) {
+        sg_log_topic_sub = false;
+    }
+}
+
+void set_log_upload_in_comm_err(bool value)
+{
+    sg_upload_in_comm_err = value;
+}
+
+/* reply of log level: {"type":"get_log_level","clientToken":"...","log_level":N} */
+static void _log_level_sub_cb(void *pClient, MQTTMessage *message, void *pUserData)
+{
+    char    payload[LOG_MQTT_PAYLOAD_LEN];
+    char *  type;
+    char *  level_str;
+    int32_t level = -1;
+
+    if (message->payload_len >= sizeof(payload)) {
+        Log_e("log topic message too long: %u", (unsigned)message->payload_len);
+        return;
+    }
+    memcpy(payload, message->payload, message->payload_len);
+    payload[message->payload_len] = '\0';
+
+    type = LITE_json_value_of("type", payload);
+    if (NULL == type || 0 != strcmp(type, LOG_TYPE_GET_LOG_LEVEL)) {
+        HAL_Free(type);
+        return;
+    }
+    HAL_Free(type);
+
+    level_str = LITE_json_value_of("log_level", payload);
+    if (NULL == level_str || QCLOUD_RET_SUCCESS != LITE_get_int32(&level, level_str) || level < eLOG_DISABLE ||
+        level > eLOG_DEBUG) {
+        Log_e("invalid log level: %s", payload);
+        HAL_Free(level_str);
+        return;
+    }
+    HAL_Free(level_str);
+
+    IOT_Log_Set_Upload_Level((LOG_LEVEL)level);
+    Log_d("log upload level is set to %d", level);
+}
+
+static void _log_level_sub_event_cb(void *pClient, MQTTEventType event_type, void *pUserData)
+{
+    switch (event_type) {
+        case MQTT_EVENT_SUBCRIBE_TIMEOUT:
+        case MQTT_EVENT_SUBCRIBE_NACK:
+        case MQTT_EVENT_UNSUBSCRIBE:
+        case MQTT_EVENT_CLIENT_DESTROY:
+            sg_log_topic_sub = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+int qcloud_log_topic_subscribe(void *client)
+{
+    POINTER_SANITY_CHECK(client, QCLOUD_ERR_INVAL);
+
+    LogUploader *up = _log_uploader_get();
+    char         topic[MAX_SIZE_OF_CLOUD_TOPIC];
+    int          rc;
+
+    if (NULL == up) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    HAL_Snprintf(topic, sizeof(topic), LOG_TOPIC_RESULT, up->product_id, up->device_name);
+    _log_uploader_put(up);
+
+    SubscribeParams sub_params      = DEFAULT_SUB_PARAMS;
+    sub_params.on_message_handler   = _log_level_sub_cb;
+    sub_params.on_sub_event_handler = _log_level_sub_event_cb;
+    sub_params.qos                  = QOS0;
+
+    rc = IOT_MQTT_Subscribe(client, topic, &sub_params);
+    if (rc < 0) {
+        Log_e("subscribe log topic failed: %d", rc);
+        return rc;
+    }
+
+    sg_log_topic_sub = true;
+    return QCLOUD_RET_SUCCESS;
+}
+
+int qcloud_get_log_level(void *client, int *log_level)
+{
+    POINTER_SANITY_CHECK(client, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(log_level, QCLOUD_ERR_INVAL);
+
+    LogUploader *up;
+    char         topic[MAX_SIZE_OF_CLOUD_TOPIC];
+    char         payload[LOG_MQTT_PAYLOAD_LEN];
+    int          rc;
+
+    // the reply is published right after subscription, which the server handles in order
+    if (!sg_log_topic_sub) {
+        rc = qcloud_log_topic_subscribe(client);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    up = _log_uploader_get();
+    if (NULL == up) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    HAL_Snprintf(topic, sizeof(topic), LOG_TOPIC_OPERATION, up->product_id, up->device_name);
+    HAL_Snprintf(payload, sizeof(payload), "{\"type\":\"" LOG_TYPE_GET_LOG_LEVEL "\",\"clientToken\":\"%s-%u\"}",
+                 up->product_id, sg_log_client_token++);
+    _log_uploader_put(up);
+
+    PublishParams pub_params = DEFAULT_PUB_PARAMS;
+    pub_params.qos           = QOS0;
+    pub_params.payload       = payload;
+    pub_params.payload_len   = strlen(payload);
+
+    rc = IOT_MQTT_Publish(client, topic, &pub_params);
+    if (rc < 0) {
+        Log_e("publish get log level failed: %d", rc);
+        return rc;
+    }
+
+    // the level from server is applied when reply arrives
+    *log_level = g_log_upload_level;
+    return QCLOUD_RET_SUCCESS;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
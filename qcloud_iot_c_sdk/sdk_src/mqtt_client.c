@@ -19,6 +19,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -187,6 +189,7 @@ int IOT_MQTT_Destroy(void **pClient)
 
     HAL_MutexDestroy(mqtt_client->lock_list_sub);
     HAL_MutexDestroy(mqtt_client->lock_list_pub);
+    qcloud_iot_mqtt_timer_deinit(mqtt_client);
 
     list_destroy(mqtt_client->list_pub_wait_ack);
     list_destroy(mqtt_client->list_sub_wait_ack);
@@ -318,6 +321,11 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
         Log_e("create pub list lock failed.");
         goto error;
     }
+    // ping timer, reconnect delay timer and ACK waiting timers
+    if (QCLOUD_RET_SUCCESS != qcloud_iot_mqtt_timer_init(pClient)) {
+        Log_e("create timer lock failed.");
+        goto error;
+    }
 
     if ((pClient->list_pub_wait_ack = list_new()) == NULL) {
         Log_e("create pub wait list failed.");
@@ -379,10 +387,6 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
     // init network stack
     qcloud_iot_mqtt_network_init(&(pClient->network_stack));
 
-    // ping timer and reconnect delay timer
-    InitTimer(&(pClient->ping_timer));
-    InitTimer(&(pClient->reconnect_delay_timer));
-
 #ifdef SYSTEM_COMM
     pClient->sys_state.result_recv_ok = false;
     pClient->sys_state.topic_sub_ok   = false;
@@ -416,6 +420,7 @@ error:
         HAL_MutexDestroy(pClient->lock_write_buf);
         pClient->lock_write_buf = NULL;
     }
+    qcloud_iot_mqtt_timer_deinit(pClient);
 
     IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE)
 }
@@ -431,6 +436,7 @@ int qcloud_iot_mqtt_fini(Qcloud_IoT_Client *mqtt_client)
 
     HAL_MutexDestroy(mqtt_client->lock_list_sub);
     HAL_MutexDestroy(mqtt_client->lock_list_pub);
+    qcloud_iot_mqtt_timer_deinit(mqtt_client);
 
     list_destroy(mqtt_client->list_pub_wait_ack);
     list_destroy(mqtt_client->list_sub_wait_ack);
@@ -16,6 +16,8 @@
  *transport
  *******************************************************************************/
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -860,11 +862,17 @@ static int _mask_pubInfo_from(Qcloud_IoT_Client *c, uint16_t msgId)
             }
 
             if (repubInfo->msg_id == msgId) {
-                repubInfo->node_state = MQTT_NODE_STATE_INVALID; /* set as invalid node */
+                break;
             }
         }
 
         list_iterator_destroy(iter);
+
+        /* remove at once, the list is only checked when some ACK timeout */
+        if (NULL != node) {
+            qcloud_iot_mqtt_timer_stop(c, &repubInfo->ack_timer);
+            list_remove(c->list_pub_wait_ack, node);
+        }
     }
     HAL_MutexUnlock(c->lock_list_pub);
 
@@ -909,12 +917,18 @@ static int _mask_sub_info_from(Qcloud_IoT_Client *c, unsigned int msgId, SubTopi
             }
 
             if (sub_info->msg_id == msgId) {
-                *messageHandler      = sub_info->handler;       /* return handle */
-                sub_info->node_state = MQTT_NODE_STATE_INVALID; /* mark as invalid node */
+                *messageHandler = sub_info->handler; /* return handle */
+                break;
             }
         }
 
         list_iterator_destroy(iter);
+
+        /* remove at once, the list is only checked when some ACK timeout */
+        if (NULL != node) {
+            qcloud_iot_mqtt_timer_stop(c, &sub_info->ack_timer);
+            list_remove(c->list_sub_wait_ack, node);
+        }
     }
     HAL_MutexUnlock(c->lock_list_sub);
 
@@ -1242,8 +1256,8 @@ static void _handle_pingresp_packet(Qcloud_IoT_Client *pClient)
 
     HAL_MutexLock(pClient->lock_generic);
     pClient->is_ping_outstanding = 0;
-    countdown(&pClient->ping_timer, pClient->options.keep_alive_interval);
     HAL_MutexUnlock(pClient->lock_generic);
+    qcloud_iot_mqtt_timer_start(pClient, &pClient->ping_timer, pClient->options.keep_alive_interval * 1000);
 
     IOT_FUNC_EXIT;
 }
@@ -1363,6 +1377,85 @@ uint8_t get_client_conn_state(Qcloud_IoT_Client *pClient)
     IOT_FUNC_EXIT_RC(is_connected);
 }
 
+static void _mqtt_ping_timeout(void *user_data)
+{
+    ((Qcloud_IoT_Client *)user_data)->timer_events |= MQTT_TIMER_EVENT_PING;
+}
+
+static void _mqtt_pub_ack_timeout(void *user_data)
+{
+    ((Qcloud_IoT_Client *)user_data)->timer_events |= MQTT_TIMER_EVENT_PUB_ACK;
+}
+
+static void _mqtt_sub_ack_timeout(void *user_data)
+{
+    ((Qcloud_IoT_Client *)user_data)->timer_events |= MQTT_TIMER_EVENT_SUB_ACK;
+}
+
+int qcloud_iot_mqtt_timer_init(Qcloud_IoT_Client *pClient)
+{
+    if (NULL == (pClient->lock_timer = HAL_MutexCreate())) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    timer_wheel_init(&pClient->timer_wheel);
+    wheel_timer_init(&pClient->ping_timer, _mqtt_ping_timeout, pClient);
+    // checked by wheel_timer_pending before reconnecting
+    wheel_timer_init(&pClient->reconnect_delay_timer, NULL, pClient);
+    pClient->timer_events = 0;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void qcloud_iot_mqtt_timer_deinit(Qcloud_IoT_Client *pClient)
+{
+    if (NULL != pClient->lock_timer) {
+        HAL_MutexDestroy(pClient->lock_timer);
+        pClient->lock_timer = NULL;
+    }
+}
+
+void qcloud_iot_mqtt_ack_timer_init(Qcloud_IoT_Client *pClient, WheelTimer *timer, MessageTypes type)
+{
+    wheel_timer_init(timer, PUBLISH == type ? _mqtt_pub_ack_timeout : _mqtt_sub_ack_timeout, pClient);
+}
+
+void qcloud_iot_mqtt_timer_start(Qcloud_IoT_Client *pClient, WheelTimer *timer, uint32_t timeout_ms)
+{
+    HAL_MutexLock(pClient->lock_timer);
+    timer_wheel_add(&pClient->timer_wheel, timer, timeout_ms);
+    HAL_MutexUnlock(pClient->lock_timer);
+}
+
+void qcloud_iot_mqtt_timer_stop(Qcloud_IoT_Client *pClient, WheelTimer *timer)
+{
+    HAL_MutexLock(pClient->lock_timer);
+    timer_wheel_del(&pClient->timer_wheel, timer);
+    HAL_MutexUnlock(pClient->lock_timer);
+}
+
+uint8_t qcloud_iot_mqtt_timer_run(Qcloud_IoT_Client *pClient, uint8_t events)
+{
+    HAL_MutexLock(pClient->lock_timer);
+    timer_wheel_run(&pClient->timer_wheel);
+    events &= pClient->timer_events;
+    pClient->timer_events &= ~events;
+    HAL_MutexUnlock(pClient->lock_timer);
+
+    return events;
+}
+
+uint32_t qcloud_iot_mqtt_timer_next_ms(Qcloud_IoT_Client *pClient)
+{
+    uint32_t next_ms;
+
+    HAL_MutexLock(pClient->lock_timer);
+    next_ms = timer_wheel_next_ms(&pClient->timer_wheel);
+    HAL_MutexUnlock(pClient->lock_timer);
+
+    return next_ms;
+}
+
 /*
  * @brief push node to subscribe(unsubscribe) ACK wait list
  *
@@ -1395,8 +1488,7 @@ int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, Messag
     sub_info->msg_id     = msgId;
     sub_info->len        = len;
 
-    InitTimer(&sub_info->sub_start_time);
-    countdown_ms(&sub_info->sub_start_time, c->command_timeout_ms);
+    qcloud_iot_mqtt_ack_timer_init(c, &sub_info->ack_timer, type);
 
     sub_info->type    = type;
     sub_info->handler = *handler;
@@ -1413,6 +1505,7 @@ int push_sub_info_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, Messag
     }
 
     list_rpush(c->list_sub_wait_ack, *node);
+    qcloud_iot_mqtt_timer_start(c, &sub_info->ack_timer, c->command_timeout_ms);
 
     HAL_MutexUnlock(c->lock_list_sub);
 
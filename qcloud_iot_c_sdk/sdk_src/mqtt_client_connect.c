@@ -15,6 +15,8 @@
  *initial documentation
  *******************************************************************************/
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -379,7 +381,9 @@ static int _mqtt_connect(Qcloud_IoT_Client *pClient, MQTTConnectParams *options)
     HAL_MutexLock(pClient->lock_generic);
     pClient->was_manually_disconnected = 0;
     pClient->is_ping_outstanding       = 0;
-    countdown(&pClient->ping_timer, pClient->options.keep_alive_interval);
+    if (pClient->options.keep_alive_interval) {
+        qcloud_iot_mqtt_timer_start(pClient, &pClient->ping_timer, pClient->options.keep_alive_interval * 1000);
+    }
     HAL_MutexUnlock(pClient->lock_generic);
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
@@ -19,6 +19,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #ifdef __cplusplus
 extern "C" {
 #endif
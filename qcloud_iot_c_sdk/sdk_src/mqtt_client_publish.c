@@ -15,6 +15,8 @@
  *    Ian Craggs - fix for https://bugs.eclipse.org/bugs/show_bug.cgi?id=453144
  *******************************************************************************/
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -107,8 +109,7 @@ static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short m
     repubInfo->node_state = MQTT_NODE_STATE_NORMANL;
     repubInfo->msg_id     = msgId;
     repubInfo->len        = len;
-    InitTimer(&repubInfo->pub_start_time);
-    countdown_ms(&repubInfo->pub_start_time, c->command_timeout_ms);
+    qcloud_iot_mqtt_ack_timer_init(c, &repubInfo->ack_timer, PUBLISH);
 
     repubInfo->buf = (unsigned char *)repubInfo + sizeof(QcloudIotPubInfo);
 
@@ -123,6 +124,7 @@ static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short m
     }
 
     list_rpush(c->list_pub_wait_ack, *node);
+    qcloud_iot_mqtt_timer_start(c, &repubInfo->ack_timer, c->command_timeout_ms);
 
     HAL_MutexUnlock(c->lock_list_pub);
 
@@ -335,13 +337,13 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
     HAL_MutexLock(pClient->lock_write_buf);
     if (pParams->qos == QOS1) {
         pParams->id = get_next_packet_id(pClient);
-        if (IOT_Log_Get_Level() <= eLOG_DEBUG) {
+        if (IOT_LOG_ENABLED(eLOG_DEBUG)) {
             Log_d("publish topic seq=%d|topicName=%s|payload=%s", pParams->id, topicName, (char *)pParams->payload);
         } else {
             Log_i("publish topic seq=%d|topicName=%s", pParams->id, topicName);
         }
     } else {
-        if (IOT_Log_Get_Level() <= eLOG_DEBUG) {
+        if (IOT_LOG_ENABLED(eLOG_DEBUG)) {
             Log_d("publish packetID=%d|topicName=%s|payload=%s", pParams->id, topicName, (char *)pParams->payload);
         } else {
             Log_i("publish packetID=%d|topicName=%s", pParams->id, topicName);
@@ -370,6 +372,7 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
     if (QCLOUD_RET_SUCCESS != rc) {
         if (pParams->qos > QOS0) {
             HAL_MutexLock(pClient->lock_list_pub);
+            qcloud_iot_mqtt_timer_stop(pClient, &((QcloudIotPubInfo *)node->val)->ack_timer);
             list_remove(pClient->list_pub_wait_ack, node);
             HAL_MutexUnlock(pClient->lock_list_pub);
         }
@@ -14,6 +14,8 @@
  *    Ian Craggs - initial API and implementation and/or initial documentation
  *******************************************************************************/
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -174,6 +176,7 @@ int qcloud_iot_mqtt_subscribe(Qcloud_IoT_Client *pClient, char *topicFilter, Sub
     rc = send_mqtt_packet(pClient, len, &timer);
     if (QCLOUD_RET_SUCCESS != rc) {
         HAL_MutexLock(pClient->lock_list_sub);
+        qcloud_iot_mqtt_timer_stop(pClient, &((QcloudIotSubInfo *)node->val)->ack_timer);
         list_remove(pClient->list_sub_wait_ack, node);
         HAL_MutexUnlock(pClient->lock_list_sub);
 
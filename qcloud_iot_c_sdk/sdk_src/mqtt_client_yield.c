@@ -15,6 +15,8 @@
  *initial documentation
  *******************************************************************************/
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_MQTT
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -97,7 +99,7 @@ static int _handle_reconnect(Qcloud_IoT_Client *pClient)
     int    rc                       = QCLOUD_RET_MQTT_RECONNECTED;
 
     // reconnect control by delay timer (increase interval exponentially )
-    if (!expired(&(pClient->reconnect_delay_timer))) {
+    if (wheel_timer_pending(&pClient->reconnect_delay_timer)) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT);
     }
 
@@ -131,7 +133,7 @@ static int _handle_reconnect(Qcloud_IoT_Client *pClient)
     if (MAX_RECONNECT_WAIT_INTERVAL < pClient->current_reconnect_wait_interval) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT);
     }
-    countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
+    qcloud_iot_mqtt_timer_start(pClient, &pClient->reconnect_delay_timer, pClient->current_reconnect_wait_interval);
 
     IOT_FUNC_EXIT_RC(rc);
 }
@@ -142,7 +144,7 @@ static int _handle_reconnect(Qcloud_IoT_Client *pClient)
  * @param pClient
  * @return
  */
-static int _mqtt_keep_alive(Qcloud_IoT_Client *pClient)
+static int _mqtt_keep_alive(Qcloud_IoT_Client *pClient, uint8_t timer_events)
 {
 #define MQTT_PING_RETRY_TIMES 2
 
@@ -156,7 +158,8 @@ static int _mqtt_keep_alive(Qcloud_IoT_Client *pClient)
         IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
     }
 
-    if (!expired(&pClient->ping_timer)) {
+    // ping timer is restarted when PINGRESP arrives, check if it is restarted after fired
+    if (!(timer_events & MQTT_TIMER_EVENT_PING) || wheel_timer_pending(&pClient->ping_timer)) {
         IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
     }
 
@@ -197,9 +200,9 @@ static int _mqtt_keep_alive(Qcloud_IoT_Client *pClient)
 
     HAL_MutexLock(pClient->lock_generic);
     pClient->is_ping_outstanding++;
-    /* start a timer to wait for PINGRESP from server */
-    countdown(&pClient->ping_timer, Min(5, pClient->options.keep_alive_interval / 2));
     HAL_MutexUnlock(pClient->lock_generic);
+    /* start a timer to wait for PINGRESP from server */
+    qcloud_iot_mqtt_timer_start(pClient, &pClient->ping_timer, Min(5, pClient->options.keep_alive_interval / 2) * 1000);
     Log_d("PING request %u has been sent...", pClient->is_ping_outstanding);
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
@@ -220,9 +223,11 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
 {
     IOT_FUNC_ENTRY;
 
-    int     rc = QCLOUD_RET_SUCCESS;
-    Timer   timer;
-    uint8_t packet_type;
+    int      rc = QCLOUD_RET_SUCCESS;
+    Timer    timer;
+    uint8_t  packet_type;
+    uint8_t  timer_events;
+    uint32_t wait_ms;
 
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     NUMBERIC_SANITY_CHECK(timeout_ms, QCLOUD_ERR_INVAL);
@@ -247,7 +252,17 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
                 rc = QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT;
                 break;
             }
+            // fire reconnect delay timer, the other events are kept until connected
+            qcloud_iot_mqtt_timer_run(pClient, 0);
             rc = _handle_reconnect(pClient);
+            if (QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT == rc && wheel_timer_pending(&pClient->reconnect_delay_timer)) {
+                // sleep until next reconnect instead of spinning
+                wait_ms = qcloud_iot_mqtt_timer_next_ms(pClient);
+                wait_ms = Min(wait_ms, (uint32_t)Max(left_ms(&timer), 0));
+                if (wait_ms > 0) {
+                    HAL_SleepMs(wait_ms);
+                }
+            }
 
             continue;
         }
@@ -255,15 +270,20 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
         rc = cycle_for_read(pClient, &timer, &packet_type, QOS0);
 
         if (rc == QCLOUD_RET_SUCCESS) {
-            /* check list of wait publish ACK to remove node that is ACKED or timeout
-             */
-            qcloud_iot_mqtt_pub_info_proc(pClient);
+            timer_events = qcloud_iot_mqtt_timer_run(
+                pClient, MQTT_TIMER_EVENT_PING | MQTT_TIMER_EVENT_PUB_ACK | MQTT_TIMER_EVENT_SUB_ACK);
 
-            /* check list of wait subscribe(or unsubscribe) ACK to remove node that is
-             * ACKED or timeout */
-            qcloud_iot_mqtt_sub_info_proc(pClient);
+            /* check list of wait publish ACK to remove node that is timeout */
+            if (timer_events & MQTT_TIMER_EVENT_PUB_ACK) {
+                qcloud_iot_mqtt_pub_info_proc(pClient);
+            }
 
-            rc = _mqtt_keep_alive(pClient);
+            /* check list of wait subscribe(or unsubscribe) ACK to remove node that is timeout */
+            if (timer_events & MQTT_TIMER_EVENT_SUB_ACK) {
+                qcloud_iot_mqtt_sub_info_proc(pClient);
+            }
+
+            rc = _mqtt_keep_alive(pClient, timer_events);
         } else if (rc == QCLOUD_ERR_SSL_READ_TIMEOUT || rc == QCLOUD_ERR_SSL_READ ||
                    rc == QCLOUD_ERR_TCP_PEER_SHUTDOWN || rc == QCLOUD_ERR_TCP_READ_FAIL) {
             Log_e("network read failed, rc: %d. MQTT Disconnect.", rc);
@@ -275,7 +295,8 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
 
             if (pClient->options.auto_connect_enable == 1) {
                 pClient->current_reconnect_wait_interval = _get_random_interval();
-                countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
+                qcloud_iot_mqtt_timer_start(pClient, &pClient->reconnect_delay_timer,
+                                            pClient->current_reconnect_wait_interval);
 
                 // reconnect timeout
                 rc = QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT;
@@ -347,18 +368,14 @@ int qcloud_iot_mqtt_pub_info_proc(Qcloud_IoT_Client *pClient)
             }
 
             /* check the request if timeout or not */
-            if (left_ms(&repubInfo->pub_start_time) > 0) {
+            if (wheel_timer_pending(&repubInfo->ack_timer)) {
                 continue;
             }
 
-            HAL_MutexUnlock(pClient->lock_list_pub);
             /* If wait ACK timeout, remove the node from list */
             /* It is up to user to do republishing or not */
             temp_node = node;
 
-            countdown_ms(&repubInfo->pub_start_time, pClient->command_timeout_ms);
-            HAL_MutexLock(pClient->lock_list_pub);
-
             /* notify timeout event */
             if (NULL != pClient->event_handle.h_fp) {
                 MQTTEventMsg msg;
@@ -440,7 +457,7 @@ int qcloud_iot_mqtt_sub_info_proc(Qcloud_IoT_Client *pClient)
             }
 
             /* check the request if timeout or not */
-            if (left_ms(&sub_info->sub_start_time) > 0) {
+            if (wheel_timer_pending(&sub_info->ack_timer)) {
                 continue;
             }
 
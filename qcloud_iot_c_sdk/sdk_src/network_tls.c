@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_TLS
+
 #include "network_interface.h"
 #include "qcloud_iot_export_error.h"
 #include "qcloud_iot_import.h"
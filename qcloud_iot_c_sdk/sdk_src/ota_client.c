@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_OTA
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,12 +33,47 @@ extern "C" {
 #include "ota_fetch.h"
 #include "ota_lib.h"
 #include "qcloud_iot_export.h"
+#include "utils_decompress.h"
+#include "utils_httpc.h"
+#include "utils_md5.h"
 #include "utils_param_check.h"
+#include "utils_patch.h"
+#include "utils_sha256.h"
 #include "utils_timer.h"
 
 #define OTA_VERSION_STR_LEN_MIN (1)
 #define OTA_VERSION_STR_LEN_MAX (32)
 
+#define OTA_SINK_TASK_NAME        "ota_sink_task"
+#define OTA_SINK_TASK_STACK_BYTES 4096
+#define OTA_SINK_TASK_PRIO        3
+#define OTA_PIPELINE_WAIT_MS      1000
+
+#define OTA_CHECKPOINT_KEY      "qcloud_ota_ckpt"
+#define OTA_CHECKPOINT_MAGIC    (0x4F544132) /* "OTA2" */
+#define OTA_CHECKPOINT_INTERVAL (32 * 1024)
+
+#define OTA_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+#define OTA_RANGE_TASK_NAME        "ota_range_task"
+#define OTA_RANGE_TASK_STACK_BYTES 8192
+#define OTA_RANGE_TASK_PRIO        3
+#define OTA_RANGE_RETRY_MAX        3
+#define OTA_RANGE_CHECKPOINT_KEY   "qcloud_ota_rngs"
+#define OTA_RANGE_CHECKPOINT_MAGIC (0x4F544152) /* "OTAR" */
+
+#define OTA_INFLATE_WINDOW_BITS_DEFAULT       15
+#define OTA_HEATSHRINK_WINDOW_BITS_DEFAULT    8
+#define OTA_HEATSHRINK_LOOKAHEAD_BITS_DEFAULT 4
+
+/* SHA-256 of firmware and of its current block, updated in the same pass as MD5 */
+typedef struct {
+    iot_sha256_context sha256;
+    iot_sha256_context block;
+    uint32_t           len;    /* length of firmware hashed */
+    uint32_t           failed; /* digest of a block mismatched */
+} OTA_Verify_t;
+
 typedef struct {
     const char *product_id;  /* point to product id */
     const char *device_name; /* point to device name */
@@ -46,12 +83,30 @@ typedef struct {
     uint32_t           size_last_fetched; /* size of last downloaded */
     uint32_t           size_fetched;      /* size of already downloaded */
     uint32_t           size_file;         /* size of file */
+    uint32_t           size_committed;    /* size of data accepted by sink and hashed */
+    uint32_t           size_checkpoint;   /* size covered by last saved checkpoint */
 
     char *purl;       /* point to URL */
     char *version;    /* point to string */
     char  md5sum[33]; /* MD5 string */
 
     void *md5;       /* MD5 handle */
+
+    OTACompressInfo       compress;       /* compress and delta info of firmware */
+    void *                decoder;        /* decompressor in sink stage */
+    void *                patcher;        /* delta patcher in sink stage, after decompressor */
+    void *                raw_md5;        /* MD5 handle of decoded firmware */
+    int                   decoded;        /* firmware is decompressed or patched, so its check applies too */
+    int                   raw_valid;      /* decoded firmware is valid */
+    OTASinkCallback       sink;           /* sink of decoded firmware */
+    OTASourceReadCallback source_read;    /* reader of running firmware for patcher */
+    void *                sink_user_data; /* user data of sink and source_read */
+
+    OTAVerifyParams verify_params; /* set by IOT_OTA_SetVerify */
+    OTA_Verify_t *  verify;        /* NULL if SHA-256 is not needed */
+    char *          block_buf;     /* data of current block, held by sink stage until its digest is checked */
+    uint32_t        block_len;     /* length of data in block_buf */
+
     void *ch_signal; /* channel handle of signal exchanged with OTA server */
     void *ch_fetch;  /* channel handle of download */
 
@@ -63,6 +118,72 @@ typedef struct {
 
 } OTA_Struct_t;
 
+/* MD5 state of downloaded firmware, saved to KV for resuming download */
+typedef struct {
+    uint32_t        magic;
+    uint32_t        offset;
+    char            md5sum[33];
+    char            version[OTA_VERSION_STR_LEN_MAX + 1];
+    iot_md5_context md5;
+    uint32_t        has_verify;
+    OTA_Verify_t    verify;
+} OTA_Checkpoint_t;
+
+#ifdef MULTITHREAD_ENABLED
+/* ring of buffers between network stage and sink stage */
+typedef struct {
+    OTA_Struct_t *  h_ota;
+    OTASinkCallback sink;
+    void *          user_data;
+    uint16_t        buf_num;
+    char **         bufs;
+    uint32_t *      lens;     /* 0 marks the end of stream */
+    uint32_t *      offsets;  /* firmware offset of each buffer */
+    void *          free_sem; /* buffers free for network stage */
+    void *          full_sem; /* buffers filled for sink stage */
+    void *          done_sem; /* sink stage quit */
+    volatile int    sink_err; /* first error of sink stage */
+    ThreadParams    thread_params;
+} OTA_Pipeline_t;
+#endif
+
+#if defined(OTA_PARALLEL_FETCH) && defined(MULTITHREAD_ENABLED)
+/* offset reached by each range, saved to KV for resuming parallel download */
+typedef struct {
+    uint32_t magic;
+    uint32_t file_size;
+    uint32_t range_num;
+    char     md5sum[33];
+    char     version[OTA_VERSION_STR_LEN_MAX + 1];
+    uint32_t next[OTA_PARALLEL_RANGE_MAX];
+} OTA_RangeCheckpoint_t;
+
+typedef struct OTA_Parallel OTA_Parallel_t;
+
+/* range [start, end) of firmware fetched by one task */
+typedef struct {
+    OTA_Parallel_t *par;
+    uint32_t        start;
+    uint32_t        next;  /* data before it is accepted by sink */
+    uint32_t        end;
+    uint32_t        saved; /* next when checkpoint is saved */
+    char *          buf;
+    char *          block;     /* data of current block held until its digest is checked, NULL without digests */
+    uint32_t        block_len; /* length of data in block */
+    ThreadParams    thread_params;
+} OTA_Range_t;
+
+struct OTA_Parallel {
+    OTA_Struct_t *     h_ota;
+    OTAParallelParams *params;
+    void *             lock;        /* serialize sink, progress and checkpoint */
+    void *             done_sem;    /* range task quit */
+    volatile int       err;         /* first error of range tasks */
+    volatile int       sink_failed; /* err is from sink */
+    OTA_Range_t        ranges[OTA_PARALLEL_RANGE_MAX];
+};
+#endif
+
 /* check ota progress */
 /* return: true, valid progress state; false, invalid progress state. */
 static int _ota_check_progress(IOT_OTA_Progress_Code progress)
@@ -115,7 +236,7 @@ static void _ota_callback(void *pcontext, const char *msg, uint32_t msg_len)
         }
 
         if (0 != qcloud_otalib_get_params(msg, &json_type, &h_ota->purl, &h_ota->version, h_ota->md5sum,
-                                          &h_ota->size_file)) {
+                                          &h_ota->size_file, &h_ota->compress)) {
             Log_e("Get firmware parameter failed");
             goto End;
         }
@@ -139,10 +260,12 @@ static void IOT_OTA_ResetStatus(void *handle)
 
     if (NULL != h_ota->purl) {
         HAL_Free(h_ota->purl);
+        h_ota->purl = NULL;
     }
 
     if (NULL != h_ota->version) {
         HAL_Free(h_ota->version);
+        h_ota->version = NULL;
     }
 }
 
@@ -265,6 +388,207 @@ do_exit:
 #undef MSG_UPGPGRADE_LEN
 }
 
+static int _ota_save_checkpoint(OTA_Struct_t *h_ota, uint32_t offset)
+{
+    OTA_Checkpoint_t ckpt;
+    int              ret;
+
+    if (NULL == h_ota->version) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    memset(&ckpt, 0, sizeof(OTA_Checkpoint_t));
+    ckpt.magic  = OTA_CHECKPOINT_MAGIC;
+    ckpt.offset = offset;
+    strncpy(ckpt.md5sum, h_ota->md5sum, sizeof(ckpt.md5sum) - 1);
+    strncpy(ckpt.version, h_ota->version, sizeof(ckpt.version) - 1);
+    utils_md5_clone(&ckpt.md5, (iot_md5_context *)h_ota->md5);
+    if (NULL != h_ota->verify) {
+        if (h_ota->verify->failed || h_ota->verify->len != offset) {
+            // corrupt block is found, download should start over, or SHA-256 is ahead of data sunk
+            return QCLOUD_ERR_FAILURE;
+        }
+        ckpt.has_verify = 1;
+        ckpt.verify     = *h_ota->verify;
+    }
+
+    ret = HAL_Kv_Set(OTA_CHECKPOINT_KEY, &ckpt, sizeof(OTA_Checkpoint_t));
+    if (QCLOUD_RET_SUCCESS != ret) {
+        Log_w("save ota checkpoint at offset %u failed: %d", offset, ret);
+        return ret;
+    }
+
+    h_ota->size_checkpoint = offset;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* restore MD5 state if the checkpoint matches the firmware and offset */
+static int _ota_load_checkpoint(OTA_Struct_t *h_ota, uint32_t offset)
+{
+    OTA_Checkpoint_t ckpt;
+    uint32_t         len = sizeof(OTA_Checkpoint_t);
+
+    if (NULL == h_ota->version) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if (QCLOUD_RET_SUCCESS != HAL_Kv_Get(OTA_CHECKPOINT_KEY, &ckpt, &len) || len != sizeof(OTA_Checkpoint_t)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    ckpt.md5sum[sizeof(ckpt.md5sum) - 1]   = '\0';
+    ckpt.version[sizeof(ckpt.version) - 1] = '\0';
+    if (OTA_CHECKPOINT_MAGIC != ckpt.magic || offset != ckpt.offset || strcmp(ckpt.md5sum, h_ota->md5sum) ||
+        strncmp(ckpt.version, h_ota->version, sizeof(ckpt.version) - 1)) {
+        Log_w("ota checkpoint of %s at offset %u mismatch", ckpt.version, ckpt.offset);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if (ckpt.has_verify != (NULL != h_ota->verify)) {
+        Log_w("ota checkpoint at offset %u mismatch in SHA-256", ckpt.offset);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    utils_md5_clone((iot_md5_context *)h_ota->md5, &ckpt.md5);
+    if (NULL != h_ota->verify) {
+        *h_ota->verify = ckpt.verify;
+    }
+    h_ota->size_checkpoint = offset;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _ota_clear_checkpoint(OTA_Struct_t *h_ota)
+{
+    HAL_Kv_Del(OTA_CHECKPOINT_KEY);
+#if defined(OTA_PARALLEL_FETCH) && defined(MULTITHREAD_ENABLED)
+    HAL_Kv_Del(OTA_RANGE_CHECKPOINT_KEY);
+#endif
+    h_ota->size_checkpoint = 0;
+}
+
+/* SHA-256 is needed if firmware info gives it or signature, or the device asks for it */
+static int _ota_verify_enabled(OTA_Struct_t *h_ota)
+{
+    return '\0' != h_ota->compress.sha256sum[0] || '\0' != h_ota->compress.signature[0] ||
+           NULL != h_ota->verify_params.verify_sign || 0 != h_ota->verify_params.block_size;
+}
+
+static int _ota_verify_reset(OTA_Struct_t *h_ota)
+{
+    if (!_ota_verify_enabled(h_ota)) {
+        HAL_Free(h_ota->verify);
+        h_ota->verify = NULL;
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (NULL == h_ota->verify && NULL == (h_ota->verify = HAL_Malloc(sizeof(OTA_Verify_t)))) {
+        Log_e("allocate for ota verify failed");
+        return IOT_OTA_ERR_NOMEM;
+    }
+
+    memset(h_ota->verify, 0, sizeof(OTA_Verify_t));
+    utils_sha256_starts(&h_ota->verify->sha256);
+    utils_sha256_starts(&h_ota->verify->block);
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* hash firmware data in order, and check digest of each block once it is complete */
+static int _ota_verify_update(OTA_Struct_t *h_ota, const char *buf, uint32_t len)
+{
+    OTA_Verify_t *  verify     = h_ota->verify;
+    uint32_t        block_size = h_ota->verify_params.block_size;
+    uint32_t        n, index;
+    unsigned char   digest[SHA256_DIGEST_SIZE];
+
+    if (NULL == verify) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (verify->failed) {
+        return IOT_OTA_ERR_VERIFY;
+    }
+
+    utils_sha256_update(&verify->sha256, (const unsigned char *)buf, len);
+    if (0 == block_size) {
+        verify->len += len;
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    while (len > 0) {
+        n = OTA_MIN(len, block_size - verify->len % block_size);
+        utils_sha256_update(&verify->block, (const unsigned char *)buf, n);
+        verify->len += n;
+        buf += n;
+        len -= n;
+
+        if (0 != verify->len % block_size && verify->len != h_ota->size_file) {
+            continue;
+        }
+
+        index = (verify->len - 1) / block_size;
+        utils_sha256_finish(&verify->block, digest);
+        utils_sha256_starts(&verify->block);
+        if (index >= h_ota->verify_params.block_num ||
+            0 != memcmp(digest, h_ota->verify_params.block_digests[index], SHA256_DIGEST_SIZE)) {
+            Log_e("digest of block %u at offset %u mismatch", index, index * block_size);
+            verify->failed = 1;
+            return IOT_OTA_ERR_VERIFY;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* check SHA-256 and signature of the whole firmware */
+static int _ota_verify_finish(OTA_Struct_t *h_ota)
+{
+    OTA_Verify_t *verify = h_ota->verify;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char          sha256_str[SHA256_DIGEST_SIZE * 2 + 1];
+    int           i, ret;
+
+    if (!_ota_verify_enabled(h_ota)) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (NULL == verify || verify->failed || verify->len != h_ota->size_file) {
+        Log_e("SHA-256 of firmware is not available");
+        return IOT_OTA_ERR_VERIFY;
+    }
+
+    utils_sha256_finish(&verify->sha256, digest);
+    verify->failed = 1;  // digest is finished, no more update
+
+    if ('\0' != h_ota->compress.sha256sum[0]) {
+        for (i = 0; i < SHA256_DIGEST_SIZE; i++) {
+            sha256_str[i * 2]     = utils_hb2hex(digest[i] >> 4);
+            sha256_str[i * 2 + 1] = utils_hb2hex(digest[i]);
+        }
+        sha256_str[SHA256_DIGEST_SIZE * 2] = '\0';
+        if (0 != strcmp(sha256_str, h_ota->compress.sha256sum)) {
+            Log_e("sha256 %s mismatch, expect %s", sha256_str, h_ota->compress.sha256sum);
+            return IOT_OTA_ERR_VERIFY;
+        }
+    }
+
+    if (NULL != h_ota->verify_params.verify_sign) {
+        if ('\0' == h_ota->compress.signature[0]) {
+            Log_e("firmware is not signed");
+            return IOT_OTA_ERR_VERIFY;
+        }
+
+        ret = h_ota->verify_params.verify_sign(h_ota->verify_params.user_data, digest, h_ota->compress.signature);
+        if (QCLOUD_RET_SUCCESS != ret) {
+            Log_e("signature of firmware is invalid: %d", ret);
+            return IOT_OTA_ERR_VERIFY;
+        }
+    } else if ('\0' != h_ota->compress.signature[0]) {
+        Log_w("signature of firmware is not checked without verify_sign");
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
 /* Init OTA handle */
 void *IOT_OTA_Init(const char *product_id, const char *device_name, void *ch_signal)
 {
@@ -340,7 +664,10 @@ int IOT_OTA_Destroy(void *handle)
 
     qcloud_osc_deinit(h_ota->ch_signal);
     qcloud_ofc_deinit(h_ota->ch_fetch);
+    // no more fetch, idle connection to firmware server is not kept
+    qcloud_http_conn_cache_flush();
     qcloud_otalib_md5_deinit(h_ota->md5);
+    HAL_Free(h_ota->verify);
 
     if (NULL != h_ota->purl) {
         HAL_Free(h_ota->purl);
@@ -361,7 +688,10 @@ int IOT_OTA_StartDownload(void *handle, uint32_t offset, uint32_t size)
     int           Ret;
 
     Log_d("to download FW from offset: %u, size: %u", offset, size);
-    h_ota->size_fetched = offset;
+    h_ota->size_fetched    = offset;
+    h_ota->size_committed  = offset;
+    h_ota->size_checkpoint = 0;
+    h_ota->decoded         = 0;
 
     // reset md5 for new download
     if (offset == 0) {
@@ -370,6 +700,17 @@ int IOT_OTA_StartDownload(void *handle, uint32_t offset, uint32_t size)
             Log_e("initialize md5 failed");
             return QCLOUD_ERR_FAILURE;
         }
+        _ota_clear_checkpoint(h_ota);
+    } else if (NULL == h_ota->verify && _ota_verify_enabled(h_ota) && QCLOUD_RET_SUCCESS == _ota_verify_reset(h_ota)) {
+        // SHA-256 of the data before offset is known only if checkpoint restores it
+        h_ota->verify->failed = 1;
+    }
+
+    if (offset > 0 && QCLOUD_RET_SUCCESS == _ota_load_checkpoint(h_ota, offset)) {
+        Log_i("resume md5 from checkpoint at offset: %u", offset);
+    } else if (offset > 0) {
+        // keep MD5 regenerated by caller through IOT_OTA_UpdateClientMd5
+        Log_w("no ota checkpoint at offset: %u, use client md5", offset);
     }
 
     // reinit ofc
@@ -395,6 +736,7 @@ void IOT_OTA_UpdateClientMd5(void *handle, char *buff, uint32_t size)
     OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
 
     qcloud_otalib_md5_update(h_ota->md5, buff, size);
+    _ota_verify_update(h_ota, buff, size);
 }
 
 /*support continuous transmission of breakpoints*/
@@ -408,6 +750,41 @@ int IOT_OTA_ResetClientMD5(void *handle)
         return QCLOUD_ERR_FAILURE;
     }
 
+    return _ota_verify_reset(h_ota);
+}
+
+int IOT_OTA_SaveCheckpoint(void *handle)
+{
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
+
+    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
+
+    if (h_ota->state < IOT_OTAS_FETCHING) {
+        h_ota->err = IOT_OTA_ERR_INVALID_STATE;
+        return IOT_OTA_ERR_INVALID_STATE;
+    }
+
+    return _ota_save_checkpoint(h_ota, h_ota->size_fetched);
+}
+
+int IOT_OTA_SetVerify(void *handle, OTAVerifyParams *pParams)
+{
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
+
+    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
+
+    if (NULL == pParams) {
+        memset(&h_ota->verify_params, 0, sizeof(OTAVerifyParams));
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (0 != pParams->block_size && (NULL == pParams->block_digests || 0 == pParams->block_num)) {
+        Log_e("block digests are not given");
+        h_ota->err = IOT_OTA_ERR_INVALID_PARAM;
+        return IOT_OTA_ERR_INVALID_PARAM;
+    }
+
+    h_ota->verify_params = *pParams;
     return QCLOUD_RET_SUCCESS;
 }
 
@@ -540,36 +917,32 @@ int IOT_OTA_IsFetchFinish(void *handle)
     return (IOT_OTAS_FETCHED == h_ota->state);
 }
 
-int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s)
+/* stop fetching and report the reason to server */
+static void _ota_fetch_failed(OTA_Struct_t *h_ota, int ret)
 {
-    int           ret;
-    OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
+    h_ota->state = IOT_OTAS_FETCHED;
+    h_ota->err   = IOT_OTA_ERR_FETCH_FAILED;
 
-    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
-    POINTER_SANITY_CHECK(buf, IOT_OTA_ERR_INVALID_PARAM);
-    NUMBERIC_SANITY_CHECK(buf_len, IOT_OTA_ERR_INVALID_PARAM);
-
-    if (IOT_OTAS_FETCHING != h_ota->state) {
-        h_ota->err = IOT_OTA_ERR_INVALID_STATE;
-        return IOT_OTA_ERR_INVALID_STATE;
+    if (ret == IOT_OTA_ERR_FETCH_AUTH_FAIL) {  // OTA auth failed
+        IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_AUTH_FAIL);
+        h_ota->err = ret;
+    } else if (ret == IOT_OTA_ERR_FETCH_NOT_EXIST) {  // fetch not existed
+        IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_FILE_NOT_EXIST);
+        h_ota->err = ret;
+    } else if (ret == IOT_OTA_ERR_FETCH_TIMEOUT) {  // fetch timeout
+        IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_DOWNLOAD_TIMEOUT);
+        h_ota->err = ret;
     }
+}
+
+/* fetch without updating MD5, which is left to caller */
+static int _ota_fetch(OTA_Struct_t *h_ota, char *buf, uint32_t buf_len, uint32_t timeout_s)
+{
+    int ret;
 
     ret = qcloud_ofc_fetch(h_ota->ch_fetch, buf, buf_len, timeout_s);
     if (ret < 0) {
-        h_ota->state = IOT_OTAS_FETCHED;
-        h_ota->err   = IOT_OTA_ERR_FETCH_FAILED;
-
-        if (ret == IOT_OTA_ERR_FETCH_AUTH_FAIL) {  // OTA auth failed
-            IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_AUTH_FAIL);
-            h_ota->err = ret;
-        } else if (ret == IOT_OTA_ERR_FETCH_NOT_EXIST) {  // fetch not existed
-            IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_FILE_NOT_EXIST);
-            h_ota->err = ret;
-        } else if (ret == IOT_OTA_ERR_FETCH_TIMEOUT) {  // fetch timeout
-            IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_DOWNLOAD_TIMEOUT);
-            h_ota->err = ret;
-        }
-
+        _ota_fetch_failed(h_ota, ret);
         return ret;
     } else if (0 == h_ota->size_fetched) {
         /* force report status in the first */
@@ -595,11 +968,864 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
         h_ota->state = IOT_OTAS_FETCHED;
     }
 
-    qcloud_otalib_md5_update(h_ota->md5, buf, ret);
+    return ret;
+}
+
+int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s)
+{
+    int           ret;
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
+
+    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
+    POINTER_SANITY_CHECK(buf, IOT_OTA_ERR_INVALID_PARAM);
+    NUMBERIC_SANITY_CHECK(buf_len, IOT_OTA_ERR_INVALID_PARAM);
+
+    if (IOT_OTAS_FETCHING != h_ota->state) {
+        h_ota->err = IOT_OTA_ERR_INVALID_STATE;
+        return IOT_OTA_ERR_INVALID_STATE;
+    }
+
+    ret = _ota_fetch(h_ota, buf, buf_len, timeout_s);
+    if (ret > 0) {
+        if (QCLOUD_RET_SUCCESS != _ota_verify_update(h_ota, buf, ret)) {
+            _ota_clear_checkpoint(h_ota);
+            h_ota->err = IOT_OTA_ERR_VERIFY;
+            return IOT_OTA_ERR_VERIFY;
+        }
+        qcloud_otalib_md5_update(h_ota->md5, buf, ret);
+    }
+
+    return ret;
+}
+
+/* output of the last decoding stage, offset is in decoded firmware */
+static int _ota_image_output(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)user_data;
+
+    if (NULL != h_ota->raw_md5) {
+        qcloud_otalib_md5_update(h_ota->raw_md5, buf, len);
+    }
+
+    return h_ota->sink(h_ota->sink_user_data, offset, buf, len);
+}
+
+/* output of decompressor, which is a patch for delta firmware */
+static int _ota_decoder_output(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)user_data;
+
+    if (NULL != h_ota->patcher) {
+        return utils_patch_feed(h_ota->patcher, buf, len);
+    }
+
+    return _ota_image_output(user_data, offset, buf, len);
+}
+
+static int _ota_patch_source_read(void *user_data, uint32_t offset, char *buf, uint32_t len)
+{
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)user_data;
+
+    return h_ota->source_read(h_ota->sink_user_data, offset, buf, len);
+}
+
+static void _ota_decoder_deinit(OTA_Struct_t *h_ota)
+{
+    utils_decompress_deinit(h_ota->decoder);
+    h_ota->decoder = NULL;
+    utils_patch_deinit(h_ota->patcher);
+    h_ota->patcher = NULL;
+    qcloud_otalib_md5_deinit(h_ota->raw_md5);
+    h_ota->raw_md5 = NULL;
+}
+
+static int _ota_decompress_init(OTA_Struct_t *h_ota)
+{
+    eDecompressFormat format;
+    uint8_t           window_bits    = h_ota->compress.window_bits;
+    uint8_t           lookahead_bits = h_ota->compress.lookahead_bits;
+
+    if (IOT_OTAC_HEATSHRINK == h_ota->compress.type) {
+        format         = DECOMPRESS_HEATSHRINK;
+        window_bits    = window_bits ? window_bits : OTA_HEATSHRINK_WINDOW_BITS_DEFAULT;
+        lookahead_bits = lookahead_bits ? lookahead_bits : OTA_HEATSHRINK_LOOKAHEAD_BITS_DEFAULT;
+    } else {
+        format      = (IOT_OTAC_GZIP == h_ota->compress.type) ? DECOMPRESS_GZIP : DECOMPRESS_ZLIB;
+        window_bits = window_bits ? window_bits : OTA_INFLATE_WINDOW_BITS_DEFAULT;
+    }
+
+    h_ota->decoder = utils_decompress_init(format, window_bits, lookahead_bits, _ota_decoder_output, h_ota);
+    return (NULL == h_ota->decoder) ? IOT_OTA_ERR_DECOMPRESS : QCLOUD_RET_SUCCESS;
+}
+
+static int _ota_decoder_init(OTA_Struct_t *h_ota, OTAPipelineParams *pParams)
+{
+    int ret = QCLOUD_RET_SUCCESS;
+
+    if (IOT_OTAD_NONE != h_ota->compress.delta && NULL == pParams->source_read) {
+        Log_e("delta firmware needs source_read of running firmware");
+        h_ota->err = IOT_OTA_ERR_INVALID_PARAM;
+        return IOT_OTA_ERR_INVALID_PARAM;
+    }
+
+    if (0 != h_ota->size_fetched) {
+        // decompressor and patcher state is not checkpointed, so decoding restarts with the download
+        Log_w("compressed or delta firmware can not resume from offset %u, download from 0", h_ota->size_fetched);
+        ret = IOT_OTA_StartDownload(h_ota, 0, h_ota->size_file);
+        if (QCLOUD_RET_SUCCESS != ret) {
+            h_ota->err = ret;
+            return ret;
+        }
+    }
+
+    h_ota->sink           = pParams->sink;
+    h_ota->source_read    = pParams->source_read;
+    h_ota->sink_user_data = pParams->user_data;
+    h_ota->decoded        = 1;
+    h_ota->raw_valid      = 0;
+
+    if (IOT_OTAC_NONE != h_ota->compress.type) {
+        ret = _ota_decompress_init(h_ota);
+    }
+
+    if (QCLOUD_RET_SUCCESS == ret && IOT_OTAD_NONE != h_ota->compress.delta) {
+        h_ota->patcher = utils_patch_init(pParams->source_size, _ota_patch_source_read, _ota_image_output, h_ota);
+        ret            = (NULL == h_ota->patcher) ? IOT_OTA_ERR_PATCH : QCLOUD_RET_SUCCESS;
+    }
+
+    if (QCLOUD_RET_SUCCESS == ret && '\0' != h_ota->compress.raw_md5sum[0] &&
+        NULL == (h_ota->raw_md5 = qcloud_otalib_md5_init())) {
+        ret = IOT_OTA_ERR_NOMEM;
+    }
+
+    if (QCLOUD_RET_SUCCESS != ret) {
+        _ota_decoder_deinit(h_ota);
+        h_ota->err = ret;
+    }
+
+    return ret;
+}
+
+/* check decoded firmware: stream check value, size and MD5 if advertised */
+static int _ota_decoder_finish(OTA_Struct_t *h_ota)
+{
+    char     md5_str[33];
+    int      err = (NULL != h_ota->patcher) ? IOT_OTA_ERR_PATCH : IOT_OTA_ERR_DECOMPRESS;
+    uint32_t raw_size;
+
+    if (NULL != h_ota->decoder && QCLOUD_RET_SUCCESS != utils_decompress_finish(h_ota->decoder)) {
+        return IOT_OTA_ERR_DECOMPRESS;
+    }
+
+    if (NULL != h_ota->patcher) {
+        if (QCLOUD_RET_SUCCESS != utils_patch_finish(h_ota->patcher)) {
+            return IOT_OTA_ERR_PATCH;
+        }
+        raw_size = utils_patch_total_out(h_ota->patcher);
+    } else {
+        raw_size = utils_decompress_total_out(h_ota->decoder);
+    }
+
+    if (h_ota->compress.raw_size && raw_size != h_ota->compress.raw_size) {
+        Log_e("decoded size %u mismatch, expect %u", raw_size, h_ota->compress.raw_size);
+        return err;
+    }
+
+    if (NULL != h_ota->raw_md5) {
+        qcloud_otalib_md5_finalize(h_ota->raw_md5, md5_str);
+        if (0 != strcmp(h_ota->compress.raw_md5sum, md5_str)) {
+            Log_e("decoded md5 %s mismatch, expect %s", md5_str, h_ota->compress.raw_md5sum);
+            return err;
+        }
+    }
+
+    Log_i("decoded firmware size: %u", raw_size);
+    h_ota->raw_valid = 1;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* write data to sink or decoder, MD5 only covers data accepted by sink so it can be checkpointed */
+static int _ota_sink_write(OTA_Struct_t *h_ota, OTASinkCallback sink, void *user_data, uint32_t offset,
+                           const char *buf, uint32_t len)
+{
+    int ret;
+
+    // hash and check digest before writing
+    ret = _ota_verify_update(h_ota, buf, len);
+    if (ret != QCLOUD_RET_SUCCESS) {
+        return ret;
+    }
+
+    if (NULL != h_ota->decoder) {
+        ret = utils_decompress_feed(h_ota->decoder, buf, len);
+    } else if (NULL != h_ota->patcher) {
+        ret = utils_patch_feed(h_ota->patcher, buf, len);
+    } else {
+        ret = sink(user_data, offset, buf, len);
+    }
+    if (ret != QCLOUD_RET_SUCCESS) {
+        return ret;
+    }
+
+    qcloud_otalib_md5_update(h_ota->md5, buf, len);
+    h_ota->size_committed = offset + len;
+
+    if (!h_ota->decoded && h_ota->size_committed - h_ota->size_checkpoint >= OTA_CHECKPOINT_INTERVAL &&
+        h_ota->size_committed < h_ota->size_file) {
+        _ota_save_checkpoint(h_ota, h_ota->size_committed);
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* hand data to sink, with block digests it is written a whole block at a time once the block is checked */
+static int _ota_sink_commit(OTA_Struct_t *h_ota, OTASinkCallback sink, void *user_data, uint32_t offset,
+                            const char *buf, uint32_t len)
+{
+    uint32_t block_size = h_ota->verify_params.block_size;
+    uint32_t start, n;
+    int      ret;
+
+    if (NULL == h_ota->block_buf) {
+        return _ota_sink_write(h_ota, sink, user_data, offset, buf, len);
+    }
+
+    while (len > 0) {
+        start = offset - h_ota->block_len;
+        n     = OTA_MIN(len, block_size - start % block_size - h_ota->block_len);
+        memcpy(h_ota->block_buf + h_ota->block_len, buf, n);
+        h_ota->block_len += n;
+        offset += n;
+        buf += n;
+        len -= n;
+
+        if (0 != offset % block_size && offset < h_ota->size_file) {
+            continue;
+        }
+
+        ret              = _ota_sink_write(h_ota, sink, user_data, start, h_ota->block_buf, h_ota->block_len);
+        h_ota->block_len = 0;
+        if (ret != QCLOUD_RET_SUCCESS) {
+            return ret;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _ota_fetch_serial(OTA_Struct_t *h_ota, OTAPipelineParams *pParams)
+{
+    int      ret = QCLOUD_RET_SUCCESS;
+    uint32_t offset;
+    char *   buf;
+
+    if (NULL == (buf = HAL_Malloc(pParams->buf_len))) {
+        Log_e("allocate for ota buffer failed");
+        h_ota->err = IOT_OTA_ERR_NOMEM;
+        return IOT_OTA_ERR_NOMEM;
+    }
+
+    while (!IOT_OTA_IsFetchFinish(h_ota)) {
+        offset = h_ota->size_fetched;
+        ret    = _ota_fetch(h_ota, buf, pParams->buf_len, pParams->timeout_s);
+        if (ret <= 0) {
+            ret = (ret < 0) ? ret : IOT_OTA_ERR_FETCH_TIMEOUT;
+            break;
+        }
+
+        ret = _ota_sink_commit(h_ota, pParams->sink, pParams->user_data, offset, buf, ret);
+        if (ret != QCLOUD_RET_SUCCESS) {
+            break;
+        }
+    }
+
+    HAL_Free(buf);
+    return ret;
+}
+
+#ifdef MULTITHREAD_ENABLED
+static void _ota_sink_thread(void *arg)
+{
+    OTA_Pipeline_t *pipe = (OTA_Pipeline_t *)arg;
+    uint16_t        idx  = 0;
+    int             ret;
+
+    for (;;) {
+        if (HAL_SemaphoreWait(pipe->full_sem, OTA_PIPELINE_WAIT_MS) != QCLOUD_RET_SUCCESS) {
+            continue;
+        }
+
+        if (0 == pipe->lens[idx]) {
+            break;
+        }
+
+        // keep draining the ring after error, so network stage won't block
+        if (QCLOUD_RET_SUCCESS == pipe->sink_err) {
+            ret = _ota_sink_commit(pipe->h_ota, pipe->sink, pipe->user_data, pipe->offsets[idx], pipe->bufs[idx],
+                                   pipe->lens[idx]);
+            if (ret != QCLOUD_RET_SUCCESS) {
+                Log_e("ota sink failed at offset %u: %d", pipe->offsets[idx], ret);
+                pipe->sink_err = ret;
+            }
+        }
+
+        HAL_SemaphorePost(pipe->free_sem);
+        idx = (idx + 1) % pipe->buf_num;
+    }
+
+    HAL_SemaphorePost(pipe->done_sem);
+}
+
+static void _ota_pipeline_free(OTA_Pipeline_t *pipe)
+{
+    if (NULL != pipe->free_sem) {
+        HAL_SemaphoreDestroy(pipe->free_sem);
+    }
+    if (NULL != pipe->full_sem) {
+        HAL_SemaphoreDestroy(pipe->full_sem);
+    }
+    if (NULL != pipe->done_sem) {
+        HAL_SemaphoreDestroy(pipe->done_sem);
+    }
+    HAL_Free(pipe);
+}
+
+static int _ota_fetch_pipelined(OTA_Struct_t *h_ota, OTAPipelineParams *pParams)
+{
+    int             ret = QCLOUD_RET_SUCCESS;
+    OTA_Pipeline_t *pipe;
+    char *          mem;
+    uint16_t        i, idx = 0;
+    uint32_t        offset;
+
+    // pipeline control, buffer pointers, lengths, offsets and buffers in one allocation
+    mem = HAL_Malloc(sizeof(OTA_Pipeline_t) +
+                     pParams->buf_num * (sizeof(char *) + 2 * sizeof(uint32_t) + pParams->buf_len));
+    if (NULL == mem) {
+        Log_e("allocate for ota pipeline failed");
+        h_ota->err = IOT_OTA_ERR_NOMEM;
+        return IOT_OTA_ERR_NOMEM;
+    }
+
+    pipe = (OTA_Pipeline_t *)mem;
+    memset(pipe, 0, sizeof(OTA_Pipeline_t));
+    pipe->h_ota     = h_ota;
+    pipe->sink      = pParams->sink;
+    pipe->user_data = pParams->user_data;
+    pipe->buf_num   = pParams->buf_num;
+    pipe->bufs      = (char **)(mem + sizeof(OTA_Pipeline_t));
+    pipe->lens      = (uint32_t *)(pipe->bufs + pipe->buf_num);
+    pipe->offsets   = pipe->lens + pipe->buf_num;
+    for (i = 0; i < pipe->buf_num; i++) {
+        pipe->bufs[i] = (char *)(pipe->offsets + pipe->buf_num) + i * pParams->buf_len;
+    }
+
+    pipe->free_sem = HAL_SemaphoreCreate();
+    pipe->full_sem = HAL_SemaphoreCreate();
+    pipe->done_sem = HAL_SemaphoreCreate();
+    if (NULL == pipe->free_sem || NULL == pipe->full_sem || NULL == pipe->done_sem) {
+        Log_e("create ota pipeline semaphore failed");
+        _ota_pipeline_free(pipe);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    for (i = 0; i < pipe->buf_num; i++) {
+        HAL_SemaphorePost(pipe->free_sem);
+    }
+
+    pipe->thread_params.thread_func = _ota_sink_thread;
+    pipe->thread_params.thread_name = OTA_SINK_TASK_NAME;
+    pipe->thread_params.user_arg    = pipe;
+    pipe->thread_params.stack_size  = OTA_SINK_TASK_STACK_BYTES;
+    pipe->thread_params.priority    = OTA_SINK_TASK_PRIO;
+    if (HAL_ThreadCreate(&pipe->thread_params) != QCLOUD_RET_SUCCESS) {
+        Log_e("create ota sink task failed");
+        _ota_pipeline_free(pipe);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    // network stage: fetch while the sink stage writes and hashes previous buffers
+    while (!IOT_OTA_IsFetchFinish(h_ota)) {
+        if (QCLOUD_RET_SUCCESS != pipe->sink_err) {
+            ret = pipe->sink_err;
+            break;
+        }
+
+        if (HAL_SemaphoreWait(pipe->free_sem, OTA_PIPELINE_WAIT_MS) != QCLOUD_RET_SUCCESS) {
+            continue;
+        }
+
+        offset = h_ota->size_fetched;
+        ret    = _ota_fetch(h_ota, pipe->bufs[idx], pParams->buf_len, pParams->timeout_s);
+        if (ret <= 0) {
+            ret = (ret < 0) ? ret : IOT_OTA_ERR_FETCH_TIMEOUT;
+            HAL_SemaphorePost(pipe->free_sem);
+            break;
+        }
+
+        pipe->lens[idx]    = ret;
+        pipe->offsets[idx] = offset;
+        ret                = QCLOUD_RET_SUCCESS;
+        HAL_SemaphorePost(pipe->full_sem);
+        idx = (idx + 1) % pipe->buf_num;
+    }
+
+    // mark end of stream and wait for the sink stage to drain the ring
+    while (HAL_SemaphoreWait(pipe->free_sem, OTA_PIPELINE_WAIT_MS) != QCLOUD_RET_SUCCESS) {
+    }
+    pipe->lens[idx] = 0;
+    HAL_SemaphorePost(pipe->full_sem);
+
+    while (HAL_SemaphoreWait(pipe->done_sem, OTA_PIPELINE_WAIT_MS) != QCLOUD_RET_SUCCESS) {
+    }
+
+    if (QCLOUD_RET_SUCCESS == ret) {
+        ret = pipe->sink_err;
+    }
+
+    _ota_pipeline_free(pipe);
+    return ret;
+}
+#endif
+
+int IOT_OTA_FetchPipeline(void *handle, OTAPipelineParams *pParams)
+{
+    int           ret   = QCLOUD_RET_SUCCESS;
+    OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
+
+    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
+    POINTER_SANITY_CHECK(pParams, IOT_OTA_ERR_INVALID_PARAM);
+    POINTER_SANITY_CHECK(pParams->sink, IOT_OTA_ERR_INVALID_PARAM);
+    NUMBERIC_SANITY_CHECK(pParams->buf_len, IOT_OTA_ERR_INVALID_PARAM);
+    NUMBERIC_SANITY_CHECK(pParams->buf_num, IOT_OTA_ERR_INVALID_PARAM);
+
+    if (IOT_OTAS_FETCHING != h_ota->state) {
+        h_ota->err = IOT_OTA_ERR_INVALID_STATE;
+        return IOT_OTA_ERR_INVALID_STATE;
+    }
+
+    if (IOT_OTAC_NONE != h_ota->compress.type || IOT_OTAD_NONE != h_ota->compress.delta) {
+        ret = _ota_decoder_init(h_ota, pParams);
+        if (QCLOUD_RET_SUCCESS != ret) {
+            return ret;
+        }
+    }
+
+    // blocks are held in RAM until checked, so that a corrupt one is never written
+    h_ota->block_len = 0;
+    if (NULL != h_ota->verify && 0 != h_ota->verify_params.block_size &&
+        NULL == (h_ota->block_buf = HAL_Malloc(h_ota->verify_params.block_size))) {
+        Log_e("allocate for ota block failed");
+        ret = IOT_OTA_ERR_NOMEM;
+    }
+
+    if (QCLOUD_RET_SUCCESS == ret) {
+#ifdef MULTITHREAD_ENABLED
+        if (pParams->buf_num > 1) {
+            ret = _ota_fetch_pipelined(h_ota, pParams);
+        } else
+#endif
+        {
+            ret = _ota_fetch_serial(h_ota, pParams);
+        }
+    }
+
+    HAL_Free(h_ota->block_buf);
+    h_ota->block_buf = NULL;
+
+    if (h_ota->decoded) {
+        if (QCLOUD_RET_SUCCESS == ret) {
+            ret = _ota_decoder_finish(h_ota);
+        }
+        _ota_decoder_deinit(h_ota);
+    }
+
+    if (IOT_OTA_ERR_VERIFY == ret) {
+        // corrupt block is written, download has to start over
+        _ota_clear_checkpoint(h_ota);
+        IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_MD5_NOT_MATCH);
+        h_ota->err = ret;
+    } else if (!h_ota->decoded && ret != QCLOUD_RET_SUCCESS && h_ota->size_committed > h_ota->size_checkpoint) {
+        // sink stage has stopped, so MD5 matches the committed size exactly
+        _ota_save_checkpoint(h_ota, h_ota->size_committed);
+    }
+
+    return ret;
+}
+
+#if defined(OTA_PARALLEL_FETCH) && defined(MULTITHREAD_ENABLED)
+static void _ota_range_save_checkpoint(OTA_Parallel_t *par)
+{
+    OTA_Struct_t *        h_ota = par->h_ota;
+    OTA_RangeCheckpoint_t ckpt;
+    uint16_t              i;
+    int                   ret;
+
+    memset(&ckpt, 0, sizeof(OTA_RangeCheckpoint_t));
+    ckpt.magic     = OTA_RANGE_CHECKPOINT_MAGIC;
+    ckpt.file_size = h_ota->size_file;
+    ckpt.range_num = par->params->range_num;
+    strncpy(ckpt.md5sum, h_ota->md5sum, sizeof(ckpt.md5sum) - 1);
+    strncpy(ckpt.version, h_ota->version, sizeof(ckpt.version) - 1);
+    for (i = 0; i < par->params->range_num; i++) {
+        ckpt.next[i] = par->ranges[i].next;
+    }
+
+    ret = HAL_Kv_Set(OTA_RANGE_CHECKPOINT_KEY, &ckpt, sizeof(OTA_RangeCheckpoint_t));
+    if (QCLOUD_RET_SUCCESS != ret) {
+        Log_w("save ota range checkpoint failed: %d", ret);
+        return;
+    }
+
+    for (i = 0; i < par->params->range_num; i++) {
+        par->ranges[i].saved = par->ranges[i].next;
+    }
+}
+
+/* resume ranges if the checkpoint matches the firmware and the split */
+static void _ota_range_load_checkpoint(OTA_Parallel_t *par)
+{
+    OTA_Struct_t *        h_ota = par->h_ota;
+    OTA_RangeCheckpoint_t ckpt;
+    uint32_t              len = sizeof(OTA_RangeCheckpoint_t);
+    uint32_t              block_size;
+    OTA_Range_t *         range;
+    uint16_t              i;
+
+    if (QCLOUD_RET_SUCCESS != HAL_Kv_Get(OTA_RANGE_CHECKPOINT_KEY, &ckpt, &len) ||
+        len != sizeof(OTA_RangeCheckpoint_t)) {
+        return;
+    }
+
+    ckpt.md5sum[sizeof(ckpt.md5sum) - 1]   = '\0';
+    ckpt.version[sizeof(ckpt.version) - 1] = '\0';
+    if (OTA_RANGE_CHECKPOINT_MAGIC != ckpt.magic || h_ota->size_file != ckpt.file_size ||
+        par->params->range_num != ckpt.range_num || strcmp(ckpt.md5sum, h_ota->md5sum) ||
+        strncmp(ckpt.version, h_ota->version, sizeof(ckpt.version) - 1)) {
+        Log_w("ota range checkpoint of %s mismatch", ckpt.version);
+        return;
+    }
+
+    block_size = h_ota->verify_params.block_size;
+    for (i = 0; i < par->params->range_num; i++) {
+        range = &par->ranges[i];
+        if (ckpt.next[i] > range->start && ckpt.next[i] <= range->end &&
+            (0 == block_size || 0 == ckpt.next[i] % block_size || ckpt.next[i] == range->end)) {
+            range->next  = ckpt.next[i];
+            range->saved = ckpt.next[i];
+            h_ota->size_fetched += range->next - range->start;
+        }
+    }
+    Log_i("resume ota ranges, fetched size: %u", h_ota->size_fetched);
+}
+
+static int _ota_range_commit(OTA_Range_t *range, const char *buf, uint32_t len)
+{
+    OTA_Parallel_t *par   = range->par;
+    OTA_Struct_t *  h_ota = par->h_ota;
+    int             ret;
+
+    HAL_MutexLock(par->lock);
+    ret = par->params->sink(par->params->user_data, range->next, buf, len);
+    if (QCLOUD_RET_SUCCESS == ret) {
+        range->next += len;
+        h_ota->size_fetched += len;
+        if (range->next - range->saved >= OTA_CHECKPOINT_INTERVAL && range->next < range->end) {
+            _ota_range_save_checkpoint(par);
+        }
+    }
+    HAL_MutexUnlock(par->lock);
 
     return ret;
 }
 
+/* with block digests, hold data of the range until its block is complete, and write the block once it is checked */
+static int _ota_range_block_commit(OTA_Range_t *range, uint32_t len)
+{
+    OTA_Struct_t *h_ota      = range->par->h_ota;
+    uint32_t      block_size = h_ota->verify_params.block_size;
+    const char *  buf        = range->buf;
+    uint32_t      n, index;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    int           ret;
+
+    if (NULL == range->block) {
+        return _ota_range_commit(range, buf, len);
+    }
+
+    while (len > 0) {
+        n = OTA_MIN(len, block_size - range->block_len);
+        memcpy(range->block + range->block_len, buf, n);
+        range->block_len += n;
+        buf += n;
+        len -= n;
+
+        if (range->block_len < block_size && range->next + range->block_len < range->end) {
+            continue;
+        }
+
+        index = range->next / block_size;
+        utils_sha256((const unsigned char *)range->block, range->block_len, digest);
+        if (index >= h_ota->verify_params.block_num ||
+            0 != memcmp(digest, h_ota->verify_params.block_digests[index], SHA256_DIGEST_SIZE)) {
+            Log_e("digest of block %u at offset %u mismatch", index, range->next);
+            return IOT_OTA_ERR_VERIFY;
+        }
+
+        ret              = _ota_range_commit(range, range->block, range->block_len);
+        range->block_len = 0;
+        if (QCLOUD_RET_SUCCESS != ret) {
+            return ret;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* fetch one range, reconnecting from where it stopped on failure */
+static void _ota_range_thread(void *arg)
+{
+    OTA_Range_t *   range   = (OTA_Range_t *)arg;
+    OTA_Parallel_t *par     = range->par;
+    void *          ch      = NULL;
+    uint32_t        len;
+    int             retries = 0;
+    int             ret     = QCLOUD_RET_SUCCESS;
+
+    while (range->next < range->end && QCLOUD_RET_SUCCESS == par->err) {
+        if (NULL == ch) {
+            if (NULL == (ch = ofc_Init(par->h_ota->purl, range->next, range->end - 1))) {
+                ret = IOT_OTA_ERR_NOMEM;
+                break;
+            }
+            ret = qcloud_ofc_connect(ch);
+        }
+
+        if (QCLOUD_RET_SUCCESS == ret) {
+            // one more byte for the terminating null of http client
+            len = OTA_MIN(par->params->buf_len, range->end - range->next - range->block_len + 1);
+            ret = qcloud_ofc_fetch(ch, range->buf, len, par->params->timeout_s);
+            if (ret > 0) {
+                ret = _ota_range_block_commit(range, ret);
+                if (QCLOUD_RET_SUCCESS != ret) {
+                    Log_e("ota sink failed at offset %u: %d", range->next, ret);
+                    par->sink_failed = 1;
+                    break;
+                }
+                retries = 0;
+                continue;
+            }
+            ret = (ret < 0) ? ret : IOT_OTA_ERR_FETCH_TIMEOUT;
+        }
+
+        if (IOT_OTA_ERR_FETCH_NOT_EXIST == ret || IOT_OTA_ERR_FETCH_AUTH_FAIL == ret ||
+            ++retries > OTA_RANGE_RETRY_MAX) {
+            break;
+        }
+
+        Log_w("ota range [%u, %u) failed at %u: %d, retry %d", range->start, range->end, range->next, ret, retries);
+        qcloud_ofc_deinit(ch);
+        ch               = NULL;
+        range->block_len = 0;  // refetch the block from its start
+    }
+
+    qcloud_ofc_deinit(ch);
+
+    if (range->next < range->end) {
+        HAL_MutexLock(par->lock);
+        if (QCLOUD_RET_SUCCESS == par->err) {
+            par->err = (QCLOUD_RET_SUCCESS == ret) ? IOT_OTA_ERR_FETCH_FAILED : ret;
+        }
+        HAL_MutexUnlock(par->lock);
+    }
+
+    HAL_SemaphorePost(par->done_sem);
+}
+
+/* MD5 over the whole firmware in order, as the ranges are sunk out of order */
+static int _ota_range_md5(OTA_Struct_t *h_ota, OTAParallelParams *pParams, char *buf)
+{
+    uint32_t offset, len;
+    int      ret;
+
+    ret = IOT_OTA_ResetClientMD5(h_ota);
+    if (QCLOUD_RET_SUCCESS != ret) {
+        return IOT_OTA_ERR_NOMEM;
+    }
+
+    for (offset = 0; offset < h_ota->size_file; offset += len) {
+        len = OTA_MIN(pParams->buf_len, h_ota->size_file - offset);
+        ret = pParams->read_back(pParams->user_data, offset, buf, len);
+        if (QCLOUD_RET_SUCCESS != ret) {
+            Log_e("ota read back failed at offset %u: %d", offset, ret);
+            return ret;
+        }
+        qcloud_otalib_md5_update(h_ota->md5, buf, len);
+        ret = _ota_verify_update(h_ota, buf, len);
+        if (QCLOUD_RET_SUCCESS != ret) {
+            return ret;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_OTA_FetchParallel(void *handle, OTAParallelParams *pParams)
+{
+    OTA_Struct_t *  h_ota = (OTA_Struct_t *)handle;
+    OTA_Parallel_t *par;
+    OTA_Range_t *   range;
+    uint16_t        i, started = 0, done = 0;
+    uint32_t        percent, block_size;
+    int             ret = QCLOUD_RET_SUCCESS;
+    Timer           report_timer;
+
+    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
+    POINTER_SANITY_CHECK(pParams, IOT_OTA_ERR_INVALID_PARAM);
+    POINTER_SANITY_CHECK(pParams->sink, IOT_OTA_ERR_INVALID_PARAM);
+    POINTER_SANITY_CHECK(pParams->read_back, IOT_OTA_ERR_INVALID_PARAM);
+    NUMBERIC_SANITY_CHECK(pParams->buf_len, IOT_OTA_ERR_INVALID_PARAM);
+    NUMBERIC_SANITY_CHECK(pParams->range_num, IOT_OTA_ERR_INVALID_PARAM);
+
+    if (pParams->range_num > OTA_PARALLEL_RANGE_MAX || pParams->buf_len < 2) {
+        h_ota->err = IOT_OTA_ERR_INVALID_PARAM;
+        return IOT_OTA_ERR_INVALID_PARAM;
+    }
+
+    if (IOT_OTAS_FETCHING != h_ota->state || 0 == h_ota->size_file) {
+        h_ota->err = IOT_OTA_ERR_INVALID_STATE;
+        return IOT_OTA_ERR_INVALID_STATE;
+    }
+
+    if (IOT_OTAC_NONE != h_ota->compress.type || IOT_OTAD_NONE != h_ota->compress.delta) {
+        // decoding needs the stream in order
+        Log_e("compressed or delta firmware can not be fetched in parallel");
+        h_ota->err = IOT_OTA_ERR_INVALID_STATE;
+        return IOT_OTA_ERR_INVALID_STATE;
+    }
+
+    // blocks are held in RAM until checked, so that a corrupt one is never written
+    block_size = h_ota->verify_params.block_size;
+
+    // control, buffers and blocks of all ranges in one allocation
+    par = HAL_Malloc(sizeof(OTA_Parallel_t) + pParams->range_num * (pParams->buf_len + block_size));
+    if (NULL == par) {
+        Log_e("allocate for ota ranges failed");
+        h_ota->err = IOT_OTA_ERR_NOMEM;
+        return IOT_OTA_ERR_NOMEM;
+    }
+
+    memset(par, 0, sizeof(OTA_Parallel_t));
+    par->h_ota          = h_ota;
+    par->params         = pParams;
+    h_ota->size_fetched = 0;
+    h_ota->decoded      = 0;
+    for (i = 0; i < pParams->range_num; i++) {
+        range        = &par->ranges[i];
+        range->par   = par;
+        range->start = (uint32_t)((uint64_t)h_ota->size_file * i / pParams->range_num);
+        range->end   = (uint32_t)((uint64_t)h_ota->size_file * (i + 1) / pParams->range_num);
+        if (block_size) {
+            // ranges are split at block boundaries, so each block is checked by one range
+            range->start -= range->start % block_size;
+            range->end   = (i + 1 == pParams->range_num) ? range->end : range->end - range->end % block_size;
+            range->block = (char *)(par + 1) + pParams->range_num * pParams->buf_len + i * block_size;
+        }
+        range->next  = range->start;
+        range->saved = range->start;
+        range->buf   = (char *)(par + 1) + i * pParams->buf_len;
+    }
+    _ota_range_load_checkpoint(par);
+
+    par->lock     = HAL_MutexCreate();
+    par->done_sem = HAL_SemaphoreCreate();
+    if (NULL == par->lock || NULL == par->done_sem) {
+        Log_e("create ota range lock failed");
+        ret = QCLOUD_ERR_FAILURE;
+        goto exit;
+    }
+
+    IOT_OTA_ReportProgress(h_ota, h_ota->size_fetched * (uint64_t)100 / h_ota->size_file, IOT_OTAR_DOWNLOAD_BEGIN);
+    InitTimer(&report_timer);
+    countdown(&report_timer, 1);
+
+    for (i = 0; i < pParams->range_num; i++) {
+        range = &par->ranges[i];
+        if (range->next == range->end) {
+            continue;
+        }
+
+        range->thread_params.thread_func = _ota_range_thread;
+        range->thread_params.thread_name = OTA_RANGE_TASK_NAME;
+        range->thread_params.user_arg    = range;
+        range->thread_params.stack_size  = OTA_RANGE_TASK_STACK_BYTES;
+        range->thread_params.priority    = OTA_RANGE_TASK_PRIO;
+        if (HAL_ThreadCreate(&range->thread_params) != QCLOUD_RET_SUCCESS) {
+            Log_e("create ota range task failed");
+            HAL_MutexLock(par->lock);
+            par->err = (QCLOUD_RET_SUCCESS == par->err) ? QCLOUD_ERR_FAILURE : par->err;
+            HAL_MutexUnlock(par->lock);
+            break;
+        }
+        started++;
+    }
+
+    // report percent every second until all range tasks quit
+    while (done < started) {
+        if (HAL_SemaphoreWait(par->done_sem, OTA_PIPELINE_WAIT_MS) == QCLOUD_RET_SUCCESS) {
+            done++;
+        }
+
+        if (expired(&report_timer)) {
+            percent = h_ota->size_fetched * (uint64_t)100 / h_ota->size_file;
+            IOT_OTA_ReportProgress(h_ota, percent, IOT_OTAR_DOWNLOADING);
+            countdown(&report_timer, 1);
+        }
+    }
+
+    ret = par->err;
+    if (IOT_OTA_ERR_VERIFY == ret) {
+        _ota_clear_checkpoint(h_ota);
+        IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_MD5_NOT_MATCH);
+        h_ota->err = ret;
+        goto exit;
+    } else if (QCLOUD_RET_SUCCESS != ret) {
+        _ota_range_save_checkpoint(par);
+        if (par->sink_failed) {
+            h_ota->err = ret;
+        } else {
+            _ota_fetch_failed(h_ota, ret);
+        }
+        goto exit;
+    }
+
+    IOT_OTA_ReportProgress(h_ota, IOT_OTAP_FETCH_PERCENTAGE_MAX, IOT_OTAR_DOWNLOADING);
+
+    ret = _ota_range_md5(h_ota, pParams, par->ranges[0].buf);
+    if (IOT_OTA_ERR_VERIFY == ret) {
+        _ota_clear_checkpoint(h_ota);
+        IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_MD5_NOT_MATCH);
+    }
+    if (QCLOUD_RET_SUCCESS != ret) {
+        h_ota->err = ret;
+        goto exit;
+    }
+
+    h_ota->size_committed = h_ota->size_file;
+    h_ota->state          = IOT_OTAS_FETCHED;
+
+exit:
+    if (NULL != par->lock) {
+        HAL_MutexDestroy(par->lock);
+    }
+    if (NULL != par->done_sem) {
+        HAL_SemaphoreDestroy(par->done_sem);
+    }
+    HAL_Free(par);
+    return ret;
+}
+#endif
+
 int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType type, void *buf, size_t buf_len)
 {
     OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
@@ -656,8 +1882,10 @@ int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType type, void *buf, size_t buf_len)
             } else {
                 char md5_str[33];
                 qcloud_otalib_md5_finalize(h_ota->md5, md5_str);
+                _ota_clear_checkpoint(h_ota);
                 Log_d("origin=%s, now=%s", h_ota->md5sum, md5_str);
-                if (0 == strcmp(h_ota->md5sum, md5_str)) {
+                if (0 == strcmp(h_ota->md5sum, md5_str) && (!h_ota->decoded || h_ota->raw_valid) &&
+                    QCLOUD_RET_SUCCESS == _ota_verify_finish(h_ota)) {
                     *((uint32_t *)buf) = 1;
                 } else {
                     *((uint32_t *)buf) = 0;
@@ -667,6 +1895,34 @@ int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType type, void *buf, size_t buf_len)
                 return 0;
             }
 
+        case IOT_OTAG_SHA256SUM:
+            strncpy(buf, h_ota->compress.sha256sum, buf_len);
+            ((char *)buf)[buf_len - 1] = '\0';
+            break;
+
+        case IOT_OTAG_SOURCE_VERSION:
+            strncpy(buf, h_ota->compress.source_version, buf_len);
+            ((char *)buf)[buf_len - 1] = '\0';
+            break;
+
+        case IOT_OTAG_COMPRESS_TYPE:
+        case IOT_OTAG_RAW_FILE_SIZE:
+        case IOT_OTAG_DELTA_TYPE:
+            if ((4 != buf_len) || (0 != ((unsigned long)buf & 0x3))) {
+                Log_e("Invalid parameter");
+                h_ota->err = IOT_OTA_ERR_INVALID_PARAM;
+                return QCLOUD_ERR_FAILURE;
+            } else if (IOT_OTAG_COMPRESS_TYPE == type) {
+                *((uint32_t *)buf) = h_ota->compress.type;
+            } else if (IOT_OTAG_DELTA_TYPE == type) {
+                *((uint32_t *)buf) = h_ota->compress.delta;
+            } else {
+                *((uint32_t *)buf) = (IOT_OTAC_NONE == h_ota->compress.type && IOT_OTAD_NONE == h_ota->compress.delta)
+                                         ? h_ota->size_file
+                                         : h_ota->compress.raw_size;
+            }
+            return 0;
+
         default:
             Log_e("invalid cmd type");
             h_ota->err = IOT_OTA_ERR_INVALID_PARAM;
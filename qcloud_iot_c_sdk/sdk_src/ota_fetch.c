@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_OTA
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -39,6 +41,7 @@ typedef struct {
     const char *   url;
     HTTPClient     http;      /* http client */
     HTTPClientData http_data; /* http client data */
+    char           head_content[OTA_HTTP_HEAD_CONTENT_LEN]; /* request header, own for each parallel fetch */
 
 } OTAHTTPStruct;
 
@@ -63,8 +66,7 @@ static int is_begin_with(const char *str1, char *str2)
 }
 #endif
 
-static char sg_head_content[OTA_HTTP_HEAD_CONTENT_LEN];
-void *      ofc_Init(const char *url, uint32_t offset, uint32_t size)
+void *ofc_Init(const char *url, uint32_t offset, uint32_t size)
 {
     OTAHTTPStruct *h_odc;
 
@@ -74,18 +76,17 @@ void *      ofc_Init(const char *url, uint32_t offset, uint32_t size)
     }
 
     memset(h_odc, 0, sizeof(OTAHTTPStruct));
-    memset(sg_head_content, 0, OTA_HTTP_HEAD_CONTENT_LEN);
-    HAL_Snprintf(sg_head_content, OTA_HTTP_HEAD_CONTENT_LEN,
+    HAL_Snprintf(h_odc->head_content, OTA_HTTP_HEAD_CONTENT_LEN,
                  "Accept: "
                  "text/html,application/xhtml+xml,application/xml;q=0.9,*/"
                  "*;q=0.8\r\n"
-                 "Accept-Encoding: gzip, deflate\r\n"
+                 "Accept-Encoding: identity\r\n"
                  "Range: bytes=%d-%d\r\n",
                  offset, size);
 
-    Log_d("head_content:%s", sg_head_content);
+    Log_d("head_content:%s", h_odc->head_content);
     /* set http request-header parameter */
-    h_odc->http.header = sg_head_content;
+    h_odc->http.header = h_odc->head_content;
     h_odc->url         = url;
 
     return h_odc;
@@ -148,10 +149,8 @@ int qcloud_ofc_deinit(void *handle)
         IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
     }
 
-    if (h_odc->http.network_stack.is_connected(&h_odc->http.network_stack))
-    {
-        h_odc->http.network_stack.disconnect(&h_odc->http.network_stack);
-    }
+    // connection is kept for next fetch if the response is read up
+    qcloud_http_client_release(&h_odc->http, &h_odc->http_data);
 
         HAL_Free(handle);
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
@@ -18,13 +18,17 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_OTA
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include "ota_lib.h"
 
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "lite-utils.h"
@@ -193,7 +197,93 @@ int qcloud_otalib_get_report_version_result(const char *json)
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
-int qcloud_otalib_get_params(const char *json, char **type, char **url, char **version, char *md5, uint32_t *fileSize)
+/* Get optional parameter of firmware, and copy to @dest */
+/* 0, successful; -1, absent or too long */
+static int _qcloud_otalib_get_firmware_optional_para(const char *json_doc, const char *key, char *dest,
+                                                     size_t dest_len)
+{
+    int   ret   = IOT_OTA_ERR_FAIL;
+    char *value = LITE_json_value_of((char *)key, (char *)json_doc);
+
+    if (NULL != value) {
+        if (strlen(value) < dest_len) {
+            strcpy(dest, value);
+            ret = QCLOUD_RET_SUCCESS;
+        }
+        HAL_Free(value);
+    }
+
+    return ret;
+}
+
+static int _qcloud_otalib_get_compress_params(const char *json, OTACompressInfo *compress)
+{
+#define OTA_COMPRESS_STR_LEN (16)
+
+    char  str[OTA_COMPRESS_STR_LEN + 1] = {0};
+    char *p;
+
+    memset(compress, 0, sizeof(OTACompressInfo));
+    if (0 == _qcloud_otalib_get_firmware_optional_para(json, SHA256_FIELD, compress->sha256sum,
+                                                       sizeof(compress->sha256sum))) {
+        if (64 != strlen(compress->sha256sum)) {
+            Log_e("invalid sha256: %s", compress->sha256sum);
+            return IOT_OTA_ERR_FAIL;
+        }
+        for (p = compress->sha256sum; *p; p++) {
+            *p = tolower((unsigned char)*p);
+        }
+    }
+    _qcloud_otalib_get_firmware_optional_para(json, SIGNATURE_FIELD, compress->signature,
+                                              sizeof(compress->signature));
+
+    if (0 == _qcloud_otalib_get_firmware_optional_para(json, COMPRESS_FIELD, str, sizeof(str))) {
+        if (0 == strcmp(str, "gzip")) {
+            compress->type = IOT_OTAC_GZIP;
+        } else if (0 == strcmp(str, "deflate")) {
+            compress->type = IOT_OTAC_DEFLATE;
+        } else if (0 == strcmp(str, "heatshrink")) {
+            compress->type = IOT_OTAC_HEATSHRINK;
+        } else if (0 != strcmp(str, "none")) {
+            Log_e("unsupported compress type: %s", str);
+            return IOT_OTA_ERR_FAIL;
+        }
+    }
+
+    if (0 == _qcloud_otalib_get_firmware_optional_para(json, DELTA_FIELD, str, sizeof(str))) {
+        if (0 == strcmp(str, "qdiff")) {
+            compress->delta = IOT_OTAD_QDIFF;
+        } else if (0 != strcmp(str, "none")) {
+            Log_e("unsupported delta type: %s", str);
+            return IOT_OTA_ERR_FAIL;
+        }
+        _qcloud_otalib_get_firmware_optional_para(json, SOURCE_VERSION_FIELD, compress->source_version,
+                                                  sizeof(compress->source_version));
+    }
+
+    if (IOT_OTAC_NONE == compress->type && IOT_OTAD_NONE == compress->delta) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    _qcloud_otalib_get_firmware_optional_para(json, RAW_MD5_FIELD, compress->raw_md5sum, sizeof(compress->raw_md5sum));
+
+    if (0 == _qcloud_otalib_get_firmware_optional_para(json, RAW_FILESIZE_FIELD, str, sizeof(str))) {
+        compress->raw_size = atoi(str);
+    }
+    if (0 == _qcloud_otalib_get_firmware_optional_para(json, WINDOW_BITS_FIELD, str, sizeof(str))) {
+        compress->window_bits = atoi(str);
+    }
+    if (0 == _qcloud_otalib_get_firmware_optional_para(json, LOOKAHEAD_BITS_FIELD, str, sizeof(str))) {
+        compress->lookahead_bits = atoi(str);
+    }
+
+    return QCLOUD_RET_SUCCESS;
+
+#undef OTA_COMPRESS_STR_LEN
+}
+
+int qcloud_otalib_get_params(const char *json, char **type, char **url, char **version, char *md5, uint32_t *fileSize,
+                             OTACompressInfo *compress)
 {
 #define OTA_FILESIZE_STR_LEN (16)
 
@@ -234,6 +324,12 @@ int qcloud_otalib_get_params(const char *json, char **type, char **url, char **v
     file_size_str[OTA_FILESIZE_STR_LEN] = '\0';
     *fileSize                           = atoi(file_size_str);
 
+    /* get compress and delta info */
+    if (0 != _qcloud_otalib_get_compress_params(json, compress)) {
+        Log_e("get compress or delta info failed");
+        IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
+    }
+
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 
 #undef OTA_FILESIZE_STR_LEN
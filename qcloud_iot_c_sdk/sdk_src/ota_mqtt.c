@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_OTA
+
 #ifdef __cplusplus
 extern "C" {
 #endif
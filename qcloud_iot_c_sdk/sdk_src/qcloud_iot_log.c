@@ -26,6 +26,7 @@ extern "C" {
 #include <string.h>
 
 #include "log_upload.h"
+#include "qcloud_iot_export_error.h"
 #include "qcloud_iot_export_log.h"
 #include "qcloud_iot_import.h"
 
@@ -41,6 +42,20 @@ LOG_LEVEL g_log_upload_level = eLOG_ERROR;
 LOG_LEVEL g_log_upload_level = eLOG_DISABLE;
 #endif
 
+/* print level of each module */
+static uint8_t sg_log_module_level[eLOG_MODULE_NUM] = {
+    [eLOG_MODULE_SDK] = eLOG_INFO, [eLOG_MODULE_MQTT] = eLOG_INFO, [eLOG_MODULE_TEMPLATE] = eLOG_INFO,
+    [eLOG_MODULE_OTA] = eLOG_INFO, [eLOG_MODULE_HTTP] = eLOG_INFO, [eLOG_MODULE_TLS] = eLOG_INFO,
+    [eLOG_MODULE_GATEWAY] = eLOG_INFO,
+};
+
+/* greater one of print level and upload level, as default print level is above upload level */
+uint8_t g_log_module_gate[eLOG_MODULE_NUM] = {
+    [eLOG_MODULE_SDK] = eLOG_INFO, [eLOG_MODULE_MQTT] = eLOG_INFO, [eLOG_MODULE_TEMPLATE] = eLOG_INFO,
+    [eLOG_MODULE_OTA] = eLOG_INFO, [eLOG_MODULE_HTTP] = eLOG_INFO, [eLOG_MODULE_TLS] = eLOG_INFO,
+    [eLOG_MODULE_GATEWAY] = eLOG_INFO,
+};
+
 static const char *_get_filename(const char *p)
 {
 #ifdef WIN32
@@ -57,9 +72,21 @@ static const char *_get_filename(const char *p)
     return q;
 }
 
+static void _log_update_gate(int module)
+{
+    g_log_module_gate[module] = sg_log_module_level[module] > g_log_upload_level ? sg_log_module_level[module]
+                                                                                   : g_log_upload_level;
+}
+
 void IOT_Log_Set_Level(LOG_LEVEL logLevel)
 {
+    int i;
+
     g_log_print_level = logLevel;
+    for (i = 0; i < eLOG_MODULE_NUM; i++) {
+        sg_log_module_level[i] = logLevel;
+        _log_update_gate(i);
+    }
 }
 
 LOG_LEVEL IOT_Log_Get_Level(void)
@@ -72,9 +99,33 @@ void IOT_Log_Set_MessageHandler(LogMessageHandler handler)
     sg_log_message_handler = handler;
 }
 
+void IOT_Log_Set_Module_Level(LOG_MODULE module, LOG_LEVEL level)
+{
+    if (module < 0 || module >= eLOG_MODULE_NUM) {
+        return;
+    }
+
+    sg_log_module_level[module] = level;
+    _log_update_gate(module);
+}
+
+LOG_LEVEL IOT_Log_Get_Module_Level(LOG_MODULE module)
+{
+    if (module < 0 || module >= eLOG_MODULE_NUM) {
+        return g_log_print_level;
+    }
+
+    return (LOG_LEVEL)sg_log_module_level[module];
+}
+
 void IOT_Log_Set_Upload_Level(LOG_LEVEL logLevel)
 {
+    int i;
+
     g_log_upload_level = logLevel;
+    for (i = 0; i < eLOG_MODULE_NUM; i++) {
+        _log_update_gate(i);
+    }
 }
 
 LOG_LEVEL IOT_Log_Get_Upload_Level(void)
@@ -110,12 +161,567 @@ int IOT_Log_Upload(bool force_upload)
 #endif
 }
 
-void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+/* upload and print a formatted log line */
+static void _log_output(int module, int level, char *text)
+{
+#ifdef LOG_UPLOAD
+    /* append to upload buffer */
+    if (level <= g_log_upload_level) {
+        append_to_upload_buffer(text, strlen(text));
+    }
+#endif
+
+    if (level <= sg_log_module_level[module]) {
+        /* customer defined log print handler */
+        if (sg_log_message_handler != NULL && sg_log_message_handler(text)) {
+            return;
+        }
+
+        /* default log handler: print to console */
+        HAL_Printf("%s", text);
+    }
+}
+
+#ifdef LOG_ASYNC
+/**
+ * Deferred logging: IOT_Log_Gen copies the format pointer and raw arguments into a
+ * record of a lock-free ring, formatting and output are done later by IOT_Log_Flush.
+ * The ring is a bounded MPSC queue, each record has a sequence stamp written last,
+ * so that producers claim records by CAS of head and the consumer needs no lock.
+ * Message with a specification too long to replay is formatted into the record at once.
+ */
+#define LOG_ASYNC_RECORD_NUM     64  /* number of records in ring, power of 2 */
+#define LOG_ASYNC_ARGS_SIZE      96  /* room of arguments in each record, the rest are cut */
+#define LOG_ASYNC_SPEC_LEN       16  /* max length of one conversion specification */
+#define LOG_ASYNC_THREAD_SLEEP_MS 20
+
+#define LOG_SPEC_NO_PRECISION   (-1)
+#define LOG_SPEC_STAR_PRECISION (-2)
+
+#define LOG_ATOMIC_LOAD(p)         __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define LOG_ATOMIC_STORE(p, v)     __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define LOG_ATOMIC_CAS(p, old, v)  __atomic_compare_exchange_n(p, old, v, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define LOG_ATOMIC_INC(p)          __atomic_fetch_add(p, 1, __ATOMIC_RELAXED)
+#define LOG_ATOMIC_XCHG(p, v)      __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL)
+
+typedef enum {
+    LOG_ARG_NONE = 0,
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LDOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+} LogArgType;
+
+/* conversion specification of format */
+typedef struct {
+    const char *start;      // '%' of the specification
+    int         len;        // length of the specification
+    uint8_t     star_num;   // '*' width and precision, each takes an int argument
+    uint8_t     type;       // LogArgType of the argument
+    int         precision;  // precision, LOG_SPEC_NO_PRECISION if not given, LOG_SPEC_STAR_PRECISION by '*'
+} LogSpec;
+
+typedef struct {
+    uint32_t    seq;  // position of record within ring minus index, stamped last by producer
+    const char *file;
+    const char *func;
+    const char *fmt;       // format string, should be static as with Log_x macros, NULL if args is formatted text
+    long        time_sec;  // HAL_Timer_current_sec() when the log is generated, formatted by consumer
+    uint16_t    line;
+    uint8_t     level;
+    uint8_t     truncated;  // arguments beyond LOG_ASYNC_ARGS_SIZE are cut
+    uint8_t     module;     // LOG_MODULE of the log
+    uint16_t    args_len;
+    uint8_t     args[LOG_ASYNC_ARGS_SIZE];
+} LogRecord;
+
+static LogRecord sg_log_ring[LOG_ASYNC_RECORD_NUM];
+static uint32_t  sg_log_head;     // next position to claim by producers
+static uint32_t  sg_log_tail;     // next position to read by consumer
+static uint32_t  sg_log_dropped;  // logs dropped as the ring is full
+static uint8_t   sg_log_flushing;
+
+#ifdef MULTITHREAD_ENABLED
+static volatile bool sg_log_thread_running;
+#endif
+
+/* parse the specification at fmt which points to '%', return false for "%%" or unknown one taking no argument */
+static bool _log_parse_spec(const char *fmt, LogSpec *spec)
+{
+    const char *p = fmt + 1;
+    int         longs = 0;
+
+    spec->start     = fmt;
+    spec->star_num  = 0;
+    spec->precision = LOG_SPEC_NO_PRECISION;
+    spec->type      = LOG_ARG_INT;
+
+    while ('-' == *p || '+' == *p || ' ' == *p || '#' == *p || '0' == *p) {
+        p++;
+    }
+    if ('*' == *p) {
+        spec->star_num++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if ('.' == *p) {
+        p++;
+        spec->precision = 0;
+        if ('*' == *p) {
+            spec->star_num++;
+            spec->precision = LOG_SPEC_STAR_PRECISION;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            spec->precision = spec->precision * 10 + (*p++ - '0');
+        }
+    }
+
+    for (;; p++) {
+        if ('l' == *p) {
+            longs++;
+        } else if ('z' == *p || 't' == *p) {
+            spec->type = LOG_ARG_SIZE;
+        } else if ('j' == *p) {
+            longs = 2;
+        } else if ('L' == *p) {
+            spec->type = LOG_ARG_LDOUBLE;
+        } else if ('h' != *p) {
+            break;
+        }
+    }
+
+    switch (*p) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (LOG_ARG_SIZE != spec->type) {
+                spec->type = (longs >= 2) ? LOG_ARG_LLONG : (longs ? LOG_ARG_LONG : LOG_ARG_INT);
+            }
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (LOG_ARG_LDOUBLE != spec->type) {
+                spec->type = LOG_ARG_DOUBLE;
+            }
+            break;
+        case 's':
+            spec->type = LOG_ARG_STR;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_PTR;
+            break;
+        default:
+            // "%%", "%n" and unknown conversions take no argument
+            return false;
+    }
+
+    spec->len = p + 1 - fmt;
+    return true;
+}
+
+static bool _log_put_arg(LogRecord *record, const void *arg, size_t size)
+{
+    if (record->args_len + size > LOG_ASYNC_ARGS_SIZE) {
+        record->truncated = 1;
+        return false;
+    }
+    memcpy(record->args + record->args_len, arg, size);
+    record->args_len += size;
+    return true;
+}
+
+/* copy the arguments by the types in format, strings are copied by content,
+ * return false if a specification is too long to replay */
+static bool _log_capture_args(LogRecord *record, const char *fmt, va_list ap)
+{
+    LogSpec     spec;
+    int         stars[2] = {0, 0};
+    int         i;
+    size_t      len;
+    const char *str;
+
+    for (; !record->truncated && NULL != (fmt = strchr(fmt, '%')); fmt += spec.len) {
+        if (!_log_parse_spec(fmt, &spec)) {
+            spec.len = ('\0' == fmt[1]) ? 1 : 2;
+            continue;
+        }
+        if (spec.len >= LOG_ASYNC_SPEC_LEN) {
+            return false;
+        }
+
+        for (i = 0; i < spec.star_num; i++) {
+            stars[i] = va_arg(ap, int);
+            _log_put_arg(record, &stars[i], sizeof(int));
+        }
+
+        switch (spec.type) {
+            case LOG_ARG_INT: {
+                int v = va_arg(ap, int);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_LONG: {
+                long v = va_arg(ap, long);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_LLONG: {
+                long long v = va_arg(ap, long long);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_SIZE: {
+                size_t v = va_arg(ap, size_t);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_DOUBLE: {
+                double v = va_arg(ap, double);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_LDOUBLE: {
+                long double v = va_arg(ap, long double);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_PTR: {
+                void *v = va_arg(ap, void *);
+                _log_put_arg(record, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_STR:
+                str = va_arg(ap, const char *);
+                str = (NULL == str) ? "(null)" : str;
+                // precision bounds the string which may not be NULL-terminated
+                i = (LOG_SPEC_STAR_PRECISION == spec.precision) ? stars[spec.star_num - 1] : spec.precision;
+                for (len = 0; (i < 0 || len < (size_t)i) && '\0' != str[len]; len++) {
+                }
+                if (record->args_len + len + 1 > LOG_ASYNC_ARGS_SIZE) {
+                    len = LOG_ASYNC_ARGS_SIZE - record->args_len - 1;
+                    record->truncated = 1;
+                }
+                memcpy(record->args + record->args_len, str, len);
+                record->args[record->args_len + len] = '\0';
+                record->args_len += len + 1;
+                break;
+        }
+    }
+
+    return true;
+}
+
+/* format one argument of type at offset of record, with '*' arguments before it */
+#define LOG_FORMAT_ARG(type, value_of)                                                                  \
+    do {                                                                                                \
+        type value;                                                                                     \
+        if (off + sizeof(type) > record->args_len) {                                                    \
+            goto end;                                                                                   \
+        }                                                                                               \
+        memcpy(&value, record->args + off, sizeof(type));                                               \
+        off += sizeof(type);                                                                            \
+        if (0 == spec.star_num) {                                                                       \
+            n = HAL_Snprintf(buf + pos, size - pos, spec_str, value_of);                                \
+        } else if (1 == spec.star_num) {                                                                \
+            n = HAL_Snprintf(buf + pos, size - pos, spec_str, stars[0], value_of);                      \
+        } else {                                                                                        \
+            n = HAL_Snprintf(buf + pos, size - pos, spec_str, stars[0], stars[1], value_of);            \
+        }                                                                                               \
+    } while (0)
+
+/* format the message of record with its captured arguments, one specification at a time */
+static void _log_format_args(LogRecord *record, char *buf, size_t size)
+{
+    const char *fmt = record->fmt, *next;
+    const char *str;
+    size_t      pos = 0, off = 0, len;
+    LogSpec     spec;
+    char        spec_str[LOG_ASYNC_SPEC_LEN];
+    int         stars[2];
+    int         i, n = 0;
+
+    while (pos + 1 < size && '\0' != *fmt) {
+        next = strchr(fmt, '%');
+        len  = (NULL == next) ? strlen(fmt) : (size_t)(next - fmt);
+        len  = (len < size - 1 - pos) ? len : size - 1 - pos;
+        memcpy(buf + pos, fmt, len);
+        pos += len;
+        fmt += len;
+        if (fmt != next) {
+            break;
+        }
+
+        if (!_log_parse_spec(fmt, &spec)) {
+            if ('%' == fmt[1]) {
+                buf[pos++] = '%';
+            }
+            fmt += ('\0' == fmt[1]) ? 1 : 2;
+            continue;
+        }
+        // only behind the cut of arguments, as capture checks the ones before
+        if (spec.len >= LOG_ASYNC_SPEC_LEN) {
+            goto end;
+        }
+        fmt += spec.len;
+        memcpy(spec_str, spec.start, spec.len);
+        spec_str[spec.len] = '\0';
+
+        for (i = 0; i < spec.star_num; i++) {
+            if (off + sizeof(int) > record->args_len) {
+                goto end;
+            }
+            memcpy(&stars[i], record->args + off, sizeof(int));
+            off += sizeof(int);
+        }
+
+        switch (spec.type) {
+            case LOG_ARG_INT:
+                LOG_FORMAT_ARG(int, value);
+                break;
+            case LOG_ARG_LONG:
+                LOG_FORMAT_ARG(long, value);
+                break;
+            case LOG_ARG_LLONG:
+                LOG_FORMAT_ARG(long long, value);
+                break;
+            case LOG_ARG_SIZE:
+                LOG_FORMAT_ARG(size_t, value);
+                break;
+            case LOG_ARG_DOUBLE:
+                LOG_FORMAT_ARG(double, value);
+                break;
+            case LOG_ARG_LDOUBLE:
+                LOG_FORMAT_ARG(long double, value);
+                break;
+            case LOG_ARG_PTR:
+                LOG_FORMAT_ARG(void *, value);
+                break;
+            default:
+                if (off >= record->args_len) {
+                    goto end;
+                }
+                str = (const char *)record->args + off;
+                off += strlen(str) + 1;
+                if (0 == spec.star_num) {
+                    n = HAL_Snprintf(buf + pos, size - pos, spec_str, str);
+                } else if (1 == spec.star_num) {
+                    n = HAL_Snprintf(buf + pos, size - pos, spec_str, stars[0], str);
+                } else {
+                    n = HAL_Snprintf(buf + pos, size - pos, spec_str, stars[0], stars[1], str);
+                }
+                break;
+        }
+        if (n < 0) {
+            break;
+        }
+        pos += ((size_t)n < size - pos) ? (size_t)n : size - 1 - pos;
+    }
+
+end:
+    buf[pos] = '\0';
+    if (record->truncated && pos + 4 < size) {
+        strcpy(buf + pos, "...");
+    }
+}
+#undef LOG_FORMAT_ARG
+
+/* claim a record of ring, NULL if the ring is full */
+static LogRecord *_log_claim_record(uint32_t *pos)
 {
-    if (level > g_log_print_level && level > g_log_upload_level) {
+    LogRecord *record;
+    uint32_t   base;
+    int32_t    diff;
+
+    *pos = LOG_ATOMIC_LOAD(&sg_log_head);
+    for (;;) {
+        record = &sg_log_ring[*pos & (LOG_ASYNC_RECORD_NUM - 1)];
+        base   = *pos & ~(uint32_t)(LOG_ASYNC_RECORD_NUM - 1);
+        diff   = (int32_t)(LOG_ATOMIC_LOAD(&record->seq) - base);
+        if (0 == diff) {
+            // free for this lap, on failure pos is reloaded with the current head
+            if (LOG_ATOMIC_CAS(&sg_log_head, pos, *pos + 1)) {
+                return record;
+            }
+        } else if (diff < 0) {
+            // not consumed since last lap
+            return NULL;
+        } else {
+            *pos = LOG_ATOMIC_LOAD(&sg_log_head);
+        }
+    }
+}
+
+static void _log_push(int module, const char *file, const char *func, int line, int level, const char *fmt,
+                      va_list ap)
+{
+    LogRecord *record;
+    uint32_t   pos;
+    va_list    ap_copy;
+    int        n;
+
+    record = _log_claim_record(&pos);
+    if (NULL == record) {
+        LOG_ATOMIC_INC(&sg_log_dropped);
         return;
     }
 
+    record->time_sec  = HAL_Timer_current_sec();
+    record->file      = file;
+    record->func      = func;
+    record->fmt       = fmt;
+    record->line      = line;
+    record->level     = level;
+    record->module    = module;
+    record->truncated = 0;
+    record->args_len  = 0;
+
+    va_copy(ap_copy, ap);
+    if (!_log_capture_args(record, fmt, ap_copy)) {
+        // format it now within room of arguments
+        n = HAL_Vsnprintf((char *)record->args, LOG_ASYNC_ARGS_SIZE, fmt, ap);
+        record->fmt       = NULL;
+        record->truncated = (n < 0 || n >= LOG_ASYNC_ARGS_SIZE);
+        if (n < 0) {
+            record->args[0] = '\0';
+        }
+    }
+    va_end(ap_copy);
+
+    // publish the record to consumer
+    LOG_ATOMIC_STORE(&record->seq, (pos & ~(uint32_t)(LOG_ASYNC_RECORD_NUM - 1)) + 1);
+}
+
+static void _log_emit_record(LogRecord *record)
+{
+    char text[MAX_LOG_MSG_LEN + 1];
+    char time_str[TIME_FORMAT_STR_LEN];
+    int  len;
+
+    len = HAL_Snprintf(text, sizeof(text), "%s|%s|%s|%s(%d): ", level_str[record->level],
+                       HAL_Timer_format_sec(record->time_sec, time_str), _get_filename(record->file), record->func,
+                       record->line);
+    if (len < 0 || len > MAX_LOG_MSG_LEN - 2) {
+        len = 0;
+    }
+
+    if (NULL != record->fmt) {
+        _log_format_args(record, text + len, MAX_LOG_MSG_LEN - 1 - len);
+    } else {
+        HAL_Snprintf(text + len, MAX_LOG_MSG_LEN - 1 - len, "%s%s", (char *)record->args,
+                     record->truncated ? "..." : "");
+    }
+    strcat(text, "\r\n");
+
+    _log_output(record->module, record->level, text);
+}
+
+int IOT_Log_Flush(void)
+{
+    LogRecord *record;
+    uint32_t   base;
+    uint32_t   dropped;
+    int        count = 0;
+
+    // single consumer, concurrent flush returns at once
+    if (LOG_ATOMIC_XCHG(&sg_log_flushing, 1)) {
+        return 0;
+    }
+
+    for (;;) {
+        record = &sg_log_ring[sg_log_tail & (LOG_ASYNC_RECORD_NUM - 1)];
+        base   = sg_log_tail & ~(uint32_t)(LOG_ASYNC_RECORD_NUM - 1);
+        if (LOG_ATOMIC_LOAD(&record->seq) != base + 1) {
+            // empty, or the next record is still being written
+            break;
+        }
+
+        _log_emit_record(record);
+        LOG_ATOMIC_STORE(&record->seq, base + LOG_ASYNC_RECORD_NUM);
+        sg_log_tail++;
+        count++;
+    }
+
+    dropped = LOG_ATOMIC_XCHG(&sg_log_dropped, 0);
+    if (dropped > 0) {
+        char text[64];
+        HAL_Snprintf(text, sizeof(text), "%s|%u logs dropped as the log ring is full\r\n", level_str[eLOG_WARN],
+                     (unsigned)dropped);
+        _log_output(eLOG_MODULE_SDK, eLOG_WARN, text);
+    }
+
+    LOG_ATOMIC_STORE(&sg_log_flushing, 0);
+    return count;
+}
+
+#ifdef MULTITHREAD_ENABLED
+static void _log_async_thread(void *arg)
+{
+    while (sg_log_thread_running) {
+        IOT_Log_Flush();
+        HAL_SleepMs(LOG_ASYNC_THREAD_SLEEP_MS);
+    }
+    IOT_Log_Flush();
+}
+
+int IOT_Log_Start_Async_Thread(uint16_t priority, uint32_t stack_size)
+{
+    ThreadParams thread_params = {0};
+    int          rc;
+
+    if (sg_log_thread_running) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    thread_params.thread_func = _log_async_thread;
+    thread_params.thread_name = "log_async_thread";
+    thread_params.stack_size  = stack_size;
+    thread_params.priority    = priority;
+    sg_log_thread_running     = true;
+
+    rc = HAL_ThreadCreate(&thread_params);
+    if (rc) {
+        sg_log_thread_running = false;
+        HAL_Printf("create log_async_thread fail: %d\r\n", rc);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void IOT_Log_Stop_Async_Thread(void)
+{
+    sg_log_thread_running = false;
+}
+#endif
+#endif /* LOG_ASYNC */
+
+static void _log_gen(int module, const char *file, const char *func, int line, int level, const char *fmt,
+                     va_list ap)
+{
+    if (level > g_log_module_gate[module]) {
+        return;
+    }
+
+#ifdef LOG_ASYNC
+    _log_push(module, file, func, line, level, fmt, ap);
+#else
     /* format log content */
     const char *file_name = _get_filename(file);
 
@@ -128,31 +734,35 @@ void IOT_Log_Gen(const char *file, const char *func, const int line, const int l
     o += HAL_Snprintf(o, sizeof(sg_text_buf), "%s|%s|%s|%s(%d): ", level_str[level], HAL_Timer_current(time_str),
                       file_name, func, line);
 
-    va_list ap;
-    va_start(ap, fmt);
     HAL_Vsnprintf(o, MAX_LOG_MSG_LEN - 2 - strlen(tmp_buf), fmt, ap);
-    va_end(ap);
 
     strcat(tmp_buf, "\r\n");
 
-#ifdef LOG_UPLOAD
-    /* append to upload buffer */
-    if (level <= g_log_upload_level) {
-        append_to_upload_buffer(tmp_buf, strlen(tmp_buf));
-    }
+    _log_output(module, level, tmp_buf);
 #endif
+}
 
-    if (level <= g_log_print_level) {
-        /* customer defined log print handler */
-        if (sg_log_message_handler != NULL && sg_log_message_handler(tmp_buf)) {
-            return;
-        }
+void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+{
+    va_list ap;
 
-        /* default log handler: print to console */
-        HAL_Printf("%s", tmp_buf);
+    va_start(ap, fmt);
+    _log_gen(eLOG_MODULE_SDK, file, func, line, level, fmt, ap);
+    va_end(ap);
+}
+
+void IOT_Log_Gen_Module(const int module, const char *file, const char *func, const int line, const int level,
+                        const char *fmt, ...)
+{
+    va_list ap;
+
+    if (module < 0 || module >= eLOG_MODULE_NUM) {
+        return;
     }
 
-    return;
+    va_start(ap, fmt);
+    _log_gen(module, file, func, line, level, fmt, ap);
+    va_end(ap);
 }
 
 #ifdef __cplusplus
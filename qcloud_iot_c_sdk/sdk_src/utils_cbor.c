@@ -0,0 +1,891 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utils_cbor.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CBOR_MAJOR_UINT   0x00
+#define CBOR_MAJOR_NINT   0x20
+#define CBOR_MAJOR_BYTES  0x40
+#define CBOR_MAJOR_TEXT   0x60
+#define CBOR_MAJOR_ARRAY  0x80
+#define CBOR_MAJOR_MAP    0xA0
+#define CBOR_MAJOR_TAG    0xC0
+#define CBOR_MAJOR_SIMPLE 0xE0
+
+#define CBOR_FALSE  0xF4
+#define CBOR_TRUE   0xF5
+#define CBOR_NULL   0xF6
+#define CBOR_FLOAT  0xFA
+#define CBOR_DOUBLE 0xFB
+#define CBOR_BREAK  0xFF
+
+#define CBOR_INFO_FALSE     20
+#define CBOR_INFO_TRUE      21
+#define CBOR_INFO_NULL      22
+#define CBOR_INFO_UNDEFINED 23
+#define CBOR_INFO_HALF      25
+#define CBOR_INFO_FLOAT     26
+#define CBOR_INFO_DOUBLE    27
+#define CBOR_INFO_INDEFINITE 31
+
+#define CBOR_MAX_NESTING   16
+#define CBOR_MAX_NUM_LEN   32
+#define CBOR_MAX_HEAD_LEN  9
+
+typedef struct {
+    const char *pos;
+    const char *end;
+} JsonReader;
+
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+} CborReader;
+
+typedef struct {
+    char * buf;
+    size_t size;
+    size_t len;
+} JsonWriter;
+
+static int _json_value_to_cbor(JsonReader *reader, CborWriter *writer, int depth);
+static int _cbor_item_to_json(CborReader *reader, JsonWriter *writer, int depth);
+
+/*
+ * JSON -> CBOR
+ */
+static void _cbor_put(CborWriter *writer, const void *data, size_t len)
+{
+    if (writer->buf && writer->len + len <= writer->size) {
+        memcpy(writer->buf + writer->len, data, len);
+    }
+    writer->len += len;
+}
+
+static size_t _cbor_head_len(uint64_t val)
+{
+    if (val < 24) {
+        return 1;
+    } else if (val <= 0xFF) {
+        return 2;
+    } else if (val <= 0xFFFF) {
+        return 3;
+    } else if (val <= 0xFFFFFFFFUL) {
+        return 5;
+    }
+    return 9;
+}
+
+static size_t _cbor_fill_head(uint8_t *head, uint8_t major, uint64_t val)
+{
+    size_t len = _cbor_head_len(val);
+    size_t i;
+
+    switch (len) {
+        case 1:
+            head[0] = major | (uint8_t)val;
+            return len;
+        case 2:
+            head[0] = major | 24;
+            break;
+        case 3:
+            head[0] = major | 25;
+            break;
+        case 5:
+            head[0] = major | 26;
+            break;
+        default:
+            head[0] = major | 27;
+            break;
+    }
+
+    for (i = len - 1; i > 0; i--) {
+        head[i] = (uint8_t)val;
+        val >>= 8;
+    }
+
+    return len;
+}
+
+static void _cbor_put_head(CborWriter *writer, uint8_t major, uint64_t val)
+{
+    uint8_t head[CBOR_MAX_HEAD_LEN];
+
+    _cbor_put(writer, head, _cbor_fill_head(head, major, val));
+}
+
+static void _json_skip_space(JsonReader *reader)
+{
+    while (reader->pos < reader->end &&
+           (' ' == *reader->pos || '\t' == *reader->pos || '\r' == *reader->pos || '\n' == *reader->pos)) {
+        reader->pos++;
+    }
+}
+
+static int _json_hex4(const char *pos, const char *end, uint32_t *code)
+{
+    int i;
+
+    if (end - pos < 4) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    *code = 0;
+    for (i = 0; i < 4; i++) {
+        *code <<= 4;
+        if (pos[i] >= '0' && pos[i] <= '9') {
+            *code |= pos[i] - '0';
+        } else if (pos[i] >= 'a' && pos[i] <= 'f') {
+            *code |= pos[i] - 'a' + 10;
+        } else if (pos[i] >= 'A' && pos[i] <= 'F') {
+            *code |= pos[i] - 'A' + 10;
+        } else {
+            return QCLOUD_ERR_JSON_PARSE;
+        }
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/**
+ * @brief unescape one character of JSON string into UTF-8
+ *
+ * @return number of JSON chars consumed, or 0 if invalid
+ */
+static int _json_unescape_char(const char *pos, const char *end, uint8_t *utf8, int *utf8_len)
+{
+    uint32_t code, low;
+    int      consumed = 6;
+
+    if ('\\' != pos[0]) {
+        utf8[0]   = (uint8_t)pos[0];
+        *utf8_len = 1;
+        return 1;
+    }
+
+    if (end - pos < 2) {
+        return 0;
+    }
+
+    *utf8_len = 1;
+    switch (pos[1]) {
+        case '"':
+        case '\\':
+        case '/':
+            utf8[0] = pos[1];
+            return 2;
+        case 'b':
+            utf8[0] = '\b';
+            return 2;
+        case 'f':
+            utf8[0] = '\f';
+            return 2;
+        case 'n':
+            utf8[0] = '\n';
+            return 2;
+        case 'r':
+            utf8[0] = '\r';
+            return 2;
+        case 't':
+            utf8[0] = '\t';
+            return 2;
+        case 'u':
+            break;
+        default:
+            return 0;
+    }
+
+    if (_json_hex4(pos + 2, end, &code) != QCLOUD_RET_SUCCESS) {
+        return 0;
+    }
+
+    // surrogate pair
+    if (code >= 0xD800 && code <= 0xDBFF && end - pos >= 12 && '\\' == pos[6] && 'u' == pos[7] &&
+        _json_hex4(pos + 8, end, &low) == QCLOUD_RET_SUCCESS && low >= 0xDC00 && low <= 0xDFFF) {
+        code     = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        consumed = 12;
+    }
+
+    if (code < 0x80) {
+        utf8[0] = (uint8_t)code;
+    } else if (code < 0x800) {
+        utf8[0]   = 0xC0 | (code >> 6);
+        utf8[1]   = 0x80 | (code & 0x3F);
+        *utf8_len = 2;
+    } else if (code < 0x10000) {
+        utf8[0]   = 0xE0 | (code >> 12);
+        utf8[1]   = 0x80 | ((code >> 6) & 0x3F);
+        utf8[2]   = 0x80 | (code & 0x3F);
+        *utf8_len = 3;
+    } else {
+        utf8[0]   = 0xF0 | (code >> 18);
+        utf8[1]   = 0x80 | ((code >> 12) & 0x3F);
+        utf8[2]   = 0x80 | ((code >> 6) & 0x3F);
+        utf8[3]   = 0x80 | (code & 0x3F);
+        *utf8_len = 4;
+    }
+
+    return consumed;
+}
+
+static int _json_string_to_cbor(JsonReader *reader, CborWriter *writer)
+{
+    const char *pos;
+    uint8_t     utf8[4];
+    int         utf8_len, consumed;
+    uint64_t    len = 0;
+
+    // first pass for the length of text string
+    for (pos = reader->pos + 1; pos < reader->end && '"' != *pos; pos += consumed) {
+        consumed = _json_unescape_char(pos, reader->end, utf8, &utf8_len);
+        if (!consumed) {
+            return QCLOUD_ERR_JSON_PARSE;
+        }
+        len += utf8_len;
+    }
+
+    if (pos >= reader->end) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    _cbor_put_head(writer, CBOR_MAJOR_TEXT, len);
+    for (pos = reader->pos + 1; '"' != *pos; pos += consumed) {
+        consumed = _json_unescape_char(pos, reader->end, utf8, &utf8_len);
+        _cbor_put(writer, utf8, utf8_len);
+    }
+
+    reader->pos = pos + 1;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _cbor_put_float(CborWriter *writer, double value)
+{
+    uint8_t  buf[CBOR_MAX_HEAD_LEN];
+    float    single = (float)value;
+    uint64_t bits;
+    uint32_t bits32;
+    int      i, len;
+
+    if ((double)single == value) {
+        memcpy(&bits32, &single, sizeof(bits32));
+        bits = bits32;
+        len  = 4;
+        buf[0] = CBOR_FLOAT;
+    } else {
+        memcpy(&bits, &value, sizeof(bits));
+        len    = 8;
+        buf[0] = CBOR_DOUBLE;
+    }
+
+    for (i = len; i > 0; i--) {
+        buf[i] = (uint8_t)bits;
+        bits >>= 8;
+    }
+
+    _cbor_put(writer, buf, len + 1);
+}
+
+static int _json_number_to_cbor(JsonReader *reader, CborWriter *writer)
+{
+    char               num[CBOR_MAX_NUM_LEN];
+    char *             num_end;
+    int                len      = 0;
+    bool               is_float = false;
+    long long          int_val;
+    unsigned long long uint_val;
+    double             float_val;
+
+    while (reader->pos < reader->end && ((*reader->pos >= '0' && *reader->pos <= '9') || '-' == *reader->pos ||
+                                         '+' == *reader->pos || '.' == *reader->pos || 'e' == *reader->pos ||
+                                         'E' == *reader->pos)) {
+        if (len >= CBOR_MAX_NUM_LEN - 1) {
+            return QCLOUD_ERR_JSON_PARSE;
+        }
+        if ('.' == *reader->pos || 'e' == *reader->pos || 'E' == *reader->pos) {
+            is_float = true;
+        }
+        num[len++] = *reader->pos++;
+    }
+
+    if (!len) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+    num[len] = '\0';
+
+    if (!is_float) {
+        errno = 0;
+        if ('-' == num[0]) {
+            int_val = strtoll(num, &num_end, 10);
+            if (!errno && '\0' == *num_end) {
+                utils_cbor_put_int(writer, int_val);  // "-0" is 0
+                return QCLOUD_RET_SUCCESS;
+            }
+        } else {
+            uint_val = strtoull(num, &num_end, 10);
+            if (!errno && '\0' == *num_end) {
+                _cbor_put_head(writer, CBOR_MAJOR_UINT, uint_val);
+                return QCLOUD_RET_SUCCESS;
+            }
+        }
+    }
+
+    // fraction, exponent or integer out of range
+    float_val = strtod(num, &num_end);
+    if ('\0' != *num_end) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    _cbor_put_float(writer, float_val);
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _json_literal_to_cbor(JsonReader *reader, CborWriter *writer, const char *literal, uint8_t simple)
+{
+    size_t len = strlen(literal);
+
+    if ((size_t)(reader->end - reader->pos) < len || strncmp(reader->pos, literal, len)) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    reader->pos += len;
+    _cbor_put(writer, &simple, 1);
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _json_container_to_cbor(JsonReader *reader, CborWriter *writer, int depth, uint8_t major, char close)
+{
+    int      rc;
+    size_t   head  = writer->len;
+    uint64_t count = 0;
+    size_t   head_len;
+
+    // count is not known yet, reserve one byte which is enough for most containers
+    _cbor_put(writer, &major, 1);
+
+    reader->pos++;
+    _json_skip_space(reader);
+    if (reader->pos < reader->end && close == *reader->pos) {
+        reader->pos++;
+        goto Fill;
+    }
+
+    for (;;) {
+        if (CBOR_MAJOR_MAP == major) {
+            _json_skip_space(reader);
+            if (reader->pos >= reader->end || '"' != *reader->pos) {
+                return QCLOUD_ERR_JSON_PARSE;
+            }
+
+            rc = _json_string_to_cbor(reader, writer);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                return rc;
+            }
+
+            _json_skip_space(reader);
+            if (reader->pos >= reader->end || ':' != *reader->pos) {
+                return QCLOUD_ERR_JSON_PARSE;
+            }
+            reader->pos++;
+        }
+
+        rc = _json_value_to_cbor(reader, writer, depth + 1);
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+        count++;
+
+        _json_skip_space(reader);
+        if (reader->pos >= reader->end) {
+            return QCLOUD_ERR_JSON_PARSE;
+        }
+
+        if (',' == *reader->pos) {
+            reader->pos++;
+        } else if (close == *reader->pos) {
+            reader->pos++;
+            break;
+        } else {
+            return QCLOUD_ERR_JSON_PARSE;
+        }
+    }
+
+Fill:
+    head_len = _cbor_head_len(count);
+    if (head_len > 1) {
+        if (writer->buf && writer->len + head_len - 1 <= writer->size) {
+            memmove(writer->buf + head + head_len, writer->buf + head + 1, writer->len - head - 1);
+        }
+        writer->len += head_len - 1;
+    }
+
+    if (writer->buf && head + head_len <= writer->size) {
+        _cbor_fill_head(writer->buf + head, major, count);
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _json_value_to_cbor(JsonReader *reader, CborWriter *writer, int depth)
+{
+    if (depth > CBOR_MAX_NESTING) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    _json_skip_space(reader);
+    if (reader->pos >= reader->end) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    switch (*reader->pos) {
+        case '{':
+            return _json_container_to_cbor(reader, writer, depth, CBOR_MAJOR_MAP, '}');
+        case '[':
+            return _json_container_to_cbor(reader, writer, depth, CBOR_MAJOR_ARRAY, ']');
+        case '"':
+            return _json_string_to_cbor(reader, writer);
+        case 't':
+            return _json_literal_to_cbor(reader, writer, "true", CBOR_TRUE);
+        case 'f':
+            return _json_literal_to_cbor(reader, writer, "false", CBOR_FALSE);
+        case 'n':
+            return _json_literal_to_cbor(reader, writer, "null", CBOR_NULL);
+        default:
+            return _json_number_to_cbor(reader, writer);
+    }
+}
+
+int utils_json_to_cbor(const char *json, size_t json_len, uint8_t *cbor, size_t cbor_size, size_t *olen)
+{
+    int        rc;
+    CborWriter writer = {cbor, cbor_size, 0};
+
+    if (NULL == json || NULL == olen) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    rc = utils_cbor_put_json(&writer, json, json_len);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    *olen = writer.len;
+    return utils_cbor_writer_result(&writer);
+}
+
+/*
+ * CBOR writer
+ */
+void utils_cbor_writer_init(CborWriter *writer, uint8_t *buf, size_t size)
+{
+    writer->buf  = buf;
+    writer->size = size;
+    writer->len  = 0;
+}
+
+void utils_cbor_put_map(CborWriter *writer, size_t count)
+{
+    _cbor_put_head(writer, CBOR_MAJOR_MAP, count);
+}
+
+void utils_cbor_put_array(CborWriter *writer, size_t count)
+{
+    _cbor_put_head(writer, CBOR_MAJOR_ARRAY, count);
+}
+
+void utils_cbor_put_text(CborWriter *writer, const char *text)
+{
+    size_t len = strlen(text);
+
+    _cbor_put_head(writer, CBOR_MAJOR_TEXT, len);
+    _cbor_put(writer, text, len);
+}
+
+void utils_cbor_put_int(CborWriter *writer, int64_t value)
+{
+    if (value < 0) {
+        _cbor_put_head(writer, CBOR_MAJOR_NINT, (uint64_t)(-(value + 1)));
+    } else {
+        _cbor_put_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+    }
+}
+
+void utils_cbor_put_float(CborWriter *writer, double value)
+{
+    _cbor_put_float(writer, value);
+}
+
+void utils_cbor_put_bool(CborWriter *writer, bool value)
+{
+    uint8_t simple = value ? CBOR_TRUE : CBOR_FALSE;
+
+    _cbor_put(writer, &simple, 1);
+}
+
+void utils_cbor_put_null(CborWriter *writer)
+{
+    uint8_t simple = CBOR_NULL;
+
+    _cbor_put(writer, &simple, 1);
+}
+
+int utils_cbor_put_json(CborWriter *writer, const char *json, size_t json_len)
+{
+    int        rc;
+    JsonReader reader = {json, json + json_len};
+
+    rc = _json_value_to_cbor(&reader, writer, 0);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    _json_skip_space(&reader);
+    return (reader.pos < reader.end && '\0' != *reader.pos) ? QCLOUD_ERR_JSON_PARSE : QCLOUD_RET_SUCCESS;
+}
+
+int utils_cbor_writer_result(CborWriter *writer)
+{
+    return (NULL != writer->buf && writer->len > writer->size) ? QCLOUD_ERR_JSON_BUFFER_TOO_SMALL
+                                                               : QCLOUD_RET_SUCCESS;
+}
+
+/*
+ * CBOR -> JSON
+ */
+static int _json_put(JsonWriter *writer, const char *data, size_t len)
+{
+    // keep one byte for '\0'
+    if (writer->len + len >= writer->size) {
+        return QCLOUD_ERR_JSON_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _cbor_read_head(CborReader *reader, uint8_t *major, uint8_t *info, uint64_t *val)
+{
+    int len;
+
+    if (reader->pos >= reader->end) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    *major = *reader->pos & 0xE0;
+    *info  = *reader->pos & 0x1F;
+    *val   = 0;
+    reader->pos++;
+
+    if (*info < 24) {
+        *val = *info;
+        return QCLOUD_RET_SUCCESS;
+    } else if (CBOR_INFO_INDEFINITE == *info) {
+        return (CBOR_MAJOR_UINT == *major || CBOR_MAJOR_NINT == *major || CBOR_MAJOR_TAG == *major)
+                   ? QCLOUD_ERR_JSON_PARSE
+                   : QCLOUD_RET_SUCCESS;
+    } else if (*info > 27) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    len = 1 << (*info - 24);
+    if (reader->end - reader->pos < len) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    while (len--) {
+        *val = (*val << 8) | *reader->pos++;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static bool _cbor_is_break(CborReader *reader)
+{
+    if (reader->pos < reader->end && CBOR_BREAK == *reader->pos) {
+        reader->pos++;
+        return true;
+    }
+    return false;
+}
+
+static int _cbor_text_chunk_to_json(CborReader *reader, JsonWriter *writer, uint64_t len)
+{
+    int           rc;
+    char          escape[8];
+    const uint8_t *pos;
+
+    if ((uint64_t)(reader->end - reader->pos) < len) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    for (pos = reader->pos; pos < reader->pos + len; pos++) {
+        if ('"' == *pos || '\\' == *pos) {
+            escape[0] = '\\';
+            escape[1] = *pos;
+            rc        = _json_put(writer, escape, 2);
+        } else if ('\n' == *pos || '\r' == *pos || '\t' == *pos) {
+            escape[0] = '\\';
+            escape[1] = ('\n' == *pos) ? 'n' : (('\r' == *pos) ? 'r' : 't');
+            rc        = _json_put(writer, escape, 2);
+        } else if (*pos < 0x20) {
+            HAL_Snprintf(escape, sizeof(escape), "\\u%04x", *pos);
+            rc = _json_put(writer, escape, 6);
+        } else {
+            rc = _json_put(writer, (const char *)pos, 1);
+        }
+
+        if (rc != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+    }
+
+    reader->pos += len;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _cbor_text_to_json(CborReader *reader, JsonWriter *writer, uint8_t info, uint64_t len)
+{
+    int      rc;
+    uint8_t  major;
+    uint64_t chunk_len;
+
+    rc = _json_put(writer, "\"", 1);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    if (CBOR_INFO_INDEFINITE != info) {
+        rc = _cbor_text_chunk_to_json(reader, writer, len);
+    } else {
+        // indefinite length text is a sequence of definite length chunks
+        while (!_cbor_is_break(reader)) {
+            rc = _cbor_read_head(reader, &major, &info, &chunk_len);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                return rc;
+            }
+            if (CBOR_MAJOR_TEXT != major || CBOR_INFO_INDEFINITE == info) {
+                return QCLOUD_ERR_JSON_PARSE;
+            }
+            rc = _cbor_text_chunk_to_json(reader, writer, chunk_len);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                return rc;
+            }
+        }
+    }
+
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    return _json_put(writer, "\"", 1);
+}
+
+/**
+ * @brief print the shortest decimal which reads back to the same value
+ */
+static int _cbor_float_to_json(JsonWriter *writer, double value, bool single)
+{
+    char num[CBOR_MAX_NUM_LEN];
+    int  precision, len = 0;
+
+    if (isnan(value) || isinf(value)) {
+        return _json_put(writer, "null", 4);
+    }
+
+    for (precision = 1; precision <= 17; precision++) {
+        len = HAL_Snprintf(num, sizeof(num), "%.*g", precision, value);
+        if (single ? ((float)strtod(num, NULL) == (float)value) : (strtod(num, NULL) == value)) {
+            break;
+        }
+    }
+
+    return _json_put(writer, num, len);
+}
+
+static double _cbor_half_to_double(uint16_t half)
+{
+    int    exp  = (half >> 10) & 0x1F;
+    int    mant = half & 0x3FF;
+    double value;
+
+    if (0 == exp) {
+        value = ldexp(mant, -24);
+    } else if (31 == exp) {
+        value = mant ? NAN : INFINITY;
+    } else {
+        value = ldexp(mant + 1024, exp - 25);
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+static int _cbor_simple_to_json(JsonWriter *writer, uint8_t info, uint64_t val)
+{
+    float    single;
+    double   value;
+    uint32_t bits32;
+
+    switch (info) {
+        case CBOR_INFO_FALSE:
+            return _json_put(writer, "false", 5);
+        case CBOR_INFO_TRUE:
+            return _json_put(writer, "true", 4);
+        case CBOR_INFO_NULL:
+        case CBOR_INFO_UNDEFINED:
+            return _json_put(writer, "null", 4);
+        case CBOR_INFO_HALF:
+            return _cbor_float_to_json(writer, _cbor_half_to_double((uint16_t)val), true);
+        case CBOR_INFO_FLOAT:
+            bits32 = (uint32_t)val;
+            memcpy(&single, &bits32, sizeof(single));
+            return _cbor_float_to_json(writer, single, true);
+        case CBOR_INFO_DOUBLE:
+            memcpy(&value, &val, sizeof(value));
+            return _cbor_float_to_json(writer, value, false);
+        default:
+            return QCLOUD_ERR_JSON_PARSE;
+    }
+}
+
+static int _cbor_container_to_json(CborReader *reader, JsonWriter *writer, int depth, uint8_t major, uint8_t info,
+                                   uint64_t count)
+{
+    int      rc;
+    uint64_t i;
+    bool     is_map = (CBOR_MAJOR_MAP == major);
+
+    rc = _json_put(writer, is_map ? "{" : "[", 1);
+    for (i = 0; rc == QCLOUD_RET_SUCCESS; i++) {
+        if (CBOR_INFO_INDEFINITE == info ? _cbor_is_break(reader) : (i == count)) {
+            break;
+        }
+
+        if (i > 0) {
+            rc = _json_put(writer, ",", 1);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                break;
+            }
+        }
+
+        if (is_map) {
+            // JSON only allows text as key
+            if (reader->pos >= reader->end || CBOR_MAJOR_TEXT != (*reader->pos & 0xE0)) {
+                return QCLOUD_ERR_JSON_PARSE;
+            }
+
+            rc = _cbor_item_to_json(reader, writer, depth + 1);
+            if (rc == QCLOUD_RET_SUCCESS) {
+                rc = _json_put(writer, ":", 1);
+            }
+            if (rc != QCLOUD_RET_SUCCESS) {
+                break;
+            }
+        }
+
+        rc = _cbor_item_to_json(reader, writer, depth + 1);
+    }
+
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    return _json_put(writer, is_map ? "}" : "]", 1);
+}
+
+static int _cbor_item_to_json(CborReader *reader, JsonWriter *writer, int depth)
+{
+    int      rc;
+    uint8_t  major, info;
+    uint64_t val;
+    char     num[CBOR_MAX_NUM_LEN];
+    int      len;
+
+    if (depth > CBOR_MAX_NESTING) {
+        return QCLOUD_ERR_JSON_PARSE;
+    }
+
+    rc = _cbor_read_head(reader, &major, &info, &val);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    switch (major) {
+        case CBOR_MAJOR_UINT:
+            len = HAL_Snprintf(num, sizeof(num), "%llu", (unsigned long long)val);
+            return _json_put(writer, num, len);
+        case CBOR_MAJOR_NINT:
+            if (UINT64_MAX == val) {
+                return _json_put(writer, "-18446744073709551616", 21);
+            }
+            len = HAL_Snprintf(num, sizeof(num), "-%llu", (unsigned long long)val + 1);
+            return _json_put(writer, num, len);
+        case CBOR_MAJOR_TEXT:
+            return _cbor_text_to_json(reader, writer, info, val);
+        case CBOR_MAJOR_ARRAY:
+        case CBOR_MAJOR_MAP:
+            return _cbor_container_to_json(reader, writer, depth, major, info, val);
+        case CBOR_MAJOR_TAG:
+            // semantic tag has no JSON representation, keep the tagged item only
+            return _cbor_item_to_json(reader, writer, depth + 1);
+        case CBOR_MAJOR_SIMPLE:
+            return _cbor_simple_to_json(writer, info, val);
+        default:
+            // byte string has no JSON representation
+            return QCLOUD_ERR_JSON_PARSE;
+    }
+}
+
+int utils_cbor_to_json(const uint8_t *cbor, size_t cbor_len, char *json, size_t json_size, size_t *olen)
+{
+    int        rc;
+    CborReader reader = {cbor, cbor + cbor_len};
+    JsonWriter writer = {json, json_size, 0};
+
+    if (NULL == cbor || NULL == json || 0 == json_size || NULL == olen) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    rc = _cbor_item_to_json(&reader, &writer, 0);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        json[0] = '\0';
+        return rc;
+    }
+
+    json[writer.len] = '\0';
+    *olen            = writer.len;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utils_compress.h"
+
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MAX_DIST  32768
+#define DEFLATE_END_BLOCK 256
+
+#define COMPRESS_HASH_EMPTY 0xFFFF
+
+#define ADLER32_BASE 65521
+#define ADLER32_NMAX 5552
+
+/* zlib header of deflate with 32K window and default level, (CMF << 8 | FLG) is multiple of 31 */
+#define ZLIB_CMF 0x78
+#define ZLIB_FLG 0x01
+
+/* bits written LSB first as deflate requires */
+typedef struct {
+    uint8_t *out;
+    uint32_t out_size;
+    uint32_t out_len;
+    uint32_t bit_buf;
+    uint8_t  bit_cnt;
+    uint8_t  overflow;
+} BitWriter;
+
+static const uint16_t sg_len_base[29] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,  15,  17,  19,  23, 27,
+                                        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+
+static const uint8_t sg_len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+static const uint16_t sg_dist_base[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                          33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                          1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+
+static const uint8_t sg_dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                          6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static uint32_t _adler32(const uint8_t *buf, uint32_t len)
+{
+    uint32_t a = 1, b = 0;
+    uint32_t n;
+
+    while (len > 0) {
+        n = len < ADLER32_NMAX ? len : ADLER32_NMAX;
+        len -= n;
+        while (n--) {
+            a += *buf++;
+            b += a;
+        }
+        a %= ADLER32_BASE;
+        b %= ADLER32_BASE;
+    }
+    return (b << 16) | a;
+}
+
+static void _put_bits(BitWriter *w, uint32_t bits, uint8_t n)
+{
+    w->bit_buf |= bits << w->bit_cnt;
+    w->bit_cnt += n;
+    while (w->bit_cnt >= 8) {
+        if (w->out_len < w->out_size) {
+            w->out[w->out_len++] = (uint8_t)w->bit_buf;
+        } else {
+            w->overflow = 1;
+        }
+        w->bit_buf >>= 8;
+        w->bit_cnt -= 8;
+    }
+}
+
+/* Huffman codes are packed starting from the most significant bit */
+static void _put_code(BitWriter *w, uint32_t code, uint8_t n)
+{
+    uint32_t rev = 0;
+    uint8_t  i;
+
+    for (i = 0; i < n; i++) {
+        rev = (rev << 1) | (code & 1);
+        code >>= 1;
+    }
+    _put_bits(w, rev, n);
+}
+
+/* fixed Huffman code of literal/length alphabet, RFC 1951 3.2.6 */
+static void _put_symbol(BitWriter *w, uint16_t sym)
+{
+    if (sym < 144) {
+        _put_code(w, 0x30 + sym, 8);
+    } else if (sym < 256) {
+        _put_code(w, 0x190 + sym - 144, 9);
+    } else if (sym < 280) {
+        _put_code(w, sym - 256, 7);
+    } else {
+        _put_code(w, 0xC0 + sym - 280, 8);
+    }
+}
+
+static void _put_match(BitWriter *w, uint32_t len, uint32_t dist)
+{
+    int i = 28;
+    int j = 29;
+
+    while (sg_len_base[i] > len) {
+        i--;
+    }
+    _put_symbol(w, DEFLATE_END_BLOCK + 1 + i);
+    _put_bits(w, len - sg_len_base[i], sg_len_extra[i]);
+
+    while (sg_dist_base[j] > dist) {
+        j--;
+    }
+    _put_code(w, j, 5);
+    _put_bits(w, dist - sg_dist_base[j], sg_dist_extra[j]);
+}
+
+static uint32_t _hash(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+    return (v * 2654435761U) >> (32 - COMPRESS_HASH_BITS);
+}
+
+int utils_compress_zlib(const char *in, uint32_t in_len, char *out, uint32_t out_size, void *work)
+{
+    POINTER_SANITY_CHECK(in, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(out, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(work, QCLOUD_ERR_INVAL);
+
+    const uint8_t *src   = (const uint8_t *)in;
+    uint16_t *     table = (uint16_t *)work;
+    BitWriter      w;
+    uint32_t       pos = 0;
+    uint32_t       cand, len, max, k, h;
+    uint32_t       adler;
+
+    if (in_len > COMPRESS_MAX_INPUT_LEN) {
+        Log_e("input too long to compress: %u", in_len);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    memset(table, 0xFF, COMPRESS_WORK_SIZE);
+    memset(&w, 0, sizeof(w));
+    w.out      = (uint8_t *)out;
+    w.out_size = out_size;
+
+    _put_bits(&w, ZLIB_CMF, 8);
+    _put_bits(&w, ZLIB_FLG, 8);
+
+    // one final block of fixed Huffman codes: BFINAL = 1, BTYPE = 01
+    _put_bits(&w, 1, 1);
+    _put_bits(&w, 1, 2);
+
+    while (pos + DEFLATE_MIN_MATCH <= in_len && !w.overflow) {
+        h        = _hash(src + pos);
+        cand     = table[h];
+        table[h] = (uint16_t)pos;
+
+        if (COMPRESS_HASH_EMPTY == cand || pos - cand > DEFLATE_MAX_DIST ||
+            0 != memcmp(src + cand, src + pos, DEFLATE_MIN_MATCH)) {
+            _put_symbol(&w, src[pos++]);
+            continue;
+        }
+
+        max = in_len - pos < DEFLATE_MAX_MATCH ? in_len - pos : DEFLATE_MAX_MATCH;
+        len = DEFLATE_MIN_MATCH;
+        while (len < max && src[cand + len] == src[pos + len]) {
+            len++;
+        }
+        _put_match(&w, len, pos - cand);
+
+        // index the positions covered by the match, so later repeats can refer to them
+        for (k = pos + 1; k < pos + len && k + DEFLATE_MIN_MATCH <= in_len; k++) {
+            table[_hash(src + k)] = (uint16_t)k;
+        }
+        pos += len;
+    }
+
+    while (pos < in_len) {
+        _put_symbol(&w, src[pos++]);
+    }
+    _put_symbol(&w, DEFLATE_END_BLOCK);
+
+    // pad to byte boundary, then Adler-32 in big endian
+    _put_bits(&w, 0, 7);
+    w.bit_buf = 0;
+    w.bit_cnt = 0;
+    adler     = _adler32(src, in_len);
+    _put_bits(&w, (adler >> 24) & 0xFF, 8);
+    _put_bits(&w, (adler >> 16) & 0xFF, 8);
+    _put_bits(&w, (adler >> 8) & 0xFF, 8);
+    _put_bits(&w, adler & 0xFF, 8);
+
+    if (w.overflow) {
+        return QCLOUD_ERR_BUF_TOO_SHORT;
+    }
+
+    return (int)w.out_len;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,839 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utils_decompress.h"
+
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+
+#define DECOMPRESS_NEED_INPUT 1
+
+#define DEFLATE_MAX_BITS  15
+#define DEFLATE_LIT_CODES 288
+#define DEFLATE_DIST_CODES 32
+#define DEFLATE_CLEN_CODES 19
+
+#define GZIP_FHCRC    0x02
+#define GZIP_FEXTRA   0x04
+#define GZIP_FNAME    0x08
+#define GZIP_FCOMMENT 0x10
+
+#define ADLER32_BASE 65521
+#define ADLER32_NMAX 5552
+
+typedef enum {
+    ST_GZIP_HEADER,
+    ST_GZIP_XLEN,
+    ST_GZIP_EXTRA,
+    ST_GZIP_NAME,
+    ST_GZIP_COMMENT,
+    ST_GZIP_HCRC,
+    ST_ZLIB_HEADER,
+    ST_BLOCK_HEADER,
+    ST_STORED_HEADER,
+    ST_STORED_COPY,
+    ST_DYNAMIC_HEADER,
+    ST_DYNAMIC_CLENS,
+    ST_DYNAMIC_LENS,
+    ST_SYMBOL,
+    ST_DIST_SYMBOL,
+    ST_DIST_EXTRA,
+    ST_COPY,
+    ST_TRAILER,
+    ST_HS_TAG,
+    ST_HS_LITERAL,
+    ST_HS_INDEX,
+    ST_HS_COUNT,
+    ST_DONE,
+} eDecompressState;
+
+/* canonical Huffman code: number of codes of each length and symbols ordered by code */
+typedef struct {
+    uint16_t counts[DEFLATE_MAX_BITS + 1];
+    uint16_t symbols[DEFLATE_LIT_CODES];
+} HuffmanTable;
+
+typedef struct {
+    eDecompressFormat        format;
+    eDecompressState         state;
+    eDecompressState         next_state; /* state after back reference copy */
+    DecompressOutputCallback output;
+    void *                   user_data;
+
+    /* input and bit buffer, LSB first for deflate and MSB first for heatshrink */
+    const uint8_t *in;
+    uint32_t       in_len;
+    uint32_t       bit_buf;
+    uint8_t        bit_cnt;
+
+    /* sliding window, which is also the output buffer */
+    uint8_t *window;
+    uint32_t window_mask;
+    uint32_t window_pos;
+    uint32_t flush_pos;
+    uint32_t total_out;
+    uint32_t flushed_out;
+
+    uint32_t copy_len;
+    uint32_t copy_dist;
+    uint8_t  lookahead_bits;
+    uint8_t  window_bits;
+
+    /* deflate block */
+    uint8_t      final;
+    uint16_t     hlit;
+    uint16_t     hdist;
+    uint16_t     hclen;
+    uint16_t     len_idx;
+    uint16_t     dist_sym;
+    uint8_t      lens[DEFLATE_LIT_CODES + DEFLATE_DIST_CODES];
+    HuffmanTable lit;
+    HuffmanTable dist;
+
+    /* wrapper header and trailer */
+    uint8_t  hdr_cnt;
+    uint8_t  hdr_flags;
+    uint16_t extra_len;
+    uint32_t check;
+    uint8_t  trailer[8];
+} Decompress_t;
+
+static const uint16_t sg_len_base[29] = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,  15,  17,  19,  23, 27,
+                                        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+
+static const uint8_t sg_len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+static const uint16_t sg_dist_base[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                          33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                          1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+
+static const uint8_t sg_dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                          6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static const uint8_t sg_clen_order[DEFLATE_CLEN_CODES] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                                          11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+static const uint32_t sg_crc32_table[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+                                            0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                            0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+static uint32_t _crc32_update(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        crc = (crc >> 4) ^ sg_crc32_table[crc & 0x0F];
+        crc = (crc >> 4) ^ sg_crc32_table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t _adler32_update(uint32_t adler, const uint8_t *buf, uint32_t len)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    uint32_t n;
+
+    while (len) {
+        n = len < ADLER32_NMAX ? len : ADLER32_NMAX;
+        len -= n;
+        while (n--) {
+            a += *buf++;
+            b += a;
+        }
+        a %= ADLER32_BASE;
+        b %= ADLER32_BASE;
+    }
+    return (b << 16) | a;
+}
+
+/* send window[flush_pos, window_pos) to output and update check value */
+static int _flush_window(Decompress_t *d)
+{
+    uint32_t len = d->window_pos - d->flush_pos;
+    uint8_t *buf = d->window + d->flush_pos;
+    int      rc;
+
+    if (0 == len) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (DECOMPRESS_GZIP == d->format) {
+        d->check = _crc32_update(d->check, buf, len);
+    } else if (DECOMPRESS_ZLIB == d->format) {
+        d->check = _adler32_update(d->check, buf, len);
+    }
+
+    rc = d->output(d->user_data, d->flushed_out, (const char *)buf, len);
+    d->flushed_out += len;
+    d->flush_pos = d->window_pos;
+    return rc;
+}
+
+static int _put_byte(Decompress_t *d, uint8_t byte)
+{
+    d->window[d->window_pos++] = byte;
+    d->total_out++;
+
+    if (d->window_pos > d->window_mask) {
+        int rc = _flush_window(d);
+        d->window_pos = 0;
+        d->flush_pos  = 0;
+        return rc;
+    }
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* LSB first bit buffer of deflate, keep at least 25 bits when input is available */
+static int _need_bits(Decompress_t *d, uint8_t n)
+{
+    while (d->bit_cnt <= 24 && d->in_len) {
+        d->bit_buf |= (uint32_t)(*d->in++) << d->bit_cnt;
+        d->bit_cnt += 8;
+        d->in_len--;
+    }
+    return d->bit_cnt >= n;
+}
+
+static uint32_t _get_bits(Decompress_t *d, uint8_t n)
+{
+    uint32_t val = d->bit_buf & ((1UL << n) - 1);
+    d->bit_buf >>= n;
+    d->bit_cnt -= n;
+    return val;
+}
+
+/* MSB first bit buffer of heatshrink */
+static int _hs_need_bits(Decompress_t *d, uint8_t n)
+{
+    while (d->bit_cnt <= 24 && d->in_len) {
+        d->bit_buf = (d->bit_buf << 8) | *d->in++;
+        d->bit_cnt += 8;
+        d->in_len--;
+    }
+    return d->bit_cnt >= n;
+}
+
+static uint32_t _hs_get_bits(Decompress_t *d, uint8_t n)
+{
+    d->bit_cnt -= n;
+    return (d->bit_buf >> d->bit_cnt) & ((1UL << n) - 1);
+}
+
+/* build canonical Huffman table from code lengths, fail when over-subscribed */
+static int _huffman_build(HuffmanTable *table, const uint8_t *lens, uint16_t num)
+{
+    uint16_t offs[DEFLATE_MAX_BITS + 1];
+    int      left = 1;
+    uint16_t i;
+
+    memset(table->counts, 0, sizeof(table->counts));
+    for (i = 0; i < num; i++) {
+        table->counts[lens[i]]++;
+    }
+
+    for (i = 1; i <= DEFLATE_MAX_BITS; i++) {
+        left <<= 1;
+        left -= table->counts[i];
+        if (left < 0) {
+            return QCLOUD_ERR_FAILURE;
+        }
+    }
+
+    offs[1] = 0;
+    for (i = 1; i < DEFLATE_MAX_BITS; i++) {
+        offs[i + 1] = offs[i] + table->counts[i];
+    }
+    for (i = 0; i < num; i++) {
+        if (lens[i]) {
+            table->symbols[offs[lens[i]]++] = i;
+        }
+    }
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* decode a symbol without consuming bits, return code length, 0 if more bits needed, -1 if invalid */
+static int _huffman_peek(Decompress_t *d, const HuffmanTable *table, uint16_t *sym)
+{
+    int code = 0, first = 0, index = 0, count, len;
+
+    for (len = 1; len <= DEFLATE_MAX_BITS; len++) {
+        if (len > d->bit_cnt) {
+            return 0;
+        }
+        code |= (d->bit_buf >> (len - 1)) & 1;
+        count = table->counts[len];
+        if (code - count < first) {
+            *sym = table->symbols[index + (code - first)];
+            return len;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void _build_fixed_tables(Decompress_t *d)
+{
+    uint16_t i;
+
+    for (i = 0; i < 144; i++) d->lens[i] = 8;
+    for (; i < 256; i++) d->lens[i] = 9;
+    for (; i < 280; i++) d->lens[i] = 7;
+    for (; i < DEFLATE_LIT_CODES; i++) d->lens[i] = 8;
+    _huffman_build(&d->lit, d->lens, DEFLATE_LIT_CODES);
+
+    memset(d->lens, 5, 30);
+    _huffman_build(&d->dist, d->lens, 30);
+}
+
+static int _start_copy(Decompress_t *d, eDecompressState next_state)
+{
+    if (d->copy_dist > d->window_mask + 1 || d->copy_dist > d->total_out) {
+        Log_e("back reference distance %u out of window", d->copy_dist);
+        return QCLOUD_ERR_FAILURE;
+    }
+    d->state      = ST_COPY;
+    d->next_state = next_state;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _block_end(Decompress_t *d)
+{
+    if (!d->final) {
+        d->state = ST_BLOCK_HEADER;
+    } else if (DECOMPRESS_DEFLATE == d->format) {
+        d->state = ST_DONE;
+    } else {
+        _get_bits(d, d->bit_cnt & 7);
+        d->hdr_cnt = 0;
+        d->state   = ST_TRAILER;
+        // check value covers all the output
+        return _flush_window(d);
+    }
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* skip optional gzip header field if absent */
+static int _gzip_field_absent(Decompress_t *d)
+{
+    switch (d->state) {
+        case ST_GZIP_XLEN:
+            return !(d->hdr_flags & GZIP_FEXTRA);
+        case ST_GZIP_NAME:
+            return !(d->hdr_flags & GZIP_FNAME);
+        case ST_GZIP_COMMENT:
+            return !(d->hdr_flags & GZIP_FCOMMENT);
+        case ST_GZIP_HCRC:
+            return !(d->hdr_flags & GZIP_FHCRC);
+        default:
+            return 0;
+    }
+}
+
+/* header of gzip and zlib wrapper, byte aligned */
+static int _run_header(Decompress_t *d)
+{
+    uint8_t byte;
+
+    if (_gzip_field_absent(d)) {
+        d->state   = (ST_GZIP_XLEN == d->state) ? ST_GZIP_NAME : (ST_GZIP_HCRC == d->state) ? ST_BLOCK_HEADER : d->state + 1;
+        d->hdr_cnt = 0;
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (!_need_bits(d, 8)) {
+        return DECOMPRESS_NEED_INPUT;
+    }
+    byte = _get_bits(d, 8);
+
+    switch (d->state) {
+        case ST_GZIP_HEADER:
+            // ID1 ID2 CM FLG MTIME(4) XFL OS
+            if ((0 == d->hdr_cnt && 0x1F != byte) || (1 == d->hdr_cnt && 0x8B != byte) ||
+                (2 == d->hdr_cnt && 8 != byte)) {
+                Log_e("invalid gzip header");
+                return QCLOUD_ERR_FAILURE;
+            }
+            if (3 == d->hdr_cnt) {
+                d->hdr_flags = byte;
+            }
+            if (++d->hdr_cnt == 10) {
+                d->hdr_cnt = 0;
+                d->state   = ST_GZIP_XLEN;
+            }
+            break;
+
+        case ST_GZIP_XLEN:
+            d->extra_len |= (uint16_t)byte << (8 * d->hdr_cnt);
+            if (++d->hdr_cnt == 2) {
+                d->state = d->extra_len ? ST_GZIP_EXTRA : ST_GZIP_NAME;
+            }
+            break;
+
+        case ST_GZIP_EXTRA:
+            if (0 == --d->extra_len) {
+                d->state = ST_GZIP_NAME;
+            }
+            break;
+
+        case ST_GZIP_NAME:
+        case ST_GZIP_COMMENT:
+            if ('\0' == byte) {
+                d->state++;
+                d->hdr_cnt = 0;
+            }
+            break;
+
+        case ST_GZIP_HCRC:
+            if (++d->hdr_cnt == 2) {
+                d->state = ST_BLOCK_HEADER;
+            }
+            break;
+
+        case ST_ZLIB_HEADER:
+            d->trailer[d->hdr_cnt++] = byte;
+            if (2 == d->hdr_cnt) {
+                // CM 8, window size, no preset dictionary, FCHECK
+                if ((d->trailer[0] & 0x0F) != 8 || (d->trailer[0] >> 4) + 8 > d->window_bits ||
+                    (d->trailer[1] & 0x20) || ((d->trailer[0] << 8) | d->trailer[1]) % 31) {
+                    Log_e("invalid or unsupported zlib header %02x%02x", d->trailer[0], d->trailer[1]);
+                    return QCLOUD_ERR_FAILURE;
+                }
+                d->state = ST_BLOCK_HEADER;
+            }
+            break;
+
+        default:
+            return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _run_trailer(Decompress_t *d)
+{
+    uint8_t  size = (DECOMPRESS_GZIP == d->format) ? 8 : 4;
+    uint32_t check;
+
+    while (d->hdr_cnt < size) {
+        if (!_need_bits(d, 8)) {
+            return DECOMPRESS_NEED_INPUT;
+        }
+        d->trailer[d->hdr_cnt++] = _get_bits(d, 8);
+    }
+
+    if (DECOMPRESS_GZIP == d->format) {
+        check = d->trailer[0] | (d->trailer[1] << 8) | (d->trailer[2] << 16) | ((uint32_t)d->trailer[3] << 24);
+        if (check != d->check) {
+            Log_e("gzip crc32 mismatch: %08x, expect %08x", d->check, check);
+            return QCLOUD_ERR_FAILURE;
+        }
+        check = d->trailer[4] | (d->trailer[5] << 8) | (d->trailer[6] << 16) | ((uint32_t)d->trailer[7] << 24);
+        if (check != d->total_out) {
+            Log_e("gzip size mismatch: %u, expect %u", d->total_out, check);
+            return QCLOUD_ERR_FAILURE;
+        }
+    } else {
+        check = ((uint32_t)d->trailer[0] << 24) | (d->trailer[1] << 16) | (d->trailer[2] << 8) | d->trailer[3];
+        if (check != d->check) {
+            Log_e("zlib adler32 mismatch: %08x, expect %08x", d->check, check);
+            return QCLOUD_ERR_FAILURE;
+        }
+    }
+
+    d->state = ST_DONE;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _run_dynamic_lens(Decompress_t *d)
+{
+    uint16_t sym, num = d->hlit + d->hdist;
+    uint8_t  extra, len_val;
+    uint32_t repeat;
+    int      len;
+
+    while (d->len_idx < num) {
+        _need_bits(d, DEFLATE_MAX_BITS);
+        len = _huffman_peek(d, &d->lit, &sym);
+        if (len < 0) {
+            return QCLOUD_ERR_FAILURE;
+        } else if (0 == len) {
+            return DECOMPRESS_NEED_INPUT;
+        }
+
+        if (sym < 16) {
+            _get_bits(d, len);
+            d->lens[d->len_idx++] = sym;
+            continue;
+        }
+
+        extra = (16 == sym) ? 2 : (17 == sym) ? 3 : 7;
+        if (!_need_bits(d, len + extra)) {
+            return DECOMPRESS_NEED_INPUT;
+        }
+        _get_bits(d, len);
+        repeat = _get_bits(d, extra) + ((18 == sym) ? 11 : 3);
+        if (16 == sym) {
+            if (0 == d->len_idx) {
+                return QCLOUD_ERR_FAILURE;
+            }
+            len_val = d->lens[d->len_idx - 1];
+        } else {
+            len_val = 0;
+        }
+        if (d->len_idx + repeat > num) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        memset(d->lens + d->len_idx, len_val, repeat);
+        d->len_idx += repeat;
+    }
+
+    if (0 == d->lens[256] || _huffman_build(&d->lit, d->lens, d->hlit) ||
+        _huffman_build(&d->dist, d->lens + d->hlit, d->hdist)) {
+        Log_e("invalid dynamic huffman code");
+        return QCLOUD_ERR_FAILURE;
+    }
+    d->state = ST_SYMBOL;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* run the state machine until input is used up or stream is done */
+static int _decompress_run(Decompress_t *d)
+{
+    int      rc = QCLOUD_RET_SUCCESS;
+    int      len;
+    uint16_t sym;
+    uint32_t val;
+
+    while (QCLOUD_RET_SUCCESS == rc) {
+        switch (d->state) {
+            case ST_GZIP_HEADER:
+            case ST_GZIP_XLEN:
+            case ST_GZIP_EXTRA:
+            case ST_GZIP_NAME:
+            case ST_GZIP_COMMENT:
+            case ST_GZIP_HCRC:
+            case ST_ZLIB_HEADER:
+                rc = _run_header(d);
+                break;
+
+            case ST_BLOCK_HEADER:
+                if (!_need_bits(d, 3)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->final = _get_bits(d, 1);
+                val      = _get_bits(d, 2);
+                if (0 == val) {
+                    _get_bits(d, d->bit_cnt & 7);
+                    d->state = ST_STORED_HEADER;
+                } else if (1 == val) {
+                    _build_fixed_tables(d);
+                    d->state = ST_SYMBOL;
+                } else if (2 == val) {
+                    d->state = ST_DYNAMIC_HEADER;
+                } else {
+                    Log_e("invalid deflate block type");
+                    rc = QCLOUD_ERR_FAILURE;
+                }
+                break;
+
+            case ST_STORED_HEADER:
+                if (!_need_bits(d, 32)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->copy_len = _get_bits(d, 16);
+                if ((_get_bits(d, 16) ^ 0xFFFF) != d->copy_len) {
+                    Log_e("invalid stored block length");
+                    rc = QCLOUD_ERR_FAILURE;
+                    break;
+                }
+                d->state = ST_STORED_COPY;
+                break;
+
+            case ST_STORED_COPY:
+                while (d->copy_len && QCLOUD_RET_SUCCESS == rc) {
+                    if (d->bit_cnt) {
+                        rc = _put_byte(d, _get_bits(d, 8));
+                    } else if (d->in_len) {
+                        d->in_len--;
+                        rc = _put_byte(d, *d->in++);
+                    } else {
+                        return DECOMPRESS_NEED_INPUT;
+                    }
+                    d->copy_len--;
+                }
+                if (QCLOUD_RET_SUCCESS == rc) {
+                    rc = _block_end(d);
+                }
+                break;
+
+            case ST_DYNAMIC_HEADER:
+                if (!_need_bits(d, 14)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->hlit  = _get_bits(d, 5) + 257;
+                d->hdist = _get_bits(d, 5) + 1;
+                d->hclen = _get_bits(d, 4) + 4;
+                if (d->hlit > 286 || d->hdist > 30) {
+                    rc = QCLOUD_ERR_FAILURE;
+                    break;
+                }
+                memset(d->lens, 0, DEFLATE_CLEN_CODES);
+                d->len_idx = 0;
+                d->state   = ST_DYNAMIC_CLENS;
+                break;
+
+            case ST_DYNAMIC_CLENS:
+                while (d->len_idx < d->hclen) {
+                    if (!_need_bits(d, 3)) {
+                        return DECOMPRESS_NEED_INPUT;
+                    }
+                    d->lens[sg_clen_order[d->len_idx++]] = _get_bits(d, 3);
+                }
+                // code length code is kept in lit table until all the lengths are read
+                if (_huffman_build(&d->lit, d->lens, DEFLATE_CLEN_CODES)) {
+                    rc = QCLOUD_ERR_FAILURE;
+                    break;
+                }
+                d->len_idx = 0;
+                d->state   = ST_DYNAMIC_LENS;
+                break;
+
+            case ST_DYNAMIC_LENS:
+                rc = _run_dynamic_lens(d);
+                break;
+
+            case ST_SYMBOL:
+                _need_bits(d, DEFLATE_MAX_BITS);
+                len = _huffman_peek(d, &d->lit, &sym);
+                if (0 == len) {
+                    return DECOMPRESS_NEED_INPUT;
+                } else if (len < 0 || sym > 285) {
+                    Log_e("invalid literal/length code");
+                    rc = QCLOUD_ERR_FAILURE;
+                } else if (sym < 256) {
+                    _get_bits(d, len);
+                    rc = _put_byte(d, sym);
+                } else if (256 == sym) {
+                    _get_bits(d, len);
+                    rc = _block_end(d);
+                } else {
+                    sym -= 257;
+                    if (!_need_bits(d, len + sg_len_extra[sym])) {
+                        return DECOMPRESS_NEED_INPUT;
+                    }
+                    _get_bits(d, len);
+                    d->copy_len = sg_len_base[sym] + _get_bits(d, sg_len_extra[sym]);
+                    d->state    = ST_DIST_SYMBOL;
+                }
+                break;
+
+            case ST_DIST_SYMBOL:
+                _need_bits(d, DEFLATE_MAX_BITS);
+                len = _huffman_peek(d, &d->dist, &sym);
+                if (0 == len) {
+                    return DECOMPRESS_NEED_INPUT;
+                } else if (len < 0 || sym > 29) {
+                    Log_e("invalid distance code");
+                    rc = QCLOUD_ERR_FAILURE;
+                    break;
+                }
+                _get_bits(d, len);
+                d->dist_sym = sym;
+                d->state    = ST_DIST_EXTRA;
+                break;
+
+            case ST_DIST_EXTRA:
+                if (!_need_bits(d, sg_dist_extra[d->dist_sym])) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->copy_dist = sg_dist_base[d->dist_sym] + _get_bits(d, sg_dist_extra[d->dist_sym]);
+                rc           = _start_copy(d, ST_SYMBOL);
+                break;
+
+            case ST_COPY:
+                while (d->copy_len && QCLOUD_RET_SUCCESS == rc) {
+                    rc = _put_byte(d, d->window[(d->window_pos - d->copy_dist) & d->window_mask]);
+                    d->copy_len--;
+                }
+                d->state = d->next_state;
+                break;
+
+            case ST_TRAILER:
+                rc = _run_trailer(d);
+                break;
+
+            case ST_HS_TAG:
+                if (!_hs_need_bits(d, 1)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->state = _hs_get_bits(d, 1) ? ST_HS_LITERAL : ST_HS_INDEX;
+                break;
+
+            case ST_HS_LITERAL:
+                if (!_hs_need_bits(d, 8)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                rc       = _put_byte(d, _hs_get_bits(d, 8));
+                d->state = ST_HS_TAG;
+                break;
+
+            case ST_HS_INDEX:
+                if (!_hs_need_bits(d, d->window_bits)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->copy_dist = _hs_get_bits(d, d->window_bits) + 1;
+                d->state     = ST_HS_COUNT;
+                break;
+
+            case ST_HS_COUNT:
+                if (!_hs_need_bits(d, d->lookahead_bits)) {
+                    return DECOMPRESS_NEED_INPUT;
+                }
+                d->copy_len = _hs_get_bits(d, d->lookahead_bits) + 1;
+                rc          = _start_copy(d, ST_HS_TAG);
+                break;
+
+            case ST_DONE:
+                if (d->in_len || d->bit_cnt >= 8) {
+                    Log_e("unexpected data after end of stream");
+                    return QCLOUD_ERR_FAILURE;
+                }
+                return QCLOUD_RET_SUCCESS;
+
+            default:
+                return QCLOUD_ERR_FAILURE;
+        }
+    }
+
+    return rc;
+}
+
+void *utils_decompress_init(eDecompressFormat format, uint8_t window_bits, uint8_t lookahead_bits,
+                            DecompressOutputCallback output, void *user_data)
+{
+    Decompress_t *d;
+
+    if (NULL == output || window_bits < DECOMPRESS_WINDOW_BITS_MIN || window_bits > DECOMPRESS_WINDOW_BITS_MAX ||
+        (DECOMPRESS_HEATSHRINK == format && (lookahead_bits < 3 || lookahead_bits >= window_bits))) {
+        Log_e("invalid decompress parameter: format %d, window %u, lookahead %u", format, window_bits, lookahead_bits);
+        return NULL;
+    }
+
+    d = HAL_Malloc(sizeof(Decompress_t) + (1UL << window_bits));
+    if (NULL == d) {
+        Log_e("malloc decompressor failed");
+        return NULL;
+    }
+
+    memset(d, 0, sizeof(Decompress_t));
+    d->format         = format;
+    d->output         = output;
+    d->user_data      = user_data;
+    d->window         = (uint8_t *)(d + 1);
+    d->window_mask    = (1UL << window_bits) - 1;
+    d->window_bits    = window_bits;
+    d->lookahead_bits = lookahead_bits;
+
+    switch (format) {
+        case DECOMPRESS_GZIP:
+            d->state = ST_GZIP_HEADER;
+            d->check = 0;
+            break;
+        case DECOMPRESS_ZLIB:
+            d->state = ST_ZLIB_HEADER;
+            d->check = 1;
+            break;
+        case DECOMPRESS_HEATSHRINK:
+            d->state = ST_HS_TAG;
+            break;
+        default:
+            d->state = ST_BLOCK_HEADER;
+            break;
+    }
+
+    return d;
+}
+
+int utils_decompress_feed(void *handle, const char *in, uint32_t len)
+{
+    Decompress_t *d = (Decompress_t *)handle;
+    int           rc;
+
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    d->in     = (const uint8_t *)in;
+    d->in_len = len;
+
+    rc = _decompress_run(d);
+    d->in     = NULL;
+    d->in_len = 0;
+    if (rc < 0) {
+        return rc;
+    }
+
+    return _flush_window(d);
+}
+
+int utils_decompress_finish(void *handle)
+{
+    Decompress_t *d = (Decompress_t *)handle;
+
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    // heatshrink has no end mark, the last byte is padded with zero bits
+    if (DECOMPRESS_HEATSHRINK == d->format && (ST_HS_TAG == d->state || ST_HS_INDEX == d->state) &&
+        d->bit_cnt < 8 && 0 == (d->bit_buf & ((1UL << d->bit_cnt) - 1))) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    if (ST_DONE != d->state) {
+        Log_e("compressed stream truncated, state %d", d->state);
+        return QCLOUD_ERR_FAILURE;
+    }
+    return QCLOUD_RET_SUCCESS;
+}
+
+uint32_t utils_decompress_total_out(void *handle)
+{
+    return handle ? ((Decompress_t *)handle)->total_out : 0;
+}
+
+void utils_decompress_deinit(void *handle)
+{
+    if (NULL != handle) {
+        HAL_Free(handle);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
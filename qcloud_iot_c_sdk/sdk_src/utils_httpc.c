@@ -18,6 +18,8 @@
  *
  */
 
+#define LOG_LOCAL_MODULE eLOG_MODULE_HTTP
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -25,6 +27,7 @@ extern "C" {
 #include "utils_httpc.h"
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "qcloud_iot_ca.h"
@@ -38,14 +41,17 @@ extern "C" {
 
 #define HTTP_CLIENT_AUTHB_SIZE 128
 
-#define HTTP_CLIENT_CHUNK_SIZE    1025
 #define HTTP_CLIENT_SEND_BUF_SIZE 1024
 
-#define HTTP_CLIENT_MAX_HOST_LEN 64
-#define HTTP_CLIENT_MAX_URL_LEN  1024
+#define HTTP_CLIENT_MAX_URL_LEN 1024
 
 #define HTTP_RETRIEVE_MORE_DATA (1)
 
+#define HTTP_CLIENT_HEADER_GAP_MS 50 /* wait for more of headers once the response starts */
+
+#define HTTP_CONN_CACHE_SIZE      2     /* idle connections kept for reuse */
+#define HTTP_CONN_IDLE_TIMEOUT_MS 30000 /* below keep-alive timeout of common servers */
+
 #if defined(MBEDTLS_DEBUG_C)
 #define DEBUG_LEVEL 2
 #endif
@@ -322,308 +328,426 @@ static int _http_client_send_userdata(HTTPClient *client, HTTPClientData *client
     return QCLOUD_RET_SUCCESS;
 }
 
-static int _http_client_recv(HTTPClient *client, char *buf, int min_len, int max_len, int *p_read_len,
-                             uint32_t timeout_ms, HTTPClientData *client_data)
+typedef enum {
+    HTTP_PARSE_STATUS = 0,
+    HTTP_PARSE_HEADER,
+    HTTP_PARSE_BODY,     /* body with Content-Length */
+    HTTP_PARSE_BODY_EOF, /* body ends when connection is closed */
+    HTTP_PARSE_CHUNK_SIZE,
+    HTTP_PARSE_CHUNK_EXT,
+    HTTP_PARSE_CHUNK_DATA,
+    HTTP_PARSE_CHUNK_END, /* CRLF after chunk data */
+    HTTP_PARSE_TRAILER,
+    HTTP_PARSE_DONE,
+} eHttpParseState;
+
+static void _http_parser_reset(HTTPResponseParser *parser, bool is_head)
 {
-    IOT_FUNC_ENTRY;
+    // keep bytes buffered and state of connection
+    parser->state      = HTTP_PARSE_STATUS;
+    parser->is_head    = is_head;
+    parser->has_length = 0;
+    parser->cr_seen    = 0;
+    parser->digits     = 0;
+    parser->line_len   = 0;
+    parser->body_left  = 0;
+}
 
-    int    rc = 0;
-    Timer  timer;
-    size_t recv_size = 0;
+static bool _http_parser_in_body(HTTPResponseParser *parser)
+{
+    return (HTTP_PARSE_BODY == parser->state || HTTP_PARSE_BODY_EOF == parser->state ||
+            HTTP_PARSE_CHUNK_DATA == parser->state);
+}
 
-    InitTimer(&timer);
-    countdown_ms(&timer, (unsigned int)timeout_ms);
+/* lower bound of bytes left before the next body byte, so reading them never waits for data not coming */
+static uint32_t _http_parser_min_need(HTTPResponseParser *parser)
+{
+    switch (parser->state) {
+        case HTTP_PARSE_CHUNK_END:
+            /* CRLF, then a chunk size line like "0\r\n" */
+            return (parser->cr_seen ? 1 : 2) + 3;
+        case HTTP_PARSE_CHUNK_SIZE:
+            return parser->digits ? 1 : 3;
+        case HTTP_PARSE_CHUNK_EXT:
+        case HTTP_PARSE_TRAILER:
+            return 1;
+        default:
+            // size of headers is unknown
+            return HTTP_CLIENT_RX_BUF_SIZE;
+    }
+}
 
-    *p_read_len = 0;
+static bool _http_strncase_equal(const char *s1, const char *s2, size_t len)
+{
+    for (; len; len--, s1++, s2++) {
+        if (tolower((unsigned char)*s1) != tolower((unsigned char)*s2)) {
+            return IOT_FALSE;
+        }
+    }
+    return IOT_TRUE;
+}
 
-    rc = client->network_stack.read(&client->network_stack, (unsigned char *)buf, max_len, (uint32_t)left_ms(&timer),
-                                    &recv_size);
-    *p_read_len = (int)recv_size;
-    if (rc == QCLOUD_ERR_SSL_NOTHING_TO_READ || rc == QCLOUD_ERR_TCP_NOTHING_TO_READ) {
-        Log_d("HTTP read nothing and timeout");
-        rc = QCLOUD_RET_SUCCESS;
-    } else if (rc == QCLOUD_ERR_SSL_READ_TIMEOUT || rc == QCLOUD_ERR_TCP_READ_TIMEOUT) {
-        if (*p_read_len == client_data->retrieve_len || client_data->retrieve_len == 0)
-            rc = QCLOUD_RET_SUCCESS;
-        else
-            Log_e("network_stack read timeout");
-    } else if (rc == QCLOUD_ERR_TCP_PEER_SHUTDOWN && *p_read_len > 0) {
-        /* HTTP server give response and close this connection */
-        client->network_stack.disconnect(&client->network_stack);
-        rc = QCLOUD_RET_SUCCESS;
-    } else if (rc != QCLOUD_RET_SUCCESS) {
-        Log_e("Connection error rc = %d (recv returned %d)", rc, *p_read_len);
-        IOT_FUNC_EXIT_RC(rc);
+/* case-insensitive search of token in header value */
+static bool _http_value_has_token(const char *value, const char *token)
+{
+    size_t len = strlen(token);
+
+    for (; strlen(value) >= len; value++) {
+        if (_http_strncase_equal(value, token, len)) {
+            return IOT_TRUE;
+        }
     }
+    return IOT_FALSE;
+}
 
-    IOT_FUNC_EXIT_RC(rc);
+static bool _http_header_is(const char *name, const char *expect)
+{
+    return strlen(name) == strlen(expect) && _http_strncase_equal(name, expect, strlen(expect));
 }
 
-static int _http_client_retrieve_content(HTTPClient *client, char *data, int len, uint32_t timeout_ms,
-                                         HTTPClientData *client_data)
+static int _http_parse_status_line(HTTPClient *client, HTTPResponseParser *parser)
 {
-    IOT_FUNC_ENTRY;
+    const char *p = parser->line;
 
-    int   count   = 0;
-    int   templen = 0;
-    int   crlf_pos;
-    Timer timer;
+    if (0 != strncmp(p, "HTTP/", 5) || NULL == (p = strchr(p, ' ')) || !isdigit((unsigned char)p[1]) ||
+        !isdigit((unsigned char)p[2]) || !isdigit((unsigned char)p[3])) {
+        Log_e("Not a correct HTTP answer : %s", parser->line);
+        return QCLOUD_ERR_HTTP_PRTCL;
+    }
 
-    InitTimer(&timer);
-    countdown_ms(&timer, (unsigned int)timeout_ms);
+    // HTTP/1.0 server closes the connection unless told otherwise
+    parser->close_after   = (0 == strncmp(parser->line, "HTTP/1.0", 8));
+    client->response_code = atoi(p + 1);
+    if ((client->response_code < 200) || (client->response_code >= 400)) {
+        Log_w("Response code %d", client->response_code);
 
-    client_data->is_more = IOT_TRUE;
+        if (client->response_code == 403)
+            return QCLOUD_ERR_HTTP_AUTH;
 
-    if (client_data->response_content_len == -1 && client_data->is_chunked == IOT_FALSE) {
-        while (1) {
-            int rc, max_len;
-            if (count + len < client_data->response_buf_len - 1) {
-                memcpy(client_data->response_buf + count, data, len);
-                count += len;
-                client_data->response_buf[count] = '\0';
-            } else {
-                memcpy(client_data->response_buf + count, data, client_data->response_buf_len - 1 - count);
-                client_data->response_buf[client_data->response_buf_len - 1] = '\0';
-                return HTTP_RETRIEVE_MORE_DATA;
-            }
+        if (client->response_code == 404)
+            return QCLOUD_ERR_HTTP_NOT_FOUND;
+    }
+
+    parser->state = HTTP_PARSE_HEADER;
+    return QCLOUD_RET_SUCCESS;
+}
 
-            max_len = HTTP_CLIENT_MIN(HTTP_CLIENT_CHUNK_SIZE - 1, client_data->response_buf_len - 1 - count);
-            rc      = _http_client_recv(client, data, 1, max_len, &len, (uint32_t)left_ms(&timer), client_data);
+static int _http_parse_header_line(HTTPResponseParser *parser, HTTPClientData *client_data)
+{
+    char *value = strchr(parser->line, ':');
 
-            /* Receive data */
-            // Log_d("data len: %d %d", len, count);
+    if (NULL == value) {
+        Log_e("invalid header line: %s", parser->line);
+        return QCLOUD_ERR_HTTP_PRTCL;
+    }
 
-            if (rc != QCLOUD_RET_SUCCESS) {
-                IOT_FUNC_EXIT_RC(rc);
-            }
-            if (0 >= left_ms(&timer)) {
-                Log_e("HTTP read timeout!");
-                IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_TIMEOUT);
-            }
+    *value++ = '\0';
+    while (' ' == *value || '\t' == *value) {
+        value++;
+    }
 
-            if (len == 0) {
-                /* read no more data */
-                Log_d("no more data, len == 0");
-                client_data->is_more = IOT_FALSE;
-                IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
-            }
+    if (_http_header_is(parser->line, "Content-Length")) {
+        if (!isdigit((unsigned char)*value) || strtoul(value, NULL, 10) > 0x7FFFFFFF) {
+            Log_e("invalid Content-Length: %s", value);
+            return QCLOUD_ERR_HTTP_PRTCL;
+        }
+        parser->has_length = 1;
+        parser->body_left  = strtoul(value, NULL, 10);
+    } else if (_http_header_is(parser->line, "Transfer-Encoding")) {
+        client_data->is_chunked = _http_value_has_token(value, "chunked");
+    } else if (_http_header_is(parser->line, "Connection")) {
+        if (_http_value_has_token(value, "close")) {
+            parser->close_after = 1;
+        } else if (_http_value_has_token(value, "keep-alive")) {
+            parser->close_after = 0;
         }
     }
 
-    while (1) {
-        uint32_t readLen = 0;
-        if (client_data->is_chunked && client_data->retrieve_len <= 0) {
-            /* Read chunk header */
-            bool foundCrlf;
-            int  n;
-            do {
-                foundCrlf = IOT_FALSE;
-                crlf_pos  = 0;
-                data[len] = 0;
-                if (len >= 2) {
-                    for (; crlf_pos < len - 2; crlf_pos++) {
-                        if (data[crlf_pos] == '\r' && data[crlf_pos + 1] == '\n') {
-                            foundCrlf = IOT_TRUE;
-                            break;
-                        }
-                    }
-                }
-                if (!foundCrlf) {
-                    /* Try to read more */
-                    if (len < HTTP_CLIENT_CHUNK_SIZE) {
-                        int new_trf_len, rc;
-                        rc = _http_client_recv(client, data + len, 0, HTTP_CLIENT_CHUNK_SIZE - len - 1, &new_trf_len,
-                                               left_ms(&timer), client_data);
-                        len += new_trf_len;
-                        if ((rc != QCLOUD_RET_SUCCESS) || (0 >= left_ms(&timer))) {
-                            Log_w("_http_client_recv ret: %d, left_time: %d", rc, left_ms(&timer));
-                            IOT_FUNC_EXIT_RC(rc);
-                        } else {
-                            continue;
-                        }
-                    } else {
-                        IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP);
-                    }
-                }
-            } while (!foundCrlf);
-            data[crlf_pos] = '\0';
-
-            // n = sscanf(data, "%x", &readLen);/* chunk length */
-            readLen                   = strtoul(data, NULL, 16);
-            n                         = (0 == readLen) ? 0 : 1;
-            client_data->retrieve_len = readLen;
-            client_data->response_content_len += client_data->retrieve_len;
-            if (readLen == 0) {
-                client_data->is_more = IOT_FALSE;
-                Log_d("no more (last chunk)");
-            }
+    return QCLOUD_RET_SUCCESS;
+}
 
-            if (n != 1) {
-                Log_e("Could not read chunk length");
-                return QCLOUD_ERR_HTTP_UNRESOLVED_DNS;
-            }
+/* end of header: decide how the body is delimited */
+static void _http_parse_header_end(HTTPClient *client, HTTPResponseParser *parser, HTTPClientData *client_data)
+{
+    client_data->response_content_len = 0;
+    client_data->retrieve_len         = 0;
+
+    if (client->response_code >= 100 && client->response_code < 200) {
+        // interim response, the final one follows
+        _http_parser_reset(parser, parser->is_head);
+        client_data->is_chunked = IOT_FALSE;
+    } else if (parser->is_head || 204 == client->response_code || 304 == client->response_code) {
+        parser->state = HTTP_PARSE_DONE;
+    } else if (client_data->is_chunked) {
+        parser->state = HTTP_PARSE_CHUNK_SIZE;
+    } else if (parser->has_length) {
+        client_data->response_content_len = parser->body_left;
+        client_data->retrieve_len         = parser->body_left;
+        parser->state                     = parser->body_left ? HTTP_PARSE_BODY : HTTP_PARSE_DONE;
+    } else {
+        parser->state = HTTP_PARSE_BODY_EOF;
+    }
+}
 
-            memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2));
-            len -= (crlf_pos + 2);
+/* parse one byte of chunk size line or chunk data end */
+static int _http_parse_chunk_byte(HTTPResponseParser *parser, HTTPClientData *client_data, char c)
+{
+    int digit;
 
+    if (HTTP_PARSE_CHUNK_END == parser->state) {
+        if ('\r' == c && !parser->cr_seen) {
+            parser->cr_seen = 1;
+        } else if ('\n' == c) {
+            parser->state = HTTP_PARSE_CHUNK_SIZE;
         } else {
-            readLen = client_data->retrieve_len;
+            Log_e("no CRLF after chunk data");
+            return QCLOUD_ERR_HTTP_PRTCL;
         }
+        return QCLOUD_RET_SUCCESS;
+    }
 
-        do {
-            templen = HTTP_CLIENT_MIN(len, readLen);
-            if (count + templen < client_data->response_buf_len - 1) {
-                memcpy(client_data->response_buf + count, data, templen);
-                count += templen;
-                client_data->response_buf[count] = '\0';
-                client_data->retrieve_len -= templen;
-            } else {
-                memcpy(client_data->response_buf + count, data, client_data->response_buf_len - 1 - count);
-                client_data->response_buf[client_data->response_buf_len - 1] = '\0';
-                client_data->retrieve_len -= (client_data->response_buf_len - 1 - count);
-                IOT_FUNC_EXIT_RC(HTTP_RETRIEVE_MORE_DATA);
-            }
+    if (HTTP_PARSE_CHUNK_SIZE == parser->state && isxdigit((unsigned char)c)) {
+        digit = isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10);
+        if (parser->body_left > (0x7FFFFFFF >> 4)) {
+            Log_e("chunk size overflow");
+            return QCLOUD_ERR_HTTP_PRTCL;
+        }
+        parser->body_left = (parser->body_left << 4) | digit;
+        parser->digits++;
+        return QCLOUD_RET_SUCCESS;
+    }
 
-            if (len > readLen) {
-                Log_d("memmove %d %d %d\n", readLen, len, client_data->retrieve_len);
-                memmove(data, &data[readLen], len - readLen); /* chunk case, read between two chunks */
-                len -= readLen;
-                readLen                   = 0;
-                client_data->retrieve_len = 0;
-            } else {
-                readLen -= len;
+    if ('\n' != c) {
+        if (HTTP_PARSE_CHUNK_SIZE == parser->state) {
+            // chunk extension or whitespace before it
+            if (0 == parser->digits || (';' != c && ' ' != c && '\t' != c && '\r' != c)) {
+                Log_e("invalid chunk size line");
+                return QCLOUD_ERR_HTTP_PRTCL;
             }
+            parser->state = HTTP_PARSE_CHUNK_EXT;
+        }
+        return QCLOUD_RET_SUCCESS;
+    }
 
-            if (readLen) {
-                int rc;
-                int max_len = HTTP_CLIENT_MIN(HTTP_CLIENT_CHUNK_SIZE - 1, client_data->response_buf_len - 1 - count);
-                max_len     = HTTP_CLIENT_MIN(max_len, readLen);
-                rc          = _http_client_recv(client, data, 1, max_len, &len, left_ms(&timer), client_data);
-                if (rc != QCLOUD_RET_SUCCESS) {
-                    Log_w("_http_client_recv ret: %d, left_time: %d", rc, left_ms(&timer));
-                    IOT_FUNC_EXIT_RC(rc);
-                }
-                if (left_ms(&timer) <= 0) {
-                    Log_e("HTTP read timeout!");
-                    IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_TIMEOUT);
-                }
-            }
-        } while (readLen);
-
-        if (client_data->is_chunked) {
-            if (len < 2) {
-                int new_trf_len, rc;
-                /* Read missing chars to find end of chunk */
-                rc = _http_client_recv(client, data + len, 2 - len, HTTP_CLIENT_CHUNK_SIZE - len - 1, &new_trf_len,
-                                       left_ms(&timer), client_data);
-                if ((rc != QCLOUD_RET_SUCCESS) || (0 >= left_ms(&timer))) {
-                    Log_w("_http_client_recv ret: %d, left_time: %d", rc, left_ms(&timer));
-                    IOT_FUNC_EXIT_RC(rc);
-                }
-                len += new_trf_len;
-            }
+    if (0 == parser->digits || parser->body_left > (uint32_t)(0x7FFFFFFF - client_data->response_content_len)) {
+        Log_e("invalid chunk size line");
+        return QCLOUD_ERR_HTTP_PRTCL;
+    }
 
-            if ((data[0] != '\r') || (data[1] != '\n')) {
-                Log_e("Format error, %s", data); /* after memmove, the beginning of next chunk */
-                IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_UNRESOLVED_DNS);
-            }
-            memmove(data, &data[2], len - 2); /* remove the \r\n */
-            len -= 2;
+    client_data->response_content_len += parser->body_left;
+    client_data->retrieve_len = parser->body_left;
+    parser->state             = parser->body_left ? HTTP_PARSE_CHUNK_DATA : HTTP_PARSE_TRAILER;
+    parser->digits            = 0;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* collect a status, header or trailer line and handle it at LF, CR and the part beyond line size are dropped */
+static int _http_parse_line_byte(HTTPClient *client, HTTPResponseParser *parser, HTTPClientData *client_data, char c)
+{
+    int rc = QCLOUD_RET_SUCCESS;
+
+    if ('\n' != c) {
+        if ('\r' != c && parser->line_len < HTTP_CLIENT_LINE_SIZE - 1) {
+            parser->line[parser->line_len++] = c;
+        }
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    parser->line[parser->line_len] = '\0';
+    if (HTTP_PARSE_STATUS == parser->state) {
+        rc = _http_parse_status_line(client, parser);
+    } else if (0 == parser->line_len) {
+        if (HTTP_PARSE_HEADER == parser->state) {
+            _http_parse_header_end(client, parser, client_data);
         } else {
-            // Log_d("no more (content-length)");
-            client_data->is_more = IOT_FALSE;
-            break;
+            parser->state = HTTP_PARSE_DONE;
         }
+    } else if (HTTP_PARSE_HEADER == parser->state) {
+        rc = _http_parse_header_line(parser, client_data);
     }
+    // trailer fields are ignored
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    parser->line_len = 0;
+    return rc;
 }
 
-static int _http_client_response_parse(HTTPClient *client, char *data, int len, uint32_t timeout_ms,
-                                       HTTPClientData *client_data)
+/* parse buffered bytes until body begins, the response ends or rx_buf is drained */
+static int _http_parser_execute(HTTPClient *client, HTTPResponseParser *parser, HTTPClientData *client_data)
 {
-    IOT_FUNC_ENTRY;
+    int  rc = QCLOUD_RET_SUCCESS;
+    char c;
+
+    while (parser->rx_pos < parser->rx_len && !_http_parser_in_body(parser) && HTTP_PARSE_DONE != parser->state) {
+        c = parser->rx_buf[parser->rx_pos++];
+        switch (parser->state) {
+            case HTTP_PARSE_STATUS:
+            case HTTP_PARSE_HEADER:
+            case HTTP_PARSE_TRAILER:
+                rc = _http_parse_line_byte(client, parser, client_data, c);
+                break;
+
+            default:
+                rc = _http_parse_chunk_byte(parser, client_data, c);
+                break;
+        }
 
-    int   crlf_pos;
-    Timer timer;
-    char *tmp_ptr, *ptr_body_end;
+        if (QCLOUD_RET_SUCCESS != rc) {
+            return rc;
+        }
+    }
 
-    InitTimer(&timer);
-    countdown_ms(&timer, timeout_ms);
+    return rc;
+}
 
-    client_data->response_content_len = -1;
+/* body bytes are put to response_buf */
+static void _http_parser_body(HTTPResponseParser *parser, HTTPClientData *client_data, uint32_t len)
+{
+    if (HTTP_PARSE_BODY_EOF == parser->state) {
+        client_data->response_content_len += len;
+        return;
+    }
 
-    char *crlf_ptr = strstr(data, "\r\n");
-    if (crlf_ptr == NULL) {
-        Log_e("\\r\\n not found");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_UNRESOLVED_DNS);
+    parser->body_left -= len;
+    client_data->retrieve_len -= len;
+    if (0 == parser->body_left) {
+        parser->cr_seen = 0;
+        parser->state   = (HTTP_PARSE_BODY == parser->state) ? HTTP_PARSE_DONE : HTTP_PARSE_CHUNK_END;
     }
+}
 
-    crlf_pos       = crlf_ptr - data;
-    data[crlf_pos] = '\0';
+/* read what arrives before timeout, 0 byte read is not an error */
+static int _http_client_recv(HTTPClient *client, char *buf, uint32_t max_len, uint32_t *p_read_len,
+                             uint32_t timeout_ms, HTTPClientData *client_data)
+{
+    int    rc;
+    size_t recv_size = 0;
 
-#if 0
-    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &(client->response_code)) != 1) {
-        Log_e("Not a correct HTTP answer : %s\n", data);
-        return QCLOUD_ERR_HTTP_UNRESOLVED_DNS;
+    *p_read_len = 0;
+    if (client->parser->closed) {
+        return QCLOUD_RET_SUCCESS;
     }
-#endif
 
-    client->response_code = atoi(data + 9);
+    rc = client->network_stack.read(&client->network_stack, (unsigned char *)buf, max_len, timeout_ms, &recv_size);
+    *p_read_len = (uint32_t)recv_size;
+    if (rc == QCLOUD_ERR_SSL_NOTHING_TO_READ || rc == QCLOUD_ERR_TCP_NOTHING_TO_READ ||
+        rc == QCLOUD_ERR_SSL_READ_TIMEOUT || rc == QCLOUD_ERR_TCP_READ_TIMEOUT) {
+        rc = QCLOUD_RET_SUCCESS;
+    } else if (rc == QCLOUD_ERR_TCP_PEER_SHUTDOWN) {
+        /* HTTP server give response and close this connection */
+        client->network_stack.disconnect(&client->network_stack);
+        client->parser->closed = 1;
+        rc                     = QCLOUD_RET_SUCCESS;
+    } else if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("Connection error rc = %d (recv returned %u)", rc, *p_read_len);
+    }
 
-    if ((client->response_code < 200) || (client->response_code >= 400)) {
-        Log_w("Response code %d", client->response_code);
+    return rc;
+}
 
-        if (client->response_code == 403)
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_AUTH);
+static int _http_client_recv_response(HTTPClient *client, uint32_t timeout_ms, HTTPClientData *client_data)
+{
+    IOT_FUNC_ENTRY;
 
-        if (client->response_code == 404)
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_NOT_FOUND);
+    HTTPResponseParser *parser = client->parser;
+    uint32_t            count = 0, cap = client_data->response_buf_len - 1;
+    uint32_t            want, read_len, wait_ms;
+    int                 rc = QCLOUD_RET_SUCCESS;
+    Timer               timer;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, timeout_ms);
+
+    if (NULL == parser || (0 == client->network_stack.handle && !parser->closed)) {
+        Log_e("Connection has not been established");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_CONN);
     }
 
-    // Log_d("Reading headers : %s", data);
+    if (!client_data->is_more) {
+        // next response on the connection
+        _http_parser_reset(parser, IOT_FALSE);
+        client_data->is_more    = IOT_TRUE;
+        client_data->is_chunked = IOT_FALSE;
+    }
 
-    // remove null character
-    memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1);
-    len -= (crlf_pos + 2);
+    while (HTTP_PARSE_DONE != parser->state) {
+        if (_http_parser_in_body(parser)) {
+            if (count == cap) {
+                rc = HTTP_RETRIEVE_MORE_DATA;
+                break;
+            }
 
-    client_data->is_chunked = IOT_FALSE;
+            want = cap - count;
+            if (HTTP_PARSE_BODY_EOF != parser->state) {
+                want = HTTP_CLIENT_MIN(want, parser->body_left);
+            }
 
-    if (NULL == (ptr_body_end = strstr(data, "\r\n\r\n"))) {
-        int new_trf_len, rc;
-        rc = _http_client_recv(client, data + len, 1, HTTP_CLIENT_CHUNK_SIZE - len - 1, &new_trf_len, left_ms(&timer),
-                               client_data);
-        if (rc != QCLOUD_RET_SUCCESS) {
-            IOT_FUNC_EXIT_RC(rc);
+            if (parser->rx_pos < parser->rx_len) {
+                // body bytes read along with the header
+                read_len = HTTP_CLIENT_MIN(want, (uint32_t)(parser->rx_len - parser->rx_pos));
+                memcpy(client_data->response_buf + count, parser->rx_buf + parser->rx_pos, read_len);
+                parser->rx_pos += read_len;
+            } else {
+                rc = _http_client_recv(client, client_data->response_buf + count, want, &read_len, left_ms(&timer),
+                                       client_data);
+            }
+
+            _http_parser_body(parser, client_data, read_len);
+            count += read_len;
+        } else if (parser->rx_pos < parser->rx_len) {
+            rc = _http_parser_execute(client, parser, client_data);
+            if (QCLOUD_RET_SUCCESS != rc) {
+                break;
+            }
+            continue;
+        } else {
+            want    = HTTP_CLIENT_MIN(_http_parser_min_need(parser), HTTP_CLIENT_RX_BUF_SIZE);
+            wait_ms = left_ms(&timer);
+            if (HTTP_CLIENT_RX_BUF_SIZE == want) {
+                // read returns when want is filled or timeout, but size of headers is unknown:
+                // wait for the first byte of response, then take what arrives within a short gap
+                if (HTTP_PARSE_STATUS == parser->state && 0 == parser->line_len) {
+                    want = 1;
+                } else {
+                    wait_ms = HTTP_CLIENT_MIN(wait_ms, HTTP_CLIENT_HEADER_GAP_MS);
+                }
+            }
+            parser->rx_pos = 0;
+            parser->rx_len = 0;
+            rc = _http_client_recv(client, parser->rx_buf, want, &read_len, wait_ms, client_data);
+            parser->rx_len = read_len;
         }
-        len += new_trf_len;
-        data[len] = '\0';
-        if (NULL == (ptr_body_end = strstr(data, "\r\n\r\n"))) {
-            Log_e("parse error: no end of the request body");
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+
+        if (QCLOUD_RET_SUCCESS != rc) {
+            break;
         }
-    }
 
-    if (NULL != (tmp_ptr = strstr(data, "Content-Length"))) {
-        client_data->response_content_len = atoi(tmp_ptr + strlen("Content-Length: "));
-        client_data->retrieve_len         = client_data->response_content_len;
-    } else if (NULL != (tmp_ptr = strstr(data, "Transfer-Encoding"))) {
-        int   len_chunk   = strlen("Chunked");
-        char *chunk_value = data + strlen("Transfer-Encoding: ");
+        if (0 == read_len) {
+            if (parser->closed) {
+                if (HTTP_PARSE_BODY_EOF == parser->state) {
+                    parser->state = HTTP_PARSE_DONE;
+                    break;
+                }
+                Log_e("connection closed by server in state %d", parser->state);
+                rc = QCLOUD_ERR_HTTP_CLOSED;
+                break;
+            }
 
-        if ((!memcmp(chunk_value, "Chunked", len_chunk)) || (!memcmp(chunk_value, "chunked", len_chunk))) {
-            client_data->is_chunked           = IOT_TRUE;
-            client_data->response_content_len = 0;
-            client_data->retrieve_len         = 0;
+            if (0 >= left_ms(&timer)) {
+                // data received so far is returned
+                rc = count ? HTTP_RETRIEVE_MORE_DATA : QCLOUD_ERR_HTTP_TIMEOUT;
+                if (!count) {
+                    Log_e("HTTP read timeout!");
+                }
+                break;
+            }
         }
-    } else {
-        Log_e("Could not parse header");
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP);
     }
 
-    len = len - (ptr_body_end + 4 - data);
-    memmove(data, ptr_body_end + 4, len + 1);
-    int rc = _http_client_retrieve_content(client, data, len, left_ms(&timer), client_data);
+    if (HTTP_PARSE_DONE == parser->state) {
+        client_data->is_more = IOT_FALSE;
+    }
+
+    client_data->response_buf[count] = '\0';
     IOT_FUNC_EXIT_RC(rc);
 }
 
@@ -654,47 +778,6 @@ static int _http_client_send_request(HTTPClient *client, const char *url, HttpMe
     return rc;
 }
 
-static int _http_client_recv_response(HTTPClient *client, uint32_t timeout_ms, HTTPClientData *client_data)
-{
-    IOT_FUNC_ENTRY;
-
-    int   reclen = 0, rc = QCLOUD_ERR_HTTP_CONN;
-    char  buf[HTTP_CLIENT_CHUNK_SIZE] = {0};
-    Timer timer;
-
-    InitTimer(&timer);
-    countdown_ms(&timer, timeout_ms);
-
-    if (0 == client->network_stack.handle) {
-        Log_e("Connection has not been established");
-        IOT_FUNC_EXIT_RC(rc);
-    }
-
-    if (client_data->is_more) {
-        client_data->response_buf[0] = '\0';
-        rc                           = _http_client_retrieve_content(client, buf, reclen, left_ms(&timer), client_data);
-    } else {
-        client_data->is_more = IOT_TRUE;
-        rc = _http_client_recv(client, buf, 1, HTTP_CLIENT_CHUNK_SIZE - 1, &reclen, left_ms(&timer), client_data);
-
-        if (rc != QCLOUD_RET_SUCCESS) {
-            IOT_FUNC_EXIT_RC(rc);
-        }
-        // else if(0 == left_ms(&timer)){
-        //  IOT_FUNC_EXIT_RC(QCLOUD_ERR_HTTP_TIMEOUT);
-        //}
-
-        buf[reclen] = '\0';
-
-        if (reclen) {
-            // HAL_Printf("RESPONSE:\n%s", buf);
-            rc = _http_client_response_parse(client, buf, reclen, left_ms(&timer), client_data);
-        }
-    }
-
-    IOT_FUNC_EXIT_RC(rc);
-}
-
 static int _http_network_init(Network *pNetwork, const char *host, int port, const char *ca_crt_dir)
 {
     int rc = QCLOUD_RET_SUCCESS;
@@ -718,6 +801,182 @@ static int _http_network_init(Network *pNetwork, const char *host, int port, con
     return rc;
 }
 
+typedef struct {
+    Network     network;  // handle is 0 for free entry
+    const char *ca_crt;
+    char        host[HTTP_CLIENT_MAX_HOST_LEN];
+    Timer       idle_timer;
+} HTTPConnCacheEntry;
+
+static HTTPConnCacheEntry sg_http_conn_cache[HTTP_CONN_CACHE_SIZE];
+
+#ifdef MULTITHREAD_ENABLED
+static void *sg_http_conn_cache_lock = NULL;
+#endif
+
+/* lock of cache, false if it cannot be created and cache is not used then */
+static bool _http_conn_cache_lock(void)
+{
+#ifdef MULTITHREAD_ENABLED
+    void *lock     = __atomic_load_n(&sg_http_conn_cache_lock, __ATOMIC_ACQUIRE);
+    void *expected = NULL;
+
+    if (NULL == lock) {
+        lock = HAL_MutexCreate();
+        if (NULL == lock) {
+            Log_e("create http connection cache lock failed");
+            return IOT_FALSE;
+        }
+        // created once for all, the loser of concurrent creation takes the published one
+        if (!__atomic_compare_exchange_n(&sg_http_conn_cache_lock, &expected, lock, IOT_FALSE, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            HAL_MutexDestroy(lock);
+            lock = expected;
+        }
+    }
+    HAL_MutexLock(lock);
+#endif
+    return IOT_TRUE;
+}
+
+static void _http_conn_cache_unlock(void)
+{
+#ifdef MULTITHREAD_ENABLED
+    HAL_MutexUnlock(__atomic_load_n(&sg_http_conn_cache_lock, __ATOMIC_ACQUIRE));
+#endif
+}
+
+/* connection can carry next request when the last response is read up and server keeps it */
+static bool _http_client_is_idle(HTTPClient *client, HTTPClientData *client_data)
+{
+    HTTPResponseParser *parser = client->parser;
+
+    return NULL != parser && 0 != client->network_stack.handle && !client_data->is_more && !parser->closed &&
+           !parser->close_after && parser->rx_pos == parser->rx_len;
+}
+
+/* idle connection may be closed by server meanwhile, which is read as shutdown or error */
+static bool _http_conn_is_alive(Network *network)
+{
+    unsigned char byte;
+    size_t        read_len = 0;
+    int           rc       = network->read(network, &byte, 1, 1, &read_len);
+
+    return 0 == read_len && (QCLOUD_ERR_SSL_NOTHING_TO_READ == rc || QCLOUD_ERR_TCP_NOTHING_TO_READ == rc ||
+                             QCLOUD_ERR_SSL_READ_TIMEOUT == rc || QCLOUD_ERR_TCP_READ_TIMEOUT == rc);
+}
+
+/* take idle connection to host:port with the same ca out of cache */
+static bool _http_conn_cache_take(HTTPClient *client, const char *url, int port, const char *ca_crt)
+{
+    char                host[HTTP_CLIENT_MAX_HOST_LEN] = {0};
+    HTTPConnCacheEntry *entry;
+    Network             network;
+    bool                expire = IOT_FALSE;
+    int                 i;
+
+    if (QCLOUD_RET_SUCCESS != _http_client_parse_host(url, host, sizeof(host))) {
+        return IOT_FALSE;
+    }
+
+#ifdef AUTH_WITH_NOTLS
+    ca_crt = NULL;
+#endif
+
+    memset(&network, 0, sizeof(Network));
+    if (!_http_conn_cache_lock()) {
+        return IOT_FALSE;
+    }
+    for (i = 0; i < HTTP_CONN_CACHE_SIZE; i++) {
+        entry = &sg_http_conn_cache[i];
+        if (0 != entry->network.handle && entry->network.port == port && entry->ca_crt == ca_crt &&
+            0 == strcmp(entry->host, host)) {
+            network               = entry->network;
+            expire                = expired(&entry->idle_timer);
+            entry->network.handle = 0;
+            break;
+        }
+    }
+    _http_conn_cache_unlock();
+
+    if (0 == network.handle) {
+        return IOT_FALSE;
+    }
+
+    if (expire || !_http_conn_is_alive(&network)) {
+        network.disconnect(&network);
+        return IOT_FALSE;
+    }
+
+    client->network_stack = network;
+    memcpy(client->host, host, sizeof(client->host));
+    client->network_stack.host = client->host;
+
+    Log_d("reuse http connection to %s:%d", client->host, port);
+    return IOT_TRUE;
+}
+
+/* put connection into cache, the oldest one is closed if cache is full */
+static void _http_conn_cache_put(HTTPClient *client)
+{
+    HTTPConnCacheEntry *entry = &sg_http_conn_cache[0];
+    Network             evicted;
+    int                 i;
+
+    if (!_http_conn_cache_lock()) {
+        qcloud_http_client_close(client);
+        return;
+    }
+    for (i = 0; i < HTTP_CONN_CACHE_SIZE; i++) {
+        if (0 == sg_http_conn_cache[i].network.handle) {
+            entry = &sg_http_conn_cache[i];
+            break;
+        }
+        if (left_ms(&sg_http_conn_cache[i].idle_timer) < left_ms(&entry->idle_timer)) {
+            entry = &sg_http_conn_cache[i];
+        }
+    }
+
+    evicted        = entry->network;
+    entry->network = client->network_stack;
+    entry->ca_crt  = NULL;
+#ifndef AUTH_WITH_NOTLS
+    if (NETWORK_TLS == client->network_stack.type) {
+        entry->ca_crt = client->network_stack.ssl_connect_params.ca_crt;
+    }
+#endif
+    strncpy(entry->host, client->host, sizeof(entry->host) - 1);
+    entry->host[sizeof(entry->host) - 1] = '\0';
+    entry->network.host                 = entry->host;
+    InitTimer(&entry->idle_timer);
+    countdown_ms(&entry->idle_timer, HTTP_CONN_IDLE_TIMEOUT_MS);
+    _http_conn_cache_unlock();
+
+    client->network_stack.handle = 0;
+    if (0 != evicted.handle) {
+        evicted.disconnect(&evicted);
+    }
+}
+
+void qcloud_http_conn_cache_flush(void)
+{
+    Network network;
+    int     i;
+
+    for (i = 0; i < HTTP_CONN_CACHE_SIZE; i++) {
+        if (!_http_conn_cache_lock()) {
+            return;
+        }
+        network                              = sg_http_conn_cache[i].network;
+        sg_http_conn_cache[i].network.handle = 0;
+        _http_conn_cache_unlock();
+
+        if (0 != network.handle) {
+            network.disconnect(&network);
+        }
+    }
+}
+
 int qcloud_http_client_connect(HTTPClient *client, const char *url, int port, const char *ca_crt)
 {
     if (client->network_stack.handle != 0) {
@@ -725,13 +984,12 @@ int qcloud_http_client_connect(HTTPClient *client, const char *url, int port, co
         return QCLOUD_ERR_HTTP_CONN;
     }
 
-    int  rc;
-    char host[HTTP_CLIENT_MAX_HOST_LEN] = {0};
-    rc                                  = _http_client_parse_host(url, host, sizeof(host));
+    int rc;
+    rc = _http_client_parse_host(url, client->host, sizeof(client->host));
     if (rc != QCLOUD_RET_SUCCESS)
         return rc;
 
-    rc = _http_network_init(&client->network_stack, host, port, ca_crt);
+    rc = _http_network_init(&client->network_stack, client->host, port, ca_crt);
     if (rc != QCLOUD_RET_SUCCESS)
         return rc;
 
@@ -756,24 +1014,81 @@ void qcloud_http_client_close(HTTPClient *client)
     }
 }
 
+static void _http_client_free_parser(HTTPClient *client)
+{
+    HAL_Free(client->parser);
+    client->parser = NULL;
+}
+
+void qcloud_http_client_release(HTTPClient *client, HTTPClientData *client_data)
+{
+    if (_http_client_is_idle(client, client_data)) {
+        _http_conn_cache_put(client);
+    } else {
+        qcloud_http_client_close(client);
+    }
+    _http_client_free_parser(client);
+}
+
 int qcloud_http_client_common(HTTPClient *client, const char *url, int port, const char *ca_crt, HttpMethod method,
                               HTTPClientData *client_data)
 {
-    int rc;
+    int  rc;
+    bool reused = IOT_FALSE;
+
+    if (client->network_stack.handle != 0 && !_http_client_is_idle(client, client_data)) {
+        // last response is not read up, the connection cannot carry another request
+        qcloud_http_client_close(client);
+    }
+
+    if (NULL == client->parser) {
+        // kept out of HTTPClientData and the stack, as it carries the rx buffer
+        client->parser = HAL_Malloc(sizeof(HTTPResponseParser));
+        if (NULL == client->parser) {
+            Log_e("malloc http response parser failed");
+            qcloud_http_client_close(client);
+            return QCLOUD_ERR_MALLOC;
+        }
+        memset(client->parser, 0, sizeof(HTTPResponseParser));
+    }
 
     if (client->network_stack.handle == 0) {
+        reused = _http_conn_cache_take(client, url, port, ca_crt);
+        if (!reused) {
+            rc = qcloud_http_client_connect(client, url, port, ca_crt);
+            if (rc != QCLOUD_RET_SUCCESS) {
+                _http_client_free_parser(client);
+                return rc;
+            }
+        }
+        memset(client->parser, 0, sizeof(HTTPResponseParser));
+    }
+
+    rc = _http_client_send_request(client, url, method, client_data);
+    if (rc != QCLOUD_RET_SUCCESS && reused) {
+        // cached connection is closed by server meanwhile, retry with a new one
+        Log_w("send on reused connection failed, rc = %d, reconnect", rc);
+        qcloud_http_client_close(client);
         rc = qcloud_http_client_connect(client, url, port, ca_crt);
-        if (rc != QCLOUD_RET_SUCCESS)
+        if (rc != QCLOUD_RET_SUCCESS) {
+            _http_client_free_parser(client);
             return rc;
+        }
+        rc = _http_client_send_request(client, url, method, client_data);
     }
 
-    rc = _http_client_send_request(client, url, method, client_data);
     if (rc != QCLOUD_RET_SUCCESS) {
         Log_e("http_client_send_request is error,rc = %d", rc);
         qcloud_http_client_close(client);
+        _http_client_free_parser(client);
         return rc;
     }
 
+    // response of this request is parsed from the beginning
+    _http_parser_reset(client->parser, HTTP_HEAD == method);
+    client_data->is_more    = IOT_TRUE;
+    client_data->is_chunked = IOT_FALSE;
+
     return QCLOUD_RET_SUCCESS;
 }
 
@@ -93,26 +93,33 @@ void utils_md5_starts(iot_md5_context *ctx)
     ctx->state[3] = 0x10325476;
 }
 
-void utils_md5_process(iot_md5_context *ctx, const unsigned char data[64])
+/*
+ * Load message block into X, words are loaded directly on little endian target
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define IOT_MD5_LOAD_BLOCK(X, data) memcpy((X), (data), 64)
+#else
+#define IOT_MD5_LOAD_BLOCK(X, data)                   \
+    {                                                 \
+        int i;                                        \
+        for (i = 0; i < 16; i++) {                    \
+            IOT_MD5_GET_UINT32_LE(X[i], data, i * 4); \
+        }                                             \
+    }
+#endif
+
+/*
+ * Process blocks of 64 bytes, state is kept in registers between blocks
+ */
+static void _utils_md5_process_blocks(uint32_t state[4], const unsigned char *data, size_t blocks)
 {
     uint32_t X[16], A, B, C, D;
 
-    IOT_MD5_GET_UINT32_LE(X[0], data, 0);
-    IOT_MD5_GET_UINT32_LE(X[1], data, 4);
-    IOT_MD5_GET_UINT32_LE(X[2], data, 8);
-    IOT_MD5_GET_UINT32_LE(X[3], data, 12);
-    IOT_MD5_GET_UINT32_LE(X[4], data, 16);
-    IOT_MD5_GET_UINT32_LE(X[5], data, 20);
-    IOT_MD5_GET_UINT32_LE(X[6], data, 24);
-    IOT_MD5_GET_UINT32_LE(X[7], data, 28);
-    IOT_MD5_GET_UINT32_LE(X[8], data, 32);
-    IOT_MD5_GET_UINT32_LE(X[9], data, 36);
-    IOT_MD5_GET_UINT32_LE(X[10], data, 40);
-    IOT_MD5_GET_UINT32_LE(X[11], data, 44);
-    IOT_MD5_GET_UINT32_LE(X[12], data, 48);
-    IOT_MD5_GET_UINT32_LE(X[13], data, 52);
-    IOT_MD5_GET_UINT32_LE(X[14], data, 56);
-    IOT_MD5_GET_UINT32_LE(X[15], data, 60);
+#ifdef HASH_HW_ACCEL
+    if (QCLOUD_RET_SUCCESS == HAL_MD5_Process(state, data, blocks)) {
+        return;
+    }
+#endif
 
 #define S(x, n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
 
@@ -122,99 +129,108 @@ void utils_md5_process(iot_md5_context *ctx, const unsigned char data[64])
         a = S(a, s) + b;            \
     }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+
+    for (; blocks > 0; blocks--, data += 64) {
+        IOT_MD5_LOAD_BLOCK(X, data);
 
 #define F(x, y, z) (z ^ (x & (y ^ z)))
 
-    P(A, B, C, D, 0, 7, 0xD76AA478);
-    P(D, A, B, C, 1, 12, 0xE8C7B756);
-    P(C, D, A, B, 2, 17, 0x242070DB);
-    P(B, C, D, A, 3, 22, 0xC1BDCEEE);
-    P(A, B, C, D, 4, 7, 0xF57C0FAF);
-    P(D, A, B, C, 5, 12, 0x4787C62A);
-    P(C, D, A, B, 6, 17, 0xA8304613);
-    P(B, C, D, A, 7, 22, 0xFD469501);
-    P(A, B, C, D, 8, 7, 0x698098D8);
-    P(D, A, B, C, 9, 12, 0x8B44F7AF);
-    P(C, D, A, B, 10, 17, 0xFFFF5BB1);
-    P(B, C, D, A, 11, 22, 0x895CD7BE);
-    P(A, B, C, D, 12, 7, 0x6B901122);
-    P(D, A, B, C, 13, 12, 0xFD987193);
-    P(C, D, A, B, 14, 17, 0xA679438E);
-    P(B, C, D, A, 15, 22, 0x49B40821);
+        P(A, B, C, D, 0, 7, 0xD76AA478);
+        P(D, A, B, C, 1, 12, 0xE8C7B756);
+        P(C, D, A, B, 2, 17, 0x242070DB);
+        P(B, C, D, A, 3, 22, 0xC1BDCEEE);
+        P(A, B, C, D, 4, 7, 0xF57C0FAF);
+        P(D, A, B, C, 5, 12, 0x4787C62A);
+        P(C, D, A, B, 6, 17, 0xA8304613);
+        P(B, C, D, A, 7, 22, 0xFD469501);
+        P(A, B, C, D, 8, 7, 0x698098D8);
+        P(D, A, B, C, 9, 12, 0x8B44F7AF);
+        P(C, D, A, B, 10, 17, 0xFFFF5BB1);
+        P(B, C, D, A, 11, 22, 0x895CD7BE);
+        P(A, B, C, D, 12, 7, 0x6B901122);
+        P(D, A, B, C, 13, 12, 0xFD987193);
+        P(C, D, A, B, 14, 17, 0xA679438E);
+        P(B, C, D, A, 15, 22, 0x49B40821);
 
 #undef F
 
 #define F(x, y, z) (y ^ (z & (x ^ y)))
 
-    P(A, B, C, D, 1, 5, 0xF61E2562);
-    P(D, A, B, C, 6, 9, 0xC040B340);
-    P(C, D, A, B, 11, 14, 0x265E5A51);
-    P(B, C, D, A, 0, 20, 0xE9B6C7AA);
-    P(A, B, C, D, 5, 5, 0xD62F105D);
-    P(D, A, B, C, 10, 9, 0x02441453);
-    P(C, D, A, B, 15, 14, 0xD8A1E681);
-    P(B, C, D, A, 4, 20, 0xE7D3FBC8);
-    P(A, B, C, D, 9, 5, 0x21E1CDE6);
-    P(D, A, B, C, 14, 9, 0xC33707D6);
-    P(C, D, A, B, 3, 14, 0xF4D50D87);
-    P(B, C, D, A, 8, 20, 0x455A14ED);
-    P(A, B, C, D, 13, 5, 0xA9E3E905);
-    P(D, A, B, C, 2, 9, 0xFCEFA3F8);
-    P(C, D, A, B, 7, 14, 0x676F02D9);
-    P(B, C, D, A, 12, 20, 0x8D2A4C8A);
+        P(A, B, C, D, 1, 5, 0xF61E2562);
+        P(D, A, B, C, 6, 9, 0xC040B340);
+        P(C, D, A, B, 11, 14, 0x265E5A51);
+        P(B, C, D, A, 0, 20, 0xE9B6C7AA);
+        P(A, B, C, D, 5, 5, 0xD62F105D);
+        P(D, A, B, C, 10, 9, 0x02441453);
+        P(C, D, A, B, 15, 14, 0xD8A1E681);
+        P(B, C, D, A, 4, 20, 0xE7D3FBC8);
+        P(A, B, C, D, 9, 5, 0x21E1CDE6);
+        P(D, A, B, C, 14, 9, 0xC33707D6);
+        P(C, D, A, B, 3, 14, 0xF4D50D87);
+        P(B, C, D, A, 8, 20, 0x455A14ED);
+        P(A, B, C, D, 13, 5, 0xA9E3E905);
+        P(D, A, B, C, 2, 9, 0xFCEFA3F8);
+        P(C, D, A, B, 7, 14, 0x676F02D9);
+        P(B, C, D, A, 12, 20, 0x8D2A4C8A);
 
 #undef F
 
 #define F(x, y, z) (x ^ y ^ z)
 
-    P(A, B, C, D, 5, 4, 0xFFFA3942);
-    P(D, A, B, C, 8, 11, 0x8771F681);
-    P(C, D, A, B, 11, 16, 0x6D9D6122);
-    P(B, C, D, A, 14, 23, 0xFDE5380C);
-    P(A, B, C, D, 1, 4, 0xA4BEEA44);
-    P(D, A, B, C, 4, 11, 0x4BDECFA9);
-    P(C, D, A, B, 7, 16, 0xF6BB4B60);
-    P(B, C, D, A, 10, 23, 0xBEBFBC70);
-    P(A, B, C, D, 13, 4, 0x289B7EC6);
-    P(D, A, B, C, 0, 11, 0xEAA127FA);
-    P(C, D, A, B, 3, 16, 0xD4EF3085);
-    P(B, C, D, A, 6, 23, 0x04881D05);
-    P(A, B, C, D, 9, 4, 0xD9D4D039);
-    P(D, A, B, C, 12, 11, 0xE6DB99E5);
-    P(C, D, A, B, 15, 16, 0x1FA27CF8);
-    P(B, C, D, A, 2, 23, 0xC4AC5665);
+        P(A, B, C, D, 5, 4, 0xFFFA3942);
+        P(D, A, B, C, 8, 11, 0x8771F681);
+        P(C, D, A, B, 11, 16, 0x6D9D6122);
+        P(B, C, D, A, 14, 23, 0xFDE5380C);
+        P(A, B, C, D, 1, 4, 0xA4BEEA44);
+        P(D, A, B, C, 4, 11, 0x4BDECFA9);
+        P(C, D, A, B, 7, 16, 0xF6BB4B60);
+        P(B, C, D, A, 10, 23, 0xBEBFBC70);
+        P(A, B, C, D, 13, 4, 0x289B7EC6);
+        P(D, A, B, C, 0, 11, 0xEAA127FA);
+        P(C, D, A, B, 3, 16, 0xD4EF3085);
+        P(B, C, D, A, 6, 23, 0x04881D05);
+        P(A, B, C, D, 9, 4, 0xD9D4D039);
+        P(D, A, B, C, 12, 11, 0xE6DB99E5);
+        P(C, D, A, B, 15, 16, 0x1FA27CF8);
+        P(B, C, D, A, 2, 23, 0xC4AC5665);
 
 #undef F
 
 #define F(x, y, z) (y ^ (x | ~z))
 
-    P(A, B, C, D, 0, 6, 0xF4292244);
-    P(D, A, B, C, 7, 10, 0x432AFF97);
-    P(C, D, A, B, 14, 15, 0xAB9423A7);
-    P(B, C, D, A, 5, 21, 0xFC93A039);
-    P(A, B, C, D, 12, 6, 0x655B59C3);
-    P(D, A, B, C, 3, 10, 0x8F0CCC92);
-    P(C, D, A, B, 10, 15, 0xFFEFF47D);
-    P(B, C, D, A, 1, 21, 0x85845DD1);
-    P(A, B, C, D, 8, 6, 0x6FA87E4F);
-    P(D, A, B, C, 15, 10, 0xFE2CE6E0);
-    P(C, D, A, B, 6, 15, 0xA3014314);
-    P(B, C, D, A, 13, 21, 0x4E0811A1);
-    P(A, B, C, D, 4, 6, 0xF7537E82);
-    P(D, A, B, C, 11, 10, 0xBD3AF235);
-    P(C, D, A, B, 2, 15, 0x2AD7D2BB);
-    P(B, C, D, A, 9, 21, 0xEB86D391);
+        P(A, B, C, D, 0, 6, 0xF4292244);
+        P(D, A, B, C, 7, 10, 0x432AFF97);
+        P(C, D, A, B, 14, 15, 0xAB9423A7);
+        P(B, C, D, A, 5, 21, 0xFC93A039);
+        P(A, B, C, D, 12, 6, 0x655B59C3);
+        P(D, A, B, C, 3, 10, 0x8F0CCC92);
+        P(C, D, A, B, 10, 15, 0xFFEFF47D);
+        P(B, C, D, A, 1, 21, 0x85845DD1);
+        P(A, B, C, D, 8, 6, 0x6FA87E4F);
+        P(D, A, B, C, 15, 10, 0xFE2CE6E0);
+        P(C, D, A, B, 6, 15, 0xA3014314);
+        P(B, C, D, A, 13, 21, 0x4E0811A1);
+        P(A, B, C, D, 4, 6, 0xF7537E82);
+        P(D, A, B, C, 11, 10, 0xBD3AF235);
+        P(C, D, A, B, 2, 15, 0x2AD7D2BB);
+        P(B, C, D, A, 9, 21, 0xEB86D391);
 
 #undef F
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
+        A = state[0] += A;
+        B = state[1] += B;
+        C = state[2] += C;
+        D = state[3] += D;
+    }
+}
+
+void utils_md5_process(iot_md5_context *ctx, const unsigned char data[64])
+{
+    _utils_md5_process_blocks(ctx->state, data, 1);
 }
 
 /*
@@ -241,16 +257,17 @@ void utils_md5_update(iot_md5_context *ctx, const unsigned char *input, size_t i
 
     if (left && ilen >= fill) {
         memcpy((void *)(ctx->buffer + left), input, fill);
-        utils_md5_process(ctx, ctx->buffer);
+        _utils_md5_process_blocks(ctx->state, ctx->buffer, 1);
         input += fill;
         ilen -= fill;
         left = 0;
     }
 
-    while (ilen >= 64) {
-        utils_md5_process(ctx, input);
-        input += 64;
-        ilen -= 64;
+    // full blocks are processed from input, without copying to ctx->buffer
+    if (ilen >= 64) {
+        _utils_md5_process_blocks(ctx->state, input, ilen >> 6);
+        input += ilen & ~(size_t)0x3F;
+        ilen &= 0x3F;
     }
 
     if (ilen > 0) {
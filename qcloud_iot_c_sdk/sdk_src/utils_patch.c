@@ -0,0 +1,294 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utils_patch.h"
+
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "utils_param_check.h"
+
+typedef enum {
+    ST_PATCH_HEADER,
+    ST_PATCH_RECORD,
+    ST_PATCH_DIFF,
+    ST_PATCH_EXTRA,
+    ST_PATCH_DONE,
+} ePatchState;
+
+typedef struct {
+    ePatchState             state;
+    PatchSourceReadCallback read;
+    PatchOutputCallback     output;
+    void *                  user_data;
+
+    uint32_t source_size; /* size of source readable */
+    uint32_t source_used; /* size of source declared by patch header */
+    uint32_t target_size;
+    uint32_t source_pos;
+    uint32_t total_out;
+    uint32_t diff_left;
+    uint32_t extra_left;
+    int32_t  seek;
+
+    uint8_t head_cnt;
+    uint8_t head[PATCH_RECORD_LEN];
+    char    buf[PATCH_SOURCE_READ];
+} Patch_t;
+
+static uint32_t _get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* collect fixed length header or record which may be split across feeds */
+static int _collect_head(Patch_t *p, const uint8_t **in, uint32_t *in_len, uint8_t len)
+{
+    uint32_t n = len - p->head_cnt;
+
+    n = (n < *in_len) ? n : *in_len;
+    memcpy(p->head + p->head_cnt, *in, n);
+    p->head_cnt += n;
+    *in += n;
+    *in_len -= n;
+
+    if (p->head_cnt < len) {
+        return 0;
+    }
+    p->head_cnt = 0;
+    return 1;
+}
+
+static int _parse_header(Patch_t *p)
+{
+    if (0 != memcmp(p->head, PATCH_MAGIC, 4)) {
+        Log_e("invalid patch magic");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    p->target_size = _get_le32(p->head + 4);
+    p->source_used = _get_le32(p->head + 8);
+    if (p->source_used > p->source_size) {
+        Log_e("patch needs source of %u bytes, only %u available", p->source_used, p->source_size);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    p->state = (0 == p->target_size) ? ST_PATCH_DONE : ST_PATCH_RECORD;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _parse_record(Patch_t *p)
+{
+    p->diff_left  = _get_le32(p->head);
+    p->extra_left = _get_le32(p->head + 4);
+    p->seek       = (int32_t)_get_le32(p->head + 8);
+
+    if ((uint64_t)p->total_out + p->diff_left + p->extra_left > p->target_size ||
+        (uint64_t)p->source_pos + p->diff_left > p->source_used) {
+        Log_e("invalid patch record: diff %u, extra %u at target %u, source %u", p->diff_left, p->extra_left,
+              p->total_out, p->source_pos);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    p->state = ST_PATCH_DIFF;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* record is applied, move source position and go on */
+static int _record_end(Patch_t *p)
+{
+    int64_t pos = (int64_t)p->source_pos + p->seek;
+
+    if (pos < 0 || pos > p->source_used) {
+        Log_e("patch seeks source to %ld out of [0, %u]", (long)pos, p->source_used);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    p->source_pos = (uint32_t)pos;
+    p->state      = (p->total_out == p->target_size) ? ST_PATCH_DONE : ST_PATCH_RECORD;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _apply_diff(Patch_t *p, const uint8_t **in, uint32_t *in_len)
+{
+    uint32_t i, n = p->diff_left;
+    int      rc;
+
+    n = (n < *in_len) ? n : *in_len;
+    n = (n < PATCH_SOURCE_READ) ? n : PATCH_SOURCE_READ;
+
+    rc = p->read(p->user_data, p->source_pos, p->buf, n);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        Log_e("read source at %u failed: %d", p->source_pos, rc);
+        return rc;
+    }
+
+    for (i = 0; i < n; i++) {
+        p->buf[i] = (char)((uint8_t)p->buf[i] + (*in)[i]);
+    }
+
+    rc = p->output(p->user_data, p->total_out, p->buf, n);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        return rc;
+    }
+
+    p->source_pos += n;
+    p->total_out += n;
+    p->diff_left -= n;
+    *in += n;
+    *in_len -= n;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _apply_extra(Patch_t *p, const uint8_t **in, uint32_t *in_len)
+{
+    uint32_t n = p->extra_left;
+    int      rc;
+
+    n  = (n < *in_len) ? n : *in_len;
+    rc = p->output(p->user_data, p->total_out, (const char *)*in, n);
+    if (QCLOUD_RET_SUCCESS != rc) {
+        return rc;
+    }
+
+    p->total_out += n;
+    p->extra_left -= n;
+    *in += n;
+    *in_len -= n;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _patch_run(Patch_t *p, const uint8_t *in, uint32_t in_len)
+{
+    int rc = QCLOUD_RET_SUCCESS;
+
+    while (QCLOUD_RET_SUCCESS == rc) {
+        switch (p->state) {
+            case ST_PATCH_HEADER:
+                if (!_collect_head(p, &in, &in_len, PATCH_HEADER_LEN)) {
+                    return QCLOUD_RET_SUCCESS;
+                }
+                rc = _parse_header(p);
+                break;
+
+            case ST_PATCH_RECORD:
+                if (!_collect_head(p, &in, &in_len, PATCH_RECORD_LEN)) {
+                    return QCLOUD_RET_SUCCESS;
+                }
+                rc = _parse_record(p);
+                break;
+
+            case ST_PATCH_DIFF:
+                if (0 == p->diff_left) {
+                    p->state = ST_PATCH_EXTRA;
+                } else if (0 == in_len) {
+                    return QCLOUD_RET_SUCCESS;
+                } else {
+                    rc = _apply_diff(p, &in, &in_len);
+                }
+                break;
+
+            case ST_PATCH_EXTRA:
+                if (0 == p->extra_left) {
+                    rc = _record_end(p);
+                } else if (0 == in_len) {
+                    return QCLOUD_RET_SUCCESS;
+                } else {
+                    rc = _apply_extra(p, &in, &in_len);
+                }
+                break;
+
+            default:
+                if (in_len) {
+                    Log_e("unexpected data after end of patch");
+                    return QCLOUD_ERR_FAILURE;
+                }
+                return QCLOUD_RET_SUCCESS;
+        }
+    }
+
+    return rc;
+}
+
+void *utils_patch_init(uint32_t source_size, PatchSourceReadCallback read, PatchOutputCallback output,
+                       void *user_data)
+{
+    Patch_t *p;
+
+    if (NULL == read || NULL == output) {
+        Log_e("invalid patch parameter");
+        return NULL;
+    }
+
+    p = HAL_Malloc(sizeof(Patch_t));
+    if (NULL == p) {
+        Log_e("malloc patcher failed");
+        return NULL;
+    }
+
+    memset(p, 0, sizeof(Patch_t));
+    p->state       = ST_PATCH_HEADER;
+    p->read        = read;
+    p->output      = output;
+    p->user_data   = user_data;
+    p->source_size = source_size;
+    return p;
+}
+
+int utils_patch_feed(void *handle, const char *in, uint32_t len)
+{
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    return _patch_run((Patch_t *)handle, (const uint8_t *)in, len);
+}
+
+int utils_patch_finish(void *handle)
+{
+    Patch_t *p = (Patch_t *)handle;
+
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+
+    if (ST_PATCH_DONE != p->state) {
+        Log_e("patch truncated, state %d, target %u/%u", p->state, p->total_out, p->target_size);
+        return QCLOUD_ERR_FAILURE;
+    }
+    return QCLOUD_RET_SUCCESS;
+}
+
+uint32_t utils_patch_total_out(void *handle)
+{
+    return handle ? ((Patch_t *)handle)->total_out : 0;
+}
+
+void utils_patch_deinit(void *handle)
+{
+    if (NULL != handle) {
+        HAL_Free(handle);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utils_reply_table.h"
+
+#include <string.h>
+
+#include "utils_timer.h"
+
+#define REPLY_TABLE_MIN_SLOTS 4
+
+static uint16_t _reply_table_hash(ReplyTable *table, uint32_t key)
+{
+    return (uint16_t)(((key * 2654435761UL) >> 16) & table->mask);
+}
+
+static bool _reply_table_earlier(ReplyTable *table, uint16_t pos_a, uint16_t pos_b)
+{
+    // timers count on the same monotonic clock, compare deadlines without reading the clock
+    return table->slots[table->heap[pos_a]].timer.end_time < table->slots[table->heap[pos_b]].timer.end_time;
+}
+
+static void _reply_table_heap_swap(ReplyTable *table, uint16_t pos_a, uint16_t pos_b)
+{
+    uint16_t slot_a = table->heap[pos_a];
+
+    table->heap[pos_a]                        = table->heap[pos_b];
+    table->heap[pos_b]                        = slot_a;
+    table->slots[table->heap[pos_a]].heap_pos = pos_a;
+    table->slots[table->heap[pos_b]].heap_pos = pos_b;
+}
+
+static void _reply_table_sift_up(ReplyTable *table, uint16_t pos)
+{
+    uint16_t parent;
+
+    while (pos > 0) {
+        parent = (pos - 1) / 2;
+        if (!_reply_table_earlier(table, pos, parent)) {
+            break;
+        }
+        _reply_table_heap_swap(table, pos, parent);
+        pos = parent;
+    }
+}
+
+static void _reply_table_sift_down(ReplyTable *table, uint16_t pos)
+{
+    uint16_t child;
+
+    for (;;) {
+        child = pos * 2 + 1;
+        if (child >= table->count) {
+            break;
+        }
+        if (child + 1 < table->count && _reply_table_earlier(table, child + 1, child)) {
+            child++;
+        }
+        if (!_reply_table_earlier(table, child, pos)) {
+            break;
+        }
+        _reply_table_heap_swap(table, pos, child);
+        pos = child;
+    }
+}
+
+static int _reply_table_lookup(ReplyTable *table, uint32_t key)
+{
+    uint16_t idx;
+
+    if (NULL == table->slots) {
+        return -1;
+    }
+
+    for (idx = _reply_table_hash(table, key); NULL != table->slots[idx].data; idx = (idx + 1) & table->mask) {
+        if (table->slots[idx].key == key) {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief remove the slot from heap and hash, shift the following slots of the
+ * probe sequence back so lookup never needs tombstones
+ */
+static void *_reply_table_delete(ReplyTable *table, uint16_t idx)
+{
+    void *   data = table->slots[idx].data;
+    uint16_t pos  = table->slots[idx].heap_pos;
+    uint16_t next, home;
+
+    table->count--;
+    if (pos != table->count) {
+        _reply_table_heap_swap(table, pos, table->count);
+        _reply_table_sift_down(table, pos);
+        _reply_table_sift_up(table, pos);
+    }
+
+    table->slots[idx].data = NULL;
+    for (next = (idx + 1) & table->mask; NULL != table->slots[next].data; next = (next + 1) & table->mask) {
+        home = _reply_table_hash(table, table->slots[next].key);
+        // keep the slot if its home lies cyclically in (idx, next]
+        if ((idx <= next) ? (home > idx && home <= next) : (home > idx || home <= next)) {
+            continue;
+        }
+
+        table->slots[idx]                       = table->slots[next];
+        table->heap[table->slots[idx].heap_pos] = idx;
+        table->slots[next].data                 = NULL;
+        idx                                     = next;
+    }
+
+    return data;
+}
+
+int reply_table_init(ReplyTable *table, uint16_t max_count)
+{
+    uint32_t slot_num = REPLY_TABLE_MIN_SLOTS;
+
+    // keep load factor no more than 0.5
+    while (slot_num < (uint32_t)max_count * 2) {
+        slot_num <<= 1;
+    }
+
+    if (0 == max_count || slot_num > UINT16_MAX + 1UL) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    table->slots = (ReplyTableSlot *)HAL_Malloc(slot_num * sizeof(ReplyTableSlot));
+    table->heap  = (uint16_t *)HAL_Malloc(max_count * sizeof(uint16_t));
+    if (NULL == table->slots || NULL == table->heap) {
+        HAL_Free(table->slots);
+        HAL_Free(table->heap);
+        table->slots = NULL;
+        table->heap  = NULL;
+        return QCLOUD_ERR_MALLOC;
+    }
+
+    memset(table->slots, 0, slot_num * sizeof(ReplyTableSlot));
+    table->mask      = slot_num - 1;
+    table->max_count = max_count;
+    table->count     = 0;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void reply_table_deinit(ReplyTable *table)
+{
+    HAL_Free(table->slots);
+    HAL_Free(table->heap);
+    table->slots = NULL;
+    table->heap  = NULL;
+    table->count = 0;
+}
+
+int reply_table_add(ReplyTable *table, uint32_t key, void *data, uint32_t timeout_ms)
+{
+    uint16_t idx;
+
+    if (NULL == table->slots || NULL == data) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    if (table->count >= table->max_count) {
+        return QCLOUD_ERR_MAX_APPENDING_REQUEST;
+    }
+
+    for (idx = _reply_table_hash(table, key); NULL != table->slots[idx].data; idx = (idx + 1) & table->mask) {
+        if (table->slots[idx].key == key) {
+            return QCLOUD_ERR_FAILURE;
+        }
+    }
+
+    table->slots[idx].key      = key;
+    table->slots[idx].data     = data;
+    table->slots[idx].heap_pos = table->count;
+    InitTimer(&table->slots[idx].timer);
+    countdown_ms(&table->slots[idx].timer, timeout_ms);
+
+    table->heap[table->count] = idx;
+    _reply_table_sift_up(table, table->count++);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void *reply_table_find(ReplyTable *table, uint32_t key)
+{
+    int idx = _reply_table_lookup(table, key);
+
+    return (idx < 0) ? NULL : table->slots[idx].data;
+}
+
+void *reply_table_remove(ReplyTable *table, uint32_t key)
+{
+    int idx = _reply_table_lookup(table, key);
+
+    return (idx < 0) ? NULL : _reply_table_delete(table, idx);
+}
+
+void *reply_table_pop_expired(ReplyTable *table)
+{
+    if (0 == table->count || !expired(&table->slots[table->heap[0]].timer)) {
+        return NULL;
+    }
+
+    return _reply_table_delete(table, table->heap[0]);
+}
+
+void *reply_table_pop(ReplyTable *table)
+{
+    if (0 == table->count) {
+        return NULL;
+    }
+
+    return _reply_table_delete(table, table->heap[0]);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "qcloud_iot_export_error.h"
 #include "qcloud_iot_export_log.h"
 #include "qcloud_iot_import.h"
 
@@ -90,26 +91,19 @@ void utils_sha1_starts(iot_sha1_context *ctx)
     ctx->state[4] = 0xC3D2E1F0;
 }
 
-void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
+/*
+ * Process blocks of 64 bytes, state is kept in registers between blocks
+ */
+static void _utils_sha1_process_blocks(uint32_t state[5], const unsigned char *data, size_t blocks)
 {
     uint32_t temp, W[16], A, B, C, D, E;
+    int      i;
 
-    IOT_SHA1_GET_UINT32_BE(W[0], data, 0);
-    IOT_SHA1_GET_UINT32_BE(W[1], data, 4);
-    IOT_SHA1_GET_UINT32_BE(W[2], data, 8);
-    IOT_SHA1_GET_UINT32_BE(W[3], data, 12);
-    IOT_SHA1_GET_UINT32_BE(W[4], data, 16);
-    IOT_SHA1_GET_UINT32_BE(W[5], data, 20);
-    IOT_SHA1_GET_UINT32_BE(W[6], data, 24);
-    IOT_SHA1_GET_UINT32_BE(W[7], data, 28);
-    IOT_SHA1_GET_UINT32_BE(W[8], data, 32);
-    IOT_SHA1_GET_UINT32_BE(W[9], data, 36);
-    IOT_SHA1_GET_UINT32_BE(W[10], data, 40);
-    IOT_SHA1_GET_UINT32_BE(W[11], data, 44);
-    IOT_SHA1_GET_UINT32_BE(W[12], data, 48);
-    IOT_SHA1_GET_UINT32_BE(W[13], data, 52);
-    IOT_SHA1_GET_UINT32_BE(W[14], data, 56);
-    IOT_SHA1_GET_UINT32_BE(W[15], data, 60);
+#ifdef HASH_HW_ACCEL
+    if (QCLOUD_RET_SUCCESS == HAL_SHA1_Process(state, data, blocks)) {
+        return;
+    }
+#endif
 
 #define S(x, n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
 
@@ -122,35 +116,40 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
         b = S(b, 30);                      \
     }
 
-    A = ctx->state[0];
-    B = ctx->state[1];
-    C = ctx->state[2];
-    D = ctx->state[3];
-    E = ctx->state[4];
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+
+    for (; blocks > 0; blocks--, data += 64) {
+        for (i = 0; i < 16; i++) {
+            IOT_SHA1_GET_UINT32_BE(W[i], data, i * 4);
+        }
 
 #define F(x, y, z) (z ^ (x & (y ^ z)))
 #define K          0x5A827999
 
-    P(A, B, C, D, E, W[0]);
-    P(E, A, B, C, D, W[1]);
-    P(D, E, A, B, C, W[2]);
-    P(C, D, E, A, B, W[3]);
-    P(B, C, D, E, A, W[4]);
-    P(A, B, C, D, E, W[5]);
-    P(E, A, B, C, D, W[6]);
-    P(D, E, A, B, C, W[7]);
-    P(C, D, E, A, B, W[8]);
-    P(B, C, D, E, A, W[9]);
-    P(A, B, C, D, E, W[10]);
-    P(E, A, B, C, D, W[11]);
-    P(D, E, A, B, C, W[12]);
-    P(C, D, E, A, B, W[13]);
-    P(B, C, D, E, A, W[14]);
-    P(A, B, C, D, E, W[15]);
-    P(E, A, B, C, D, R(16));
-    P(D, E, A, B, C, R(17));
-    P(C, D, E, A, B, R(18));
-    P(B, C, D, E, A, R(19));
+        P(A, B, C, D, E, W[0]);
+        P(E, A, B, C, D, W[1]);
+        P(D, E, A, B, C, W[2]);
+        P(C, D, E, A, B, W[3]);
+        P(B, C, D, E, A, W[4]);
+        P(A, B, C, D, E, W[5]);
+        P(E, A, B, C, D, W[6]);
+        P(D, E, A, B, C, W[7]);
+        P(C, D, E, A, B, W[8]);
+        P(B, C, D, E, A, W[9]);
+        P(A, B, C, D, E, W[10]);
+        P(E, A, B, C, D, W[11]);
+        P(D, E, A, B, C, W[12]);
+        P(C, D, E, A, B, W[13]);
+        P(B, C, D, E, A, W[14]);
+        P(A, B, C, D, E, W[15]);
+        P(E, A, B, C, D, R(16));
+        P(D, E, A, B, C, R(17));
+        P(C, D, E, A, B, R(18));
+        P(B, C, D, E, A, R(19));
 
 #undef K
 #undef F
@@ -158,26 +157,26 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
 #define F(x, y, z) (x ^ y ^ z)
 #define K          0x6ED9EBA1
 
-    P(A, B, C, D, E, R(20));
-    P(E, A, B, C, D, R(21));
-    P(D, E, A, B, C, R(22));
-    P(C, D, E, A, B, R(23));
-    P(B, C, D, E, A, R(24));
-    P(A, B, C, D, E, R(25));
-    P(E, A, B, C, D, R(26));
-    P(D, E, A, B, C, R(27));
-    P(C, D, E, A, B, R(28));
-    P(B, C, D, E, A, R(29));
-    P(A, B, C, D, E, R(30));
-    P(E, A, B, C, D, R(31));
-    P(D, E, A, B, C, R(32));
-    P(C, D, E, A, B, R(33));
-    P(B, C, D, E, A, R(34));
-    P(A, B, C, D, E, R(35));
-    P(E, A, B, C, D, R(36));
-    P(D, E, A, B, C, R(37));
-    P(C, D, E, A, B, R(38));
-    P(B, C, D, E, A, R(39));
+        P(A, B, C, D, E, R(20));
+        P(E, A, B, C, D, R(21));
+        P(D, E, A, B, C, R(22));
+        P(C, D, E, A, B, R(23));
+        P(B, C, D, E, A, R(24));
+        P(A, B, C, D, E, R(25));
+        P(E, A, B, C, D, R(26));
+        P(D, E, A, B, C, R(27));
+        P(C, D, E, A, B, R(28));
+        P(B, C, D, E, A, R(29));
+        P(A, B, C, D, E, R(30));
+        P(E, A, B, C, D, R(31));
+        P(D, E, A, B, C, R(32));
+        P(C, D, E, A, B, R(33));
+        P(B, C, D, E, A, R(34));
+        P(A, B, C, D, E, R(35));
+        P(E, A, B, C, D, R(36));
+        P(D, E, A, B, C, R(37));
+        P(C, D, E, A, B, R(38));
+        P(B, C, D, E, A, R(39));
 
 #undef K
 #undef F
@@ -185,26 +184,26 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
 #define F(x, y, z) ((x & y) | (z & (x | y)))
 #define K          0x8F1BBCDC
 
-    P(A, B, C, D, E, R(40));
-    P(E, A, B, C, D, R(41));
-    P(D, E, A, B, C, R(42));
-    P(C, D, E, A, B, R(43));
-    P(B, C, D, E, A, R(44));
-    P(A, B, C, D, E, R(45));
-    P(E, A, B, C, D, R(46));
-    P(D, E, A, B, C, R(47));
-    P(C, D, E, A, B, R(48));
-    P(B, C, D, E, A, R(49));
-    P(A, B, C, D, E, R(50));
-    P(E, A, B, C, D, R(51));
-    P(D, E, A, B, C, R(52));
-    P(C, D, E, A, B, R(53));
-    P(B, C, D, E, A, R(54));
-    P(A, B, C, D, E, R(55));
-    P(E, A, B, C, D, R(56));
-    P(D, E, A, B, C, R(57));
-    P(C, D, E, A, B, R(58));
-    P(B, C, D, E, A, R(59));
+        P(A, B, C, D, E, R(40));
+        P(E, A, B, C, D, R(41));
+        P(D, E, A, B, C, R(42));
+        P(C, D, E, A, B, R(43));
+        P(B, C, D, E, A, R(44));
+        P(A, B, C, D, E, R(45));
+        P(E, A, B, C, D, R(46));
+        P(D, E, A, B, C, R(47));
+        P(C, D, E, A, B, R(48));
+        P(B, C, D, E, A, R(49));
+        P(A, B, C, D, E, R(50));
+        P(E, A, B, C, D, R(51));
+        P(D, E, A, B, C, R(52));
+        P(C, D, E, A, B, R(53));
+        P(B, C, D, E, A, R(54));
+        P(A, B, C, D, E, R(55));
+        P(E, A, B, C, D, R(56));
+        P(D, E, A, B, C, R(57));
+        P(C, D, E, A, B, R(58));
+        P(B, C, D, E, A, R(59));
 
 #undef K
 #undef F
@@ -212,35 +211,41 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
 #define F(x, y, z) (x ^ y ^ z)
 #define K          0xCA62C1D6
 
-    P(A, B, C, D, E, R(60));
-    P(E, A, B, C, D, R(61));
-    P(D, E, A, B, C, R(62));
-    P(C, D, E, A, B, R(63));
-    P(B, C, D, E, A, R(64));
-    P(A, B, C, D, E, R(65));
-    P(E, A, B, C, D, R(66));
-    P(D, E, A, B, C, R(67));
-    P(C, D, E, A, B, R(68));
-    P(B, C, D, E, A, R(69));
-    P(A, B, C, D, E, R(70));
-    P(E, A, B, C, D, R(71));
-    P(D, E, A, B, C, R(72));
-    P(C, D, E, A, B, R(73));
-    P(B, C, D, E, A, R(74));
-    P(A, B, C, D, E, R(75));
-    P(E, A, B, C, D, R(76));
-    P(D, E, A, B, C, R(77));
-    P(C, D, E, A, B, R(78));
-    P(B, C, D, E, A, R(79));
+        P(A, B, C, D, E, R(60));
+        P(E, A, B, C, D, R(61));
+        P(D, E, A, B, C, R(62));
+        P(C, D, E, A, B, R(63));
+        P(B, C, D, E, A, R(64));
+        P(A, B, C, D, E, R(65));
+        P(E, A, B, C, D, R(66));
+        P(D, E, A, B, C, R(67));
+        P(C, D, E, A, B, R(68));
+        P(B, C, D, E, A, R(69));
+        P(A, B, C, D, E, R(70));
+        P(E, A, B, C, D, R(71));
+        P(D, E, A, B, C, R(72));
+        P(C, D, E, A, B, R(73));
+        P(B, C, D, E, A, R(74));
+        P(A, B, C, D, E, R(75));
+        P(E, A, B, C, D, R(76));
+        P(D, E, A, B, C, R(77));
+        P(C, D, E, A, B, R(78));
+        P(B, C, D, E, A, R(79));
 
 #undef K
 #undef F
 
-    ctx->state[0] += A;
-    ctx->state[1] += B;
-    ctx->state[2] += C;
-    ctx->state[3] += D;
-    ctx->state[4] += E;
+        A = state[0] += A;
+        B = state[1] += B;
+        C = state[2] += C;
+        D = state[3] += D;
+        E = state[4] += E;
+    }
+}
+
+void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
+{
+    _utils_sha1_process_blocks(ctx->state, data, 1);
 }
 
 /*
@@ -267,16 +272,17 @@ void utils_sha1_update(iot_sha1_context *ctx, const unsigned char *input, size_t
 
     if (left && ilen >= fill) {
         memcpy((void *)(ctx->buffer + left), input, fill);
-        utils_sha1_process(ctx, ctx->buffer);
+        _utils_sha1_process_blocks(ctx->state, ctx->buffer, 1);
         input += fill;
         ilen -= fill;
         left = 0;
     }
 
-    while (ilen >= 64) {
-        utils_sha1_process(ctx, input);
-        input += 64;
-        ilen -= 64;
+    // full blocks are processed from input, without copying to ctx->buffer
+    if (ilen >= 64) {
+        _utils_sha1_process_blocks(ctx->state, input, ilen >> 6);
+        input += ilen & ~(size_t)0x3F;
+        ilen &= 0x3F;
     }
 
     if (ilen > 0) {
@@ -0,0 +1,291 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "utils_sha256.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+/* Implementation that should never be optimized out by the compiler */
+static void utils_sha256_zeroize(void *v, size_t n)
+{
+    volatile unsigned char *p = v;
+    while (n--) {
+        *p++ = 0;
+    }
+}
+
+/*
+ * 32-bit integer manipulation macros (big endian)
+ */
+#ifndef IOT_SHA256_GET_UINT32_BE
+#define IOT_SHA256_GET_UINT32_BE(n, b, i)                                                                   \
+    {                                                                                                       \
+        (n) = ((uint32_t)(b)[(i)] << 24) | ((uint32_t)(b)[(i) + 1] << 16) | ((uint32_t)(b)[(i) + 2] << 8) | \
+              ((uint32_t)(b)[(i) + 3]);                                                                     \
+    }
+#endif
+
+#ifndef IOT_SHA256_PUT_UINT32_BE
+#define IOT_SHA256_PUT_UINT32_BE(n, b, i)          \
+    {                                              \
+        (b)[(i)]     = (unsigned char)((n) >> 24); \
+        (b)[(i) + 1] = (unsigned char)((n) >> 16); \
+        (b)[(i) + 2] = (unsigned char)((n) >> 8);  \
+        (b)[(i) + 3] = (unsigned char)((n));       \
+    }
+#endif
+
+void utils_sha256_init(iot_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(iot_sha256_context));
+}
+
+void utils_sha256_free(iot_sha256_context *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    utils_sha256_zeroize(ctx, sizeof(iot_sha256_context));
+}
+
+void utils_sha256_clone(iot_sha256_context *dst, const iot_sha256_context *src)
+{
+    *dst = *src;
+}
+
+/*
+ * SHA-256 context setup
+ */
+void utils_sha256_starts(iot_sha256_context *ctx)
+{
+    ctx->total[0] = 0;
+    ctx->total[1] = 0;
+
+    ctx->state[0] = 0x6A09E667;
+    ctx->state[1] = 0xBB67AE85;
+    ctx->state[2] = 0x3C6EF372;
+    ctx->state[3] = 0xA54FF53A;
+    ctx->state[4] = 0x510E527F;
+    ctx->state[5] = 0x9B05688C;
+    ctx->state[6] = 0x1F83D9AB;
+    ctx->state[7] = 0x5BE0CD19;
+}
+
+static const uint32_t iot_sha256_k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+/*
+ * Process blocks of 64 bytes, state is kept in registers between blocks
+ */
+static void _utils_sha256_process_blocks(uint32_t state[8], const unsigned char *data, size_t blocks)
+{
+    uint32_t temp1, temp2, W[16], A, B, C, D, E, F, G, H;
+    int      i;
+
+#ifdef HASH_HW_ACCEL
+    if (QCLOUD_RET_SUCCESS == HAL_SHA256_Process(state, data, blocks)) {
+        return;
+    }
+#endif
+
+#define SHR(x, n)  ((x & 0xFFFFFFFF) >> n)
+#define ROTR(x, n) (SHR(x, n) | (x << (32 - n)))
+
+#define S0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ SHR(x, 3))
+#define S1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ SHR(x, 10))
+#define S2(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define S3(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+
+#define F0(x, y, z) ((x & y) | (z & (x | y)))
+#define F1(x, y, z) (z ^ (x & (y ^ z)))
+
+/* message schedule in a window of 16 words, like SHA-1 */
+#define R(t) (W[(t) & 0x0F] += S1(W[((t) - 2) & 0x0F]) + W[((t) - 7) & 0x0F] + S0(W[((t) - 15) & 0x0F]))
+
+#define P(a, b, c, d, e, f, g, h, x, K)          \
+    {                                            \
+        temp1 = h + S3(e) + F1(e, f, g) + K + x; \
+        temp2 = S2(a) + F0(a, b, c);             \
+        d += temp1;                              \
+        h = temp1 + temp2;                       \
+    }
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+    F = state[5];
+    G = state[6];
+    H = state[7];
+
+    for (; blocks > 0; blocks--, data += 64) {
+        for (i = 0; i < 16; i++) {
+            IOT_SHA256_GET_UINT32_BE(W[i], data, i * 4);
+        }
+
+        for (i = 0; i < 16; i += 8) {
+            P(A, B, C, D, E, F, G, H, W[i + 0], iot_sha256_k[i + 0]);
+            P(H, A, B, C, D, E, F, G, W[i + 1], iot_sha256_k[i + 1]);
+            P(G, H, A, B, C, D, E, F, W[i + 2], iot_sha256_k[i + 2]);
+            P(F, G, H, A, B, C, D, E, W[i + 3], iot_sha256_k[i + 3]);
+            P(E, F, G, H, A, B, C, D, W[i + 4], iot_sha256_k[i + 4]);
+            P(D, E, F, G, H, A, B, C, W[i + 5], iot_sha256_k[i + 5]);
+            P(C, D, E, F, G, H, A, B, W[i + 6], iot_sha256_k[i + 6]);
+            P(B, C, D, E, F, G, H, A, W[i + 7], iot_sha256_k[i + 7]);
+        }
+
+        for (i = 16; i < 64; i += 8) {
+            P(A, B, C, D, E, F, G, H, R(i + 0), iot_sha256_k[i + 0]);
+            P(H, A, B, C, D, E, F, G, R(i + 1), iot_sha256_k[i + 1]);
+            P(G, H, A, B, C, D, E, F, R(i + 2), iot_sha256_k[i + 2]);
+            P(F, G, H, A, B, C, D, E, R(i + 3), iot_sha256_k[i + 3]);
+            P(E, F, G, H, A, B, C, D, R(i + 4), iot_sha256_k[i + 4]);
+            P(D, E, F, G, H, A, B, C, R(i + 5), iot_sha256_k[i + 5]);
+            P(C, D, E, F, G, H, A, B, R(i + 6), iot_sha256_k[i + 6]);
+            P(B, C, D, E, F, G, H, A, R(i + 7), iot_sha256_k[i + 7]);
+        }
+
+        A = state[0] += A;
+        B = state[1] += B;
+        C = state[2] += C;
+        D = state[3] += D;
+        E = state[4] += E;
+        F = state[5] += F;
+        G = state[6] += G;
+        H = state[7] += H;
+    }
+
+#undef P
+#undef R
+#undef F1
+#undef F0
+#undef S3
+#undef S2
+#undef S1
+#undef S0
+#undef ROTR
+#undef SHR
+}
+
+void utils_sha256_process(iot_sha256_context *ctx, const unsigned char data[64])
+{
+    _utils_sha256_process_blocks(ctx->state, data, 1);
+}
+
+/*
+ * SHA-256 process buffer
+ */
+void utils_sha256_update(iot_sha256_context *ctx, const unsigned char *input, size_t ilen)
+{
+    size_t   fill;
+    uint32_t left;
+
+    if (ilen == 0) {
+        return;
+    }
+
+    left = ctx->total[0] & 0x3F;
+    fill = 64 - left;
+
+    ctx->total[0] += (uint32_t)ilen;
+    ctx->total[0] &= 0xFFFFFFFF;
+
+    if (ctx->total[0] < (uint32_t)ilen) {
+        ctx->total[1]++;
+    }
+
+    if (left && ilen >= fill) {
+        memcpy((void *)(ctx->buffer + left), input, fill);
+        _utils_sha256_process_blocks(ctx->state, ctx->buffer, 1);
+        input += fill;
+        ilen -= fill;
+        left = 0;
+    }
+
+    // full blocks are processed from input, without copying to ctx->buffer
+    if (ilen >= 64) {
+        _utils_sha256_process_blocks(ctx->state, input, ilen >> 6);
+        input += ilen & ~(size_t)0x3F;
+        ilen &= 0x3F;
+    }
+
+    if (ilen > 0) {
+        memcpy((void *)(ctx->buffer + left), input, ilen);
+    }
+}
+
+static const unsigned char iot_sha256_padding[64] = {
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+/*
+ * SHA-256 final digest
+ */
+void utils_sha256_finish(iot_sha256_context *ctx, unsigned char output[32])
+{
+    uint32_t      last, padn;
+    uint32_t      high, low;
+    unsigned char msglen[8];
+    int           i;
+
+    high = (ctx->total[0] >> 29) | (ctx->total[1] << 3);
+    low  = (ctx->total[0] << 3);
+
+    IOT_SHA256_PUT_UINT32_BE(high, msglen, 0);
+    IOT_SHA256_PUT_UINT32_BE(low, msglen, 4);
+
+    last = ctx->total[0] & 0x3F;
+    padn = (last < 56) ? (56 - last) : (120 - last);
+
+    utils_sha256_update(ctx, iot_sha256_padding, padn);
+    utils_sha256_update(ctx, msglen, 8);
+
+    for (i = 0; i < 8; i++) {
+        IOT_SHA256_PUT_UINT32_BE(ctx->state[i], output, i * 4);
+    }
+}
+
+/*
+ * output = SHA-256( input buffer )
+ */
+void utils_sha256(const unsigned char *input, size_t ilen, unsigned char output[32])
+{
+    iot_sha256_context ctx;
+
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    utils_sha256_update(&ctx, input, ilen);
+    utils_sha256_finish(&ctx, output);
+    utils_sha256_free(&ctx);
+}
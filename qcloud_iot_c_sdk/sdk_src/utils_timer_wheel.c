@@ -0,0 +1,227 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "utils_timer_wheel.h"
+
+#include <string.h>
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN      ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS))
+
+static void _timer_wheel_link(TimerWheel *wheel, WheelTimer *timer)
+{
+    uint64_t     expire = timer->expire > wheel->now ? timer->expire : wheel->now;
+    uint64_t     delta  = expire - wheel->now;
+    int          level  = 0;
+    int          slot;
+    WheelTimer **head;
+
+    if (delta >= TIMER_WHEEL_SPAN) {
+        // beyond the wheel, park in the farthest slot and relink when it is cascaded
+        expire = wheel->now + TIMER_WHEEL_SPAN - 1;
+        delta  = TIMER_WHEEL_SPAN - 1;
+    }
+    while (delta >> (TIMER_WHEEL_SLOT_BITS * (level + 1))) {
+        level++;
+    }
+
+    slot = (int)(expire >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+    head = &wheel->slots[level][slot];
+
+    timer->next = *head;
+    if (NULL != timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head        = timer;
+    wheel->bitmap[level] |= (uint64_t)1 << slot;
+}
+
+static void _timer_wheel_unlink(WheelTimer *timer)
+{
+    *timer->pprev = timer->next;
+    if (NULL != timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next  = NULL;
+    timer->pprev = NULL;
+}
+
+/* take all timers of a slot, the bit of an emptied slot is only cleared here */
+static WheelTimer *_timer_wheel_detach(TimerWheel *wheel, int level, int slot, WheelTimer **list)
+{
+    *list = wheel->slots[level][slot];
+    if (NULL != *list) {
+        (*list)->pprev = list;
+    }
+    wheel->slots[level][slot] = NULL;
+    wheel->bitmap[level] &= ~((uint64_t)1 << slot);
+
+    return *list;
+}
+
+/* distance from slot to the next slot marked in bitmap, in circle */
+static int _timer_wheel_next_slot(uint64_t bitmap, int slot)
+{
+    int offset = 0;
+
+    bitmap = slot ? (bitmap >> slot) | (bitmap << (TIMER_WHEEL_SLOTS - slot)) : bitmap;
+    while (!(bitmap & 1)) {
+        bitmap >>= 1;
+        offset++;
+    }
+
+    return offset;
+}
+
+/* the first tick from now which expires slot of level 0 or cascades slot of upper level */
+static uint64_t _timer_wheel_next_tick(TimerWheel *wheel)
+{
+    uint64_t next = UINT64_MAX;
+    uint64_t block, tick;
+    int      level, shift;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (0 == wheel->bitmap[level]) {
+            continue;
+        }
+
+        // slots of level are handled at the start of blocks of 64^level ticks
+        shift = TIMER_WHEEL_SLOT_BITS * level;
+        block = (wheel->now + ((uint64_t)1 << shift) - 1) >> shift;
+        block += _timer_wheel_next_slot(wheel->bitmap[level], (int)(block & TIMER_WHEEL_SLOT_MASK));
+        tick = block << shift;
+        if (tick < next) {
+            next = tick;
+        }
+    }
+
+    return next;
+}
+
+void timer_wheel_init(TimerWheel *wheel)
+{
+    memset(wheel, 0, sizeof(TimerWheel));
+    wheel->now = HAL_GetTimeMs64();
+}
+
+void wheel_timer_init(WheelTimer *timer, WheelTimerHandler handler, void *user_data)
+{
+    memset(timer, 0, sizeof(WheelTimer));
+    timer->handler   = handler;
+    timer->user_data = user_data;
+}
+
+void timer_wheel_add(TimerWheel *wheel, WheelTimer *timer, uint32_t timeout_ms)
+{
+    if (wheel_timer_pending(timer)) {
+        _timer_wheel_unlink(timer);
+    } else {
+        wheel->count++;
+    }
+
+    timer->expire = HAL_GetTimeMs64() + timeout_ms;
+    _timer_wheel_link(wheel, timer);
+}
+
+void timer_wheel_del(TimerWheel *wheel, WheelTimer *timer)
+{
+    if (!wheel_timer_pending(timer)) {
+        return;
+    }
+
+    _timer_wheel_unlink(timer);
+    wheel->count--;
+}
+
+int timer_wheel_run(TimerWheel *wheel)
+{
+    uint64_t    now   = HAL_GetTimeMs64();
+    int         fired = 0;
+    int         level;
+    uint64_t    tick;
+    WheelTimer *list;
+    WheelTimer *timer;
+
+    while (wheel->now <= now) {
+        tick = _timer_wheel_next_tick(wheel);
+        if (tick > now) {
+            break;
+        }
+        wheel->now = tick;
+
+        // at the start of a block, move timers of the block in upper level down
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (tick & (((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * level)) - 1)) {
+                break;
+            }
+            _timer_wheel_detach(wheel, level, (int)(tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK,
+                                &list);
+            while (NULL != (timer = list)) {
+                _timer_wheel_unlink(timer);
+                _timer_wheel_link(wheel, timer);
+            }
+        }
+
+        // timers restarted by handler are linked after this tick
+        _timer_wheel_detach(wheel, 0, (int)tick & TIMER_WHEEL_SLOT_MASK, &list);
+        wheel->now = tick + 1;
+        while (NULL != (timer = list)) {
+            _timer_wheel_unlink(timer);
+            wheel->count--;
+            fired++;
+            if (NULL != timer->handler) {
+                timer->handler(timer->user_data);
+            }
+        }
+    }
+
+    if (wheel->now <= now) {
+        wheel->now = now + 1;
+    }
+
+    return fired;
+}
+
+uint32_t timer_wheel_next_ms(TimerWheel *wheel)
+{
+    uint64_t now = HAL_GetTimeMs64();
+    uint64_t tick;
+
+    if (0 == wheel->count) {
+        return UINT32_MAX;
+    }
+
+    tick = _timer_wheel_next_tick(wheel);
+    if (tick <= now) {
+        return 0;
+    }
+
+    return tick - now > UINT32_MAX ? UINT32_MAX : (uint32_t)(tick - now);
+}
+
+#ifdef __cplusplus
+}
+#endif
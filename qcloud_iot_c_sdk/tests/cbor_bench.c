@@ -0,0 +1,175 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Size and CPU benchmark of the codecs of data_template, on a property report like the one
+ * IOT_Template_Report_Changed builds. It compares JSON, CBOR encoded from the properties
+ * directly, CBOR transcoded from the JSON report, and decoding CBOR back to JSON.
+ *
+ * usage: cbor_bench [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "data_template_client_json.h"
+#include "utils_cbor.h"
+
+#define BENCH_BUF_LEN      1024
+#define BENCH_CLIENT_TOKEN "ABCDEFGHIJ-123"
+
+static int32_t  sg_power      = 1;
+static int32_t  sg_brightness = 87;
+static int32_t  sg_color      = 2;
+static uint32_t sg_energy     = 3000000000u;
+static float    sg_temp       = 23.5f;
+static double   sg_ratio      = 0.125;
+static bool     sg_online     = true;
+static char     sg_name[]     = "living-room-lamp";
+
+static DeviceProperty sg_props[] = {
+    {"power_switch", &sg_power, 0, JINT32}, {"brightness", &sg_brightness, 0, JINT32},
+    {"color", &sg_color, 0, JINT32},        {"energy", &sg_energy, 0, JUINT32},
+    {"temperature", &sg_temp, 0, JFLOAT},   {"ratio", &sg_ratio, 0, JDOUBLE},
+    {"online", &sg_online, 0, JBOOL},       {"name", sg_name, sizeof(sg_name) - 1, JSTRING},
+};
+
+#define BENCH_PROP_NUM (sizeof(sg_props) / sizeof(sg_props[0]))
+
+static double _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t _build_json(char *buf, size_t size)
+{
+    size_t i, len;
+
+    snprintf(buf, size, "{\"method\":\"report\", \"clientToken\":\"%s\", \"params\":{", BENCH_CLIENT_TOKEN);
+    for (i = 0; i < BENCH_PROP_NUM; i++) {
+        if (QCLOUD_RET_SUCCESS != template_put_json_node(buf, size, sg_props[i].key, sg_props[i].data, sg_props[i].type)) {
+            abort();
+        }
+    }
+    len          = strlen(buf);
+    buf[len - 1] = '}';  // replace the last ','
+    buf[len++]   = '}';
+    buf[len]     = '\0';
+
+    return len;
+}
+
+static size_t _build_cbor(uint8_t *buf, size_t size)
+{
+    CborWriter writer;
+    size_t     i;
+
+    utils_cbor_writer_init(&writer, buf, size);
+    utils_cbor_put_map(&writer, 3);
+    utils_cbor_put_text(&writer, "method");
+    utils_cbor_put_text(&writer, "report");
+    utils_cbor_put_text(&writer, "clientToken");
+    utils_cbor_put_text(&writer, BENCH_CLIENT_TOKEN);
+    utils_cbor_put_text(&writer, "params");
+    utils_cbor_put_map(&writer, BENCH_PROP_NUM);
+    for (i = 0; i < BENCH_PROP_NUM; i++) {
+        template_put_cbor_node(&writer, sg_props[i].key, sg_props[i].data, sg_props[i].type, false);
+    }
+    if (QCLOUD_RET_SUCCESS != utils_cbor_writer_result(&writer)) {
+        abort();
+    }
+
+    return writer.len;
+}
+
+static size_t _transcode(const char *json, size_t json_len, uint8_t *buf, size_t size)
+{
+    size_t len;
+
+    if (QCLOUD_RET_SUCCESS != utils_json_to_cbor(json, json_len, buf, size, &len)) {
+        abort();
+    }
+
+    return len;
+}
+
+static size_t _decode(const uint8_t *cbor, size_t cbor_len, char *buf, size_t size)
+{
+    size_t len;
+
+    if (QCLOUD_RET_SUCCESS != utils_cbor_to_json(cbor, cbor_len, buf, size, &len)) {
+        abort();
+    }
+
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    static char    json[BENCH_BUF_LEN], decoded[BENCH_BUF_LEN];
+    static uint8_t cbor[BENCH_BUF_LEN];
+    long           i, rounds = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    size_t         json_len = 0, cbor_len = 0, transcoded_len = 0, decoded_len = 0;
+    double         start, json_ns, cbor_ns, json_cbor_ns, transcode_ns, decode_ns;
+
+    if (rounds <= 0) {
+        rounds = 1;
+    }
+
+    start = _now_ns();
+    for (i = 0; i < rounds; i++) {
+        json[0]  = '\0';
+        json_len = _build_json(json, sizeof(json));
+    }
+    json_ns = (_now_ns() - start) / rounds;
+
+    start = _now_ns();
+    for (i = 0; i < rounds; i++) {
+        cbor_len = _build_cbor(cbor, sizeof(cbor));
+    }
+    cbor_ns = (_now_ns() - start) / rounds;
+
+    start = _now_ns();
+    for (i = 0; i < rounds; i++) {
+        transcoded_len = _transcode(json, json_len, cbor, sizeof(cbor));
+    }
+    transcode_ns = (_now_ns() - start) / rounds;
+    json_cbor_ns = json_ns + transcode_ns;
+
+    start = _now_ns();
+    for (i = 0; i < rounds; i++) {
+        decoded_len = _decode(cbor, transcoded_len, decoded, sizeof(decoded));
+    }
+    decode_ns = (_now_ns() - start) / rounds;
+
+    printf("report of %u properties, %ld rounds\n", (unsigned)BENCH_PROP_NUM, rounds);
+    printf("%-22s %6s %10s\n", "codec", "bytes", "ns/doc");
+    printf("%-22s %6u %10.0f\n", "JSON", (unsigned)json_len, json_ns);
+    printf("%-22s %6u %10.0f\n", "CBOR direct", (unsigned)cbor_len, cbor_ns);
+    printf("%-22s %6u %10.0f\n", "CBOR from JSON", (unsigned)transcoded_len, json_cbor_ns);
+    printf("%-22s %6u %10.0f\n", "CBOR to JSON", (unsigned)decoded_len, decode_ns);
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Fuzz harness of the CBOR codec of data_template.
+ *
+ * Each input is fed to the decoder as CBOR and to the encoder as JSON. Whatever is accepted
+ * must reach a fixed point after one lossy round, in which integers out of range become
+ * floats and non-finite floats become null, and encoding into a short buffer must fail
+ * without writing out of it.
+ *
+ * Built with libFuzzer when FUZZ_WITH_LIBFUZZER is defined, or runs the given corpus files
+ * and random mutations of the built-in seeds standalone.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "data_template_client_json.h"
+#include "utils_cbor.h"
+
+#define FUZZ_JSON_BUF_LEN  4096
+#define FUZZ_MAX_INPUT_LEN 1024
+
+#define FUZZ_CHECK(cond)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                                \
+        }                                                                           \
+    } while (0)
+
+static const char *sg_seeds[] = {
+    "{\"method\":\"report\", \"clientToken\":\"ABCDEFGHIJ-1\", \"params\":{\"power\":1,\"color\":0}}",
+    "{\"method\":\"control\",\"clientToken\":\"clientToken-1\",\"params\":{\"name\":\"lamp\",\"ratio\":0.5,\"big\":"
+    "4000000000,\"neg\":-2147483648,\"on\":true,\"off\":false,\"none\":null}}",
+    "{\"method\":\"events_post\",\"events\":[{\"eventId\":\"a\",\"timestamp\":1700000000000,\"params\":{}},[],{}]}",
+    "[\"\\u00e9\\ud83d\\ude00\\n\\\"\",1e400,-0,1.5e-7,18446744073709551616,-9223372036854775809]",
+};
+
+/**
+ * @brief encode JSON into a buffer of exactly the encoded length, and check a shorter one is rejected
+ */
+static int _encode_json(const char *json, size_t json_len, uint8_t **cbor, size_t *cbor_len)
+{
+    int     rc;
+    size_t  len;
+    uint8_t short_buf[1];
+
+    rc = utils_json_to_cbor(json, json_len, NULL, 0, &len);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    // the buffer is not touched past its size
+    FUZZ_CHECK(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL == utils_json_to_cbor(json, json_len, short_buf, 0, &len));
+
+    *cbor = (uint8_t *)malloc(len);
+    FUZZ_CHECK(NULL != *cbor);
+    if (len > 1) {
+        FUZZ_CHECK(QCLOUD_ERR_JSON_BUFFER_TOO_SMALL == utils_json_to_cbor(json, json_len, *cbor, len - 1, cbor_len));
+    }
+    FUZZ_CHECK(QCLOUD_RET_SUCCESS == utils_json_to_cbor(json, json_len, *cbor, len, cbor_len));
+    FUZZ_CHECK(len == *cbor_len);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+/**
+ * @brief decode CBOR to JSON, and encode/decode it again until it's stable
+ */
+static void _check_round_trip(const uint8_t *cbor, size_t cbor_len)
+{
+    static char first[FUZZ_JSON_BUF_LEN], second[FUZZ_JSON_BUF_LEN];
+    uint8_t *   again = NULL;
+    size_t      again_len, json_len, second_len;
+
+    if (QCLOUD_RET_SUCCESS != utils_cbor_to_json(cbor, cbor_len, first, sizeof(first), &json_len)) {
+        return;
+    }
+    FUZZ_CHECK(strlen(first) == json_len);
+
+    // output of decoder is always valid JSON, and stable after one more round
+    FUZZ_CHECK(QCLOUD_RET_SUCCESS == _encode_json(first, json_len, &again, &again_len));
+    FUZZ_CHECK(QCLOUD_RET_SUCCESS == utils_cbor_to_json(again, again_len, second, sizeof(second), &second_len));
+    free(again);
+
+    FUZZ_CHECK(QCLOUD_RET_SUCCESS == _encode_json(second, second_len, &again, &again_len));
+    FUZZ_CHECK(QCLOUD_RET_SUCCESS == utils_cbor_to_json(again, again_len, first, sizeof(first), &json_len));
+    free(again);
+
+    FUZZ_CHECK(json_len == second_len && !memcmp(first, second, json_len));
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    uint8_t *cbor = NULL;
+    size_t   cbor_len;
+    char     json[64];
+    size_t   json_len;
+
+    if (size > FUZZ_MAX_INPUT_LEN) {
+        return 0;
+    }
+
+    // input as CBOR, the decoder stops at the end of input and output buffer
+    _check_round_trip(data, size);
+    if (QCLOUD_RET_SUCCESS == utils_cbor_to_json(data, size, json, sizeof(json), &json_len)) {
+        FUZZ_CHECK(json_len < sizeof(json) && '\0' == json[json_len]);
+    }
+
+    // input as JSON
+    if (QCLOUD_RET_SUCCESS == _encode_json((const char *)data, size, &cbor, &cbor_len)) {
+        _check_round_trip(cbor, cbor_len);
+        free(cbor);
+    }
+
+    return 0;
+}
+
+#ifndef FUZZ_WITH_LIBFUZZER
+static size_t _mutate(uint8_t *buf, size_t len, size_t size)
+{
+    int    i, count = 1 + rand() % 4;
+    size_t pos;
+
+    for (i = 0; i < count; i++) {
+        pos = len ? (size_t)rand() % len : 0;
+        switch (rand() % 5) {
+            case 0:  // flip bits
+                if (len) {
+                    buf[pos] ^= (uint8_t)(1 << (rand() % 8));
+                }
+                break;
+            case 1:  // random byte
+                if (len) {
+                    buf[pos] = (uint8_t)rand();
+                }
+                break;
+            case 2:  // truncate
+                len = pos;
+                break;
+            case 3:  // insert a byte
+                if (len < size) {
+                    memmove(buf + pos + 1, buf + pos, len - pos);
+                    buf[pos] = (uint8_t)rand();
+                    len++;
+                }
+                break;
+            default:  // duplicate a block
+                if (len && len * 2 <= size) {
+                    memcpy(buf + len, buf, len);
+                    len *= 2;
+                }
+                break;
+        }
+    }
+
+    return len;
+}
+
+static void _run_file(const char *path)
+{
+    static uint8_t buf[FUZZ_MAX_INPUT_LEN];
+    size_t         len;
+    FILE *         fp = fopen(path, "rb");
+
+    if (NULL == fp) {
+        perror(path);
+        exit(1);
+    }
+    len = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+
+    LLVMFuzzerTestOneInput(buf, len);
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buf[FUZZ_MAX_INPUT_LEN];
+    uint8_t *      cbor;
+    size_t         len, cbor_len;
+    long           i, iterations = 100000;
+    int            seed_num      = sizeof(sg_seeds) / sizeof(sg_seeds[0]);
+
+    // corpus files, or number of random iterations
+    if (argc > 1 && (argc > 2 || !strtol(argv[1], NULL, 10))) {
+        for (i = 1; i < argc; i++) {
+            _run_file(argv[i]);
+        }
+        printf("%d files passed\n", argc - 1);
+        return 0;
+    }
+    if (argc > 1) {
+        iterations = strtol(argv[1], NULL, 10);
+    }
+
+    srand(1);
+    for (i = 0; i < iterations; i++) {
+        const char *seed = sg_seeds[i % seed_num];
+
+        // mutate both the JSON seed and the CBOR of it
+        if ((i / seed_num) & 1 && QCLOUD_RET_SUCCESS == _encode_json(seed, strlen(seed), &cbor, &cbor_len)) {
+            memcpy(buf, cbor, cbor_len);
+            len = cbor_len;
+            free(cbor);
+        } else {
+            len = strlen(seed);
+            memcpy(buf, seed, len);
+        }
+
+        len = _mutate(buf, len, sizeof(buf));
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+
+    printf("%ld iterations passed\n", iterations);
+    return 0;
+}
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Host test of utils_compress_zlib, round trip through utils_decompress.
+ *
+ *   compress_test [rounds]
+ *
+ * Each round compresses a random input, log-like text, repeated runs or random bytes, up to
+ * COMPRESS_MAX_INPUT_LEN, and inflates the zlib stream fed in random pieces, which must give
+ * the input back with a valid Adler-32. Output buffers one byte short of the stream must be
+ * refused with QCLOUD_ERR_BUF_TOO_SHORT, and a stream with corrupted Adler-32 rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qcloud_iot_export_log.h"
+#include "utils_compress.h"
+#include "utils_decompress.h"
+
+#define COMPRESS_OUT_SIZE  (COMPRESS_MAX_INPUT_LEN + COMPRESS_MAX_INPUT_LEN / 4 + 64)
+#define COMPRESS_FEED_MAX  1500
+
+#define COMPRESS_CHECK(cond)                                                        \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+typedef enum { INPUT_LOG, INPUT_RUNS, INPUT_RANDOM, INPUT_KIND_NUM } InputKind;
+
+typedef struct {
+    const char *expect;
+    uint32_t    expect_len;
+    uint32_t    next_offset;
+} InflateTarget;
+
+static const char *sg_words[] = {"mqtt", "connect", "publish", "topic", "$thing/up/property", "timeout",
+                                 "rc=-1001", "qcloud", "ota", "success", "failed", "packet_id", "=", "\"", " "};
+
+static uint32_t sg_seed = 1;
+
+static uint32_t _rand(void)
+{
+    sg_seed ^= sg_seed << 13;
+    sg_seed ^= sg_seed >> 17;
+    sg_seed ^= sg_seed << 5;
+    return sg_seed;
+}
+
+static uint32_t _gen_input(InputKind kind, char *buf, uint32_t len)
+{
+    uint32_t    i = 0, n;
+    const char *word;
+
+    switch (kind) {
+        case INPUT_LOG:
+            while (i < len) {
+                if (0 == _rand() % 12) {
+                    n = snprintf(buf + i, len - i + 1, "DBG|2026-10-19 10:%02u:%02u|mqtt_client.c|%u\n",
+                                 _rand() % 60, _rand() % 60, _rand() % 1000);
+                } else {
+                    word = sg_words[_rand() % (sizeof(sg_words) / sizeof(sg_words[0]))];
+                    n    = snprintf(buf + i, len - i + 1, "%s ", word);
+                }
+                i += n < len - i ? n : len - i;
+            }
+            break;
+
+        case INPUT_RUNS:
+            while (i < len) {
+                n = 1 + _rand() % 300;
+                n = n < len - i ? n : len - i;
+                memset(buf + i, 'a' + _rand() % 3, n);
+                i += n;
+            }
+            break;
+
+        default:
+            for (; i < len; i++) {
+                buf[i] = (char)_rand();
+            }
+            break;
+    }
+
+    return len;
+}
+
+static int _inflate_output(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    InflateTarget *t = (InflateTarget *)user_data;
+
+    // output of corrupted stream may differ before the check value is reached
+    if (offset != t->next_offset || offset + len > t->expect_len || memcmp(t->expect + offset, buf, len)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    t->next_offset += len;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* inflate stream fed in random pieces, return QCLOUD_RET_SUCCESS if it gives expect back */
+static int _inflate(const char *stream, uint32_t stream_len, const char *expect, uint32_t expect_len)
+{
+    InflateTarget t   = {expect, expect_len, 0};
+    void *        dec = utils_decompress_init(DECOMPRESS_ZLIB, DECOMPRESS_WINDOW_BITS_MAX, 0, _inflate_output, &t);
+    uint32_t      off, n;
+    int           rc = QCLOUD_RET_SUCCESS;
+
+    COMPRESS_CHECK(NULL != dec);
+    for (off = 0; off < stream_len && QCLOUD_RET_SUCCESS == rc; off += n) {
+        n  = 1 + _rand() % COMPRESS_FEED_MAX;
+        n  = n < stream_len - off ? n : stream_len - off;
+        rc = utils_decompress_feed(dec, stream + off, n);
+    }
+    if (QCLOUD_RET_SUCCESS == rc) {
+        rc = utils_decompress_finish(dec);
+    }
+    if (QCLOUD_RET_SUCCESS == rc && t.next_offset != expect_len) {
+        rc = QCLOUD_ERR_FAILURE;
+    }
+    utils_decompress_deinit(dec);
+
+    return rc;
+}
+
+static void _round(InputKind kind, uint32_t len, uint64_t *in_total, uint64_t *out_total)
+{
+    static char in[COMPRESS_MAX_INPUT_LEN + 1], out[COMPRESS_OUT_SIZE];
+    static char work[COMPRESS_WORK_SIZE];
+    int         out_len;
+
+    _gen_input(kind, in, len);
+    out_len = utils_compress_zlib(in, len, out, sizeof(out), work);
+    COMPRESS_CHECK(out_len > 0);
+    COMPRESS_CHECK(3 == (out[2] & 7));  // one final block with fixed Huffman codes
+    COMPRESS_CHECK(QCLOUD_RET_SUCCESS == _inflate(out, out_len, in, len));
+
+    // stream is the same in an exact buffer, and does not fit one byte less
+    COMPRESS_CHECK(out_len == utils_compress_zlib(in, len, out, out_len, work));
+    COMPRESS_CHECK(QCLOUD_ERR_BUF_TOO_SHORT == utils_compress_zlib(in, len, out, out_len - 1, work));
+
+    // flipped bit of Adler-32, padding bits before it are not checked by any inflater
+    out_len = utils_compress_zlib(in, len, out, sizeof(out), work);
+    out[out_len - 1 - _rand() % 4] ^= 1 << (_rand() % 8);
+    COMPRESS_CHECK(QCLOUD_RET_SUCCESS != _inflate(out, out_len, in, len));
+
+    if (INPUT_LOG == kind) {
+        *in_total += len;
+        *out_total += utils_compress_zlib(in, len, out, sizeof(out), work);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int      i, rounds = argc > 1 ? atoi(argv[1]) : 300;
+    uint32_t lens[]    = {0, 1, 2, 3, 258, 259, COMPRESS_MAX_INPUT_LEN};
+    uint64_t in_total = 0, out_total = 0;
+    int      kind;
+
+    IOT_Log_Set_Level(eLOG_DISABLE);
+    for (kind = 0; kind < INPUT_KIND_NUM; kind++) {
+        for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+            _round(kind, lens[i], &in_total, &out_total);
+        }
+    }
+    for (i = 0; i < rounds; i++) {
+        _round(_rand() % INPUT_KIND_NUM, _rand() % (COMPRESS_MAX_INPUT_LEN + 1), &in_total, &out_total);
+    }
+
+    printf("compress_test: %d rounds passed, log text %.1f%% of input\n", rounds,
+           in_total ? out_total * 100.0 / in_total : 0);
+    return 0;
+}
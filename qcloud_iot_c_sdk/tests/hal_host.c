@@ -0,0 +1,285 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * HAL of the host, enough for the harnesses in this directory together with
+ * platform/HAL_Timer_freertos.c. Key-value store is kept in memory.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+void *HAL_Malloc(_IN_ uint32_t size)
+{
+    return malloc(size);
+}
+
+void HAL_Free(_IN_ void *ptr)
+{
+    free(ptr);
+}
+
+void HAL_Printf(_IN_ const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+
+    fflush(stdout);
+}
+
+int HAL_Snprintf(_IN_ char *str, const int len, const char *fmt, ...)
+{
+    va_list args;
+    int     rc;
+
+    va_start(args, fmt);
+    rc = vsnprintf(str, len, fmt, args);
+    va_end(args);
+
+    return rc;
+}
+
+int HAL_Vsnprintf(_OU_ char *str, _IN_ const int len, _IN_ const char *fmt, _IN_ va_list ap)
+{
+    return vsnprintf(str, len, fmt, ap);
+}
+
+void *HAL_MutexCreate(void)
+{
+    pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+
+    if (NULL != mutex) {
+        pthread_mutex_init(mutex, NULL);
+    }
+
+    return mutex;
+}
+
+void HAL_MutexDestroy(_IN_ void *mutex)
+{
+    if (NULL != mutex) {
+        pthread_mutex_destroy((pthread_mutex_t *)mutex);
+        free(mutex);
+    }
+}
+
+void HAL_MutexLock(_IN_ void *mutex)
+{
+    pthread_mutex_lock((pthread_mutex_t *)mutex);
+}
+
+void HAL_MutexUnlock(_IN_ void *mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+int HAL_MutexTryLock(_IN_ void *mutex)
+{
+    return pthread_mutex_trylock((pthread_mutex_t *)mutex);
+}
+
+void HAL_SleepMs(_IN_ uint32_t ms)
+{
+    usleep(ms * 1000);
+}
+
+void HAL_DelayMs(_IN_ uint32_t ms)
+{
+    usleep(ms * 1000);
+}
+
+static void *_host_thread_func(void *arg)
+{
+    ThreadParams *params = (ThreadParams *)arg;
+
+    params->thread_func(params->user_arg);
+    return NULL;
+}
+
+int HAL_ThreadCreate(ThreadParams *params)
+{
+    pthread_t thread;
+
+    if (NULL == params || 0 != pthread_create(&thread, NULL, _host_thread_func, params)) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    pthread_detach(thread);
+    params->thread_id = (size_t)thread;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    uint32_t        count;
+} HostSemaphore;
+
+void *HAL_SemaphoreCreate(void)
+{
+    HostSemaphore *sem = malloc(sizeof(HostSemaphore));
+
+    if (NULL != sem) {
+        pthread_mutex_init(&sem->lock, NULL);
+        pthread_cond_init(&sem->cond, NULL);
+        sem->count = 0;
+    }
+
+    return sem;
+}
+
+void HAL_SemaphoreDestroy(void *sem)
+{
+    HostSemaphore *s = (HostSemaphore *)sem;
+
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+void HAL_SemaphorePost(void *sem)
+{
+    HostSemaphore *s = (HostSemaphore *)sem;
+
+    pthread_mutex_lock(&s->lock);
+    s->count++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+int HAL_SemaphoreWait(void *sem, uint32_t timeout_ms)
+{
+    HostSemaphore * s  = (HostSemaphore *)sem;
+    struct timespec ts;
+    int             rc = 0;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    while (0 == s->count && ETIMEDOUT != rc) {
+        rc = pthread_cond_timedwait(&s->cond, &s->lock, &ts);
+    }
+    if (s->count > 0) {
+        s->count--;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return 0 == rc ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+}
+
+/* key-value store in memory, lost on exit */
+#define HOST_KV_NUM      8
+#define HOST_KV_KEY_LEN  32
+#define HOST_KV_VAL_SIZE 1024
+
+static struct {
+    char     key[HOST_KV_KEY_LEN];
+    uint8_t  val[HOST_KV_VAL_SIZE];
+    uint32_t len;
+} sg_host_kv[HOST_KV_NUM];
+
+static pthread_mutex_t sg_host_kv_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* slot of key, or a free slot by empty key */
+static int _host_kv_find(const char *key)
+{
+    int i;
+
+    for (i = 0; i < HOST_KV_NUM; i++) {
+        if (0 == strcmp(sg_host_kv[i].key, key)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int HAL_Kv_Set(const char *key, const void *val, uint32_t len)
+{
+    int i;
+
+    if (strlen(key) >= HOST_KV_KEY_LEN || len > HOST_KV_VAL_SIZE) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    pthread_mutex_lock(&sg_host_kv_lock);
+    i = _host_kv_find(key);
+    if (i < 0) {
+        i = _host_kv_find("");
+    }
+    if (i >= 0) {
+        strcpy(sg_host_kv[i].key, key);
+        memcpy(sg_host_kv[i].val, val, len);
+        sg_host_kv[i].len = len;
+    }
+    pthread_mutex_unlock(&sg_host_kv_lock);
+
+    return i >= 0 ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+}
+
+int HAL_Kv_Get(const char *key, void *val, uint32_t *len)
+{
+    int i;
+
+    pthread_mutex_lock(&sg_host_kv_lock);
+    i = _host_kv_find(key);
+    if (i >= 0 && sg_host_kv[i].len <= *len) {
+        memcpy(val, sg_host_kv[i].val, sg_host_kv[i].len);
+        *len = sg_host_kv[i].len;
+    } else {
+        i = -1;
+    }
+    pthread_mutex_unlock(&sg_host_kv_lock);
+
+    return i >= 0 ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+}
+
+int HAL_Kv_Del(const char *key)
+{
+    int i;
+
+    pthread_mutex_lock(&sg_host_kv_lock);
+    i = _host_kv_find(key);
+    if (i >= 0) {
+        memset(&sg_host_kv[i], 0, sizeof(sg_host_kv[i]));
+    }
+    pthread_mutex_unlock(&sg_host_kv_lock);
+
+    return QCLOUD_RET_SUCCESS;
+}
@@ -0,0 +1,125 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Throughput benchmark of the hash functions of utils, updating one context with buffers of
+ * the sizes seen on device: an HMAC message, a fetch buffer of OTA, and a large read back.
+ *
+ * usage: hash_bench [megabytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils_md5.h"
+#include "utils_sha1.h"
+
+#define BENCH_BUF_MAX (64 * 1024)
+#define BENCH_RUNS    3  // best of runs, as the host is shared
+
+static const size_t sg_buf_lens[] = {64, 1024, BENCH_BUF_MAX};
+
+static double _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double _md5_run(const unsigned char *buf, size_t buf_len, size_t total)
+{
+    iot_md5_context ctx;
+    unsigned char   digest[16];
+    size_t          done;
+    double          start;
+
+    utils_md5_init(&ctx);
+    utils_md5_starts(&ctx);
+    start = _now_ns();
+    for (done = 0; done < total; done += buf_len) {
+        utils_md5_update(&ctx, buf, buf_len);
+    }
+    utils_md5_finish(&ctx, digest);
+    utils_md5_free(&ctx);
+
+    return done / ((_now_ns() - start) / 1e9) / (1024 * 1024);
+}
+
+static double _sha1_run(const unsigned char *buf, size_t buf_len, size_t total)
+{
+    iot_sha1_context ctx;
+    unsigned char    digest[20];
+    size_t           done;
+    double           start;
+
+    utils_sha1_init(&ctx);
+    utils_sha1_starts(&ctx);
+    start = _now_ns();
+    for (done = 0; done < total; done += buf_len) {
+        utils_sha1_update(&ctx, buf, buf_len);
+    }
+    utils_sha1_finish(&ctx, digest);
+    utils_sha1_free(&ctx);
+
+    return done / ((_now_ns() - start) / 1e9) / (1024 * 1024);
+}
+
+typedef double (*HashRun)(const unsigned char *buf, size_t buf_len, size_t total);
+
+static double _best_mbps(HashRun run, const unsigned char *buf, size_t buf_len, size_t total)
+{
+    double best = 0, mbps;
+    int    i;
+
+    for (i = 0; i < BENCH_RUNS; i++) {
+        mbps = run(buf, buf_len, total);
+        best = mbps > best ? mbps : best;
+    }
+
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    static unsigned char buf[BENCH_BUF_MAX];
+    long                 megabytes = argc > 1 ? strtol(argv[1], NULL, 10) : 64;
+    size_t               i, total;
+
+    if (megabytes <= 0) {
+        megabytes = 1;
+    }
+    total = (size_t)megabytes * 1024 * 1024;
+
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = (unsigned char)(i * 131 + 7);
+    }
+
+    printf("%ld MB hashed per run, best of %d runs\n", megabytes, BENCH_RUNS);
+    printf("%-8s %10s %10s\n", "buffer", "MD5 MB/s", "SHA-1 MB/s");
+    for (i = 0; i < sizeof(sg_buf_lens) / sizeof(sg_buf_lens[0]); i++) {
+        printf("%-8u %10.0f %10.0f\n", (unsigned)sg_buf_lens[i], _best_mbps(_md5_run, buf, sg_buf_lens[i], total),
+               _best_mbps(_sha1_run, buf, sg_buf_lens[i], total));
+    }
+
+    return 0;
+}
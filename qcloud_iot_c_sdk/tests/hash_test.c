@@ -0,0 +1,303 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Host test of the hash functions of utils.
+ *
+ *   hash_test [rounds]
+ *
+ * Digests are checked against the test vectors of RFC 1321 for MD5, RFC 3174 for SHA-1 and
+ * FIPS 180-2 for SHA-256, including one million 'a'. Each round hashes a random message at a
+ * random alignment, once in one call and once in random pieces, with a clone taken midway, and
+ * all must agree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils_md5.h"
+#include "utils_sha1.h"
+#include "utils_sha256.h"
+
+#define HASH_MSG_MAX   (4 * 1024)
+#define HASH_PIECE_MAX 200
+
+#define HASH_CHECK(cond)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+typedef struct {
+    const char *input;
+    int         repeat;
+    const char *digest;
+} HashVector;
+
+static const HashVector sg_md5_vectors[] = {
+    {"", 1, "d41d8cd98f00b204e9800998ecf8427e"},
+    {"a", 1, "0cc175b9c0f1b6a831c399e269772661"},
+    {"abc", 1, "900150983cd24fb0d6963f7d28e17f72"},
+    {"message digest", 1, "f96b697d7cb7938d525a2f31aaf161d0"},
+    {"abcdefghijklmnopqrstuvwxyz", 1, "c3fcd3d76192e4007dfb496cca67e13b"},
+    {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 1, "d174ab98d277d9f5a5611c2c9f419d9f"},
+    {"1234567890", 8, "57edf4a22be3c955ac49da2e2107b67a"},
+    {"a", 1000000, "7707d6ae4e027c70eea2a935c2296f21"},
+};
+
+static const HashVector sg_sha1_vectors[] = {
+    {"abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+    {"a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+    {"0123456701234567012345670123456701234567012345670123456701234567", 10,
+     "dea356a2cddd90c7a7ecedc5ebb563934f460452"},
+    {"", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+};
+
+static const HashVector sg_sha256_vectors[] = {
+    {"abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {"a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+    {"", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+};
+
+static uint32_t sg_seed = 1;
+
+static uint32_t _rand(void)
+{
+    sg_seed ^= sg_seed << 13;
+    sg_seed ^= sg_seed >> 17;
+    sg_seed ^= sg_seed << 5;
+    return sg_seed;
+}
+
+static void _hex(const unsigned char *digest, size_t len, char *hex)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        sprintf(hex + i * 2, "%02x", digest[i]);
+    }
+}
+
+/* message of vector in one buffer, for the one call digest */
+static unsigned char *_vector_message(const HashVector *v, size_t *len)
+{
+    size_t         n   = strlen(v->input);
+    unsigned char *msg = malloc(n * v->repeat + 1);
+    int            i;
+
+    HASH_CHECK(NULL != msg);
+    for (i = 0; i < v->repeat; i++) {
+        memcpy(msg + i * n, v->input, n);
+    }
+    *len = n * v->repeat;
+
+    return msg;
+}
+
+static void _md5_vectors(void)
+{
+    iot_md5_context ctx;
+    unsigned char   digest[16], *msg;
+    char            hex[33];
+    size_t          i, len;
+    int             j;
+
+    for (i = 0; i < sizeof(sg_md5_vectors) / sizeof(sg_md5_vectors[0]); i++) {
+        const HashVector *v = &sg_md5_vectors[i];
+
+        // repeated input one piece a time
+        utils_md5_init(&ctx);
+        utils_md5_starts(&ctx);
+        for (j = 0; j < v->repeat; j++) {
+            utils_md5_update(&ctx, (const unsigned char *)v->input, strlen(v->input));
+        }
+        utils_md5_finish(&ctx, digest);
+        utils_md5_free(&ctx);
+        _hex(digest, sizeof(digest), hex);
+        HASH_CHECK(0 == strcmp(hex, v->digest));
+
+        msg = _vector_message(v, &len);
+        utils_md5(msg, len, digest);
+        _hex(digest, sizeof(digest), hex);
+        HASH_CHECK(0 == strcmp(hex, v->digest));
+        free(msg);
+    }
+}
+
+static void _sha1_vectors(void)
+{
+    iot_sha1_context ctx;
+    unsigned char    digest[20], *msg;
+    char             hex[41];
+    size_t           i, len;
+    int              j;
+
+    for (i = 0; i < sizeof(sg_sha1_vectors) / sizeof(sg_sha1_vectors[0]); i++) {
+        const HashVector *v = &sg_sha1_vectors[i];
+
+        utils_sha1_init(&ctx);
+        utils_sha1_starts(&ctx);
+        for (j = 0; j < v->repeat; j++) {
+            utils_sha1_update(&ctx, (const unsigned char *)v->input, strlen(v->input));
+        }
+        utils_sha1_finish(&ctx, digest);
+        utils_sha1_free(&ctx);
+        _hex(digest, sizeof(digest), hex);
+        HASH_CHECK(0 == strcmp(hex, v->digest));
+
+        msg = _vector_message(v, &len);
+        utils_sha1(msg, len, digest);
+        _hex(digest, sizeof(digest), hex);
+        HASH_CHECK(0 == strcmp(hex, v->digest));
+        free(msg);
+    }
+}
+
+static void _sha256_vectors(void)
+{
+    iot_sha256_context ctx;
+    unsigned char      digest[32], *msg;
+    char               hex[65];
+    size_t             i, len;
+    int                j;
+
+    for (i = 0; i < sizeof(sg_sha256_vectors) / sizeof(sg_sha256_vectors[0]); i++) {
+        const HashVector *v = &sg_sha256_vectors[i];
+
+        utils_sha256_init(&ctx);
+        utils_sha256_starts(&ctx);
+        for (j = 0; j < v->repeat; j++) {
+            utils_sha256_update(&ctx, (const unsigned char *)v->input, strlen(v->input));
+        }
+        utils_sha256_finish(&ctx, digest);
+        utils_sha256_free(&ctx);
+        _hex(digest, sizeof(digest), hex);
+        HASH_CHECK(0 == strcmp(hex, v->digest));
+
+        msg = _vector_message(v, &len);
+        utils_sha256(msg, len, digest);
+        _hex(digest, sizeof(digest), hex);
+        HASH_CHECK(0 == strcmp(hex, v->digest));
+        free(msg);
+    }
+}
+
+/* random message at random alignment, hashed in one call and in random pieces */
+static void _round(void)
+{
+    static unsigned char buf[HASH_MSG_MAX + 8];
+    iot_md5_context      md5, md5_clone;
+    iot_sha1_context     sha1, sha1_clone;
+    iot_sha256_context   sha256, sha256_clone;
+    unsigned char        expect[32], digest[32], clone_digest[32];
+    unsigned char *      msg   = buf + _rand() % 8;
+    size_t               len   = _rand() % (HASH_MSG_MAX + 1);
+    size_t               split = len ? _rand() % len : 0;
+    size_t               off, n;
+
+    for (off = 0; off < len; off++) {
+        msg[off] = (unsigned char)_rand();
+    }
+
+    utils_md5_init(&md5);
+    utils_md5_init(&md5_clone);
+    utils_md5_starts(&md5);
+    utils_sha1_init(&sha1);
+    utils_sha1_init(&sha1_clone);
+    utils_sha1_starts(&sha1);
+    utils_sha256_init(&sha256);
+    utils_sha256_init(&sha256_clone);
+    utils_sha256_starts(&sha256);
+    for (off = 0; off < len; off += n) {
+        n = _rand() % (HASH_PIECE_MAX + 1);
+        n = n < len - off ? n : len - off;
+        if (off <= split && split < off + n) {
+            // clone carries the partial block, both go on to the same digest
+            utils_md5_update(&md5, msg + off, split - off);
+            utils_sha1_update(&sha1, msg + off, split - off);
+            utils_sha256_update(&sha256, msg + off, split - off);
+            utils_md5_clone(&md5_clone, &md5);
+            utils_sha1_clone(&sha1_clone, &sha1);
+            utils_sha256_clone(&sha256_clone, &sha256);
+            utils_md5_update(&md5_clone, msg + split, len - split);
+            utils_sha1_update(&sha1_clone, msg + split, len - split);
+            utils_sha256_update(&sha256_clone, msg + split, len - split);
+            utils_md5_update(&md5, msg + split, off + n - split);
+            utils_sha1_update(&sha1, msg + split, off + n - split);
+            utils_sha256_update(&sha256, msg + split, off + n - split);
+            continue;
+        }
+        utils_md5_update(&md5, msg + off, n);
+        utils_sha1_update(&sha1, msg + off, n);
+        utils_sha256_update(&sha256, msg + off, n);
+    }
+
+    utils_md5(msg, len, expect);
+    utils_md5_finish(&md5, digest);
+    HASH_CHECK(0 == memcmp(expect, digest, 16));
+    if (len) {
+        utils_md5_finish(&md5_clone, clone_digest);
+        HASH_CHECK(0 == memcmp(expect, clone_digest, 16));
+    }
+
+    utils_sha1(msg, len, expect);
+    utils_sha1_finish(&sha1, digest);
+    HASH_CHECK(0 == memcmp(expect, digest, 20));
+    if (len) {
+        utils_sha1_finish(&sha1_clone, clone_digest);
+        HASH_CHECK(0 == memcmp(expect, clone_digest, 20));
+    }
+
+    utils_sha256(msg, len, expect);
+    utils_sha256_finish(&sha256, digest);
+    HASH_CHECK(0 == memcmp(expect, digest, 32));
+    if (len) {
+        utils_sha256_finish(&sha256_clone, clone_digest);
+        HASH_CHECK(0 == memcmp(expect, clone_digest, 32));
+    }
+
+    utils_md5_free(&md5);
+    utils_md5_free(&md5_clone);
+    utils_sha1_free(&sha1);
+    utils_sha1_free(&sha1_clone);
+    utils_sha256_free(&sha256);
+    utils_sha256_free(&sha256_clone);
+}
+
+int main(int argc, char **argv)
+{
+    int i, rounds = argc > 1 ? atoi(argv[1]) : 2000;
+
+    _md5_vectors();
+    _sha1_vectors();
+    _sha256_vectors();
+    for (i = 0; i < rounds; i++) {
+        _round();
+    }
+
+    printf("hash_test: vectors and %d rounds passed\n", rounds);
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Fuzz harness of the HTTP response parser of utils_httpc.
+ *
+ * Each input is served as the response of a request, by a fake network which returns it in
+ * random pieces, and read with qcloud_http_recv_data into a random sized buffer. Whatever
+ * the input is, reading must end within a bounded number of calls without touching memory
+ * out of the buffers. Standalone, well formed responses with Content-Length, chunked and
+ * close delimited bodies are generated as well, and the body read must equal the one sent.
+ * Short responses are also served on a connection kept open, read the way the HAL does,
+ * which returns when the buffer is full or the timeout expires: reading such a response
+ * must not wait for the timeout of the request.
+ *
+ * Built with libFuzzer when FUZZ_WITH_LIBFUZZER is defined.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "network_interface.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_export_log.h"
+#include "utils_httpc.h"
+
+#define FUZZ_URL           "http://fuzz.test/file"
+#define FUZZ_MAX_INPUT_LEN 8192
+#define FUZZ_MAX_BODY_LEN  3000
+#define FUZZ_MAX_CALLS     (2 * FUZZ_MAX_INPUT_LEN + 16)
+#define FUZZ_TIMEOUT_MS    10000
+#define FUZZ_MAX_WAIT_MS   1000 /* virtual time waited for a short response on open connection */
+
+#define FUZZ_CHECK(cond)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                                \
+        }                                                                           \
+    } while (0)
+
+static const uint8_t *sg_input;
+static size_t         sg_input_len;
+static size_t         sg_input_pos;
+static uint32_t       sg_rand;
+static bool           sg_keep_open;  // server keeps connection open after the response
+static uint32_t       sg_wait_ms;    // virtual time waited in reads on open connection
+
+/* split points are derived from the input, so that a crash can be reproduced by it */
+static uint32_t _rand(void)
+{
+    sg_rand ^= sg_rand << 13;
+    sg_rand ^= sg_rand >> 17;
+    sg_rand ^= sg_rand << 5;
+    return sg_rand;
+}
+
+static int _fake_connect(Network *network)
+{
+    network->handle = 1;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _fake_read(Network *network, unsigned char *buf, size_t len, uint32_t timeout_ms, size_t *read_len)
+{
+    size_t n = sg_input_len - sg_input_pos;
+
+    FUZZ_CHECK(0 != network->handle && len > 0);
+    if (sg_keep_open) {
+        // whole response has arrived, read blocks for more until timeout like the HAL
+        if (n > len) {
+            n = len;
+        } else if (n < len) {
+            sg_wait_ms += timeout_ms;
+        }
+        memcpy(buf, sg_input + sg_input_pos, n);
+        sg_input_pos += n;
+        *read_len = n;
+        return n == len ? QCLOUD_RET_SUCCESS : (n ? QCLOUD_ERR_TCP_READ_TIMEOUT : QCLOUD_ERR_TCP_NOTHING_TO_READ);
+    }
+    if (0 == n) {
+        *read_len = 0;
+        return QCLOUD_ERR_TCP_PEER_SHUTDOWN;
+    }
+
+    // whole of what is asked, or a random piece of it
+    if (n > len) {
+        n = len;
+    }
+    if (_rand() & 1) {
+        n = 1 + _rand() % n;
+    }
+
+    memcpy(buf, sg_input + sg_input_pos, n);
+    sg_input_pos += n;
+    *read_len = n;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _fake_write(Network *network, unsigned char *buf, size_t len, uint32_t timeout_ms, size_t *written_len)
+{
+    *written_len = len;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _fake_disconnect(Network *network)
+{
+    network->handle = 0;
+}
+
+int network_init(Network *network)
+{
+    network->connect    = _fake_connect;
+    network->read       = _fake_read;
+    network->write      = _fake_write;
+    network->disconnect = _fake_disconnect;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* read the response of one request, return error code or length of body read into body */
+static int _serve(const uint8_t *data, size_t size, HttpMethod method, char *body, size_t body_size)
+{
+    HTTPClient     client;
+    HTTPClientData client_data;
+    char *         buf;
+    uint32_t       buf_len;
+    size_t         body_len = 0, n;
+    int            rc, calls;
+
+    sg_input     = data;
+    sg_input_len = size;
+    sg_input_pos = 0;
+    sg_wait_ms   = 0;
+    sg_rand      = 2166136261u ^ (uint32_t)size;
+    for (n = 0; n < size && n < 64; n++) {
+        sg_rand = (sg_rand ^ data[n]) * 16777619u;
+    }
+    sg_rand |= 1;
+
+    memset(&client, 0, sizeof(HTTPClient));
+    memset(&client_data, 0, sizeof(HTTPClientData));
+    rc = qcloud_http_client_common(&client, FUZZ_URL, HTTP_PORT, NULL, method, &client_data);
+    FUZZ_CHECK(QCLOUD_RET_SUCCESS == rc);
+
+    // exact size, so that ASan catches any write beyond it
+    buf_len = 2 + _rand() % 600;
+    buf     = malloc(buf_len);
+    FUZZ_CHECK(buf != NULL);
+
+    for (calls = 0; client_data.is_more; calls++) {
+        FUZZ_CHECK(calls < FUZZ_MAX_CALLS);
+        client_data.response_buf     = buf;
+        client_data.response_buf_len = buf_len;
+        rc = qcloud_http_recv_data(&client, FUZZ_TIMEOUT_MS, &client_data);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            break;
+        }
+
+        n = strlen(buf);
+        FUZZ_CHECK(n < buf_len);
+        if (NULL != body) {
+            FUZZ_CHECK(body_len + n <= body_size);
+            memcpy(body + body_len, buf, n);
+        }
+        body_len += n;
+        FUZZ_CHECK(body_len <= size);
+    }
+
+    qcloud_http_client_release(&client, &client_data);
+    FUZZ_CHECK(NULL == client.parser);
+    qcloud_http_conn_cache_flush();
+    free(buf);
+
+    return QCLOUD_RET_SUCCESS == rc ? (int)body_len : rc;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size > FUZZ_MAX_INPUT_LEN) {
+        return 0;
+    }
+
+    _serve(data, size, HTTP_GET, NULL, 0);
+    _serve(data, size, HTTP_HEAD, NULL, 0);
+    return 0;
+}
+
+#ifndef FUZZ_WITH_LIBFUZZER
+static const char *sg_header_names[] = {"Content-Type", "content-length", "TRANSFER-ENCODING", "Connection",
+                                        "X-Long-Header"};
+
+/* random body framed as HTTP response, bytes of which may be NUL only out of the body */
+static size_t _gen_response(char *out, size_t size, char *body, size_t *body_len, bool *is_head)
+{
+    size_t len = 0, i, chunk;
+    int    framing = rand() % 4;
+
+    *body_len = rand() % FUZZ_MAX_BODY_LEN;
+    for (i = 0; i < *body_len; i++) {
+        body[i] = (char)(1 + rand() % 255);
+    }
+    *is_head = (3 == framing);
+
+#define OUT(...) len += snprintf(out + len, size - len, __VA_ARGS__)
+    if (rand() % 4 == 0) {
+        OUT("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+    OUT("%s 200 OK\r\n", 2 == framing ? "HTTP/1.0" : "HTTP/1.1");
+    for (i = rand() % 4; i > 0; i--) {
+        // header lines longer than kept for parsing are truncated
+        OUT("%s: %.*s\r\n", sg_header_names[rand() % 2 ? 0 : 4], rand() % 200,
+            "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstu"
+            "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstu");
+    }
+
+    switch (framing) {
+        case 0:
+        case 3:
+            OUT("%s: %u\r\n\r\n", sg_header_names[1], (unsigned)*body_len);
+            if (!*is_head) {
+                memcpy(out + len, body, *body_len);
+                len += *body_len;
+            }
+            break;
+        case 1:
+            OUT("%s: gzip, chunked\r\n\r\n", sg_header_names[2]);
+            for (i = 0; i < *body_len; i += chunk) {
+                chunk = 1 + rand() % 700;
+                chunk = chunk < *body_len - i ? chunk : *body_len - i;
+                OUT(rand() % 2 ? "%zx" : "%zX", chunk);
+                OUT("%s\r\n", rand() % 4 ? "" : "; name=\"value\" ");
+                memcpy(out + len, body + i, chunk);
+                len += chunk;
+                OUT("\r\n");
+            }
+            OUT("0\r\n%s\r\n", rand() % 2 ? "" : "X-Checksum: abc\r\n");
+            break;
+        default:
+            // body ends when server closes the connection
+            OUT("%s: close\r\n\r\n", sg_header_names[3]);
+            memcpy(out + len, body, *body_len);
+            len += *body_len;
+            break;
+    }
+#undef OUT
+
+    if (*is_head) {
+        *body_len = 0;
+    }
+
+    FUZZ_CHECK(len < size);
+    return len;
+}
+
+/* response shorter than the rx buffer of parser, framed so that its end is known without close */
+static size_t _gen_short_response(char *out, size_t size, char *body, size_t *body_len)
+{
+    size_t len = 0, i;
+
+    *body_len = rand() % 200;
+    for (i = 0; i < *body_len; i++) {
+        body[i] = (char)('a' + rand() % 26);
+    }
+
+#define OUT(...) len += snprintf(out + len, size - len, __VA_ARGS__)
+    if (rand() % 4 == 0) {
+        OUT("HTTP/1.1 100 Continue\r\n\r\n");
+    }
+    OUT("HTTP/1.1 206 Partial Content\r\n");
+    if (rand() % 2) {
+        OUT("%s: %u\r\n\r\n%.*s", sg_header_names[1], (unsigned)*body_len, (int)*body_len, body);
+    } else {
+        OUT("%s: chunked\r\n\r\n", sg_header_names[2]);
+        if (*body_len) {
+            OUT("%zx\r\n%.*s\r\n", *body_len, (int)*body_len, body);
+        }
+        OUT("0\r\n\r\n");
+    }
+#undef OUT
+
+    FUZZ_CHECK(len < size);
+    return len;
+}
+
+static size_t _mutate(uint8_t *buf, size_t len, size_t size)
+{
+    static const char *tokens[] = {"\r\n", "\r\n\r\n", "\r", "\n", ";", "0", "ffffffff", "-1", ":"};
+    int                i, count = 1 + rand() % 4;
+    size_t             pos, n;
+    const char *       token;
+
+    for (i = 0; i < count; i++) {
+        pos = len ? (size_t)rand() % len : 0;
+        switch (rand() % 5) {
+            case 0:  // random byte
+                if (len) {
+                    buf[pos] = (uint8_t)rand();
+                }
+                break;
+            case 1:  // truncate
+                len = pos;
+                break;
+            case 2:  // delete a block
+                n = rand() % 16;
+                n = n < len - pos ? n : len - pos;
+                memmove(buf + pos, buf + pos + n, len - pos - n);
+                len -= n;
+                break;
+            default:  // insert a token of the syntax
+                token = tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+                n     = strlen(token);
+                if (len + n <= size) {
+                    memmove(buf + pos + n, buf + pos, len - pos);
+                    memcpy(buf + pos, token, n);
+                    len += n;
+                }
+                break;
+        }
+    }
+
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    static char response[FUZZ_MAX_INPUT_LEN], body[FUZZ_MAX_BODY_LEN], got[FUZZ_MAX_INPUT_LEN];
+    size_t      len, body_len;
+    bool        is_head;
+    long        i, iterations = 20000;
+    int         rc;
+
+    if (argc > 1) {
+        iterations = strtol(argv[1], NULL, 10);
+    }
+
+    IOT_Log_Set_Level(eLOG_DISABLE);
+    srand(1);
+    for (i = 0; i < iterations; i++) {
+        len = _gen_response(response, sizeof(response), body, &body_len, &is_head);
+
+        // well formed response is read up
+        rc = _serve((uint8_t *)response, len, is_head ? HTTP_HEAD : HTTP_GET, got, sizeof(got));
+        FUZZ_CHECK(rc == (int)body_len && !memcmp(got, body, body_len));
+
+        len = _mutate((uint8_t *)response, len, sizeof(response));
+        LLVMFuzzerTestOneInput((uint8_t *)response, len);
+
+        // short response on open connection is read without waiting for the timeout
+        len          = _gen_short_response(response, sizeof(response), body, &body_len);
+        sg_keep_open = true;
+        rc           = _serve((uint8_t *)response, len, HTTP_GET, got, sizeof(got));
+        sg_keep_open = false;
+        FUZZ_CHECK(rc == (int)body_len && !memcmp(got, body, body_len));
+        FUZZ_CHECK(sg_wait_ms < FUZZ_MAX_WAIT_MS);
+    }
+
+    printf("%ld iterations passed\n", iterations);
+    return 0;
+}
+#endif
@@ -0,0 +1,323 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "http_standin.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "network_interface.h"
+#include "qcloud_iot_export_error.h"
+#include "qcloud_iot_import.h"
+
+#define STANDIN_RESET_UNIT (16 * 1024)
+
+typedef struct {
+    char *   req;  // request being received
+    size_t   req_len;
+    size_t   req_size;
+    char *   resp;  // response being delivered
+    size_t   resp_len;
+    size_t   resp_pos;
+    uint64_t resp_start;  // time when the first byte of response is available
+    uint64_t next_reset;  // bytes delivered when reset is decided next
+    uint64_t delivered;
+    uint32_t rand;
+    uint32_t generation;  // connections of older generation are reset
+    int      dead;
+} StandinConn;
+
+static StandinConfig   sg_config;
+static StandinStats    sg_stats;
+static bool            sg_down;
+static uint32_t        sg_generation;
+static uint32_t        sg_seed;
+static pthread_mutex_t sg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void standin_start(const StandinConfig *config)
+{
+    pthread_mutex_lock(&sg_lock);
+    sg_config = *config;
+    memset(&sg_stats, 0, sizeof(sg_stats));
+    sg_down = false;
+    sg_seed = 1;  // same resets on each run of a single connection
+    pthread_mutex_unlock(&sg_lock);
+}
+
+void standin_set_down(bool down)
+{
+    pthread_mutex_lock(&sg_lock);
+    sg_down = down;
+    sg_generation += down ? 1 : 0;
+    pthread_mutex_unlock(&sg_lock);
+}
+
+void standin_get_stats(StandinStats *stats)
+{
+    pthread_mutex_lock(&sg_lock);
+    *stats = sg_stats;
+    pthread_mutex_unlock(&sg_lock);
+}
+
+const char *standin_header(const StandinRequest *req, const char *name)
+{
+    const char *line;
+    size_t      len = strlen(name);
+
+    for (line = req->header; NULL != line && '\0' != *line; line = strstr(line, "\r\n")) {
+        line += ('\r' == *line) ? 2 : 0;
+        if (0 == strncasecmp(line, name, len) && ':' == line[len]) {
+            for (line += len + 1; ' ' == *line; line++) {
+            }
+            return line;
+        }
+    }
+
+    return NULL;
+}
+
+size_t standin_response(char **resp, int status, const char *extra_header, const char *body, size_t body_len)
+{
+    char   head[512];
+    size_t len;
+
+    len   = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Length: %zu\r\n%s\r\n", status,
+                   status < 300 ? "OK" : "Error", body_len, extra_header ? extra_header : "");
+    *resp = malloc(len + body_len + 1);
+    memcpy(*resp, head, len);
+    memcpy(*resp + len, body, body_len);
+
+    return len + body_len;
+}
+
+static uint32_t _standin_rand(StandinConn *conn)
+{
+    conn->rand ^= conn->rand << 13;
+    conn->rand ^= conn->rand >> 17;
+    conn->rand ^= conn->rand << 5;
+    return conn->rand;
+}
+
+static int _standin_connect(Network *network)
+{
+    StandinConn *conn;
+
+    pthread_mutex_lock(&sg_lock);
+    if (sg_down) {
+        sg_stats.refused++;
+        pthread_mutex_unlock(&sg_lock);
+        return QCLOUD_ERR_TCP_CONNECT;
+    }
+    sg_stats.connects++;
+    sg_seed = sg_seed * 1103515245 + 12345;
+
+    conn = calloc(1, sizeof(StandinConn));
+    if (NULL == conn) {
+        pthread_mutex_unlock(&sg_lock);
+        return QCLOUD_ERR_TCP_CONNECT;
+    }
+    conn->rand       = sg_seed | 1;
+    conn->generation = sg_generation;
+    conn->next_reset = STANDIN_RESET_UNIT;
+    pthread_mutex_unlock(&sg_lock);
+
+    network->handle = (uintptr_t)conn;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* connection is reset by the server going down */
+static bool _standin_dead(StandinConn *conn)
+{
+    pthread_mutex_lock(&sg_lock);
+    conn->dead |= conn->generation != sg_generation;
+    pthread_mutex_unlock(&sg_lock);
+
+    return conn->dead;
+}
+
+/* serve the request once its header and body are received */
+static void _standin_serve(StandinConn *conn)
+{
+    StandinRequest req;
+    char *         end, *line_end, *sp;
+    const char *   value;
+    size_t         head_len;
+
+    conn->req[conn->req_len] = '\0';
+    end                      = strstr(conn->req, "\r\n\r\n");
+    if (NULL == end) {
+        return;
+    }
+
+    head_len = end + 4 - conn->req;
+    memset(&req, 0, sizeof(req));
+    req.header = conn->req;
+    value      = standin_header(&req, "Content-Length");
+    if (NULL != value && conn->req_len < head_len + strtoul(value, NULL, 10)) {
+        return;
+    }
+
+    // request line into method and path, header lines after it
+    *end     = '\0';
+    line_end = strstr(conn->req, "\r\n");
+    if (NULL == line_end) {
+        line_end = end;
+    }
+    *line_end  = '\0';
+    req.method = conn->req;
+    sp         = strchr(conn->req, ' ');
+    if (NULL != sp) {
+        *sp      = '\0';
+        req.path = sp + 1;
+        sp       = strchr(sp + 1, ' ');
+        if (NULL != sp) {
+            *sp = '\0';
+        }
+    }
+    req.header   = line_end < end ? line_end + 2 : end;
+    req.body     = conn->req + head_len;
+    req.body_len = conn->req_len - head_len;
+
+    free(conn->resp);
+    conn->resp       = NULL;
+    conn->resp_len   = sg_config.handler(sg_config.user_data, &req, &conn->resp);
+    conn->resp_pos   = 0;
+    conn->resp_start = HAL_GetTimeMs64() + sg_config.latency_ms;
+    conn->req_len    = 0;
+
+    pthread_mutex_lock(&sg_lock);
+    sg_stats.requests++;
+    pthread_mutex_unlock(&sg_lock);
+}
+
+static int _standin_write(Network *network, unsigned char *data, size_t len, uint32_t timeout_ms,
+                          size_t *written_len)
+{
+    StandinConn *conn = (StandinConn *)network->handle;
+
+    if (_standin_dead(conn)) {
+        return QCLOUD_ERR_TCP_WRITE_FAIL;
+    }
+
+    if (conn->req_len + len + 1 > conn->req_size) {
+        conn->req_size = (conn->req_len + len + 1) * 2;
+        conn->req      = realloc(conn->req, conn->req_size);
+    }
+    memcpy(conn->req + conn->req_len, data, len);
+    conn->req_len += len;
+    *written_len = len;
+
+    _standin_serve(conn);
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* bytes of response the rate allows by now */
+static size_t _standin_allowed(StandinConn *conn, uint64_t now)
+{
+    uint64_t allowed;
+
+    if (now < conn->resp_start) {
+        return 0;
+    }
+    if (0 == sg_config.rate) {
+        return conn->resp_len - conn->resp_pos;
+    }
+
+    allowed = (now - conn->resp_start) * sg_config.rate / 1000 + 1;
+    allowed = allowed < conn->resp_len ? allowed : conn->resp_len;
+    return allowed > conn->resp_pos ? allowed - conn->resp_pos : 0;
+}
+
+static int _standin_read(Network *network, unsigned char *data, size_t len, uint32_t timeout_ms, size_t *read_len)
+{
+    StandinConn *conn     = (StandinConn *)network->handle;
+    uint64_t     deadline = HAL_GetTimeMs64() + timeout_ms;
+    uint64_t     now;
+    size_t       got = 0, n;
+
+    *read_len = 0;
+    while (got < len) {
+        if (_standin_dead(conn)) {
+            return QCLOUD_ERR_TCP_READ_FAIL;
+        }
+
+        now = HAL_GetTimeMs64();
+        n   = NULL != conn->resp ? _standin_allowed(conn, now) : 0;
+        if (0 == n) {
+            if (now >= deadline) {
+                break;
+            }
+            HAL_SleepMs(1);
+            continue;
+        }
+
+        n = n < len - got ? n : len - got;
+        if (conn->delivered + n >= conn->next_reset) {
+            n = conn->next_reset - conn->delivered;
+            conn->next_reset += STANDIN_RESET_UNIT;
+            if (_standin_rand(conn) % 1000 < sg_config.reset_permille) {
+                conn->dead = 1;
+                pthread_mutex_lock(&sg_lock);
+                sg_stats.resets++;
+                pthread_mutex_unlock(&sg_lock);
+                return QCLOUD_ERR_TCP_READ_FAIL;
+            }
+        }
+
+        memcpy(data + got, conn->resp + conn->resp_pos, n);
+        conn->resp_pos += n;
+        conn->delivered += n;
+        got += n;
+
+        pthread_mutex_lock(&sg_lock);
+        sg_stats.bytes += n;
+        pthread_mutex_unlock(&sg_lock);
+    }
+
+    *read_len = got;
+    if (got == len) {
+        return QCLOUD_RET_SUCCESS;
+    }
+    return got ? QCLOUD_ERR_TCP_READ_TIMEOUT : QCLOUD_ERR_TCP_NOTHING_TO_READ;
+}
+
+static void _standin_disconnect(Network *network)
+{
+    StandinConn *conn = (StandinConn *)network->handle;
+
+    if (NULL != conn) {
+        free(conn->req);
+        free(conn->resp);
+        free(conn);
+    }
+    network->handle = 0;
+}
+
+int network_init(Network *network)
+{
+    network->connect    = _standin_connect;
+    network->read       = _standin_read;
+    network->write      = _standin_write;
+    network->disconnect = _standin_disconnect;
+    return QCLOUD_RET_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Local HTTP stand-in of the host harnesses.
+ *
+ * It provides network_init of the SDK, so utils_httpc runs unchanged on connections served in
+ * process by a handler of the harness. Each response is delivered after a latency and at a
+ * capped rate per connection, the way one stream of a remote server is, and a connection may
+ * be reset at random. Reads block until the buffer is filled or the timeout expires, as the
+ * TCP read of the HAL does.
+ */
+
+#ifndef QCLOUD_IOT_TESTS_HTTP_STANDIN_H_
+#define QCLOUD_IOT_TESTS_HTTP_STANDIN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *method;
+    const char *path;
+    const char *header;  // request header lines
+    const char *body;
+    size_t      body_len;
+} StandinRequest;
+
+/* build the whole response message with standin_response, return its length */
+typedef size_t (*StandinHandler)(void *user_data, const StandinRequest *req, char **resp);
+
+typedef struct {
+    StandinHandler handler;
+    void *         user_data;
+    uint32_t       rate;            // bytes per second of each connection, 0 for no cap
+    uint32_t       latency_ms;      // delay of the first byte of each response
+    uint32_t       reset_permille;  // chance of connection reset per 16KB delivered
+} StandinConfig;
+
+typedef struct {
+    uint32_t connects;
+    uint32_t refused;  // connects while the server is down
+    uint32_t requests;
+    uint32_t resets;
+    uint64_t bytes;  // bytes of responses delivered
+} StandinStats;
+
+/* serve connections made from now with config, statistics are cleared */
+void standin_start(const StandinConfig *config);
+
+/* server goes down: open connections are reset, and connect fails while set */
+void standin_set_down(bool down);
+
+void standin_get_stats(StandinStats *stats);
+
+/* find header value in request, NULL if absent */
+const char *standin_header(const StandinRequest *req, const char *name);
+
+/* malloc response with status line, Content-Length, extra header lines and body */
+size_t standin_response(char **resp, int status, const char *extra_header, const char *body, size_t body_len);
+
+#endif /* QCLOUD_IOT_TESTS_HTTP_STANDIN_H_ */
@@ -0,0 +1,302 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Host test of the log uploader against the local HTTP stand-in.
+ *
+ * Logs of the ring are posted in batches no larger than MAX_HTTP_LOG_POST_SIZE, each signed by
+ * HMAC-SHA1 and optionally compressed, which the stand-in checks and inflates. When the server
+ * is down, retries back off from LOG_UPLOAD_INTERVAL_MS, logs filling the ring are spilled to
+ * the flash given by the save callbacks, and they are posted first, in order, once the server
+ * is back. All the lines must reach the server exactly once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "http_standin.h"
+#include "log_upload.h"
+#include "mqtt_client.h"
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_decompress.h"
+#include "utils_hmac.h"
+
+#define UPLOAD_HOST       "standin.test"
+#define UPLOAD_SIGN_KEY   "c2lnbi1rZXktb2YtdGVzdA=="
+#define UPLOAD_SIGN_LEN   40
+#define UPLOAD_LOG_MAX    (64 * 1024)
+#define UPLOAD_SLACK_MS   600  // upload is polled, and the host is shared
+#define UPLOAD_RING_FILL  (LOG_UPLOAD_BUFFER_SIZE * 7 / 8)  // above the watermark of log_upload.c
+
+#define UPLOAD_CHECK(cond)                                                          \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+static char     sg_sent[UPLOAD_LOG_MAX];      // lines appended
+static size_t   sg_sent_len;
+static char     sg_received[UPLOAD_LOG_MAX];  // lines posted to server
+static size_t   sg_received_len;
+static uint32_t sg_posts, sg_deflated_posts;
+static uint32_t sg_line_no;
+
+static char   sg_flash[MAX_LOG_SAVE_SIZE];  // logs saved by uploader
+static size_t sg_flash_len;
+
+/* log level topic is not tested, MQTT is not linked */
+int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParams)
+{
+    return QCLOUD_ERR_FAILURE;
+}
+
+int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams)
+{
+    return QCLOUD_ERR_FAILURE;
+}
+
+static size_t _flash_save(const char *msg, size_t len)
+{
+    len = len < sizeof(sg_flash) - sg_flash_len ? len : sizeof(sg_flash) - sg_flash_len;
+    memcpy(sg_flash + sg_flash_len, msg, len);
+    sg_flash_len += len;
+    return len;
+}
+
+static size_t _flash_read(char *buf, size_t len, size_t offset)
+{
+    if (offset >= sg_flash_len) {
+        return 0;
+    }
+    len = len < sg_flash_len - offset ? len : sg_flash_len - offset;
+    memcpy(buf, sg_flash + offset, len);
+    return len;
+}
+
+static int _flash_del(void)
+{
+    sg_flash_len = 0;
+    return 0;
+}
+
+static size_t _flash_size(void)
+{
+    return sg_flash_len;
+}
+
+static int _inflate_output(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    char *body = (char *)user_data;
+
+    if (offset + len > MAX_HTTP_LOG_POST_SIZE) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    memcpy(body + offset, buf, len);
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* check signature and batch of one post, and keep its lines */
+static size_t _handler(void *user_data, const StandinRequest *req, char **resp)
+{
+    static char body[MAX_HTTP_LOG_POST_SIZE + 1];
+    char        sign[UPLOAD_SIGN_LEN + 1];
+    const char *encoding = standin_header(req, "Content-Encoding");
+    const char *lines;
+    size_t      len = req->body_len;
+    void *      dec;
+
+    UPLOAD_CHECK(0 == strcmp(req->method, "POST") && 0 == strcmp(req->path, "/cgi-bin/report-log"));
+
+    if (NULL != encoding && 0 == strncmp(encoding, "deflate\r\n", 9)) {
+        dec = utils_decompress_init(DECOMPRESS_ZLIB, DECOMPRESS_WINDOW_BITS_MAX, 0, _inflate_output, body);
+        UPLOAD_CHECK(QCLOUD_RET_SUCCESS == utils_decompress_feed(dec, req->body, req->body_len));
+        UPLOAD_CHECK(QCLOUD_RET_SUCCESS == utils_decompress_finish(dec));
+        len = utils_decompress_total_out(dec);
+        utils_decompress_deinit(dec);
+        UPLOAD_CHECK(len > req->body_len);
+        sg_deflated_posts++;
+    } else {
+        UPLOAD_CHECK(len <= MAX_HTTP_LOG_POST_SIZE);
+        memcpy(body, req->body, len);
+    }
+    body[len] = '\0';
+
+    // <signature>;<timestamp>;<product id>;<device name>\n<log lines>
+    UPLOAD_CHECK(len > UPLOAD_SIGN_LEN && ';' == body[UPLOAD_SIGN_LEN]);
+    utils_hmac_sha1(body + UPLOAD_SIGN_LEN, len - UPLOAD_SIGN_LEN, sign, UPLOAD_SIGN_KEY, strlen(UPLOAD_SIGN_KEY));
+    UPLOAD_CHECK(0 == memcmp(sign, body, UPLOAD_SIGN_LEN));
+    lines = strchr(body, '\n');
+    UPLOAD_CHECK(NULL != lines && NULL != strstr(body, ";PRODUCT;device\n"));
+
+    // whole lines only
+    lines++;
+    UPLOAD_CHECK('\n' == body[len - 1]);
+    UPLOAD_CHECK(sg_received_len + (body + len - lines) <= sizeof(sg_received));
+    memcpy(sg_received + sg_received_len, lines, body + len - lines);
+    sg_received_len += body + len - lines;
+    sg_posts++;
+
+    return standin_response(resp, 200, NULL, "{}", 2);
+}
+
+/* append lines of about 60 bytes, as many as fit in len */
+static void _append_lines(size_t len)
+{
+    char   line[80];
+    size_t n, total;
+
+    for (total = 0;; total += n) {
+        n = snprintf(line, sizeof(line), "INF|2026-10-19 10:00:00|log_upload_test.c|line %05u of the test\n",
+                     sg_line_no);
+        if (total + n > len) {
+            break;
+        }
+        UPLOAD_CHECK(0 == append_to_upload_buffer(line, n));
+        UPLOAD_CHECK(sg_sent_len + n <= sizeof(sg_sent));
+        memcpy(sg_sent + sg_sent_len, line, n);
+        sg_sent_len += n;
+        sg_line_no++;
+    }
+}
+
+static void _init(bool compress)
+{
+    LogUploadInitParams params;
+
+    memset(&params, 0, sizeof(params));
+    params.product_id    = "PRODUCT";
+    params.device_name   = "device";
+    params.sign_key      = UPLOAD_SIGN_KEY;
+    params.save_func     = _flash_save;
+    params.read_func     = _flash_read;
+    params.del_func      = _flash_del;
+    params.get_size_func = _flash_size;
+    params.host          = UPLOAD_HOST;
+    params.compress      = compress;
+    UPLOAD_CHECK(QCLOUD_RET_SUCCESS == init_log_uploader(&params));
+}
+
+static void _check_received(void)
+{
+    UPLOAD_CHECK(sg_received_len == sg_sent_len && 0 == memcmp(sg_received, sg_sent, sg_sent_len));
+}
+
+/* more than one post of logs in the ring, with and without compression */
+static void _batches(bool compress)
+{
+    uint32_t posts = sg_posts, deflated = sg_deflated_posts;
+
+    _init(compress);
+    _append_lines(UPLOAD_RING_FILL);
+    UPLOAD_CHECK(QCLOUD_RET_SUCCESS == do_log_upload(true));
+    _check_received();
+    UPLOAD_CHECK(sg_posts - posts >= 2);
+    UPLOAD_CHECK(compress ? sg_deflated_posts - deflated == sg_posts - posts : sg_deflated_posts == deflated);
+    fini_log_uploader();
+
+    printf("%-10s %u posts ok\n", compress ? "deflate" : "plain", sg_posts - posts);
+}
+
+/* poll upload until the server is tried again, return ms since start */
+static uint64_t _wait_retry(uint64_t start, uint32_t timeout_ms)
+{
+    StandinStats stats;
+    uint32_t     refused;
+
+    standin_get_stats(&stats);
+    refused = stats.refused;
+    while (HAL_GetTimeMs64() - start < timeout_ms) {
+        do_log_upload(false);
+        standin_get_stats(&stats);
+        if (stats.refused != refused) {
+            return HAL_GetTimeMs64() - start;
+        }
+        HAL_SleepMs(20);
+    }
+
+    return HAL_GetTimeMs64() - start;
+}
+
+/* server is down: retries back off, logs are spilled to flash and posted when server is back */
+static void _backoff_and_spill(void)
+{
+    StandinStats stats;
+    uint64_t     start, first, second;
+    size_t       flash_len;
+
+    _init(false);
+    standin_set_down(true);
+
+    _append_lines(600);
+    UPLOAD_CHECK(QCLOUD_RET_SUCCESS != do_log_upload(true));
+    start = HAL_GetTimeMs64();
+    UPLOAD_CHECK(sg_flash_len > 0);
+
+    // not retried before the interval, even if forced
+    UPLOAD_CHECK(QCLOUD_RET_SUCCESS == do_log_upload(true));
+    standin_get_stats(&stats);
+    UPLOAD_CHECK(1 == stats.refused);
+
+    // ring filled over watermark while waiting is saved without trying the server
+    _append_lines(UPLOAD_RING_FILL);
+    flash_len = sg_flash_len;
+    UPLOAD_CHECK(QCLOUD_RET_SUCCESS == do_log_upload(false));
+    standin_get_stats(&stats);
+    UPLOAD_CHECK(1 == stats.refused && sg_flash_len > flash_len);
+
+    first = _wait_retry(start, LOG_UPLOAD_INTERVAL_MS + UPLOAD_SLACK_MS);
+    UPLOAD_CHECK(first >= LOG_UPLOAD_INTERVAL_MS && first < LOG_UPLOAD_INTERVAL_MS + UPLOAD_SLACK_MS);
+    _append_lines(600);
+    second = _wait_retry(start, first + 2 * LOG_UPLOAD_INTERVAL_MS + UPLOAD_SLACK_MS);
+    UPLOAD_CHECK(second - first >= 2 * LOG_UPLOAD_INTERVAL_MS &&
+                 second - first < 2 * LOG_UPLOAD_INTERVAL_MS + UPLOAD_SLACK_MS);
+    fini_log_uploader();
+
+    // back again, new uploader starts without backoff and posts saved logs before the ring
+    standin_set_down(false);
+    _init(false);
+    _append_lines(600);
+    UPLOAD_CHECK(QCLOUD_RET_SUCCESS == do_log_upload(true));
+    _check_received();
+    UPLOAD_CHECK(0 == sg_flash_len);
+    fini_log_uploader();
+
+    printf("backoff    retries after %u and %u ms, spill ok\n", (unsigned)first, (unsigned)(second - first));
+}
+
+int main(int argc, char **argv)
+{
+    StandinConfig config = {_handler, NULL, 0, 0, 0};
+
+    IOT_Log_Set_Level(eLOG_DISABLE);
+    IOT_Log_Set_Upload_Level(eLOG_DISABLE);
+    standin_start(&config);
+
+    _batches(false);
+    _batches(true);
+    _backoff_and_spill();
+
+    printf("log_upload_test: passed\n");
+    return 0;
+}
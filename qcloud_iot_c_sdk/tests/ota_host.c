@@ -0,0 +1,99 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "ota_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ota_client.h"
+#include "qcloud_iot_export.h"
+
+static OnOTAMessageCallback sg_ota_cb;
+static void *               sg_ota_context;
+
+void *qcloud_osc_init(const char *productId, const char *deviceName, void *channel, OnOTAMessageCallback callback,
+                      void *context)
+{
+    sg_ota_cb      = callback;
+    sg_ota_context = context;
+    return channel;
+}
+
+int qcloud_osc_deinit(void *handle)
+{
+    return QCLOUD_RET_SUCCESS;
+}
+
+int qcloud_osc_report_progress(void *handle, const char *msg)
+{
+    return 0;
+}
+
+int qcloud_osc_report_version(void *handle, const char *msg)
+{
+    return 0;
+}
+
+int qcloud_osc_report_upgrade_result(void *handle, const char *msg)
+{
+    return 0;
+}
+
+void *ota_host_open(const char *info)
+{
+    static int channel;
+    void *     h_ota = IOT_OTA_Init("PRODUCT", "device", &channel);
+
+    if (NULL == h_ota) {
+        abort();
+    }
+
+    sg_ota_cb(sg_ota_context, info, strlen(info));
+    if (!IOT_OTA_IsFetching(h_ota)) {
+        abort();
+    }
+
+    return h_ota;
+}
+
+size_t ota_host_serve(const char *image, uint32_t size, const StandinRequest *req, char **resp)
+{
+    const char *range = standin_header(req, "Range");
+    char        header[96];
+    uint32_t    first = 0, last = size - 1;
+
+    if (NULL == req->path || strcmp(req->path, OTA_HOST_PATH)) {
+        return standin_response(resp, 404, NULL, "", 0);
+    }
+
+    if (NULL == range) {
+        return standin_response(resp, 200, NULL, image, size);
+    }
+
+    if (2 != sscanf(range, "bytes=%u-%u", &first, &last) || first >= size) {
+        return standin_response(resp, 416, NULL, "", 0);
+    }
+    last = last < size ? last : size - 1;
+    snprintf(header, sizeof(header), "Content-Range: bytes %u-%u/%u\r\n", first, last, size);
+
+    return standin_response(resp, 206, header, image + first, last - first + 1);
+}
@@ -0,0 +1,43 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * OTA side of the host harnesses. The signal channel is replaced: reports are dropped and the
+ * firmware info is given by the harness. The firmware is served by the HTTP stand-in, so
+ * ota_client and ota_fetch run unchanged.
+ */
+
+#ifndef QCLOUD_IOT_TESTS_OTA_HOST_H_
+#define QCLOUD_IOT_TESTS_OTA_HOST_H_
+
+#include <stdint.h>
+
+#include "http_standin.h"
+
+#define OTA_HOST_URL  "http://standin.test/fw"
+#define OTA_HOST_PATH "/fw"
+
+/* OTA handle in fetching state, as after the firmware info message is received, abort on failure */
+void *ota_host_open(const char *info);
+
+/* serve GET of image at OTA_HOST_PATH, with inclusive Range clamped to its size */
+size_t ota_host_serve(const char *image, uint32_t size, const StandinRequest *req, char **resp);
+
+#endif /* QCLOUD_IOT_TESTS_OTA_HOST_H_ */
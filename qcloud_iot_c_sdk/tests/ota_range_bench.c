@@ -0,0 +1,286 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Benchmark and check of IOT_OTA_FetchParallel against the local HTTP stand-in. The firmware
+ * is served with Range support, each stream capped in rate and delayed by a latency. It times
+ * the single stream pipeline against K ranges, runs both with connection resets, and checks
+ * that a download stopped by a server outage resumes from the range checkpoint. The image
+ * written by the sink is compared with the served one, and MD5 is checked by IOT_OTA_Ioctl.
+ *
+ * usage: ota_range_bench [size_kb [rate_kb_per_s [latency_ms]]]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "http_standin.h"
+#include "ota_host.h"
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_md5.h"
+
+#define BENCH_RESET_PERMILLE 10
+
+static char *   sg_image;  // served firmware
+static char *   sg_flash;  // firmware written by sink
+static uint32_t sg_size;
+static char     sg_md5[33];
+static int      sg_version;
+
+static size_t _bench_handler(void *user_data, const StandinRequest *req, char **resp)
+{
+    return ota_host_serve(sg_image, sg_size, req, resp);
+}
+
+static int _bench_sink(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    if (offset + len > sg_size) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    memcpy(sg_flash + offset, buf, len);
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _bench_read_back(void *user_data, uint32_t offset, char *buf, uint32_t len)
+{
+    memcpy(buf, sg_flash + offset, len);
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* OTA handle of the firmware of current version */
+static void *_bench_open(void)
+{
+    char info[256];
+
+    snprintf(info, sizeof(info),
+             "{\"type\":\"update_firmware\",\"version\":\"1.0.%d\",\"url\":\"%s\",\"md5sum\":\"%s\","
+             "\"file_size\":%u}",
+             sg_version, OTA_HOST_URL, sg_md5, sg_size);
+    return ota_host_open(info);
+}
+
+static int _bench_check(void *h_ota)
+{
+    uint32_t firmware_valid = 0;
+
+    IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, &firmware_valid, 4);
+    return firmware_valid && 0 == memcmp(sg_image, sg_flash, sg_size);
+}
+
+static double _now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _bench_report(const char *name, int ret, int valid, double start)
+{
+    StandinStats stats;
+
+    standin_get_stats(&stats);
+    printf("%-18s %8.2f %6s %6s %8u %6u %10llu\n", name, _now_s() - start, QCLOUD_RET_SUCCESS == ret ? "ok" : "abort",
+           valid ? "ok" : "-", stats.connects, stats.resets, (unsigned long long)stats.bytes);
+}
+
+/* single stream through the pipeline, return 1 if the firmware is valid */
+static int _bench_single(const StandinConfig *config, const char *name)
+{
+    OTAPipelineParams params = DEFAULT_OTA_PIPELINE_PARAMS;
+    void *            h_ota;
+    double            start;
+    int               ret, valid = 0;
+
+    sg_version++;
+    memset(sg_flash, 0, sg_size);
+    standin_start(config);
+    h_ota = _bench_open();
+
+    start            = _now_s();
+    params.sink      = _bench_sink;
+    params.buf_len   = 4096;
+    params.timeout_s = 5;
+    ret              = IOT_OTA_StartDownload(h_ota, 0, sg_size);
+    if (QCLOUD_RET_SUCCESS == ret) {
+        ret = IOT_OTA_FetchPipeline(h_ota, &params);
+    }
+    if (QCLOUD_RET_SUCCESS == ret) {
+        valid = _bench_check(h_ota);
+    }
+    _bench_report(name, ret, valid, start);
+
+    IOT_OTA_Destroy(h_ota);
+    return valid;
+}
+
+static int _bench_parallel(void *h_ota, uint16_t range_num)
+{
+    OTAParallelParams params = DEFAULT_OTA_PARALLEL_PARAMS;
+
+    params.sink      = _bench_sink;
+    params.read_back = _bench_read_back;
+    params.range_num = range_num;
+    params.timeout_s = 5;
+    return IOT_OTA_FetchParallel(h_ota, &params);
+}
+
+/* K ranges, return 1 if the firmware is valid */
+static int _bench_ranges(const StandinConfig *config, const char *name, uint16_t range_num)
+{
+    void * h_ota;
+    double start;
+    int    ret, valid = 0;
+
+    sg_version++;
+    memset(sg_flash, 0, sg_size);
+    standin_start(config);
+    h_ota = _bench_open();
+
+    start = _now_s();
+    ret   = _bench_parallel(h_ota, range_num);
+    if (QCLOUD_RET_SUCCESS == ret) {
+        valid = _bench_check(h_ota);
+    }
+    _bench_report(name, ret, valid, start);
+
+    IOT_OTA_Destroy(h_ota);
+    return valid;
+}
+
+/* take the server down once half of the firmware is served */
+static void *_bench_outage(void *arg)
+{
+    StandinStats stats;
+
+    do {
+        HAL_SleepMs(10);
+        standin_get_stats(&stats);
+    } while (stats.bytes < sg_size / 2);
+    standin_set_down(true);
+
+    return NULL;
+}
+
+/* download stopped by an outage, and resumed by the next call */
+static int _bench_resume(const StandinConfig *config, uint16_t range_num)
+{
+    StandinStats stats;
+    pthread_t    outage;
+    void *       h_ota;
+    double       start;
+    int          ret, valid = 0;
+
+    sg_version++;
+    memset(sg_flash, 0, sg_size);
+    standin_start(config);
+    h_ota = _bench_open();
+    start = _now_s();
+    pthread_create(&outage, NULL, _bench_outage, NULL);
+    ret = _bench_parallel(h_ota, range_num);
+    pthread_join(outage, NULL);
+    _bench_report("K=4 outage", ret, 0, start);
+    IOT_OTA_Destroy(h_ota);
+    if (QCLOUD_RET_SUCCESS == ret) {
+        printf("download is not stopped by the outage\n");
+        return 0;
+    }
+
+    // same firmware again, ranges resume from the checkpoint
+    standin_start(config);
+    h_ota = _bench_open();
+    start = _now_s();
+    ret   = _bench_parallel(h_ota, range_num);
+    if (QCLOUD_RET_SUCCESS == ret) {
+        valid = _bench_check(h_ota);
+    }
+    _bench_report("K=4 resumed", ret, valid, start);
+    IOT_OTA_Destroy(h_ota);
+
+    standin_get_stats(&stats);
+    if (stats.bytes >= sg_size) {
+        printf("resumed download fetched %llu bytes of %u\n", (unsigned long long)stats.bytes, sg_size);
+        return 0;
+    }
+
+    return valid;
+}
+
+int main(int argc, char **argv)
+{
+    StandinConfig config = {_bench_handler, NULL, 250 * 1024, 100, 0};
+    unsigned char digest[16];
+    uint32_t      i, rand = 1;
+    int           failed = 0;
+
+    sg_size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 2048) * 1024;
+    if (argc > 2) {
+        config.rate = strtoul(argv[2], NULL, 10) * 1024;
+    }
+    if (argc > 3) {
+        config.latency_ms = strtoul(argv[3], NULL, 10);
+    }
+    if (0 == sg_size) {
+        sg_size = 1;
+    }
+
+    IOT_Log_Set_Level(eLOG_DISABLE);
+
+    sg_image = malloc(sg_size);
+    sg_flash = malloc(sg_size);
+    if (NULL == sg_image || NULL == sg_flash) {
+        return 1;
+    }
+    for (i = 0; i < sg_size; i++) {
+        rand ^= rand << 13;
+        rand ^= rand >> 17;
+        rand ^= rand << 5;
+        sg_image[i] = (char)rand;
+    }
+    utils_md5((const unsigned char *)sg_image, sg_size, digest);
+    for (i = 0; i < 16; i++) {
+        snprintf(sg_md5 + i * 2, 3, "%02x", digest[i]);
+    }
+
+    printf("firmware %u KB, %u KB/s and %u ms latency per stream\n", sg_size / 1024, config.rate / 1024,
+           config.latency_ms);
+    printf("%-18s %8s %6s %6s %8s %6s %10s\n", "fetch", "seconds", "fetch", "md5", "connects", "resets", "bytes");
+
+    failed |= !_bench_single(&config, "single stream");
+    failed |= !_bench_ranges(&config, "K=4", 4);
+    failed |= !_bench_ranges(&config, "K=8", 8);
+
+    // a reset stream aborts the single stream, ranges are refetched from where they stopped
+    config.reset_permille = BENCH_RESET_PERMILLE;
+    _bench_single(&config, "single 1% resets");
+    failed |= !_bench_ranges(&config, "K=4 1% resets", 4);
+    config.reset_permille = 0;
+
+    failed |= !_bench_resume(&config, 4);
+
+    free(sg_image);
+    free(sg_flash);
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
@@ -0,0 +1,231 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Host test of OTA firmware verification against the local HTTP stand-in.
+ *
+ * Firmware is fetched by the serial and the pipelined IOT_OTA_FetchPipeline and by
+ * IOT_OTA_FetchParallel with block digests. An intact image must pass IOT_OTA_Ioctl, and an
+ * image with one corrupt block must be rejected with IOT_OTA_ERR_VERIFY before any byte of that
+ * block reaches the sink. SHA-256 of firmware info and the signature callback are checked too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ota_host.h"
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_md5.h"
+#include "utils_sha256.h"
+
+#define VERIFY_IMAGE_SIZE  (256 * 1024 + 1000)  // last block is short
+#define VERIFY_BLOCK_SIZE  (16 * 1024)
+#define VERIFY_BLOCK_NUM   ((VERIFY_IMAGE_SIZE + VERIFY_BLOCK_SIZE - 1) / VERIFY_BLOCK_SIZE)
+#define VERIFY_BAD_BLOCK   5
+#define VERIFY_SIGNATURE   "signed-by-test"
+
+#define VERIFY_CHECK(cond)                                                          \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+typedef enum { FETCH_SERIAL, FETCH_PIPELINED, FETCH_PARALLEL } FetchMode;
+
+static const char *sg_mode_names[] = {"serial", "pipelined", "parallel"};
+
+static char          sg_image[VERIFY_IMAGE_SIZE];   // intact firmware
+static char          sg_served[VERIFY_IMAGE_SIZE];  // firmware on the server
+static char          sg_flash[VERIFY_IMAGE_SIZE];   // firmware written by sink
+static unsigned char sg_block_digests[VERIFY_BLOCK_NUM][32];
+static unsigned char sg_sha256[32];
+static char          sg_md5[33];
+static int           sg_bad_written;  // sink got data of the corrupt block
+static int           sg_sign_calls;
+
+static size_t _handler(void *user_data, const StandinRequest *req, char **resp)
+{
+    return ota_host_serve(sg_served, VERIFY_IMAGE_SIZE, req, resp);
+}
+
+static int _sink(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    VERIFY_CHECK(offset + len <= VERIFY_IMAGE_SIZE);
+    if (offset < (VERIFY_BAD_BLOCK + 1) * VERIFY_BLOCK_SIZE && offset + len > VERIFY_BAD_BLOCK * VERIFY_BLOCK_SIZE) {
+        sg_bad_written = 1;
+    }
+    memcpy(sg_flash + offset, buf, len);
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _read_back(void *user_data, uint32_t offset, char *buf, uint32_t len)
+{
+    memcpy(buf, sg_flash + offset, len);
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _verify_sign(void *user_data, const unsigned char digest[32], const char *signature)
+{
+    sg_sign_calls++;
+    return 0 == memcmp(digest, sg_sha256, 32) && 0 == strcmp(signature, VERIFY_SIGNATURE) ? QCLOUD_RET_SUCCESS
+                                                                                           : QCLOUD_ERR_FAILURE;
+}
+
+static void _hex(const unsigned char *digest, size_t len, char *hex)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        sprintf(hex + i * 2, "%02x", digest[i]);
+    }
+}
+
+/* fetch firmware with extra firmware info and verify params, return fetch result and if the firmware is valid */
+static int _fetch(FetchMode mode, const char *extra_info, OTAVerifyParams *verify, uint32_t *valid)
+{
+    OTAPipelineParams pipeline = DEFAULT_OTA_PIPELINE_PARAMS;
+    OTAParallelParams parallel = DEFAULT_OTA_PARALLEL_PARAMS;
+    char              info[512];
+    void *            h_ota;
+    int               ret;
+
+    snprintf(info, sizeof(info),
+             "{\"type\":\"update_firmware\",\"version\":\"2.0.0\",\"url\":\"%s\",\"md5sum\":\"%s\","
+             "\"file_size\":%u%s}",
+             OTA_HOST_URL, sg_md5, VERIFY_IMAGE_SIZE, extra_info);
+    h_ota = ota_host_open(info);
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == IOT_OTA_SetVerify(h_ota, verify));
+
+    memset(sg_flash, 0, sizeof(sg_flash));
+    sg_bad_written = 0;
+    *valid         = 0;
+    if (FETCH_PARALLEL == mode) {
+        parallel.sink      = _sink;
+        parallel.read_back = _read_back;
+        parallel.timeout_s = 5;
+        ret                = IOT_OTA_FetchParallel(h_ota, &parallel);
+    } else {
+        pipeline.sink      = _sink;
+        pipeline.buf_num   = FETCH_SERIAL == mode ? 1 : 2;
+        pipeline.buf_len   = 3000;  // not a divisor of block size
+        pipeline.timeout_s = 5;
+        ret                = IOT_OTA_StartDownload(h_ota, 0, VERIFY_IMAGE_SIZE);
+        if (QCLOUD_RET_SUCCESS == ret) {
+            ret = IOT_OTA_FetchPipeline(h_ota, &pipeline);
+        }
+    }
+    if (QCLOUD_RET_SUCCESS == ret) {
+        IOT_OTA_Ioctl(h_ota, IOT_OTAG_CHECK_FIRMWARE, valid, 4);
+    }
+
+    IOT_OTA_Destroy(h_ota);
+    return ret;
+}
+
+static void _block_digests(FetchMode mode)
+{
+    OTAVerifyParams verify = {NULL, NULL, VERIFY_BLOCK_SIZE, VERIFY_BLOCK_NUM, sg_block_digests};
+    uint32_t        valid;
+
+    memcpy(sg_served, sg_image, sizeof(sg_served));
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == _fetch(mode, "", &verify, &valid));
+    VERIFY_CHECK(valid && 0 == memcmp(sg_flash, sg_image, sizeof(sg_flash)));
+
+    // one flipped byte in the middle of a block, the fetch stops there
+    sg_served[VERIFY_BAD_BLOCK * VERIFY_BLOCK_SIZE + 777] ^= 0x5a;
+    VERIFY_CHECK(IOT_OTA_ERR_VERIFY == _fetch(mode, "", &verify, &valid));
+    VERIFY_CHECK(!sg_bad_written);
+
+    // the last block is short
+    memcpy(sg_served, sg_image, sizeof(sg_served));
+    sg_served[VERIFY_IMAGE_SIZE - 1] ^= 0x01;
+    VERIFY_CHECK(IOT_OTA_ERR_VERIFY == _fetch(mode, "", &verify, &valid));
+
+    printf("%-10s block digests ok\n", sg_mode_names[mode]);
+}
+
+static void _firmware_sha256(void)
+{
+    OTAVerifyParams verify = {_verify_sign, NULL, 0, 0, NULL};
+    char            extra[160], hex[65];
+    uint32_t        valid;
+
+    memcpy(sg_served, sg_image, sizeof(sg_served));
+    _hex(sg_sha256, sizeof(sg_sha256), hex);
+
+    snprintf(extra, sizeof(extra), ",\"sha256\":\"%s\"", hex);
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == _fetch(FETCH_PIPELINED, extra, NULL, &valid));
+    VERIFY_CHECK(valid);
+
+    hex[0] = '0' == hex[0] ? '1' : '0';
+    snprintf(extra, sizeof(extra), ",\"sha256\":\"%s\"", hex);
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == _fetch(FETCH_PIPELINED, extra, NULL, &valid));
+    VERIFY_CHECK(!valid);
+
+    // signature over SHA-256, unsigned firmware is rejected when verify_sign is set
+    sg_sign_calls = 0;
+    snprintf(extra, sizeof(extra), ",\"signature\":\"%s\"", VERIFY_SIGNATURE);
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == _fetch(FETCH_PARALLEL, extra, &verify, &valid));
+    VERIFY_CHECK(valid && 1 == sg_sign_calls);
+    snprintf(extra, sizeof(extra), ",\"signature\":\"%s\"", "forged");
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == _fetch(FETCH_SERIAL, extra, &verify, &valid));
+    VERIFY_CHECK(!valid && 2 == sg_sign_calls);
+    VERIFY_CHECK(QCLOUD_RET_SUCCESS == _fetch(FETCH_SERIAL, "", &verify, &valid));
+    VERIFY_CHECK(!valid && 2 == sg_sign_calls);
+
+    printf("firmware sha256 and signature ok\n");
+}
+
+int main(int argc, char **argv)
+{
+    StandinConfig config = {_handler, NULL, 0, 0, 0};
+    unsigned char digest[16];
+    uint32_t      i, rand = 7;
+
+    IOT_Log_Set_Level(eLOG_DISABLE);
+    standin_start(&config);
+
+    for (i = 0; i < VERIFY_IMAGE_SIZE; i++) {
+        rand ^= rand << 13;
+        rand ^= rand >> 17;
+        rand ^= rand << 5;
+        sg_image[i] = (char)rand;
+    }
+    for (i = 0; i < VERIFY_BLOCK_NUM; i++) {
+        utils_sha256((const unsigned char *)sg_image + i * VERIFY_BLOCK_SIZE,
+                     i + 1 < VERIFY_BLOCK_NUM ? VERIFY_BLOCK_SIZE : VERIFY_IMAGE_SIZE - i * VERIFY_BLOCK_SIZE,
+                     sg_block_digests[i]);
+    }
+    utils_sha256((const unsigned char *)sg_image, VERIFY_IMAGE_SIZE, sg_sha256);
+    utils_md5((const unsigned char *)sg_image, VERIFY_IMAGE_SIZE, digest);
+    _hex(digest, sizeof(digest), sg_md5);
+
+    _block_digests(FETCH_SERIAL);
+    _block_digests(FETCH_PIPELINED);
+    _block_digests(FETCH_PARALLEL);
+    _firmware_sha256();
+
+    printf("ota_verify_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,303 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Host test of utils_patch against patches generated by tools/qdiff.
+ *
+ *   patch_test <qdiff> [rounds]
+ *
+ * Each round writes a pseudo firmware image and a modified version of it to files, runs the
+ * generator on them, and applies the patch in random pieces with the source read from the
+ * old image file, as OTA does from the running partition. Truncated and corrupted patches
+ * must be rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils_patch.h"
+
+#define PATCH_OLD_FILE   "patch_test_old.bin"
+#define PATCH_NEW_FILE   "patch_test_new.bin"
+#define PATCH_DIFF_FILE  "patch_test.qdiff"
+#define PATCH_IMAGE_MAX  (256 * 1024)
+#define PATCH_FEED_MAX   1500
+
+#define PATCH_CHECK(cond)                                                           \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+typedef struct {
+    FILE *         source;
+    const uint8_t *expect;
+    uint32_t       expect_len;
+    uint32_t       next_offset;
+    int            mismatch;
+} PatchTarget;
+
+static uint32_t sg_seed = 1;
+
+static uint32_t _rand(void)
+{
+    sg_seed = sg_seed * 1103515245 + 12345;
+    return (sg_seed >> 8) & 0xffffff;
+}
+
+static void _write_file(const char *path, const uint8_t *buf, uint32_t len)
+{
+    FILE *fp = fopen(path, "wb");
+
+    PATCH_CHECK(fp != NULL);
+    PATCH_CHECK(fwrite(buf, 1, len, fp) == len);
+    PATCH_CHECK(fclose(fp) == 0);
+}
+
+static uint8_t *_read_file(const char *path, uint32_t *len)
+{
+    FILE *   fp = fopen(path, "rb");
+    uint8_t *buf;
+    long     size;
+
+    PATCH_CHECK(fp != NULL);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+    buf = malloc(size + 1);
+    PATCH_CHECK(buf != NULL && fread(buf, 1, size, fp) == (size_t)size);
+    fclose(fp);
+    *len = (uint32_t)size;
+    return buf;
+}
+
+/* code like image: repeated instruction patterns with embedded addresses and some strings */
+static uint32_t _gen_old(uint8_t *buf)
+{
+    uint32_t len = 1024 + _rand() % (PATCH_IMAGE_MAX / 2);
+    uint32_t i, addr = 0x40080000;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        if (_rand() % 16 == 0) {
+            memcpy(buf + i, "version:", 8);
+            continue;
+        }
+        buf[i]     = (uint8_t)(0x36 + _rand() % 4);
+        buf[i + 1] = (uint8_t)(_rand() % 3);
+        buf[i + 2] = 0x00;
+        buf[i + 3] = (uint8_t)_rand();
+        addr += 4 * (_rand() % 64);
+        memcpy(buf + i + 4, &addr, 4);
+    }
+    for (; i < len; i++) {
+        buf[i] = (uint8_t)_rand();
+    }
+
+    return len;
+}
+
+/* new image: blocks moved, inserted and deleted, addresses shifted and some bytes changed */
+static uint32_t _gen_new(const uint8_t *old, uint32_t old_len, uint8_t *buf)
+{
+    uint32_t len = 0, pos = 0, n, i, delta = 4 * (_rand() % 16);
+
+    while (pos < old_len && len < PATCH_IMAGE_MAX - 4096) {
+        n = 1 + _rand() % 4096;
+        if (n > old_len - pos) {
+            n = old_len - pos;
+        }
+        if (n > PATCH_IMAGE_MAX - len) {
+            n = PATCH_IMAGE_MAX - len;
+        }
+
+        switch (_rand() % 8) {
+            case 0: /* insert new data */
+                for (i = 0; i < n % 512; i++) {
+                    buf[len++] = (uint8_t)_rand();
+                }
+                break;
+            case 1: /* delete */
+                pos += n;
+                break;
+            case 2: /* copy from anywhere */
+                pos = _rand() % old_len;
+                break;
+            default: /* copy with relocated addresses and sparse changes */
+                memcpy(buf + len, old + pos, n);
+                for (i = (8 - pos % 8) % 8; i + 8 <= n; i += 8) {
+                    if (buf[len + i + 2] == 0x00) {
+                        buf[len + i + 4] += delta;
+                    }
+                }
+                for (i = 0; i < n / 256; i++) {
+                    buf[len + _rand() % n] ^= 0x5a;
+                }
+                len += n;
+                pos += n;
+                break;
+        }
+    }
+
+    return len;
+}
+
+static int _source_read(void *user_data, uint32_t offset, char *buf, uint32_t len)
+{
+    PatchTarget *t = (PatchTarget *)user_data;
+
+    PATCH_CHECK(len <= PATCH_SOURCE_READ);
+    if (fseek(t->source, offset, SEEK_SET) || fread(buf, 1, len, t->source) != len) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _output(void *user_data, uint32_t offset, const char *buf, uint32_t len)
+{
+    PatchTarget *t = (PatchTarget *)user_data;
+
+    PATCH_CHECK(offset == t->next_offset);
+    if (offset + len > t->expect_len || memcmp(t->expect + offset, buf, len)) {
+        t->mismatch = 1;
+    }
+    t->next_offset = offset + len;
+    return QCLOUD_RET_SUCCESS;
+}
+
+/* apply patch in random pieces, return result of feed or finish */
+static int _apply(const uint8_t *patch, uint32_t patch_len, uint32_t source_size, PatchTarget *t)
+{
+    void *   h;
+    uint32_t off = 0, n;
+    int      rc  = QCLOUD_RET_SUCCESS;
+
+    t->next_offset = 0;
+    t->mismatch    = 0;
+    h              = utils_patch_init(source_size, _source_read, _output, t);
+    PATCH_CHECK(h != NULL);
+
+    while (off < patch_len && QCLOUD_RET_SUCCESS == rc) {
+        n = 1 + _rand() % PATCH_FEED_MAX;
+        if (n > patch_len - off) {
+            n = patch_len - off;
+        }
+        rc = utils_patch_feed(h, (const char *)patch + off, n);
+        off += n;
+    }
+    if (QCLOUD_RET_SUCCESS == rc) {
+        rc = utils_patch_finish(h);
+        PATCH_CHECK(QCLOUD_RET_SUCCESS != rc || utils_patch_total_out(h) == t->next_offset);
+    }
+
+    utils_patch_deinit(h);
+    return rc;
+}
+
+static void _put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void _round(const char *qdiff)
+{
+    static uint8_t old[PATCH_IMAGE_MAX], new[PATCH_IMAGE_MAX];
+    char           cmd[512];
+    uint32_t       old_len, new_len, patch_len;
+    uint8_t *      patch;
+    PatchTarget    t;
+    int            rc;
+
+    old_len = _gen_old(old);
+    new_len = _gen_new(old, old_len, new);
+    _write_file(PATCH_OLD_FILE, old, old_len);
+    _write_file(PATCH_NEW_FILE, new, new_len);
+
+    HAL_Snprintf(cmd, sizeof(cmd), "%s %s %s %s >/dev/null", qdiff, PATCH_OLD_FILE, PATCH_NEW_FILE, PATCH_DIFF_FILE);
+    PATCH_CHECK(system(cmd) == 0);
+    patch = _read_file(PATCH_DIFF_FILE, &patch_len);
+    PATCH_CHECK(patch_len >= PATCH_HEADER_LEN && !memcmp(patch, PATCH_MAGIC, 4));
+
+    t.source     = fopen(PATCH_OLD_FILE, "rb");
+    t.expect     = new;
+    t.expect_len = new_len;
+    PATCH_CHECK(t.source != NULL);
+
+    rc = _apply(patch, patch_len, old_len, &t);
+    PATCH_CHECK(QCLOUD_RET_SUCCESS == rc && !t.mismatch && t.next_offset == new_len);
+
+    // a truncated patch is never complete
+    if (new_len) {
+        rc = _apply(patch, PATCH_HEADER_LEN + _rand() % (patch_len - PATCH_HEADER_LEN), old_len, &t);
+        PATCH_CHECK(QCLOUD_RET_SUCCESS != rc);
+    }
+
+    // trailing garbage
+    patch = realloc(patch, patch_len + 1);
+    patch[patch_len] = 0;
+    PATCH_CHECK(QCLOUD_RET_SUCCESS != _apply(patch, patch_len + 1, old_len, &t));
+
+    // a smaller source than the patch needs
+    if (old_len) {
+        PATCH_CHECK(QCLOUD_RET_SUCCESS != _apply(patch, patch_len, old_len / 2, &t));
+    }
+
+    // bad magic
+    patch[0] ^= 0xff;
+    PATCH_CHECK(QCLOUD_RET_SUCCESS != _apply(patch, patch_len, old_len, &t));
+    patch[0] ^= 0xff;
+
+    // first record seeks before the source
+    if (patch_len >= PATCH_HEADER_LEN + PATCH_RECORD_LEN) {
+        _put_le32(patch + PATCH_HEADER_LEN + 8, 0x80000000u);
+        PATCH_CHECK(QCLOUD_RET_SUCCESS != _apply(patch, patch_len, old_len, &t));
+    }
+
+    printf("old %6u new %6u patch %6u\n", old_len, new_len, patch_len);
+    fclose(t.source);
+    free(patch);
+}
+
+int main(int argc, char **argv)
+{
+    int i, rounds;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <qdiff> [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    rounds = argc > 2 ? atoi(argv[2]) : 20;
+    for (i = 0; i < rounds; i++) {
+        _round(argv[1]);
+    }
+
+    remove(PATCH_OLD_FILE);
+    remove(PATCH_NEW_FILE);
+    remove(PATCH_DIFF_FILE);
+    printf("patch_test: %d rounds passed\n", rounds);
+    return 0;
+}
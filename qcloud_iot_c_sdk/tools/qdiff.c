@@ -0,0 +1,330 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Generator of QDIFF patch applied by utils_patch, refer to utils_patch.h for the format.
+ * It runs on the host that builds firmware, e.g.
+ *
+ *   cc -O2 -o qdiff qdiff.c
+ *   qdiff old.bin new.bin new.qdiff
+ *   gzip -9 -k new.qdiff
+ *
+ * and the patch, compressed or not, is published as firmware with "delta":"qdiff".
+ *
+ * Matches are searched as bsdiff does, with a hash chain of source instead of suffix
+ * array: approximate matches become diff bytes, which are mostly zero, and the gaps
+ * between them become extra bytes.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QDIFF_MAGIC       "QDF1"
+#define QDIFF_HASH_BITS   20
+#define QDIFF_HASH_LEN    8  /* bytes hashed to find candidates of a match */
+#define QDIFF_CHAIN_MAX   64 /* candidates tried at each position */
+#define QDIFF_MATCH_SLACK 8  /* a match should be longer than the current alignment by this */
+
+typedef struct {
+    const uint8_t *src;
+    uint32_t       src_len;
+    int32_t *      head; /* last source position of each hash */
+    int32_t *      prev; /* previous source position of the same hash */
+} QdiffIndex;
+
+static uint32_t _hash(const uint8_t *p)
+{
+    uint32_t h = 2166136261u;
+    int      i;
+
+    for (i = 0; i < QDIFF_HASH_LEN; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+
+    return h >> (32 - QDIFF_HASH_BITS);
+}
+
+static int _index_build(QdiffIndex *idx, const uint8_t *src, uint32_t src_len)
+{
+    uint32_t i, h;
+
+    idx->src     = src;
+    idx->src_len = src_len;
+    idx->head    = malloc(sizeof(int32_t) << QDIFF_HASH_BITS);
+    idx->prev    = malloc(sizeof(int32_t) * (src_len + 1));
+    if (NULL == idx->head || NULL == idx->prev) {
+        return -1;
+    }
+
+    memset(idx->head, 0xff, sizeof(int32_t) << QDIFF_HASH_BITS);
+    for (i = 0; i + QDIFF_HASH_LEN <= src_len; i++) {
+        h            = _hash(src + i);
+        idx->prev[i] = idx->head[h];
+        idx->head[h] = (int32_t)i;
+    }
+
+    return 0;
+}
+
+static uint32_t _match_len(const uint8_t *a, uint32_t a_len, const uint8_t *b, uint32_t b_len)
+{
+    uint32_t i, n = a_len < b_len ? a_len : b_len;
+
+    for (i = 0; i < n && a[i] == b[i]; i++) {
+    }
+
+    return i;
+}
+
+/* longest exact match of dst in source, return its length and position */
+static uint32_t _search(const QdiffIndex *idx, const uint8_t *dst, uint32_t dst_len, uint32_t *pos)
+{
+    uint32_t best = 0, len;
+    int32_t  cand;
+    int      n;
+
+    if (dst_len < QDIFF_HASH_LEN) {
+        return 0;
+    }
+
+    cand = idx->head[_hash(dst)];
+    for (n = 0; cand >= 0 && n < QDIFF_CHAIN_MAX; n++, cand = idx->prev[cand]) {
+        len = _match_len(idx->src + cand, idx->src_len - cand, dst, dst_len);
+        if (len > best) {
+            best = len;
+            *pos = (uint32_t)cand;
+            if (len == dst_len) {
+                break;
+            }
+        }
+    }
+
+    return best;
+}
+
+static int _put_le32(FILE *fp, uint32_t v)
+{
+    uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+
+    return fwrite(b, 1, 4, fp) == 4 ? 0 : -1;
+}
+
+static int _put_record(FILE *fp, const uint8_t *src, const uint8_t *dst, uint32_t diff_len, uint32_t extra_len,
+                       int32_t seek)
+{
+    uint32_t i;
+    uint8_t  b;
+
+    if (_put_le32(fp, diff_len) || _put_le32(fp, extra_len) || _put_le32(fp, (uint32_t)seek)) {
+        return -1;
+    }
+
+    for (i = 0; i < diff_len; i++) {
+        b = (uint8_t)(dst[i] - src[i]);
+        if (fputc(b, fp) == EOF) {
+            return -1;
+        }
+    }
+
+    return fwrite(dst + diff_len, 1, extra_len, fp) == extra_len ? 0 : -1;
+}
+
+/* bsdiff main loop, with records written as QDIFF records */
+static int _qdiff(const QdiffIndex *idx, const uint8_t *dst, uint32_t dst_len, FILE *fp)
+{
+    const uint8_t *src     = idx->src;
+    uint32_t       src_len = idx->src_len;
+    uint32_t       scan = 0, len = 0, pos = 0, last_scan = 0, last_pos = 0, scsc;
+    int64_t        last_offset = 0;
+    uint32_t       lenf, lenb, overlap, lens, i;
+    int64_t        s, sf, sb, ss;
+    uint32_t       old_score;
+
+    if (fwrite(QDIFF_MAGIC, 1, 4, fp) != 4 || _put_le32(fp, dst_len) || _put_le32(fp, src_len)) {
+        return -1;
+    }
+
+    while (scan < dst_len) {
+        old_score = 0;
+        for (scsc = scan += len; scan < dst_len; scan++) {
+            len = _search(idx, dst + scan, dst_len - scan, &pos);
+
+            for (; scsc < scan + len; scsc++) {
+                if (scsc + last_offset < src_len && src[scsc + last_offset] == dst[scsc]) {
+                    old_score++;
+                }
+            }
+
+            if ((len == old_score && len != 0) || len > old_score + QDIFF_MATCH_SLACK) {
+                break;
+            }
+
+            if (scan + last_offset < src_len && src[scan + last_offset] == dst[scan]) {
+                old_score--;
+            }
+        }
+
+        if (len == old_score && scan != dst_len) {
+            continue;
+        }
+
+        // extend the last match forward and the new one backward, allowing mismatches
+        s = sf = 0;
+        lenf   = 0;
+        for (i = 0; last_scan + i < scan && last_pos + i < src_len;) {
+            if (src[last_pos + i] == dst[last_scan + i]) {
+                s++;
+            }
+            i++;
+            if (s * 2 - i > sf * 2 - lenf) {
+                sf   = s;
+                lenf = i;
+            }
+        }
+
+        lenb = 0;
+        if (scan < dst_len) {
+            s = sb = 0;
+            for (i = 1; scan >= last_scan + i && pos >= i; i++) {
+                if (src[pos - i] == dst[scan - i]) {
+                    s++;
+                }
+                if (s * 2 - i > sb * 2 - lenb) {
+                    sb   = s;
+                    lenb = i;
+                }
+            }
+        }
+
+        if (last_scan + lenf > scan - lenb) {
+            overlap = (last_scan + lenf) - (scan - lenb);
+            s = ss = 0;
+            lens   = 0;
+            for (i = 0; i < overlap; i++) {
+                if (dst[last_scan + lenf - overlap + i] == src[last_pos + lenf - overlap + i]) {
+                    s++;
+                }
+                if (dst[scan - lenb + i] == src[pos - lenb + i]) {
+                    s--;
+                }
+                if (s > ss) {
+                    ss   = s;
+                    lens = i + 1;
+                }
+            }
+            lenf += lens - overlap;
+            lenb -= lens;
+        }
+
+        if (_put_record(fp, src + last_pos, dst + last_scan, lenf, (scan - lenb) - (last_scan + lenf),
+                        (int32_t)((int64_t)(pos - lenb) - (last_pos + lenf)))) {
+            return -1;
+        }
+
+        last_scan   = scan - lenb;
+        last_pos    = pos - lenb;
+        last_offset = (int64_t)pos - scan;
+    }
+
+    return 0;
+}
+
+static uint8_t *_read_file(const char *path, uint32_t *len)
+{
+    FILE *   fp = fopen(path, "rb");
+    uint8_t *buf;
+    long     size;
+
+    if (NULL == fp) {
+        perror(path);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+    if (size < 0 || size > INT32_MAX) {
+        fprintf(stderr, "%s: size %ld is not supported\n", path, size);
+        fclose(fp);
+        return NULL;
+    }
+
+    // one more byte so that an empty file is not NULL
+    buf = malloc(size + 1);
+    if (NULL == buf || fread(buf, 1, size, fp) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", path);
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+    *len = (uint32_t)size;
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    QdiffIndex idx;
+    uint8_t *  src, *dst;
+    uint32_t   src_len, dst_len;
+    FILE *     fp;
+    long       patch_len;
+    int        rc;
+
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <old file> <new file> <patch file>\n", argv[0]);
+        return 2;
+    }
+
+    src = _read_file(argv[1], &src_len);
+    dst = _read_file(argv[2], &dst_len);
+    if (NULL == src || NULL == dst) {
+        return 1;
+    }
+
+    if (_index_build(&idx, src, src_len)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    fp = fopen(argv[3], "wb");
+    if (NULL == fp) {
+        perror(argv[3]);
+        return 1;
+    }
+
+    rc        = _qdiff(&idx, dst, dst_len, fp);
+    patch_len = ftell(fp);
+    if (fclose(fp) || rc) {
+        fprintf(stderr, "%s: write failed\n", argv[3]);
+        remove(argv[3]);
+        return 1;
+    }
+
+    printf("%s: %u -> %u bytes, patch %ld bytes\n", argv[3], src_len, dst_len, patch_len);
+    free(idx.head);
+    free(idx.prev);
+    free(src);
+    free(dst);
+    return 0;
+}